@@ -29,6 +29,20 @@ fxc shaders\tex2vid.hlsl %CS_FXCOPTS% /D AV_PIX_FMT_NV21=1 /D AVCOL_SPC_BT709=1
 
 fxc shaders\tex2vid.hlsl %CS_FXCOPTS% /D AV_PIX_FMT_BGR0=1 /D AVCOL_SPC_RGB=1 /Fo %OUTDIR%\b44000e74095a254ef98a2cdfcbaf015ab6c295e
 
+REM Same conversions with the last motion sample added.
+
+fxc shaders\tex2vid.hlsl %CS_FXCOPTS% /D MOSAMPLE_FUSED=1 /D AV_PIX_FMT_YUV420P=1 /D AVCOL_SPC_BT470BG=1 /Fo %OUTDIR%\e0b777d953b69bb6b7297fe8b2961d9ae804b8f8
+fxc shaders\tex2vid.hlsl %CS_FXCOPTS% /D MOSAMPLE_FUSED=1 /D AV_PIX_FMT_YUV444P=1 /D AVCOL_SPC_BT470BG=1 /Fo %OUTDIR%\0c6aa8f1296b89f0b3f97c8159e18705eca1122f
+fxc shaders\tex2vid.hlsl %CS_FXCOPTS% /D MOSAMPLE_FUSED=1 /D AV_PIX_FMT_NV12=1 /D AVCOL_SPC_BT470BG=1 /Fo %OUTDIR%\210b20b41ffef536e6304b6ac824859a84a23756
+fxc shaders\tex2vid.hlsl %CS_FXCOPTS% /D MOSAMPLE_FUSED=1 /D AV_PIX_FMT_NV21=1 /D AVCOL_SPC_BT470BG=1 /Fo %OUTDIR%\081be158c6389b080eee97440f5b56f26bd30955
+
+fxc shaders\tex2vid.hlsl %CS_FXCOPTS% /D MOSAMPLE_FUSED=1 /D AV_PIX_FMT_YUV420P=1 /D AVCOL_SPC_BT709=1 /Fo %OUTDIR%\6a18d0b01461e3c878a15bcbed8015308d1578c6
+fxc shaders\tex2vid.hlsl %CS_FXCOPTS% /D MOSAMPLE_FUSED=1 /D AV_PIX_FMT_YUV444P=1 /D AVCOL_SPC_BT709=1 /Fo %OUTDIR%\b57e51b53aaaee428ba4588b214cd492b22b6692
+fxc shaders\tex2vid.hlsl %CS_FXCOPTS% /D MOSAMPLE_FUSED=1 /D AV_PIX_FMT_NV12=1 /D AVCOL_SPC_BT709=1 /Fo %OUTDIR%\35ba58072262420c07256f59a73f8c4789f0bd2a
+fxc shaders\tex2vid.hlsl %CS_FXCOPTS% /D MOSAMPLE_FUSED=1 /D AV_PIX_FMT_NV21=1 /D AVCOL_SPC_BT709=1 /Fo %OUTDIR%\af1f0f783d0d14dba169653492035c04da2fe48a
+
+fxc shaders\tex2vid.hlsl %CS_FXCOPTS% /D MOSAMPLE_FUSED=1 /D AV_PIX_FMT_BGR0=1 /D AVCOL_SPC_RGB=1 /Fo %OUTDIR%\a17fb74ce1b26b1cddd58bfdb942e4db3974bfe3
+
 fxc shaders\motion_sample.hlsl %CS_FXCOPTS% /Fo %OUTDIR%\c52620855f15b2c47b8ca24b890850a90fdc7017
 
 fxc shaders\text.hlsl %VS_FXCOPTS% /D TEXT_VS /Fo %OUTDIR%\34e7f561dcf7ccdd3b8f1568ebdbf4299b54f07d
@@ -7,6 +7,7 @@ mkdir publish_temp\svr
 
 copy /Y ".\bin\svr_game.dll" "publish_temp\svr\"
 copy /Y ".\bin\svr_launcher.exe" "publish_temp\svr\"
+copy /Y ".\bin\svr_encoder.exe" "publish_temp\svr\"
 copy /Y ".\bin\ffmpeg.exe" "publish_temp\svr\"
 xcopy /Q /E ".\bin\data\" "publish_temp\svr\data\"
 copy /Y ".\update.cmd" "publish_temp\svr\"
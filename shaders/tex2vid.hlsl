@@ -7,6 +7,32 @@
 // Input texture based in BGRA unorm format (0.0 to 1.0).
 Texture2D<float4> input_texture : register(t0);
 
+#if MOSAMPLE_FUSED
+
+// With motion blur, the input texture is the work texture and the last sample of the frame is added here instead of in
+// motion_sample.hlsl. This way the work texture does not have to be written and read again before the conversion.
+// The sum is the same as in motion_sample.hlsl.
+
+Texture2D<unorm float4> sample_texture : register(t1);
+
+cbuffer mosample_buffer_0 : register(b0)
+{
+    float mosample_weight;
+};
+
+#endif
+
+float4 load_input(uint3 dtid, uint2 offset)
+{
+    uint3 pos = uint3(dtid.xy + offset, 0);
+
+    #if MOSAMPLE_FUSED
+    return input_texture.Load(pos) + (sample_texture.Load(pos) * mosample_weight);
+    #else
+    return input_texture.Load(pos);
+    #endif
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 
 uint3 convert_rgb_to_yuv(float3 rgb)
@@ -41,7 +67,7 @@ float4 average_nearby_for_yuv(uint3 dtid)
     uint height;
     input_texture.GetDimensions(width, height);
 
-    float4 base = input_texture.Load(dtid);
+    float4 base = load_input(dtid, uint2(0, 0));
 
     float4 topright;
     float4 botleft;
@@ -49,7 +75,7 @@ float4 average_nearby_for_yuv(uint3 dtid)
 
     if (dtid.x + 1 < width)
     {
-        topright = input_texture.Load(dtid, int2(1, 0));
+        topright = load_input(dtid, uint2(1, 0));
     }
 
     else
@@ -59,7 +85,7 @@ float4 average_nearby_for_yuv(uint3 dtid)
 
     if (dtid.y + 1 < height)
     {
-        botleft = input_texture.Load(dtid, int2(0, 1));
+        botleft = load_input(dtid, uint2(0, 1));
     }
 
     else
@@ -69,7 +95,7 @@ float4 average_nearby_for_yuv(uint3 dtid)
 
     if (dtid.x + 1 < width && dtid.y + 1 < height)
     {
-        botright = input_texture.Load(dtid, int2(1, 1));
+        botright = load_input(dtid, uint2(1, 1));
     }
 
     else
@@ -93,6 +119,13 @@ float4 average_nearby_for_yuv(uint3 dtid)
     return (base + topright + botleft + botright) / 4.0;
 }
 
+// For subsampled chroma, all 4 threads of a 2x2 block would write to the same chroma location with different values.
+// Only let the top left thread write so the result is not dependent on thread ordering (and matches the CPU conversion).
+bool is_chroma_thread(uint3 dtid)
+{
+    return ((dtid.x & 1) == 0) && ((dtid.y & 1) == 0);
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 
 #if AV_PIX_FMT_YUV420P
@@ -109,8 +142,12 @@ void proc(uint3 dtid)
     float4 pix = average_nearby_for_yuv(dtid);
     uint3 yuv = convert_rgb_to_yuv(pix.xyz);
     output_texture_y[dtid.xy] = yuv.x;
-    output_texture_u[dtid.xy >> 1] = yuv.y;
-    output_texture_v[dtid.xy >> 1] = yuv.z;
+
+    if (is_chroma_thread(dtid))
+    {
+        output_texture_u[dtid.xy >> 1] = yuv.y;
+        output_texture_v[dtid.xy >> 1] = yuv.z;
+    }
 }
 
 #endif
@@ -127,7 +164,7 @@ RWTexture2D<uint> output_texture_v : register(u2);
 
 void proc(uint3 dtid)
 {
-    float4 pix = input_texture[dtid.xy];
+    float4 pix = load_input(dtid, uint2(0, 0));
     uint3 yuv = convert_rgb_to_yuv(pix.xyz);
     output_texture_y[dtid.xy] = yuv.x;
     output_texture_u[dtid.xy] = yuv.y;
@@ -151,7 +188,11 @@ void proc(uint3 dtid)
     float4 pix = average_nearby_for_yuv(dtid);
     uint3 yuv = convert_rgb_to_yuv(pix.xyz);
     output_texture_y[dtid.xy] = yuv.x;
-    output_texture_uv[dtid.xy >> 1] = uint2(yuv.yz);
+
+    if (is_chroma_thread(dtid))
+    {
+        output_texture_uv[dtid.xy >> 1] = uint2(yuv.yz);
+    }
 }
 
 #endif
@@ -172,7 +213,11 @@ void proc(uint3 dtid)
     float4 pix = average_nearby_for_yuv(dtid);
     uint3 yuv = convert_rgb_to_yuv(pix.xyz);
     output_texture_y[dtid.xy] = yuv.x;
-    output_texture_vu[dtid.xy >> 1] = uint2(yuv.zy);
+
+    if (is_chroma_thread(dtid))
+    {
+        output_texture_vu[dtid.xy >> 1] = uint2(yuv.zy);
+    }
 }
 
 #endif
@@ -187,7 +232,7 @@ RWTexture2D<uint4> output_texture_rgb : register(u0);
 
 void proc(uint3 dtid)
 {
-    float4 pix = input_texture.Load(dtid);
+    float4 pix = load_input(dtid, uint2(0, 0));
     output_texture_rgb[dtid.xy] = uint4(float4(pix.zyx, 1) * 255.0);
 }
 
@@ -0,0 +1,1034 @@
+#include "svr_common.h"
+#include <Windows.h>
+#include <strsafe.h>
+#include "svr_capture.h"
+#include "svr_net.h"
+#include <stdio.h>
+#include <malloc.h>
+#include <ctype.h>
+
+// Encoder process (svr_encoder.exe), which is started by the user and not the game.
+//
+// This is the batch encoder for intermediate captures (see svr_capture.h):
+// svr_encoder.exe --transcode <processes> <capture files...>
+//
+// And the encode worker that encodes parts of movies for games on other computers (see svr_net.h):
+// svr_encoder.exe --worker <address>[:port] <secret>
+
+const s32 ENCODER_EXIT_ARGS = 1;
+const s32 ENCODER_EXIT_TRANSCODE = 2;
+const s32 ENCODER_EXIT_PROC = 3;
+const s32 ENCODER_EXIT_WRITE = 4;
+const s32 ENCODER_EXIT_NET = 5;
+
+// Same as in the game.
+const s32 MAX_PIPE_BUFFER_SIZE = 8 * 1024 * 1024;
+
+// -------------------------------------------------
+// Transcoding of intermediate captures.
+
+// A capture is split into as many parts as there are processes, at keyframes. Every part is decompressed by its own thread
+// and given to its own ffmpeg, and the parts are joined into the movie at the end.
+
+struct TranscodePart
+{
+    HANDLE thread;
+
+    const char* capture_path;
+    SvrCaptureHeader* header;
+    SvrCaptureIndexEntry* entries;
+
+    // Range of index entries.
+    s32 start;
+    s32 end;
+
+    char dest_path[MAX_PATH];
+    s32 num_threads;
+
+    bool ok;
+};
+
+// Starts ffmpeg for a part, which reads the frames from a pipe that we write to.
+bool start_transcode_proc(TranscodePart* part, HANDLE* write_pipe, HANDLE* proc)
+{
+    const s32 FULL_ARGS_SIZE = 1024;
+    const s32 ARGS_BUF_SIZE = 128;
+
+    bool ret = false;
+
+    HANDLE read_h = NULL;
+
+    SECURITY_ATTRIBUTES sa;
+    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
+    sa.lpSecurityDescriptor = NULL;
+    sa.bInheritHandle = TRUE;
+
+    STARTUPINFOA start_info = {};
+    PROCESS_INFORMATION proc_info;
+
+    char full_args[FULL_ARGS_SIZE];
+    char buf[ARGS_BUF_SIZE];
+
+    if (!CreatePipe(&read_h, write_pipe, &sa, (DWORD)svr_min(part->header->frame_size, MAX_PIPE_BUFFER_SIZE)))
+    {
+        goto rfail;
+    }
+
+    SetHandleInformation(*write_pipe, HANDLE_FLAG_INHERIT, 0);
+
+    start_info.cb = sizeof(STARTUPINFOA);
+    start_info.hStdInput = read_h;
+    start_info.dwFlags = STARTF_USESTDHANDLES;
+
+    StringCchCopyA(full_args, FULL_ARGS_SIZE, "ffmpeg.exe -hide_banner -loglevel quiet");
+    StringCchCatA(full_args, FULL_ARGS_SIZE, part->header->input_args);
+    StringCchCatA(full_args, FULL_ARGS_SIZE, " -y -i -");
+
+    StringCchPrintfA(buf, ARGS_BUF_SIZE, " -threads %d", part->num_threads);
+    StringCchCatA(full_args, FULL_ARGS_SIZE, buf);
+
+    StringCchCatA(full_args, FULL_ARGS_SIZE, part->header->output_args);
+
+    StringCchCatA(full_args, FULL_ARGS_SIZE, " \"");
+    StringCchCatA(full_args, FULL_ARGS_SIZE, part->dest_path);
+    StringCchCatA(full_args, FULL_ARGS_SIZE, "\"");
+
+    if (!CreateProcessA("ffmpeg.exe", full_args, NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL, NULL, &start_info, &proc_info))
+    {
+        goto rfail;
+    }
+
+    *proc = proc_info.hProcess;
+    CloseHandle(proc_info.hThread);
+
+    ret = true;
+    goto rexit;
+
+rfail:
+    if (*write_pipe)
+    {
+        CloseHandle(*write_pipe);
+        *write_pipe = NULL;
+    }
+
+rexit:
+    if (read_h)
+    {
+        CloseHandle(read_h);
+    }
+
+    return ret;
+}
+
+DWORD WINAPI transcode_part_proc(LPVOID lpParameter)
+{
+    TranscodePart* part = (TranscodePart*)lpParameter;
+
+    s32 frame_size = part->header->frame_size;
+
+    HANDLE file = NULL;
+    HANDLE write_pipe = NULL;
+    HANDLE proc = NULL;
+
+    u8* source = (u8*)malloc(svr_capture_bound(frame_size));
+    u8* scratch = (u8*)malloc(frame_size);
+    u8* frame = (u8*)malloc(frame_size);
+
+    DWORD exit_code = 1;
+
+    // Every part reads by itself.
+    file = CreateFileA(part->capture_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        file = NULL;
+        goto rexit;
+    }
+
+    if (!start_transcode_proc(part, &write_pipe, &proc))
+    {
+        goto rexit;
+    }
+
+    for (s32 i = part->start; i < part->end; i++)
+    {
+        SvrCaptureIndexEntry& entry = part->entries[i];
+
+        LARGE_INTEGER pos;
+        pos.QuadPart = entry.offset + sizeof(SvrCaptureRecord);
+
+        DWORD read;
+
+        if (!SetFilePointerEx(file, pos, NULL, FILE_BEGIN) || !ReadFile(file, source, entry.size, &read, NULL) || read != (DWORD)entry.size)
+        {
+            goto rexit;
+        }
+
+        // The part starts at a keyframe so the frame before is always there.
+        if (!svr_capture_decompress(source, entry.size, (entry.flags & SVR_CAPTURE_KEYFRAME) != 0, frame_size, scratch, frame))
+        {
+            goto rexit;
+        }
+
+        // Raw video has no way of saying that a frame is repeated, so the same data is written again.
+        for (s32 j = 0; j < entry.num_frames; j++)
+        {
+            if (!WriteFile(write_pipe, frame, frame_size, NULL, NULL))
+            {
+                goto rexit;
+            }
+        }
+    }
+
+    // Closing the pipe will make ffmpeg exit.
+    CloseHandle(write_pipe);
+    write_pipe = NULL;
+
+    WaitForSingleObject(proc, INFINITE);
+    GetExitCodeProcess(proc, &exit_code);
+
+    part->ok = exit_code == 0;
+
+rexit:
+    if (write_pipe) CloseHandle(write_pipe);
+
+    if (proc)
+    {
+        WaitForSingleObject(proc, INFINITE);
+        CloseHandle(proc);
+    }
+
+    if (file) CloseHandle(file);
+
+    free(source);
+    free(scratch);
+    free(frame);
+
+    return 0;
+}
+
+// Captures where the game stopped before the index was written are gone through record by record.
+SvrCaptureIndexEntry* rebuild_capture_index(HANDLE file, SvrCaptureHeader* header, s32* num_entries)
+{
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+
+    s32 capacity = 4096;
+    SvrCaptureIndexEntry* entries = (SvrCaptureIndexEntry*)malloc(sizeof(SvrCaptureIndexEntry) * capacity);
+
+    s32 num = 0;
+    s64 offset = sizeof(SvrCaptureHeader);
+
+    while (true)
+    {
+        SvrCaptureRecord record;
+        DWORD read;
+
+        LARGE_INTEGER pos;
+        pos.QuadPart = offset;
+
+        if (!SetFilePointerEx(file, pos, NULL, FILE_BEGIN) || !ReadFile(file, &record, sizeof(SvrCaptureRecord), &read, NULL) || read != sizeof(SvrCaptureRecord))
+        {
+            break;
+        }
+
+        // The last record may be cut off.
+        if (record.size <= 0 || record.size > svr_capture_bound(header->frame_size) || record.num_frames <= 0)
+        {
+            break;
+        }
+
+        if (offset + (s64)sizeof(SvrCaptureRecord) + record.size > file_size.QuadPart)
+        {
+            break;
+        }
+
+        if (num == capacity)
+        {
+            capacity *= 2;
+            entries = (SvrCaptureIndexEntry*)realloc(entries, sizeof(SvrCaptureIndexEntry) * capacity);
+        }
+
+        SvrCaptureIndexEntry& entry = entries[num];
+        entry = {};
+        entry.offset = offset;
+        entry.size = record.size;
+        entry.num_frames = record.num_frames;
+        entry.flags = record.flags;
+
+        num++;
+        offset += sizeof(SvrCaptureRecord) + record.size;
+    }
+
+    *num_entries = num;
+    return entries;
+}
+
+// Joins the parts into the movie and adds the audio. The video is copied.
+bool join_transcode_parts(const char* movie_path, const char* audio_path, SvrCaptureHeader* header, s32 num_parts)
+{
+    const s32 FULL_ARGS_SIZE = 2048;
+    const s32 ARGS_BUF_SIZE = 128;
+
+    char list_path[MAX_PATH];
+    StringCchPrintfA(list_path, MAX_PATH, "%s.parts.txt", movie_path);
+
+    if (!svr_write_part_list(list_path, movie_path, num_parts))
+    {
+        printf("Could not create part list %s\n", list_path);
+        return false;
+    }
+
+    char full_args[FULL_ARGS_SIZE];
+    char buf[ARGS_BUF_SIZE];
+
+    StringCchCopyA(full_args, FULL_ARGS_SIZE, "ffmpeg.exe -hide_banner -loglevel quiet");
+
+    // The paths in the list are full paths, which are not allowed by default.
+    StringCchCatA(full_args, FULL_ARGS_SIZE, " -f concat -safe 0 -i \"");
+    StringCchCatA(full_args, FULL_ARGS_SIZE, list_path);
+    StringCchCatA(full_args, FULL_ARGS_SIZE, "\"");
+
+    if (audio_path)
+    {
+        StringCchCatA(full_args, FULL_ARGS_SIZE, " -f s16le -ar 44100 -ac 2 -i \"");
+        StringCchCatA(full_args, FULL_ARGS_SIZE, audio_path);
+        StringCchCatA(full_args, FULL_ARGS_SIZE, "\" -map 0:v -map 1:a");
+    }
+
+    StringCchCatA(full_args, FULL_ARGS_SIZE, " -vcodec copy");
+
+    if (audio_path)
+    {
+        StringCchPrintfA(buf, ARGS_BUF_SIZE, " -acodec aac -b:a %dk", header->audio_bitrate);
+        StringCchCatA(full_args, FULL_ARGS_SIZE, buf);
+    }
+
+    StringCchCatA(full_args, FULL_ARGS_SIZE, " -y \"");
+    StringCchCatA(full_args, FULL_ARGS_SIZE, movie_path);
+    StringCchCatA(full_args, FULL_ARGS_SIZE, "\"");
+
+    STARTUPINFOA start_info = {};
+    start_info.cb = sizeof(STARTUPINFOA);
+
+    PROCESS_INFORMATION proc_info;
+    DWORD exit_code = 1;
+
+    if (CreateProcessA("ffmpeg.exe", full_args, NULL, NULL, FALSE, CREATE_NO_WINDOW, NULL, NULL, &start_info, &proc_info))
+    {
+        CloseHandle(proc_info.hThread);
+
+        WaitForSingleObject(proc_info.hProcess, INFINITE);
+        GetExitCodeProcess(proc_info.hProcess, &exit_code);
+        CloseHandle(proc_info.hProcess);
+    }
+
+    DeleteFileA(list_path);
+
+    return exit_code == 0;
+}
+
+bool transcode_capture(const char* capture_path, s32 num_procs)
+{
+    bool ret = false;
+
+    SvrCaptureHeader header;
+    SvrCaptureIndexEntry* entries = NULL;
+    s32 num_entries = 0;
+
+    TranscodePart* parts = NULL;
+    s32 num_parts = 0;
+
+    s64 total_frames = 0;
+    s64 part_frames = 0;
+
+    char movie_path[MAX_PATH];
+    char audio_path[MAX_PATH];
+    DWORD read;
+
+    size_t path_len = strlen(capture_path);
+    size_t ext_len = strlen(SVR_CAPTURE_EXTENSION);
+
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+
+    // The movie is the name of the capture without the extension.
+    if (path_len <= ext_len || _stricmp(capture_path + path_len - ext_len, SVR_CAPTURE_EXTENSION))
+    {
+        printf("%s is not a capture\n", capture_path);
+        return false;
+    }
+
+    StringCchCopyNA(movie_path, MAX_PATH, capture_path, path_len - ext_len);
+
+    HANDLE file = CreateFileA(capture_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        printf("Could not open %s (%lu)\n", capture_path, GetLastError());
+        return false;
+    }
+
+    if (!ReadFile(file, &header, sizeof(SvrCaptureHeader), &read, NULL) || read != sizeof(SvrCaptureHeader) || header.magic != SVR_CAPTURE_MAGIC)
+    {
+        printf("%s is not a capture\n", capture_path);
+        goto rexit;
+    }
+
+    if (header.version != SVR_CAPTURE_VERSION)
+    {
+        printf("%s is from a different version of SVR\n", capture_path);
+        goto rexit;
+    }
+
+    if (header.index_offset != 0)
+    {
+        LARGE_INTEGER pos;
+        pos.QuadPart = header.index_offset;
+
+        num_entries = header.num_records;
+        entries = (SvrCaptureIndexEntry*)malloc(sizeof(SvrCaptureIndexEntry) * num_entries);
+
+        DWORD size = sizeof(SvrCaptureIndexEntry) * num_entries;
+
+        if (!SetFilePointerEx(file, pos, NULL, FILE_BEGIN) || !ReadFile(file, entries, size, &read, NULL) || read != size)
+        {
+            printf("Could not read the index of %s\n", capture_path);
+            goto rexit;
+        }
+    }
+
+    else
+    {
+        entries = rebuild_capture_index(file, &header, &num_entries);
+        printf("%s was not finished, the frames that are there are used\n", capture_path);
+    }
+
+    for (s32 i = 0; i < num_entries; i++)
+    {
+        total_frames += entries[i].num_frames;
+    }
+
+    if (total_frames == 0)
+    {
+        printf("%s has no frames\n", capture_path);
+        goto rexit;
+    }
+
+    // Split at the keyframe after every equal share of the frames.
+    parts = (TranscodePart*)calloc(num_procs, sizeof(TranscodePart));
+
+    for (s32 i = 0; i < num_entries; i++)
+    {
+        bool split = (entries[i].flags & SVR_CAPTURE_KEYFRAME) && part_frames >= (total_frames * num_parts) / num_procs;
+
+        if (i == 0 || (split && num_parts < num_procs))
+        {
+            if (num_parts > 0)
+            {
+                parts[num_parts - 1].end = i;
+            }
+
+            parts[num_parts].start = i;
+            num_parts++;
+        }
+
+        part_frames += entries[i].num_frames;
+    }
+
+    parts[num_parts - 1].end = num_entries;
+
+    printf("Encoding %s (%lld frames) in %d parts\n", capture_path, total_frames, num_parts);
+
+    for (s32 i = 0; i < num_parts; i++)
+    {
+        TranscodePart& part = parts[i];
+        part.capture_path = capture_path;
+        part.header = &header;
+        part.entries = entries;
+
+        // x264 uses 1.5 threads per core on its own, which is split between the processes.
+        part.num_threads = (s32)(info.dwNumberOfProcessors * 3 / 2) / num_parts;
+        svr_clamp(&part.num_threads, 1, INT32_MAX);
+
+        svr_build_part_path(movie_path, i, part.dest_path, MAX_PATH);
+
+        part.thread = CreateThread(NULL, 0, transcode_part_proc, &part, 0, NULL);
+    }
+
+    ret = true;
+
+    for (s32 i = 0; i < num_parts; i++)
+    {
+        WaitForSingleObject(parts[i].thread, INFINITE);
+        CloseHandle(parts[i].thread);
+
+        if (!parts[i].ok)
+        {
+            printf("Could not encode part %d\n", i + 1);
+            ret = false;
+        }
+    }
+
+    if (ret)
+    {
+        svr_capture_build_audio_path(capture_path, audio_path, MAX_PATH);
+
+        if (!join_transcode_parts(movie_path, header.audio_bitrate > 0 ? audio_path : NULL, &header, num_parts))
+        {
+            printf("Could not join the parts of %s, they are kept next to it\n", movie_path);
+            ret = false;
+        }
+    }
+
+    if (ret)
+    {
+        for (s32 i = 0; i < num_parts; i++)
+        {
+            DeleteFileA(parts[i].dest_path);
+        }
+
+        printf("Encoded %s\n", movie_path);
+    }
+
+rexit:
+    CloseHandle(file);
+
+    free(entries);
+    free(parts);
+
+    return ret;
+}
+
+s32 transcode_main(s32 argc, char** argv)
+{
+    if (argc < 4)
+    {
+        printf("Usage: svr_encoder.exe --transcode <processes> <capture files...>\n");
+        return ENCODER_EXIT_ARGS;
+    }
+
+    s32 num_procs = atoi(argv[2]);
+    svr_clamp(&num_procs, 1, 64);
+
+    s32 ret = 0;
+
+    // One after the other, as every capture already uses all of the processes.
+    for (s32 i = 3; i < argc; i++)
+    {
+        if (!transcode_capture(argv[i], num_procs))
+        {
+            ret = ENCODER_EXIT_TRANSCODE;
+        }
+    }
+
+    return ret;
+}
+
+// -------------------------------------------------
+// Encode worker.
+
+// Started by the user on another computer with svr_encoder.exe --worker <address>[:port] <secret>, in an SVR directory there so that
+// ffmpeg is next to it. The address is the IP address of the network card that the games are on, and the secret is the same as
+// encoder_workers_secret in the profile of the games.
+// Every connection is a lane of a game, and has a thread here that encodes one part at a time with an ffmpeg of its own (see svr_net.h).
+// The part is written to a file here and sent back when ffmpeg is done, as most containers cannot be written to a pipe.
+
+struct WorkerConn
+{
+    SvrNetConn conn;
+    s32 id;
+};
+
+const char* worker_secret;
+
+// For the names of the part files, as every connection can have a part at the same time.
+LONG worker_part_counter;
+
+// Values that SVR can make (see PXCONV_FFMPEG_TEXT_TABLE in game_proc_ffmpeg.cpp and the tables in game_proc_profile.cpp).
+// Nothing else is given to ffmpeg.
+
+const char* WORKER_EXTENSIONS[] = {
+    ".mp4",
+    ".mkv",
+    ".mov",
+};
+
+const char* WORKER_PIX_FMTS[] = {
+    "yuv420p",
+    "yuv444p",
+    "nv12",
+    "nv21",
+    "bgr0",
+};
+
+const char* WORKER_COLOR_SPACES[] = {
+    "",
+    "bt470bg",
+    "bt709",
+};
+
+const char* WORKER_CODECS[] = {
+    "libx264",
+    "libx264rgb",
+};
+
+const char* WORKER_PRESETS[] = {
+    "ultrafast",
+    "superfast",
+    "veryfast",
+    "faster",
+    "fast",
+    "medium",
+    "slow",
+    "slower",
+    "veryslow",
+    "placebo",
+};
+
+bool is_worker_name(char* name, const char** list, s32 num)
+{
+    // The names come from the network and may not end.
+    name[SVR_NET_MAX_NAME - 1] = 0;
+
+    for (s32 i = 0; i < num; i++)
+    {
+        if (!strcmp(name, list[i]))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool check_worker_part(SvrNetPartStart* start)
+{
+    #define WORKER_NAME(NAME, LIST) is_worker_name(NAME, LIST, SVR_ARRAY_SIZE(LIST))
+
+    bool names = WORKER_NAME(start->extension, WORKER_EXTENSIONS) && WORKER_NAME(start->pix_fmt, WORKER_PIX_FMTS)
+        && WORKER_NAME(start->color_space, WORKER_COLOR_SPACES) && WORKER_NAME(start->codec, WORKER_CODECS)
+        && WORKER_NAME(start->preset, WORKER_PRESETS);
+
+    #undef WORKER_NAME
+
+    if (!names)
+    {
+        return false;
+    }
+
+    if (start->width < 1 || start->width > 8192 || start->height < 1 || start->height > 8192 || start->fps < 1 || start->fps > 1000)
+    {
+        return false;
+    }
+
+    if (start->crf < 0 || start->crf > 52 || start->intra < 0 || start->intra > 1 || start->queue_frames < 0 || start->queue_frames > 100000)
+    {
+        return false;
+    }
+
+    // A frame is never larger than 4 bytes per pixel, which also limits how much memory a game can have this take.
+    return start->frame_size > 0 && start->frame_size <= start->width * start->height * 4;
+}
+
+// Same arguments as build_ffmpeg_process_args in the game makes for a part without audio.
+void build_worker_args(SvrNetPartStart* start, const char* dest_path, char* full_args, s32 full_args_size)
+{
+    const s32 ARGS_BUF_SIZE = 128;
+
+    char buf[ARGS_BUF_SIZE];
+
+    StringCchCopyA(full_args, full_args_size, "ffmpeg.exe -hide_banner -loglevel quiet -f rawvideo -vcodec rawvideo");
+
+    StringCchPrintfA(buf, ARGS_BUF_SIZE, " -pix_fmt %s -s %dx%d -r %d", start->pix_fmt, start->width, start->height, start->fps);
+    StringCchCatA(full_args, full_args_size, buf);
+
+    if (start->queue_frames > 0)
+    {
+        StringCchPrintfA(buf, ARGS_BUF_SIZE, " -thread_queue_size %d", start->queue_frames);
+        StringCchCatA(full_args, full_args_size, buf);
+    }
+
+    // The encoder has all the cores here.
+    StringCchCatA(full_args, full_args_size, " -y -i - -threads 0");
+
+    StringCchPrintfA(buf, ARGS_BUF_SIZE, " -vcodec %s", start->codec);
+    StringCchCatA(full_args, full_args_size, buf);
+
+    if (start->color_space[0])
+    {
+        StringCchPrintfA(buf, ARGS_BUF_SIZE, " -colorspace %s", start->color_space);
+        StringCchCatA(full_args, full_args_size, buf);
+    }
+
+    StringCchPrintfA(buf, ARGS_BUF_SIZE, " -framerate %d -crf %d -preset %s", start->fps, start->crf, start->preset);
+    StringCchCatA(full_args, full_args_size, buf);
+
+    if (start->intra)
+    {
+        StringCchCatA(full_args, full_args_size, " -x264-params keyint=1");
+    }
+
+    StringCchPrintfA(buf, ARGS_BUF_SIZE, " \"%s\"", dest_path);
+    StringCchCatA(full_args, full_args_size, buf);
+}
+
+// Same as start_transcode_proc but with the arguments made from what the game sent.
+bool start_worker_proc(SvrNetPartStart* start, const char* dest_path, HANDLE* write_pipe, HANDLE* proc)
+{
+    const s32 FULL_ARGS_SIZE = 2048;
+
+    bool ret = false;
+
+    HANDLE read_h = NULL;
+
+    SECURITY_ATTRIBUTES sa;
+    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
+    sa.lpSecurityDescriptor = NULL;
+    sa.bInheritHandle = TRUE;
+
+    STARTUPINFOA start_info = {};
+    PROCESS_INFORMATION proc_info;
+
+    char full_args[FULL_ARGS_SIZE];
+
+    if (!CreatePipe(&read_h, write_pipe, &sa, (DWORD)svr_min(start->frame_size, MAX_PIPE_BUFFER_SIZE)))
+    {
+        goto rfail;
+    }
+
+    SetHandleInformation(*write_pipe, HANDLE_FLAG_INHERIT, 0);
+
+    start_info.cb = sizeof(STARTUPINFOA);
+    start_info.hStdInput = read_h;
+    start_info.dwFlags = STARTF_USESTDHANDLES;
+
+    build_worker_args(start, dest_path, full_args, FULL_ARGS_SIZE);
+
+    if (!CreateProcessA("ffmpeg.exe", full_args, NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL, NULL, &start_info, &proc_info))
+    {
+        goto rfail;
+    }
+
+    *proc = proc_info.hProcess;
+    CloseHandle(proc_info.hThread);
+
+    ret = true;
+    goto rexit;
+
+rfail:
+    if (*write_pipe)
+    {
+        CloseHandle(*write_pipe);
+        *write_pipe = NULL;
+    }
+
+rexit:
+    if (read_h)
+    {
+        CloseHandle(read_h);
+    }
+
+    return ret;
+}
+
+// Sends the encoded part back in pieces.
+bool send_worker_part(SvrNetConn* conn, const char* path, u8* buf)
+{
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    bool ret = true;
+
+    while (true)
+    {
+        DWORD read = 0;
+
+        if (!ReadFile(file, buf, SVR_NET_CHUNK_SIZE, &read, NULL))
+        {
+            ret = false;
+            break;
+        }
+
+        if (read == 0)
+        {
+            break;
+        }
+
+        if (!svr_net_send(conn, SVR_NET_PART_DATA, 0, buf, (s32)read))
+        {
+            ret = false;
+            break;
+        }
+    }
+
+    CloseHandle(file);
+
+    return ret;
+}
+
+DWORD WINAPI worker_conn_proc(LPVOID lpParameter)
+{
+    WorkerConn* wc = (WorkerConn*)lpParameter;
+
+    // Made larger when a part has larger frames than this.
+    s32 buf_size = SVR_NET_CHUNK_SIZE;
+    u8* buf = (u8*)malloc(buf_size);
+
+    HANDLE write_pipe = NULL;
+    HANDLE proc = NULL;
+
+    char part_path[MAX_PATH];
+    s32 part = 0;
+    s32 frame_size = 0;
+
+    // Set when the part cannot be made. The frames are still taken so that the game does not wait forever, and the part fails at the end.
+    s32 part_error = 0;
+
+    bool in_part = false;
+
+    SvrNetHeader header;
+
+    // Connections that do not answer right away are not kept.
+    svr_net_set_timeout(&wc->conn, SVR_NET_TIMEOUT);
+
+    if (!svr_net_check_hello(&wc->conn, worker_secret))
+    {
+        printf("Connection %d did not have the secret or is of another version\n", wc->id);
+        goto rexit;
+    }
+
+    // The game can pause the movie for as long as it wants.
+    svr_net_set_timeout(&wc->conn, 0);
+
+    printf("Game %d connected\n", wc->id);
+
+    if (!svr_net_send(&wc->conn, SVR_NET_CREDIT, SVR_NET_CREDITS, NULL, 0))
+    {
+        goto rexit;
+    }
+
+    while (svr_net_recv(&wc->conn, &header, buf, buf_size))
+    {
+        if (header.type == SVR_NET_PART_START)
+        {
+            if (in_part || header.size != (s32)sizeof(SvrNetPartStart))
+            {
+                break;
+            }
+
+            SvrNetPartStart* start = (SvrNetPartStart*)buf;
+
+            if (!check_worker_part(start))
+            {
+                printf("Game %d sent a part that is not allowed\n", wc->id);
+                break;
+            }
+
+            part = start->part;
+            frame_size = start->frame_size;
+            part_error = 0;
+            in_part = true;
+
+            StringCchPrintfA(part_path, MAX_PATH, "svr_worker_%lu_%ld%s", GetCurrentProcessId(), InterlockedIncrement(&worker_part_counter), start->extension);
+
+            if (!start_worker_proc(start, part_path, &write_pipe, &proc))
+            {
+                printf("Could not start ffmpeg for part %d of game %d (%lu)\n", part + 1, wc->id, GetLastError());
+                part_error = ENCODER_EXIT_PROC;
+            }
+
+            // The buffer is not used after this for the start of the part.
+            if (frame_size > buf_size)
+            {
+                buf_size = frame_size;
+                buf = (u8*)realloc(buf, buf_size);
+            }
+        }
+
+        else if (header.type == SVR_NET_FRAME)
+        {
+            if (!in_part || header.size != frame_size)
+            {
+                break;
+            }
+
+            // Repeated frames are only sent once, but raw video has no way of saying that a frame is repeated so they are written again.
+            for (s32 i = 0; i < header.value && part_error == 0; i++)
+            {
+                if (!WriteFile(write_pipe, buf, frame_size, NULL, NULL))
+                {
+                    part_error = ENCODER_EXIT_WRITE;
+                }
+            }
+
+            if (!svr_net_send(&wc->conn, SVR_NET_CREDIT, 1, NULL, 0))
+            {
+                break;
+            }
+        }
+
+        else if (header.type == SVR_NET_PART_END)
+        {
+            if (!in_part)
+            {
+                break;
+            }
+
+            in_part = false;
+
+            DWORD exit_code = part_error;
+
+            if (proc)
+            {
+                // Closing the pipe will make ffmpeg exit.
+                CloseHandle(write_pipe);
+                write_pipe = NULL;
+
+                // The game would otherwise give up on a part that takes long to finish.
+                while (WaitForSingleObject(proc, SVR_NET_KEEPALIVE) == WAIT_TIMEOUT)
+                {
+                    svr_net_send(&wc->conn, SVR_NET_CREDIT, 0, NULL, 0);
+                }
+
+                if (part_error == 0)
+                {
+                    GetExitCodeProcess(proc, &exit_code);
+                }
+
+                CloseHandle(proc);
+                proc = NULL;
+            }
+
+            bool sent = exit_code != 0 || send_worker_part(&wc->conn, part_path, buf);
+
+            DeleteFileA(part_path);
+
+            if (!sent || !svr_net_send(&wc->conn, SVR_NET_PART_DONE, (s32)exit_code, NULL, 0))
+            {
+                break;
+            }
+
+            printf("Encoded part %d of game %d\n", part + 1, wc->id);
+        }
+
+        else
+        {
+            break;
+        }
+    }
+
+rexit:
+    // A part that was not finished is of no use to anyone.
+    if (proc)
+    {
+        CloseHandle(write_pipe);
+
+        WaitForSingleObject(proc, INFINITE);
+        CloseHandle(proc);
+
+        DeleteFileA(part_path);
+    }
+
+    printf("Game %d disconnected\n", wc->id);
+
+    svr_net_close(&wc->conn);
+
+    free(buf);
+    free(wc);
+
+    return 0;
+}
+
+s32 worker_main(s32 argc, char** argv)
+{
+    if (argc < 4)
+    {
+        printf("Usage: svr_encoder.exe --worker <address>[:port] <secret>\n");
+        printf("The address is the IP address of this computer on the network that the games are on. The port is %d if not given.\n", (s32)SVR_NET_DEFAULT_PORT);
+        return ENCODER_EXIT_ARGS;
+    }
+
+    const char* address = argv[2];
+    worker_secret = argv[3];
+
+    if (strlen(worker_secret) < SVR_NET_MIN_SECRET)
+    {
+        printf("The secret must be at least %d characters\n", SVR_NET_MIN_SECRET);
+        return ENCODER_EXIT_ARGS;
+    }
+
+    if (!svr_net_init())
+    {
+        printf("Could not start networking\n");
+        return ENCODER_EXIT_NET;
+    }
+
+    u64 listen_sock = svr_net_listen(address);
+
+    if (listen_sock == 0)
+    {
+        printf("Could not listen on %s\n", address);
+        return ENCODER_EXIT_NET;
+    }
+
+    printf("Waiting for games on %s\n", address);
+
+    s32 num_conns = 0;
+
+    while (true)
+    {
+        WorkerConn* wc = (WorkerConn*)calloc(1, sizeof(WorkerConn));
+
+        if (!svr_net_accept(listen_sock, &wc->conn))
+        {
+            printf("Could not accept connections anymore\n");
+            free(wc);
+            break;
+        }
+
+        num_conns++;
+        wc->id = num_conns;
+
+        // The thread owns the connection.
+        HANDLE thread = CreateThread(NULL, 0, worker_conn_proc, wc, 0, NULL);
+
+        if (thread == NULL)
+        {
+            svr_net_close(&wc->conn);
+            free(wc);
+            continue;
+        }
+
+        CloseHandle(thread);
+    }
+
+    svr_net_close_listen(listen_sock);
+
+    return ENCODER_EXIT_NET;
+}
+
+// -------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    if (argc >= 2 && !strcmp(argv[1], "--transcode"))
+    {
+        return transcode_main(argc, argv);
+    }
+
+    if (argc >= 2 && !strcmp(argv[1], "--worker"))
+    {
+        return worker_main(argc, argv);
+    }
+
+    printf("Usage:\n");
+    printf("svr_encoder.exe --transcode <processes> <capture files...>\n");
+    printf("svr_encoder.exe --worker <address>[:port] <secret>\n");
+
+    return ENCODER_EXIT_ARGS;
+}
@@ -8,9 +8,14 @@
 #include <assert.h>
 #include <intrin.h>
 #include "svr_prof.h"
-#include "svr_stream.h"
-#include "svr_sem.h"
 #include "game_proc_profile.h"
+#include "game_proc_ffmpeg.h"
+#include "svr_pxconv.h"
+#include "svr_mosample_sched.h"
+#include "svr_stage.h"
+#include "svr_trace.h"
+#include "svr_stats.h"
+#include "game_proc_report.h"
 #include <stb_sprintf.h>
 #include "svr_api.h"
 #include <Shlwapi.h>
@@ -21,24 +26,20 @@ using namespace DirectX;
 // Don't use fatal process ending errors in here as this is used both in standalone and in integration.
 // It is only standalone SVR that can do fatal processs ending errors.
 
-// Must be a power of 2.
-const s32 NUM_BUFFERED_DL_TEXS = 2;
+const s32 MAX_BUFFERED_DL_TEXS = MAX_PIPELINE_DEPTH;
 
-// Rotation of CPU textures to download to.
-struct CpuTexDl
+// CPU textures that converted frames are downloaded to.
+// These are used as a ring. A slot is copied to on the game thread and is mapped when the GPU is done with it (we try to not wait for this).
+// The mapped memory is then read by the serialize stage (or by the ffmpeg thread with encoder_direct_writes), and the slot is unmapped on the game thread when that is done.
+// The D3D11 context is only ever used by the game thread.
+struct DlSlot
 {
-    ID3D11Texture2D* texs[NUM_BUFFERED_DL_TEXS];
-    s32 i;
+    ID3D11Texture2D* texs[3];
+    D3D11_MAPPED_SUBRESOURCE maps[3];
+    s32 num_mapped;
 
-    ID3D11Texture2D* get_current()
-    {
-        return texs[i];
-    }
-
-    void advance()
-    {
-        i = (i + 1) & (NUM_BUFFERED_DL_TEXS - 1);
-    }
+    // How many frames of the movie the downloaded frame is.
+    s32 num_frames;
 };
 
 // -------------------------------------------------
@@ -55,23 +56,6 @@ ID3D11RenderTargetView* work_tex_rtv;
 ID3D11ShaderResourceView* work_tex_srv;
 ID3D11UnorderedAccessView* work_tex_uav;
 
-// -------------------------------------------------
-// Audio state.
-
-// We write wav for now because writing multiple streams over a single pipe is weird. Will be looked into later.
-
-const s32 WAV_BUFFERED_SAMPLES = 32768;
-
-HANDLE wav_f;
-DWORD wav_data_length;
-DWORD wav_file_length;
-DWORD wav_header_pos;
-DWORD wav_data_pos;
-
-// Only write out samples when we have enough.
-SvrWaveSample* wav_buf;
-s32 wav_num_samples;
-
 // -------------------------------------------------
 // Velo state.
 
@@ -155,13 +139,20 @@ __declspec(align(16)) struct MosampleCb
 
 ID3D11ComputeShader* mosample_cs;
 
+// Pixel format conversions that add the last sample of a video frame to the work texture (see tex2vid.hlsl).
+// Synchronized with the pxconv arrays.
+ID3D11ComputeShader* mosample_pxconv_cs[NUM_PXCONVS];
+
 // Constains the mosample weight.
 ID3D11Buffer* mosample_cb;
 
 // To not upload data all the time.
 float mosample_weight_cache;
-float mosample_remainder;
-float mosample_remainder_step;
+
+SvrMosampleSched mosample_sched;
+
+// How many game frames the next frame is ahead of the previous one (see proc_next_frame_needed).
+s32 mosample_advance;
 
 // -------------------------------------------------
 // Movie state.
@@ -171,60 +162,37 @@ s32 movie_height;
 
 char movie_path[MAX_PATH];
 
+// Frames of the movie that have been given to the encoder, counting repeated frames. For where a new file starts (see proc_rotate_output).
+s64 movie_frames_given;
+
+// Samples that have been added into frames of the movie with motion blur, for the stats.
+s64 movie_subframes;
+
+// Frames written to the encoder per second, for the stats.
+SvrRate encoder_rate;
+
 // -------------------------------------------------
 // Time profiling.
 
 SvrProf frame_prof;
 SvrProf dl_prof;
-SvrProf write_prof;
 SvrProf mosample_prof;
 
-// -------------------------------------------------
-// Movie profile.
-
-MovieProfile movie_profile;
-
-// -------------------------------------------------
-// FFmpeg process communication.
-
-struct ThreadPipeData
-{
-    u8* ptr;
-    s32 size;
-};
-
-// We write data to the ffmpeg process through this pipe.
-// It is redirected to their stdin.
-HANDLE ffmpeg_write_pipe;
-
-HANDLE ffmpeg_proc;
-
-// How many completed buffers we keep in memory waiting to be sent to ffmpeg.
-const s32 MAX_BUFFERED_SEND_BUFS = 8;
-
-// The buffers that are sent to the ffmpeg process.
-// For SW encoding these buffers are uncompressed frames of equal size.
-ThreadPipeData ffmpeg_send_bufs[MAX_BUFFERED_SEND_BUFS];
+// Same times as above but for every frame, which are always kept and shown when the movie ends.
+SvrHist frame_hist;
+SvrHist dl_hist;
+SvrHist mosample_hist;
 
-HANDLE ffmpeg_thread;
+// Time waited for a download slot to be written.
+SvrHist dl_wait_hist;
 
-// Queues and semaphores for communicating between the threads.
+// Time waited for the GPU to be done with the oldest download when all slots were waiting for it.
+SvrHist dl_map_wait_hist;
 
-SvrAsyncStream<ThreadPipeData> ffmpeg_write_queue;
-SvrAsyncStream<ThreadPipeData> ffmpeg_read_queue;
-
-// Semaphore that is signalled when there are frames to send to ffmpeg (pulls from ffmpeg_write_queue).
-// This is incremented by the game thread when it has added a downloaded frame to the write queue.
-SvrSemaphore ffmpeg_write_sem;
-
-// Semaphore that is signalled when there are frames available to download into (pulls from ffmpeg_read_queue).
-// This is incremented by the ffmpeg thread when it has sent a frame to the ffmpeg process.
-SvrSemaphore ffmpeg_read_sem;
+// -------------------------------------------------
+// Movie profile.
 
-bool has_ffmpeg_proc_exited()
-{
-    return WaitForSingleObject(ffmpeg_proc, 0) == WAIT_TIMEOUT;
-}
+MovieProfile movie_profile;
 
 // -------------------------------------------------
 
@@ -257,29 +225,30 @@ struct PxConvText
     const char* color_space;
 };
 
-enum PxConv
-{
-    PXCONV_YUV420_601 = 0,
-    PXCONV_YUV444_601,
-    PXCONV_NV12_601,
-    PXCONV_NV21_601,
-
-    PXCONV_YUV420_709,
-    PXCONV_YUV444_709,
-    PXCONV_NV12_709,
-    PXCONV_NV21_709,
-
-    PXCONV_BGR0,
-
-    NUM_PXCONVS,
-};
-
 // Up to 3 planes used for YUV video.
 ID3D11Texture2D* pxconv_texs[3];
 ID3D11UnorderedAccessView* pxconv_uavs[3];
 ID3D11ComputeShader* pxconv_cs[NUM_PXCONVS];
 
-CpuTexDl pxconv_dls[3];
+DlSlot dl_slots[MAX_BUFFERED_DL_TEXS];
+s32 num_dl_slots;
+
+// Next slot to copy to.
+s32 dl_copy_index;
+
+// Oldest slot that is copied to but not mapped yet.
+s32 dl_map_index;
+s32 num_copied_dl_slots;
+
+// Oldest slot that is given to the serialize stage.
+s32 dl_unmap_index;
+s32 num_mapped_dl_slots;
+
+// Reads mapped slots into the buffers that are sent to ffmpeg.
+SvrStage dl_serialize_stage;
+
+// Semaphore that is signalled when a slot is not read anymore and it can be unmapped.
+SvrSemaphore dl_done_sem;
 
 UINT pxconv_pitches[3];
 UINT pxconv_widths[3];
@@ -308,6 +277,20 @@ const char* PXCONV_SHADER_NAMES[] = {
     "b44000e74095a254ef98a2cdfcbaf015ab6c295e",
 };
 
+const char* MOSAMPLE_PXCONV_SHADER_NAMES[] = {
+    "e0b777d953b69bb6b7297fe8b2961d9ae804b8f8",
+    "0c6aa8f1296b89f0b3f97c8159e18705eca1122f",
+    "210b20b41ffef536e6304b6ac824859a84a23756",
+    "081be158c6389b080eee97440f5b56f26bd30955",
+
+    "6a18d0b01461e3c878a15bcbed8015308d1578c6",
+    "b57e51b53aaaee428ba4588b214cd492b22b6692",
+    "35ba58072262420c07256f59a73f8c4789f0bd2a",
+    "af1f0f783d0d14dba169653492035c04da2fe48a",
+
+    "a17fb74ce1b26b1cddd58bfdb942e4db3974bfe3",
+};
+
 // Names for ini.
 PxConvText PXCONV_INI_TEXT_TABLE[] = {
     PxConvText { "yuv420", "601" },
@@ -323,52 +306,6 @@ PxConvText PXCONV_INI_TEXT_TABLE[] = {
     PxConvText { "bgr0", "rgb" },
 };
 
-// Names for ffmpeg.
-PxConvText PXCONV_FFMPEG_TEXT_TABLE[] = {
-    PxConvText { "yuv420p", "bt470bg" },
-    PxConvText { "yuv444p", "bt470bg" },
-    PxConvText { "nv12", "bt470bg" },
-    PxConvText { "nv21", "bt470bg" },
-
-    PxConvText { "yuv420p", "bt709" },
-    PxConvText { "yuv444p", "bt709" },
-    PxConvText { "nv12", "bt709" },
-    PxConvText { "nv21", "bt709" },
-
-    PxConvText { "bgr0", NULL },
-};
-
-// How many planes that are used in a pixel format.
-s32 calc_format_planes(PxConv pxconv)
-{
-    switch (pxconv)
-    {
-        case PXCONV_YUV420_601:
-        case PXCONV_YUV444_601:
-        case PXCONV_YUV420_709:
-        case PXCONV_YUV444_709:
-        {
-            return 3;
-        }
-
-        case PXCONV_NV12_601:
-        case PXCONV_NV21_601:
-        case PXCONV_NV12_709:
-        case PXCONV_NV21_709:
-        {
-            return 2;
-        }
-
-        case PXCONV_BGR0:
-        {
-            return 1;
-        }
-    }
-
-    assert(false);
-    return 0;
-}
-
 UINT calc_bytes_pitch(DXGI_FORMAT format)
 {
     switch (format)
@@ -383,93 +320,160 @@ UINT calc_bytes_pitch(DXGI_FORMAT format)
     return 0;
 }
 
-// Retrieves the size of a plane in a pixel format.
-void calc_plane_dims(PxConv pxconv, s32 width, s32 height, s32 plane, s32* out_width, s32* out_height)
+// Maps all planes of a slot. Returns false if the GPU is not done with it yet and we don't want to wait.
+bool map_dl_slot(ID3D11DeviceContext* d3d11_context, DlSlot* slot, bool wait)
 {
-    // Height and width chroma shifts for each plane dimension (luma is ignored, so set to 0).
+    UINT flags = wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT;
 
-    const s32 YUV420_SHIFTS[3] = { 0, 1, 1 };
-    const s32 NV_SHIFTS[2] = { 0, 1 };
+    // Planes that were mapped in an earlier try stay mapped.
 
-    switch (pxconv)
+    while (slot->num_mapped < used_pxconv_planes)
     {
-        case PXCONV_YUV420_601:
-        case PXCONV_YUV420_709:
-        {
-            assert(plane < 3);
+        HRESULT hr = d3d11_context->Map(slot->texs[slot->num_mapped], 0, D3D11_MAP_READ, flags, &slot->maps[slot->num_mapped]);
 
-            *out_width = width >> YUV420_SHIFTS[plane];
-            *out_height = height >> YUV420_SHIFTS[plane];
-            break;
+        if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+        {
+            return false;
         }
 
-        case PXCONV_NV12_601:
-        case PXCONV_NV21_601:
-        case PXCONV_NV12_709:
-        case PXCONV_NV21_709:
-        {
-            assert(plane < 2);
+        assert(SUCCEEDED(hr));
 
-            *out_width = width >> NV_SHIFTS[plane];
-            *out_height = height >> NV_SHIFTS[plane];
-            break;
-        }
+        slot->num_mapped++;
+    }
 
-        case PXCONV_YUV444_601:
-        case PXCONV_YUV444_709:
-        {
-            assert(plane < 3);
+    return true;
+}
 
-            *out_width = width;
-            *out_height = height;
-            break;
-        }
+// Gives the oldest copied slot to the serialize stage. All its planes must be mapped.
+void push_mapped_dl_slot()
+{
+    svr_stage_push(&dl_serialize_stage, &dl_slots[dl_map_index]);
 
-        case PXCONV_BGR0:
-        {
-            assert(plane < 1);
+    dl_map_index = (dl_map_index + 1) % num_dl_slots;
+    num_copied_dl_slots--;
+    num_mapped_dl_slots++;
+}
 
-            *out_width = width;
-            *out_height = height;
-            break;
-        }
+// Gives copied slots to the serialize stage in order, as long as they can be mapped.
+void map_dl_slots(ID3D11DeviceContext* d3d11_context, bool wait)
+{
+    while (num_copied_dl_slots > 0)
+    {
+        DlSlot* slot = &dl_slots[dl_map_index];
 
-        default:
+        if (!map_dl_slot(d3d11_context, slot, wait))
         {
-            assert(false);
             break;
         }
+
+        push_mapped_dl_slot();
+    }
+}
+
+// Unmaps the oldest slot that was given to the serialize stage. It must not be read anymore.
+void unmap_dl_slot(ID3D11DeviceContext* d3d11_context)
+{
+    DlSlot* slot = &dl_slots[dl_unmap_index];
+
+    for (s32 i = 0; i < slot->num_mapped; i++)
+    {
+        d3d11_context->Unmap(slot->texs[i], 0);
+    }
+
+    slot->num_mapped = 0;
+
+    dl_unmap_index = (dl_unmap_index + 1) % num_dl_slots;
+    num_mapped_dl_slots--;
+}
+
+// Unmaps the slots that are not read anymore so they can be copied to again.
+void unmap_done_dl_slots(ID3D11DeviceContext* d3d11_context)
+{
+    while (num_mapped_dl_slots > 0 && svr_sem_try_wait(&dl_done_sem))
+    {
+        unmap_dl_slot(d3d11_context);
     }
 }
 
-// Put textures into system memory.
-// The system memory destination msut be big enough to hold all textures.
-void download_textures(ID3D11DeviceContext* d3d11_context, ID3D11Texture2D** gpu_texes, CpuTexDl* cpu_texes, s32 num_texes, void* dest, s32 size)
+// Waits until there is a slot to copy to.
+void wait_for_free_dl_slot(ID3D11DeviceContext* d3d11_context)
 {
-    // Need to copy the textures into readable memory.
+    if (num_copied_dl_slots + num_mapped_dl_slots < num_dl_slots)
+    {
+        return;
+    }
 
-    for (s32 i = 0; i < num_texes; i++)
+    // All slots are waiting for the GPU, so the oldest one has to be waited for.
+    if (num_mapped_dl_slots == 0)
     {
-        d3d11_context->CopyResource(cpu_texes[i].get_current(), gpu_texes[i]);
+        svr_start_hist(&dl_map_wait_hist);
+
+        map_dl_slot(d3d11_context, &dl_slots[dl_map_index], true);
+
+        svr_end_hist(&dl_map_wait_hist);
+
+        push_mapped_dl_slot();
     }
 
-    D3D11_MAPPED_SUBRESOURCE* maps = (D3D11_MAPPED_SUBRESOURCE*)_alloca(sizeof(D3D11_MAPPED_SUBRESOURCE) * num_texes);
-    void** map_datas = (void**)_alloca(sizeof(void*) * num_texes);
-    UINT* row_pitches = (UINT*)_alloca(sizeof(UINT) * num_texes);
+    svr_start_hist(&dl_wait_hist);
+    svr_trace_begin("Queue wait");
+
+    svr_sem_wait(&dl_done_sem);
+
+    svr_trace_end("Queue wait");
+    svr_end_hist(&dl_wait_hist);
 
-    // Mapping will take between 400 and 1500 us on average, not much to do about that. Probably has to do with waiting for CopyResource above to finish.
-    // We cannot use D3D11_MAP_FLAG_DO_NOT_WAIT here (and advance the cpu texture queue) because of the CopyResource call above which
-    // may not have finished yet.
+    unmap_dl_slot(d3d11_context);
+}
+
+// Sends the remaining slots and waits for them to be read.
+void flush_dl_slots(ID3D11DeviceContext* d3d11_context)
+{
+    map_dl_slots(d3d11_context, true);
+
+    svr_stage_stop(&dl_serialize_stage);
 
-    for (s32 i = 0; i < num_texes; i++)
+    while (num_mapped_dl_slots > 0)
     {
-        d3d11_context->Map(cpu_texes[i].get_current(), 0, D3D11_MAP_READ, 0, &maps[i]);
+        svr_sem_wait(&dl_done_sem);
+        unmap_dl_slot(d3d11_context);
     }
+}
 
-    for (s32 i = 0; i < num_texes; i++)
+void dl_slot_written_fn(void* user)
+{
+    svr_sem_release(&dl_done_sem);
+}
+
+// Put the planes of a mapped slot into system memory that is sent to ffmpeg.
+void serialize_stage_fn(void* item, void* user)
+{
+    DlSlot* slot = (DlSlot*)item;
+
+    ThreadPipeData pipe_data;
+    ffmpeg_acquire_send_buf(&pipe_data);
+
+    // Write converted frames to ffmpeg straight from the mapped CPU textures instead of copying them to a send buffer first.
+    // This saves one full frame copy, but the CPU textures stay mapped until they have been written.
+    if (movie_profile.encoder_direct_writes)
     {
-        map_datas[i] = maps[i].pData;
-        row_pitches[i] = maps[i].RowPitch;
+        // The send buffer is not used, the slot is unmapped when the ffmpeg thread has written it.
+
+        for (s32 i = 0; i < used_pxconv_planes; i++)
+        {
+            PipePlane& plane = pipe_data.planes[i];
+            plane.ptr = (u8*)slot->maps[i].pData;
+            plane.row_size = pxconv_pitches[i];
+            plane.rows = pxconv_heights[i];
+            plane.pitch = slot->maps[i].RowPitch;
+        }
+
+        pipe_data.num_planes = used_pxconv_planes;
+        pipe_data.num_frames = slot->num_frames;
+        pipe_data.written_fn = dl_slot_written_fn;
+
+        ffmpeg_submit_send_buf(&pipe_data);
+        return;
     }
 
     // From MSDN:
@@ -482,31 +486,27 @@ void download_textures(ID3D11DeviceContext* d3d11_context, ID3D11Texture2D** gpu
 
     s32 offset = 0;
 
-    for (s32 i = 0; i < num_texes; i++)
+    for (s32 i = 0; i < used_pxconv_planes; i++)
     {
-        u8* source_ptr = (u8*)map_datas[i];
-        u8* dest_ptr = (u8*)dest + offset;
+        u8* source_ptr = (u8*)slot->maps[i].pData;
+        u8* dest_ptr = pipe_data.ptr + offset;
 
         for (UINT j = 0; j < pxconv_heights[i]; j++)
         {
             memcpy(dest_ptr, source_ptr, pxconv_pitches[i]);
 
-            source_ptr += row_pitches[i];
+            source_ptr += slot->maps[i].RowPitch;
             dest_ptr += pxconv_pitches[i];
         }
 
         offset += pxconv_pitches[i] * pxconv_heights[i];
     }
 
-    for (s32 i = 0; i < num_texes; i++)
-    {
-        d3d11_context->Unmap(cpu_texes[i].get_current(), 0);
-    }
+    pipe_data.num_frames = slot->num_frames;
 
-    for (s32 i = 0; i < num_texes; i++)
-    {
-        cpu_texes[i].advance();
-    }
+    ffmpeg_submit_send_buf(&pipe_data);
+
+    svr_sem_release(&dl_done_sem);
 }
 
 void free_all_static_sw_stuff()
@@ -524,28 +524,18 @@ void free_all_dynamic_sw_stuff()
         svr_maybe_release(&pxconv_texs[i]);
         svr_maybe_release(&pxconv_uavs[i]);
 
-        for (s32 j = 0; j < NUM_BUFFERED_DL_TEXS; j++)
+        for (s32 j = 0; j < MAX_BUFFERED_DL_TEXS; j++)
         {
-            svr_maybe_release(&pxconv_dls[i].texs[j]);
+            svr_maybe_release(&dl_slots[j].texs[i]);
         }
     }
-
-    for (s32 i = 0; i < MAX_BUFFERED_SEND_BUFS; i++)
-    {
-        ThreadPipeData& pipe_data = ffmpeg_send_bufs[i];
-
-        if (pipe_data.ptr)
-        {
-            free(pipe_data.ptr);
-        }
-
-        pipe_data = {};
-    }
 }
 
 // Put texture into video format.
 void convert_pixel_formats(ID3D11DeviceContext* d3d11_context, ID3D11ShaderResourceView* source_srv)
 {
+    svr_trace_begin("Pxconv");
+
     d3d11_context->CSSetShader(pxconv_cs[movie_pxconv], NULL, 0);
     d3d11_context->CSSetShaderResources(0, 1, &source_srv);
     d3d11_context->CSSetUnorderedAccessViews(0, used_pxconv_planes, pxconv_uavs, NULL);
@@ -557,6 +547,8 @@ void convert_pixel_formats(ID3D11DeviceContext* d3d11_context, ID3D11ShaderResou
 
     d3d11_context->CSSetShaderResources(0, 1, null_srvs);
     d3d11_context->CSSetUnorderedAccessViews(0, 1, null_uavs, NULL);
+
+    svr_trace_end("Pxconv");
 }
 
 bool create_pxconv_textures(ID3D11Device* d3d11_device, DXGI_FORMAT* formats)
@@ -596,9 +588,9 @@ bool create_pxconv_textures(ID3D11Device* d3d11_device, DXGI_FORMAT* formats)
         tex_desc.BindFlags = 0;
         tex_desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
 
-        for (s32 j = 0; j < NUM_BUFFERED_DL_TEXS; j++)
+        for (s32 j = 0; j < num_dl_slots; j++)
         {
-            hr = d3d11_device->CreateTexture2D(&tex_desc, NULL, &pxconv_dls[i].texs[j]);
+            hr = d3d11_device->CreateTexture2D(&tex_desc, NULL, &dl_slots[j].texs[i]);
 
             if (FAILED(hr))
             {
@@ -621,19 +613,18 @@ bool start_with_sw(ID3D11Device* d3d11_device)
 {
     bool ret = false;
 
-    // We don't allow the pixel format and color space to be selectable anymore, but we will keep the support in for now.
+    movie_pxconv = calc_encoder_pxconv(&movie_profile);
 
-    if (!strcmp(movie_profile.sw_encoder, "libx264"))
-    {
-        movie_pxconv = PXCONV_NV12_601;
-    }
+    used_pxconv_planes = calc_format_planes(movie_pxconv);
 
-    else if (!strcmp(movie_profile.sw_encoder, "libx264rgb"))
-    {
-        movie_pxconv = PXCONV_BGR0;
-    }
+    num_dl_slots = movie_profile.pipeline_depth;
+    dl_copy_index = 0;
+    dl_map_index = 0;
+    dl_unmap_index = 0;
+    num_copied_dl_slots = 0;
+    num_mapped_dl_slots = 0;
 
-    used_pxconv_planes = calc_format_planes(movie_pxconv);
+    svr_sem_init(&dl_done_sem, 0, MAX_BUFFERED_DL_TEXS);
 
     DXGI_FORMAT formats[3];
 
@@ -701,45 +692,6 @@ rexit:
     return ret;
 }
 
-// -------------------------------------------------
-
-// This thread will write data to the ffmpeg process.
-// Writing to the pipe is real slow and we want to buffer up a few to send which it can work on.
-DWORD WINAPI ffmpeg_thread_proc(LPVOID lpParameter)
-{
-    while (true)
-    {
-        svr_sem_wait(&ffmpeg_write_sem);
-
-        ThreadPipeData pipe_data;
-        bool res1 = ffmpeg_write_queue.pull(&pipe_data);
-        assert(res1);
-
-        if (pipe_data.ptr == NULL)
-        {
-            return 0;
-        }
-
-        // This will not return until the data has been read by the remote process.
-        // Writing with pipes is very inconsistent and can wary with several milliseconds.
-        // It has been tested to use overlapped I/O with completion routines but that was also too inconsistent and way too complicated.
-        // For SW encoding this will take about 300 - 6000 us (always sending the same size).
-
-        // There is some issue with writing with pipes that if it starts off slower than it should be, then it will forever be slow until the computer restarts.
-        // Therefore it is useful to measure this.
-
-        svr_start_prof(&write_prof);
-        WriteFile(ffmpeg_write_pipe, pipe_data.ptr, pipe_data.size, NULL, NULL);
-        svr_end_prof(&write_prof);
-
-        ffmpeg_read_queue.push(&pipe_data);
-
-        svr_sem_release(&ffmpeg_read_sem);
-    }
-
-    return 0;
-}
-
 bool load_one_shader(const char* name, void* buf, s32 buf_size, DWORD* shader_size)
 {
     char full_shader_path[MAX_PATH];
@@ -819,6 +771,22 @@ bool create_shaders(ID3D11Device* d3d11_device)
         }
     }
 
+    for (s32 i = 0; i < NUM_PXCONVS; i++)
+    {
+        if (!load_one_shader(MOSAMPLE_PXCONV_SHADER_NAMES[i], file_mem, SHADER_MEM_SIZE, &shader_size))
+        {
+            goto rfail;
+        }
+
+        hr = d3d11_device->CreateComputeShader(file_mem, shader_size, NULL, &mosample_pxconv_cs[i]);
+
+        if (FAILED(hr))
+        {
+            svr_log("Could not create mosample pxconv shader %d (%#x)\n", i, hr);
+            goto rfail;
+        }
+    }
+
     if (!load_one_shader("c52620855f15b2c47b8ca24b890850a90fdc7017", file_mem, SHADER_MEM_SIZE, &shader_size))
     {
         goto rfail;
@@ -874,6 +842,11 @@ void free_all_static_proc_stuff()
     svr_maybe_release(&mosample_cs);
     svr_maybe_release(&mosample_cb);
 
+    for (s32 i = 0; i < NUM_PXCONVS; i++)
+    {
+        svr_maybe_release(&mosample_pxconv_cs[i]);
+    }
+
     svr_maybe_release(&d2d1_factory);
     svr_maybe_release(&d2d1_device);
     svr_maybe_release(&d2d1_context);
@@ -886,8 +859,6 @@ void free_all_static_proc_stuff()
     svr_maybe_release(&velo_text_vs);
     svr_maybe_release(&velo_text_ps);
 
-    free(wav_buf);
-    wav_buf = NULL;
 }
 
 void free_all_dynamic_proc_stuff()
@@ -900,12 +871,6 @@ void free_all_dynamic_proc_stuff()
     svr_maybe_release(&velo_atlas_tex);
     svr_maybe_release(&velo_atlas_tex_srv);
     svr_maybe_release(&velo_atlas_tex_rtv);
-
-    if (wav_f)
-    {
-        CloseHandle(wav_f);
-        wav_f = NULL;
-    }
 }
 
 bool init_velo(ID3D11Device* d3d11_device)
@@ -1034,10 +999,11 @@ bool proc_init(const char* svr_path, ID3D11Device* d3d11_device)
         goto rfail;
     }
 
-    ffmpeg_write_queue.init(MAX_BUFFERED_SEND_BUFS);
-    ffmpeg_read_queue.init(MAX_BUFFERED_SEND_BUFS);
+    ffmpeg_init();
+
+    svr_stage_init(&dl_serialize_stage, "Serialize", MAX_BUFFERED_DL_TEXS);
 
-    wav_buf = (SvrWaveSample*)_aligned_malloc(sizeof(SvrWaveSample) * WAV_BUFFERED_SAMPLES, 16);
+    svr_create_shared_stats();
 
     ret = true;
     goto rexit;
@@ -1051,197 +1017,6 @@ rexit:
     return ret;
 }
 
-void build_ffmpeg_process_args(char* full_args, s32 full_args_size)
-{
-    const s32 ARGS_BUF_SIZE = 128;
-
-    char buf[ARGS_BUF_SIZE];
-
-    StringCchCatA(full_args, full_args_size, "-hide_banner");
-
-    #if 1
-    StringCchCatA(full_args, full_args_size, " -loglevel quiet");
-    #else
-    StringCchCatA(full_args, full_args_size, " -loglevel debug");
-    #endif
-
-    // Parameters below here is regarding the input (the stuff we are sending).
-
-    PxConvText& pxconv_text = PXCONV_FFMPEG_TEXT_TABLE[movie_pxconv];
-
-    // We are sending uncompressed frames.
-    StringCchCatA(full_args, full_args_size, " -f rawvideo -vcodec rawvideo");
-
-    // Pixel format that goes through the pipe.
-    StringCchPrintfA(buf, ARGS_BUF_SIZE, " -pix_fmt %s", pxconv_text.format);
-    StringCchCatA(full_args, full_args_size, buf);
-
-    // Video size.
-    StringCchPrintfA(buf, ARGS_BUF_SIZE, " -s %dx%d", movie_width, movie_height);
-    StringCchCatA(full_args, full_args_size, buf);
-
-    // Input frame rate.
-    StringCchPrintfA(buf, ARGS_BUF_SIZE, " -r %d", movie_profile.movie_fps);
-    StringCchCatA(full_args, full_args_size, buf);
-
-    // Overwrite existing, and read from stdin.
-    StringCchCatA(full_args, full_args_size, " -y -i -");
-
-    // Parameters below here is regarding the output (the stuff that will be written to the file).
-
-    // Number of encoding threads, or 0 for auto.
-    // We used to allow this to be configured, its intended purpose was for game multiprocessing (opening multiple games) but
-    // there are too many problems in the Source engine that we cannot control. It leads to many buggy and weird scenarios (like animations not playing or demos jumping).
-    StringCchCatA(full_args, full_args_size, " -threads 0");
-
-    // Output video codec.
-    StringCchPrintfA(buf, ARGS_BUF_SIZE, " -vcodec %s", movie_profile.sw_encoder);
-    StringCchCatA(full_args, full_args_size, buf);
-
-    if (pxconv_text.color_space)
-    {
-        // Output video color space (only for YUV).
-        StringCchPrintfA(buf, ARGS_BUF_SIZE, " -colorspace %s", pxconv_text.color_space);
-        StringCchCatA(full_args, full_args_size, buf);
-    }
-
-    // Output video framerate.
-    StringCchPrintfA(buf, ARGS_BUF_SIZE, " -framerate %d", movie_profile.movie_fps);
-    StringCchCatA(full_args, full_args_size, buf);
-
-    // Output quality factor.
-    StringCchPrintfA(buf, ARGS_BUF_SIZE, " -crf %d", movie_profile.sw_crf);
-    StringCchCatA(full_args, full_args_size, buf);
-
-    // Output x264 preset.
-    StringCchPrintfA(buf, ARGS_BUF_SIZE, " -preset %s", movie_profile.sw_x264_preset);
-    StringCchCatA(full_args, full_args_size, buf);
-
-    if (movie_profile.sw_x264_intra)
-    {
-        StringCchCatA(full_args, full_args_size, " -x264-params keyint=1");
-    }
-
-    // The path can be specified as relative here because we set the working directory of the ffmpeg process
-    // to the SVR directory.
-
-    StringCchCatA(full_args, full_args_size, " \"");
-    StringCchCatA(full_args, full_args_size, movie_path);
-    StringCchCatA(full_args, full_args_size, "\"");
-}
-
-// We start a separate process for two reasons:
-// 1) Source is a 32-bit engine, and it was common to run out of memory in games such as CSGO that uses a lot of memory.
-// 2) The ffmpeg API is horrible to work with with an incredible amount of pitfalls that will grant you a media that is slighly incorrect
-//    and there is no reliable documentation.
-// Data is sent to this process through a pipe that we create.
-// For SW encoding we send uncompressed frames which are then encoded and muxed in the ffmpeg process.
-bool start_ffmpeg_proc()
-{
-    const s32 FULL_ARGS_SIZE = 1024;
-
-    bool ret = false;
-
-    STARTUPINFOA start_info = {};
-    DWORD create_flags = 0;
-
-    char full_args[FULL_ARGS_SIZE];
-    full_args[0] = 0;
-
-    HANDLE read_h = NULL;
-    HANDLE write_h = NULL;
-
-    SECURITY_ATTRIBUTES sa;
-    PROCESS_INFORMATION proc_info;
-
-    char full_ffmpeg_path[MAX_PATH];
-
-    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
-    sa.lpSecurityDescriptor = NULL;
-    sa.bInheritHandle = TRUE;
-
-    if (!CreatePipe(&read_h, &write_h, &sa, 4 * 1024))
-    {
-        svr_log("ERROR: Could not create ffmpeg process pipes (%lu)\n", GetLastError());
-        goto rfail;
-    }
-
-    // Since we start the ffmpeg process with inherited handles, it would try to inherit the writing endpoint of this pipe too.
-    // We have to remove the inheritance of this pipe. Otherwise it's never able to exit.
-    SetHandleInformation(write_h, HANDLE_FLAG_INHERIT, 0);
-
-    #if 1
-    create_flags |= CREATE_NO_WINDOW;
-    #endif
-
-    // Working directory for the FFmpeg process should be in the SVR directory.
-
-    full_ffmpeg_path[0] = 0;
-    StringCchCatA(full_ffmpeg_path, MAX_PATH, svr_resource_path);
-    StringCchCatA(full_ffmpeg_path, MAX_PATH, "\\ffmpeg.exe");
-
-    start_info.cb = sizeof(STARTUPINFOA);
-    start_info.hStdInput = read_h;
-    start_info.dwFlags |= STARTF_USESTDHANDLES;
-
-    build_ffmpeg_process_args(full_args, FULL_ARGS_SIZE);
-
-    if (!CreateProcessA(full_ffmpeg_path, full_args, NULL, NULL, TRUE, create_flags, NULL, svr_resource_path, &start_info, &proc_info))
-    {
-        svr_log("ERROR: Could not create ffmpeg process (%lu)\n", GetLastError());
-        goto rfail;
-    }
-
-    ffmpeg_proc = proc_info.hProcess;
-    CloseHandle(proc_info.hThread);
-
-    ffmpeg_write_pipe = write_h;
-
-    ret = true;
-    goto rexit;
-
-rfail:
-    if (write_h) CloseHandle(write_h);
-
-rexit:
-    if (read_h) CloseHandle(read_h);
-
-    return ret;
-}
-
-void end_ffmpeg_proc()
-{
-    svr_sem_wait(&ffmpeg_read_sem);
-
-    ThreadPipeData pipe_data;
-    pipe_data.ptr = NULL;
-    pipe_data.size = 0;
-
-    ffmpeg_write_queue.push(&pipe_data);
-
-    svr_sem_release(&ffmpeg_write_sem);
-
-    WaitForSingleObject(ffmpeg_thread, INFINITE);
-
-    CloseHandle(ffmpeg_thread);
-    ffmpeg_thread = NULL;
-
-    // Both queues should not be updated anymore at this point so they should be the same when observed.
-    // Since we exit with a sentinel value, the semaphores will be out of sync from the queues but they are reinit on movie start.
-    assert(ffmpeg_write_queue.read_buffer_health() == 0);
-    assert(ffmpeg_read_queue.read_buffer_health() == MAX_BUFFERED_SEND_BUFS);
-
-    // Close our end of the pipe.
-    // This will mark the completion of the stream, and the process will finish its work.
-    CloseHandle(ffmpeg_write_pipe);
-    ffmpeg_write_pipe = NULL;
-
-    WaitForSingleObject(ffmpeg_proc, INFINITE);
-
-    CloseHandle(ffmpeg_proc);
-    ffmpeg_proc = NULL;
-}
-
 s32 to_utf16(const char* value, s32 value_length, wchar* buf, s32 buf_chars)
 {
     s32 length = MultiByteToWideChar(CP_UTF8, 0, value, value_length, buf, buf_chars);
@@ -1855,83 +1630,21 @@ void draw_velo(ID3D11DeviceContext* d3d11_context, ID3D11RenderTargetView* rtv,
     d3d11_context->OMSetRenderTargets(1, &null_rtv, NULL);
 }
 
-bool create_audio()
-{
-    char wav_path[MAX_PATH];
-    StringCchCopyA(wav_path, MAX_PATH, movie_path);
-    PathRenameExtensionA(wav_path, ".wav");
-
-    wav_f = CreateFileA(wav_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-
-    if (wav_f == INVALID_HANDLE_VALUE)
-    {
-        game_log("Could not create wave file %s (%lu)\n", wav_path, GetLastError());
-        return false;
-    }
-
-    const DWORD RIFF = MAKEFOURCC('R', 'I', 'F', 'F');
-    const DWORD WAVE = MAKEFOURCC('W', 'A', 'V', 'E');
-    const DWORD FMT_ = MAKEFOURCC('f', 'm', 't', ' ');
-    const DWORD DATA = MAKEFOURCC('d', 'a', 't', 'a');
-
-    const DWORD WAV_PLACEHOLDER = 0;
-
-    WriteFile(wav_f, &RIFF, sizeof(DWORD), NULL, NULL);
-    wav_header_pos = SetFilePointer(wav_f, 0, NULL, FILE_CURRENT);
-    WriteFile(wav_f, &WAV_PLACEHOLDER, sizeof(DWORD), NULL, NULL);
-
-    WriteFile(wav_f, &WAVE, sizeof(DWORD), NULL, NULL);
-
-    WORD channels = 2;
-    WORD sample_rate = 44100;
-    WORD sample_bits = 16;
-
-    WAVEFORMATEX wfx = {};
-    wfx.wFormatTag = WAVE_FORMAT_PCM;
-    wfx.nChannels = channels;
-    wfx.nSamplesPerSec = sample_rate;
-    wfx.wBitsPerSample = sample_bits;
-    wfx.nBlockAlign = wfx.nChannels * (wfx.wBitsPerSample / 8);
-    wfx.nAvgBytesPerSec = wfx.nSamplesPerSec * wfx.nBlockAlign;
-
-    DWORD wfx_size = sizeof(WAVEFORMATEX);
-
-    WriteFile(wav_f, &FMT_, sizeof(DWORD), NULL, NULL);
-    WriteFile(wav_f, &wfx_size, sizeof(DWORD), NULL, NULL);
-    WriteFile(wav_f, &wfx, sizeof(WAVEFORMATEX), NULL, NULL);
-
-    WriteFile(wav_f, &DATA, sizeof(DWORD), NULL, NULL);
-    wav_data_pos = SetFilePointer(wav_f, 0, NULL, FILE_CURRENT);
-    WriteFile(wav_f, &WAV_PLACEHOLDER, sizeof(DWORD), NULL, NULL);
-
-    wav_file_length = SetFilePointer(wav_f, 0, NULL, FILE_CURRENT);
-
-    return true;
-}
-
 bool proc_start(ID3D11Device* d3d11_device, ID3D11DeviceContext* d3d11_context, const char* dest, const char* profile, ID3D11ShaderResourceView* game_content_srv)
 {
     bool ret = false;
 
     HRESULT hr;
 
-    if (*profile == 0)
-    {
-        profile = "default";
-    }
-
-    char full_profile_path[MAX_PATH];
-    full_profile_path[0] = 0;
-    StringCchCatA(full_profile_path, MAX_PATH, svr_resource_path);
-    StringCchCatA(full_profile_path, MAX_PATH, "\\data\\profiles\\");
-    StringCchCatA(full_profile_path, MAX_PATH, profile);
-    StringCchCatA(full_profile_path, MAX_PATH, ".ini");
+    FfmpegStartData ffmpeg_data;
 
-    if (!read_profile(full_profile_path, &movie_profile))
+    if (!read_profile_by_name(svr_resource_path, profile, &movie_profile))
     {
         goto rfail;
     }
 
+    svr_prof_enabled = svr_prof_launch_enabled || movie_profile.profiling_enabled;
+
     ID3D11Resource* content_tex_res;
     game_content_srv->GetResource(&content_tex_res);
 
@@ -1947,11 +1660,10 @@ bool proc_start(ID3D11Device* d3d11_device, ID3D11DeviceContext* d3d11_context,
     movie_width = tex_desc.Width;
     movie_height = tex_desc.Height;
 
-    movie_path[0] = 0;
-    StringCchCatA(movie_path, MAX_PATH, svr_resource_path);
-    StringCchCatA(movie_path, MAX_PATH, "\\movies\\");
-    CreateDirectoryA(movie_path, NULL);
-    StringCchCatA(movie_path, MAX_PATH, dest);
+    build_movie_path(svr_resource_path, dest, movie_path, MAX_PATH);
+
+    movie_frames_given = 0;
+    movie_subframes = 0;
 
     if (!start_with_sw(d3d11_device))
     {
@@ -1992,56 +1704,45 @@ bool proc_start(ID3D11Device* d3d11_device, ID3D11DeviceContext* d3d11_context,
         }
     }
 
-    if (movie_profile.audio_enabled)
+    if (movie_profile.mosample_enabled)
     {
-        if (!create_audio())
-        {
-            goto rfail;
-        }
+        svr_mosample_sched_init(&mosample_sched, movie_profile.mosample_mult, movie_profile.mosample_exposure);
+        mosample_advance = 1;
     }
 
-    // We have a controlled environment until the ffmpeg thread is started.
-    // Set the semaphore and queues to known states.
-
-    svr_sem_init(&ffmpeg_write_sem, 0, MAX_BUFFERED_SEND_BUFS);
-    svr_sem_init(&ffmpeg_read_sem, MAX_BUFFERED_SEND_BUFS, MAX_BUFFERED_SEND_BUFS);
-
-    // Need to overwrite with new data.
-    ffmpeg_read_queue.reset();
-    ffmpeg_write_queue.reset();
-
-    // Each buffer contains 1 uncompressed frame.
+    ffmpeg_data.resource_path = svr_resource_path;
+    ffmpeg_data.movie_path = movie_path;
+    ffmpeg_data.profile = &movie_profile;
+    ffmpeg_data.pxconv = movie_pxconv;
+    ffmpeg_data.width = movie_width;
+    ffmpeg_data.height = movie_height;
+    ffmpeg_data.frame_size = pxconv_total_plane_sizes;
+    ffmpeg_data.planes_only = movie_profile.encoder_direct_writes != 0;
 
-    for (s32 i = 0; i < MAX_BUFFERED_SEND_BUFS; i++)
+    if (!ffmpeg_start(&ffmpeg_data))
     {
-        ThreadPipeData pipe_data;
-        pipe_data.ptr = (u8*)malloc(pxconv_total_plane_sizes);
-        pipe_data.size = pxconv_total_plane_sizes;
-
-        ffmpeg_send_bufs[i] = pipe_data;
-    }
-
-    for (s32 i = 0; i < MAX_BUFFERED_SEND_BUFS; i++)
-    {
-        ffmpeg_read_queue.push(&ffmpeg_send_bufs[i]);
+        goto rfail;
     }
 
-    if (movie_profile.mosample_enabled)
+    // The trace is ended when the movie has been finished (see ffmpeg_end).
+    if (movie_profile.trace_enabled)
     {
-        mosample_remainder = 0.0f;
+        char trace_path[MAX_PATH];
+        StringCchPrintfA(trace_path, MAX_PATH, "%s.trace.json", movie_path);
 
-        s32 sps = movie_profile.movie_fps * movie_profile.mosample_mult;
-        mosample_remainder_step = (1.0f / sps) / (1.0f / movie_profile.movie_fps);
+        svr_trace_name_thread("Game", -1);
+        svr_start_trace(trace_path);
     }
 
-    if (!start_ffmpeg_proc())
-    {
-        goto rfail;
-    }
+    svr_reset_hist(&frame_hist);
+    svr_reset_hist(&dl_hist);
+    svr_reset_hist(&mosample_hist);
+    svr_reset_hist(&dl_wait_hist);
+    svr_reset_hist(&dl_map_wait_hist);
 
-    _ReadWriteBarrier();
+    svr_stage_start(&dl_serialize_stage, num_dl_slots, serialize_stage_fn, NULL);
 
-    ffmpeg_thread = CreateThread(NULL, 0, ffmpeg_thread_proc, NULL, 0, NULL);
+    svr_start_rate(&encoder_rate, 0);
 
     ret = true;
     goto rexit;
@@ -2054,24 +1755,42 @@ rexit:
 }
 
 // For SW encoding, send uncompressed frame over pipe.
-void send_converted_video_frame_to_ffmpeg(ID3D11DeviceContext* d3d11_context)
+// The converted frame is copied to a CPU texture here, and is given to the serialize stage when the GPU is done with it.
+// This is usually a few frames later, so the game thread does not have to wait for the download (which used to take between 400 and 1500 us).
+// A frame that is repeated in the movie is only downloaded once.
+void send_converted_video_frame_to_ffmpeg(ID3D11DeviceContext* d3d11_context, s32 num_frames)
 {
-    svr_sem_wait(&ffmpeg_read_sem);
+    svr_start_prof(&dl_prof);
+    svr_start_hist(&dl_hist);
+    svr_trace_begin("Download");
 
-    ThreadPipeData pipe_data;
-    bool res1 = ffmpeg_read_queue.pull(&pipe_data);
-    assert(res1);
+    unmap_done_dl_slots(d3d11_context);
+    wait_for_free_dl_slot(d3d11_context);
 
-    svr_start_prof(&dl_prof);
-    download_textures(d3d11_context, pxconv_texs, pxconv_dls, used_pxconv_planes, pipe_data.ptr, pipe_data.size);
-    svr_end_prof(&dl_prof);
+    DlSlot* slot = &dl_slots[dl_copy_index];
+    slot->num_frames = num_frames;
+
+    movie_frames_given += num_frames;
+
+    for (s32 i = 0; i < used_pxconv_planes; i++)
+    {
+        d3d11_context->CopyResource(slot->texs[i], pxconv_texs[i]);
+    }
+
+    dl_copy_index = (dl_copy_index + 1) % num_dl_slots;
+    num_copied_dl_slots++;
 
-    ffmpeg_write_queue.push(&pipe_data);
+    // Submit the copy now, otherwise it may stay in the command buffer until the game flushes and we cannot map it any sooner.
+    d3d11_context->Flush();
+
+    map_dl_slots(d3d11_context, false);
 
-    svr_sem_release(&ffmpeg_write_sem);
+    svr_trace_end("Download");
+    svr_end_hist(&dl_hist);
+    svr_end_prof(&dl_prof);
 }
 
-void motion_sample(ID3D11DeviceContext* d3d11_context, ID3D11ShaderResourceView* game_content_srv, float weight)
+void update_mosample_weight(ID3D11DeviceContext* d3d11_context, float weight)
 {
     if (weight != mosample_weight_cache)
     {
@@ -2081,6 +1800,13 @@ void motion_sample(ID3D11DeviceContext* d3d11_context, ID3D11ShaderResourceView*
         mosample_weight_cache = weight;
         update_constant_buffer(d3d11_context, mosample_cb, &cb_data, sizeof(MosampleCb));
     }
+}
+
+void motion_sample(ID3D11DeviceContext* d3d11_context, ID3D11ShaderResourceView* game_content_srv, float weight)
+{
+    svr_trace_begin("Mosample");
+
+    update_mosample_weight(d3d11_context, weight);
 
     d3d11_context->CSSetShader(mosample_cs, NULL, 0);
     d3d11_context->CSSetShaderResources(0, 1, &game_content_srv);
@@ -2091,7 +1817,9 @@ void motion_sample(ID3D11DeviceContext* d3d11_context, ID3D11ShaderResourceView*
     d3d11_context->Dispatch(calc_cs_thread_groups(movie_width), calc_cs_thread_groups(movie_height), 1);
 
     svr_start_prof(&mosample_prof);
+    svr_start_hist(&mosample_hist);
     d3d11_context->Flush();
+    svr_end_hist(&mosample_hist);
     svr_end_prof(&mosample_prof);
 
     ID3D11ShaderResourceView* null_srv = NULL;
@@ -2099,9 +1827,11 @@ void motion_sample(ID3D11DeviceContext* d3d11_context, ID3D11ShaderResourceView*
 
     d3d11_context->CSSetShaderResources(0, 1, &null_srv);
     d3d11_context->CSSetUnorderedAccessViews(0, 1, &null_uav, NULL);
+
+    svr_trace_end("Mosample");
 }
 
-void encode_video_frame(ID3D11DeviceContext* d3d11_context, ID3D11ShaderResourceView* srv, ID3D11RenderTargetView* rtv)
+void encode_video_frame(ID3D11DeviceContext* d3d11_context, ID3D11ShaderResourceView* srv, ID3D11RenderTargetView* rtv, s32 num_frames)
 {
     if (movie_profile.veloc_enabled)
     {
@@ -2116,55 +1846,71 @@ void encode_video_frame(ID3D11DeviceContext* d3d11_context, ID3D11ShaderResource
     }
 
     convert_pixel_formats(d3d11_context, srv);
-    send_converted_video_frame_to_ffmpeg(d3d11_context);
+    send_converted_video_frame_to_ffmpeg(d3d11_context, num_frames);
 }
 
-void mosample_game_frame(ID3D11DeviceContext* d3d11_context, ID3D11ShaderResourceView* game_content_srv)
+// Same as motion_sample followed by convert_pixel_formats on the work texture, but the sum is only used for the conversion and
+// is not written back. This saves writing the whole work texture and reading it again.
+void motion_sample_and_convert(ID3D11DeviceContext* d3d11_context, ID3D11ShaderResourceView* game_content_srv, float weight)
 {
-    float old_rem = mosample_remainder;
-    float exposure = movie_profile.mosample_exposure;
+    update_mosample_weight(d3d11_context, weight);
 
-    mosample_remainder += mosample_remainder_step;
+    ID3D11ShaderResourceView* srvs[] = { work_tex_srv, game_content_srv };
 
-    if (mosample_remainder <= (1.0f - exposure))
-    {
+    d3d11_context->CSSetShader(mosample_pxconv_cs[movie_pxconv], NULL, 0);
+    d3d11_context->CSSetShaderResources(0, 2, srvs);
+    d3d11_context->CSSetConstantBuffers(0, 1, &mosample_cb);
+    d3d11_context->CSSetUnorderedAccessViews(0, used_pxconv_planes, pxconv_uavs, NULL);
 
-    }
+    d3d11_context->Dispatch(calc_cs_thread_groups(movie_width), calc_cs_thread_groups(movie_height), 1);
 
-    else if (mosample_remainder < 1.0f)
+    ID3D11ShaderResourceView* null_srvs[] = { NULL, NULL };
+    ID3D11UnorderedAccessView* null_uavs[] = { NULL };
+
+    d3d11_context->CSSetShaderResources(0, 2, null_srvs);
+    d3d11_context->CSSetUnorderedAccessViews(0, 1, null_uavs, NULL);
+}
+
+void mosample_game_frame(ID3D11DeviceContext* d3d11_context, ID3D11ShaderResourceView* game_content_srv)
+{
+    SvrMosampleStep step = svr_mosample_sched_advance(&mosample_sched, mosample_advance);
+    mosample_advance = 1;
+
+    movie_subframes += (step.weight > 0.0f) + (step.num_frames > 0 && step.next_weight > 0.0f);
+
+    if (step.num_frames == 0)
     {
-        float weight = (mosample_remainder - svr_max(1.0f - exposure, old_rem)) * (1.0f / exposure);
-        motion_sample(d3d11_context, game_content_srv, weight);
+        if (step.weight > 0.0f)
+        {
+            motion_sample(d3d11_context, game_content_srv, step.weight);
+        }
     }
 
     else
     {
-        float weight = (1.0f - svr_max(1.0f - exposure, old_rem)) * (1.0f / exposure);
-        motion_sample(d3d11_context, game_content_srv, weight);
-
-        encode_video_frame(d3d11_context, work_tex_srv, work_tex_rtv);
-
-        mosample_remainder -= 1.0f;
-
-        s32 additional = mosample_remainder;
+        // The velocity overlay is drawn into the work texture, so then the sum has to be written first.
+        bool fuse_last_sample = !movie_profile.veloc_enabled;
 
-        if (additional > 0)
+        if (fuse_last_sample)
         {
-            for (s32 i = 0; i < additional; i++)
-            {
-                encode_video_frame(d3d11_context, work_tex_srv, work_tex_rtv);
-            }
+            motion_sample_and_convert(d3d11_context, game_content_srv, step.weight);
+            send_converted_video_frame_to_ffmpeg(d3d11_context, step.num_frames);
+        }
 
-            mosample_remainder -= additional;
+        else
+        {
+            motion_sample(d3d11_context, game_content_srv, step.weight);
+            encode_video_frame(d3d11_context, work_tex_srv, work_tex_rtv, step.num_frames);
         }
 
+        // Unlike on the CPU, this cannot be done in the conversion as other thread groups may still read the neighbors of a pixel.
+        // A clear does not go through the shaders and is usually just a flag for the driver.
         float clear_color[] = { 0.0f, 0.0f, 0.0f, 1.0f };
         d3d11_context->ClearRenderTargetView(work_tex_rtv, clear_color);
 
-        if (mosample_remainder > FLT_EPSILON && mosample_remainder > (1.0f - exposure))
+        if (step.next_weight > 0.0f)
         {
-            weight = ((mosample_remainder - (1.0f - exposure)) * (1.0f / exposure));
-            motion_sample(d3d11_context, game_content_srv, weight);
+            motion_sample(d3d11_context, game_content_srv, step.next_weight);
         }
     }
 }
@@ -2172,6 +1918,8 @@ void mosample_game_frame(ID3D11DeviceContext* d3d11_context, ID3D11ShaderResourc
 void proc_frame(ID3D11DeviceContext* d3d11_context, ID3D11ShaderResourceView* game_content_srv, ID3D11RenderTargetView* game_content_rtv)
 {
     svr_start_prof(&frame_prof);
+    svr_start_hist(&frame_hist);
+    svr_trace_begin("Frame");
 
     if (movie_profile.mosample_enabled)
     {
@@ -2180,10 +1928,19 @@ void proc_frame(ID3D11DeviceContext* d3d11_context, ID3D11ShaderResourceView* ga
 
     else
     {
-        encode_video_frame(d3d11_context, game_content_srv, game_content_rtv);
+        encode_video_frame(d3d11_context, game_content_srv, game_content_rtv, 1);
     }
 
+    svr_trace_end("Frame");
+    svr_end_hist(&frame_hist);
     svr_end_prof(&frame_prof);
+
+    if (svr_shared_stats_due())
+    {
+        SvrStats stats;
+        proc_get_stats(&stats);
+        svr_publish_stats(&stats);
+    }
 }
 
 void proc_give_velocity(float* xyz)
@@ -2201,27 +1958,20 @@ bool proc_is_audio_enabled()
     return movie_profile.audio_enabled;
 }
 
-void write_wav_samples()
+void proc_give_audio(SvrWaveSample* samples, s32 num_samples)
 {
-    s32 buf_size = sizeof(SvrWaveSample) * wav_num_samples;
-
-    wav_data_length += buf_size;
-    wav_file_length += buf_size;
-
-    WriteFile(wav_f, wav_buf, buf_size, NULL, NULL);
-
-    wav_num_samples = 0;
+    ffmpeg_give_audio(samples, num_samples);
 }
 
-void proc_give_audio(SvrWaveSample* samples, s32 num_samples)
+bool proc_rotate_output(ID3D11DeviceContext* d3d11_context, const char* dest)
 {
-    if (wav_num_samples + num_samples >= WAV_BUFFERED_SAMPLES)
-    {
-        write_wav_samples();
-    }
+    char path[MAX_PATH];
+    build_movie_path(svr_resource_path, dest, path, MAX_PATH);
+
+    // The frames of the file before can have to be written before the new file can be started, and the slots are only mapped by us.
+    map_dl_slots(d3d11_context, true);
 
-    memcpy(wav_buf + wav_num_samples, samples, sizeof(SvrWaveSample) * num_samples);
-    wav_num_samples += num_samples;
+    return ffmpeg_rotate_output(path, movie_frames_given);
 }
 
 void show_total_prof(const char* name, SvrProf* prof)
@@ -2237,51 +1987,121 @@ void show_prof(const char* name, SvrProf* prof)
     }
 }
 
-void end_audio()
+// The encoder side fills in the rest when the movie has been finished.
+void fill_proc_report(ProcReport* report)
 {
-    if (wav_num_samples > 0)
-    {
-        write_wav_samples();
-    }
-
-    SetFilePointer(wav_f, wav_header_pos, NULL, FILE_BEGIN);
-    WriteFile(wav_f, &wav_file_length, sizeof(DWORD), NULL, NULL);
-
-    SetFilePointer(wav_f, wav_data_pos, NULL, FILE_BEGIN);
-    WriteFile(wav_f, &wav_data_length, sizeof(DWORD), NULL, NULL);
-
-    wav_data_length = 0;
-    wav_file_length = 0;
-    wav_header_pos = 0;
-    wav_data_pos = 0;
-    wav_num_samples = 0;
+    report->backend = "GPU";
+    report->width = movie_width;
+    report->height = movie_height;
+    report->subframes = movie_subframes;
+
+    report->frame = frame_hist;
+    report->mosample = mosample_hist;
+    report->download = dl_hist;
+    report->readback_wait = dl_map_wait_hist;
+
+    // A download slot is free again when the serialize stage has put its frame in a send buffer, or with direct writes
+    // when the ffmpeg thread has written the frame. The encoder side tells which one it was.
+    report->slot_wait = dl_wait_hist;
+    report->queue_wait = dl_wait_hist;
+    svr_merge_hist(&report->queue_wait, &dl_serialize_stage.wait_hist);
 }
 
-void proc_end()
+void proc_end(ID3D11DeviceContext* d3d11_context)
 {
-    end_ffmpeg_proc();
+    flush_dl_slots(d3d11_context);
+
+    ProcReport* report = ffmpeg_get_report();
 
-    if (movie_profile.audio_enabled)
+    if (report)
     {
-        end_audio();
+        fill_proc_report(report);
     }
 
+    ffmpeg_end();
+
     free_all_dynamic_sw_stuff();
     free_all_dynamic_proc_stuff();
 
-    #if SVR_PROF
-    show_total_prof("Total work time", &frame_prof);
-    show_prof("Download", &dl_prof);
-    show_prof("Write", &write_prof);
-    show_prof("Mosample", &mosample_prof);
-    #endif
+    // No movie is active now.
+    SvrStats stats = {};
+    svr_publish_stats(&stats);
+
+    show_hist("Frame", &frame_hist);
+    show_hist("Download", &dl_hist);
+    show_hist("Waiting for a download slot", &dl_wait_hist);
+    show_hist("Waiting for the GPU", &dl_map_wait_hist);
+    show_hist("Waiting for the serialize stage", &dl_serialize_stage.wait_hist);
+    show_hist("Mosample", &mosample_hist);
+
+    if (svr_prof_enabled)
+    {
+        show_total_prof("Total work time", &frame_prof);
+        show_prof("Download", &dl_prof);
+        show_total_prof("Total serialize stage time", &dl_serialize_stage.prof);
+        show_prof("Mosample", &mosample_prof);
+    }
 
     svr_reset_prof(&frame_prof);
     svr_reset_prof(&dl_prof);
-    svr_reset_prof(&write_prof);
+    svr_reset_prof(&dl_serialize_stage.prof);
     svr_reset_prof(&mosample_prof);
 }
 
+void proc_shutdown()
+{
+    // Finalizer threads would be ended with the process and leave the movies cut off.
+    wait_for_finalizing_sessions(0);
+}
+
+s32 proc_next_frame_needed()
+{
+    if (!movie_profile.mosample_enabled)
+    {
+        return 1;
+    }
+
+    mosample_advance = svr_mosample_sched_next_needed(&mosample_sched);
+    return mosample_advance;
+}
+
+void proc_get_latency(ProcLatency* latency)
+{
+    FfmpegLatency ffmpeg_latency;
+    ffmpeg_get_latency(&ffmpeg_latency);
+
+    *latency = {};
+
+    svr_merge_hist(&latency->frame, &frame_hist);
+    svr_merge_hist(&latency->mosample, &mosample_hist);
+    svr_merge_hist(&latency->download, &dl_hist);
+    svr_merge_hist(&latency->queue_wait, &dl_wait_hist);
+    svr_merge_hist(&latency->queue_wait, &dl_serialize_stage.wait_hist);
+    svr_merge_hist(&latency->write, &ffmpeg_latency.write);
+    svr_merge_hist(&latency->send_wait, &ffmpeg_latency.send_wait);
+}
+
+void proc_get_stats(SvrStats* stats)
+{
+    FfmpegStats ffmpeg_stats;
+    ffmpeg_get_stats(&ffmpeg_stats);
+
+    *stats = {};
+
+    stats->movie_active = 1;
+    stats->frames_submitted = ffmpeg_stats.frames_submitted;
+    stats->frames_encoded = ffmpeg_stats.frames_written;
+    stats->subframes_accumulated = movie_subframes;
+    stats->write_queue_depth = ffmpeg_stats.write_queue_depth;
+    stats->read_queue_depth = ffmpeg_stats.read_queue_depth;
+
+    // The game thread waits for download slots and for room in the serialize stage. Send buffers are waited for by the serialize stage.
+    stats->stall_time_us = dl_wait_hist.total + dl_serialize_stage.wait_hist.total;
+
+    stats->encoder_fps = svr_update_rate(&encoder_rate, ffmpeg_stats.frames_written);
+    stats->audio_samples_written = ffmpeg_stats.audio_samples_written;
+}
+
 s32 proc_get_game_rate()
 {
     if (movie_profile.mosample_enabled)
@@ -1,5 +1,6 @@
 #pragma once
 #include "svr_common.h"
+#include "svr_hist.h"
 
 // Proc is the layer below the public API. This is where the magic happens.
 
@@ -8,6 +9,27 @@ struct ID3D11DeviceContext;
 struct ID3D11ShaderResourceView;
 struct ID3D11RenderTargetView;
 struct SvrWaveSample;
+struct SvrStats;
+
+// Times of the movie that is being made, in microseconds. The same for both proc backends.
+struct ProcLatency
+{
+    SvrHist frame;
+    SvrHist mosample;
+
+    // Only on the CPU, as the conversion on the GPU is not waited for.
+    SvrHist pxconv;
+
+    // Only on the GPU.
+    SvrHist download;
+
+    // Waiting for room in the next step of the pipeline (the download slots, or the capture buffers and the stages on the CPU).
+    SvrHist queue_wait;
+
+    // From ffmpeg_get_latency.
+    SvrHist write;
+    SvrHist send_wait;
+};
 
 bool proc_init(const char* resource_path, ID3D11Device* d3d11_device);
 bool proc_start(ID3D11Device* d3d11_device, ID3D11DeviceContext* d3d11_context, const char* dest, const char* profile, ID3D11ShaderResourceView* game_content_srv);
@@ -16,5 +38,16 @@ void proc_give_velocity(float* xyz);
 bool proc_is_velo_enabled();
 bool proc_is_audio_enabled();
 void proc_give_audio(SvrWaveSample* samples, s32 num_samples);
-void proc_end();
+bool proc_rotate_output(ID3D11DeviceContext* d3d11_context, const char* dest);
+void proc_end(ID3D11DeviceContext* d3d11_context);
+
+// Waits for the movies that are being finished in the background. Called when the game exits.
+void proc_shutdown();
+s32 proc_next_frame_needed();
 s32 proc_get_game_rate();
+
+// Can be called while the movie is being made.
+void proc_get_latency(ProcLatency* latency);
+
+// Same as svr_get_stats, for the movie that is being made.
+void proc_get_stats(SvrStats* stats);
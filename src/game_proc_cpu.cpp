@@ -0,0 +1,714 @@
+#include "game_proc_cpu.h"
+#include "game_shared.h"
+#include "game_proc_profile.h"
+#include "game_proc_ffmpeg.h"
+#include "svr_pxconv.h"
+#include "svr_mosample.h"
+#include "svr_mosample_sched.h"
+#include "svr_prof.h"
+#include "svr_stage.h"
+#include "svr_trace.h"
+#include "svr_stats.h"
+#include "game_proc_report.h"
+#include "svr_api.h"
+#include <Windows.h>
+#include <strsafe.h>
+#include <malloc.h>
+#include <assert.h>
+
+// Don't use fatal process ending errors in here as this is used both in standalone and in integration.
+
+// -------------------------------------------------
+
+char cpu_resource_path[MAX_PATH];
+
+// -------------------------------------------------
+// Movie state.
+
+MovieProfile cpu_movie_profile;
+
+s32 cpu_movie_width;
+s32 cpu_movie_height;
+
+char cpu_movie_path[MAX_PATH];
+
+// Frames of the movie that have been given to the stages, counting repeated frames. For where a new file starts (see proc_cpu_rotate_output).
+s64 cpu_movie_frames_given;
+
+// Same as in game_proc, for the stats.
+s64 cpu_movie_subframes;
+SvrRate cpu_encoder_rate;
+
+PxConv cpu_movie_pxconv;
+
+s32 cpu_used_pxconv_planes;
+s32 cpu_pxconv_plane_sizes[3];
+s32 cpu_pxconv_total_plane_sizes;
+
+// -------------------------------------------------
+// Pipeline state.
+
+// The game thread only copies the frame and hands it to the first stage:
+// capture (game thread) -> accumulate (only with mosample) -> convert -> write (ffmpeg thread).
+// With mosample, the last sample of every video frame is added in the convert stage while converting, which also clears
+// the work buffer. This way the work buffer is only read once at the end of a frame (see svr_pxconv_from_mosample_float32).
+
+// A buffer that moves through the stages.
+struct CpuPipeBuf
+{
+    void* mem;
+
+    // How many video frames this becomes when converted.
+    s32 num_frames;
+
+    // For work buffers, the captured frame that is the last sample. It is added during the conversion and given back
+    // to the capture pool after.
+    CpuPipeBuf* sample;
+    float sample_weight;
+
+    // For captured frames, how they are used in the video frames. Decided on the game thread (see proc_cpu_next_frame_needed).
+    SvrMosampleStep mosample_step;
+};
+
+// Copies of the incoming frames (BGRA8 with no padding between rows).
+CpuPipeBuf cpu_capture_bufs[MAX_PIPELINE_DEPTH];
+SvrPool cpu_capture_pool;
+
+SvrStage cpu_accum_stage;
+SvrStage cpu_convert_stage;
+
+// -------------------------------------------------
+// Mosample state.
+
+// Same as the work texture in game_proc, but as floats with the R, G and B channels of a row one after the other (see svr_mosample.h).
+// With mosample_fixed_point these are 16-bit fixed point in the same layout instead.
+// One is accumulated into while the other is converted.
+const s32 CPU_NUM_WORK_BUFS = 2;
+
+CpuPipeBuf cpu_work_bufs[CPU_NUM_WORK_BUFS];
+SvrPool cpu_work_pool;
+s32 cpu_work_buf_pitch;
+
+// The work buffer that is being accumulated into. Only used by the accumulate stage.
+CpuPipeBuf* cpu_cur_work_buf;
+
+// Only used by the game thread.
+SvrMosampleSched cpu_mosample_sched;
+s32 cpu_mosample_advance;
+
+// The accumulation of a sample is split up in rows between these threads, as one thread cannot keep up with high multipliers.
+SvrBandPool cpu_mosample_band_pool;
+
+// What the band threads are currently accumulating.
+const u8* cpu_mosample_source;
+float cpu_mosample_weight;
+
+// -------------------------------------------------
+// Time profiling.
+
+SvrProf cpu_frame_prof;
+SvrProf cpu_pxconv_prof;
+SvrProf cpu_mosample_prof;
+
+// Same times as above but for every frame, which are always kept and shown when the movie ends.
+SvrHist cpu_frame_hist;
+SvrHist cpu_pxconv_hist;
+SvrHist cpu_mosample_hist;
+
+// Time the game thread waited for a capture buffer to be given back by the stages.
+// The buffers go around between the game and the stages, so this is where the game waits when the pipeline cannot keep up.
+SvrHist cpu_capture_wait_hist;
+
+bool cpu_inited;
+
+// -------------------------------------------------
+
+bool proc_cpu_init(const char* resource_path)
+{
+    StringCchCopyA(cpu_resource_path, MAX_PATH, resource_path);
+
+    ffmpeg_init();
+
+    if (!cpu_inited)
+    {
+        svr_pxconv_init();
+        svr_mosample_init();
+
+        game_log("Using %s for pixel conversion\n", svr_get_simd_level_name(svr_pxconv_get_simd_level()));
+        game_log("Using %s for motion sampling\n", svr_get_simd_level_name(svr_mosample_get_simd_level()));
+
+        // The conversions are checked against the reference by svr_headless.exe selftest.
+
+        svr_pool_init(&cpu_capture_pool, MAX_PIPELINE_DEPTH);
+        svr_pool_init(&cpu_work_pool, CPU_NUM_WORK_BUFS);
+
+        svr_stage_init(&cpu_accum_stage, "Accumulate", MAX_PIPELINE_DEPTH);
+        svr_stage_init(&cpu_convert_stage, "Convert", MAX_PIPELINE_DEPTH);
+
+        svr_create_shared_stats();
+
+        cpu_inited = true;
+    }
+
+    return true;
+}
+
+void free_pipe_bufs(CpuPipeBuf* bufs, s32 num)
+{
+    for (s32 i = 0; i < num; i++)
+    {
+        if (bufs[i].mem)
+        {
+            _aligned_free(bufs[i].mem);
+        }
+
+        bufs[i] = {};
+    }
+}
+
+bool alloc_pipe_bufs(CpuPipeBuf* bufs, s32 num, s32 size, SvrPool* pool)
+{
+    svr_pool_reset(pool);
+
+    for (s32 i = 0; i < num; i++)
+    {
+        bufs[i].mem = _aligned_malloc(size, 64);
+        bufs[i].num_frames = 1;
+        bufs[i].sample = NULL;
+        bufs[i].sample_weight = 0.0f;
+
+        if (bufs[i].mem == NULL)
+        {
+            return false;
+        }
+
+        memset(bufs[i].mem, 0, size);
+
+        svr_pool_put(pool, &bufs[i]);
+    }
+
+    return true;
+}
+
+void free_all_dynamic_cpu_stuff()
+{
+    free_pipe_bufs(cpu_capture_bufs, MAX_PIPELINE_DEPTH);
+    free_pipe_bufs(cpu_work_bufs, CPU_NUM_WORK_BUFS);
+
+    cpu_cur_work_buf = NULL;
+}
+
+void accum_stage_fn(void* item, void* user);
+void convert_stage_fn(void* item, void* user);
+
+bool proc_cpu_start(const char* dest, const char* profile, s32 width, s32 height)
+{
+    bool ret = false;
+
+    FfmpegStartData ffmpeg_data;
+
+    if (!read_profile_by_name(cpu_resource_path, profile, &cpu_movie_profile))
+    {
+        goto rfail;
+    }
+
+    svr_prof_enabled = svr_prof_launch_enabled || cpu_movie_profile.profiling_enabled;
+
+    if (cpu_movie_profile.veloc_enabled)
+    {
+        game_log("Velo is not available when processing on the CPU\n");
+        cpu_movie_profile.veloc_enabled = 0;
+    }
+
+    cpu_movie_width = width;
+    cpu_movie_height = height;
+
+    build_movie_path(cpu_resource_path, dest, cpu_movie_path, MAX_PATH);
+
+    cpu_movie_frames_given = 0;
+    cpu_movie_subframes = 0;
+
+    cpu_movie_pxconv = calc_encoder_pxconv(&cpu_movie_profile);
+    cpu_used_pxconv_planes = calc_format_planes(cpu_movie_pxconv);
+
+    // Combined size of all planes.
+    cpu_pxconv_total_plane_sizes = 0;
+
+    for (s32 i = 0; i < cpu_used_pxconv_planes; i++)
+    {
+        s32 dims[2];
+        calc_plane_dims(cpu_movie_pxconv, width, height, i, &dims[0], &dims[1]);
+
+        cpu_pxconv_plane_sizes[i] = calc_plane_pitch(cpu_movie_pxconv, width, i) * dims[1];
+        cpu_pxconv_total_plane_sizes += cpu_pxconv_plane_sizes[i];
+    }
+
+    if (!svr_pxconv_reserve(width))
+    {
+        svr_log("ERROR: Could not allocate pixel conversion rows\n");
+        goto rfail;
+    }
+
+    if (!alloc_pipe_bufs(cpu_capture_bufs, cpu_movie_profile.pipeline_depth, 4 * width * height, &cpu_capture_pool))
+    {
+        svr_log("ERROR: Could not allocate CPU capture buffers\n");
+        goto rfail;
+    }
+
+    if (cpu_movie_profile.mosample_enabled)
+    {
+        if (cpu_movie_profile.mosample_fixed_point)
+        {
+            cpu_work_buf_pitch = sizeof(u16) * 3 * width;
+        }
+
+        else
+        {
+            cpu_work_buf_pitch = sizeof(float) * 3 * width;
+        }
+
+        if (!alloc_pipe_bufs(cpu_work_bufs, CPU_NUM_WORK_BUFS, cpu_work_buf_pitch * height, &cpu_work_pool))
+        {
+            svr_log("ERROR: Could not allocate CPU work buffers\n");
+            goto rfail;
+        }
+
+        cpu_cur_work_buf = (CpuPipeBuf*)svr_pool_take(&cpu_work_pool);
+
+        svr_mosample_sched_init(&cpu_mosample_sched, cpu_movie_profile.mosample_mult, cpu_movie_profile.mosample_exposure);
+        cpu_mosample_advance = 1;
+    }
+
+    ffmpeg_data.resource_path = cpu_resource_path;
+    ffmpeg_data.movie_path = cpu_movie_path;
+    ffmpeg_data.profile = &cpu_movie_profile;
+    ffmpeg_data.pxconv = cpu_movie_pxconv;
+    ffmpeg_data.width = cpu_movie_width;
+    ffmpeg_data.height = cpu_movie_height;
+    ffmpeg_data.frame_size = cpu_pxconv_total_plane_sizes;
+    ffmpeg_data.planes_only = false;
+
+    if (!ffmpeg_start(&ffmpeg_data))
+    {
+        goto rfail;
+    }
+
+    svr_reset_hist(&cpu_frame_hist);
+    svr_reset_hist(&cpu_pxconv_hist);
+    svr_reset_hist(&cpu_mosample_hist);
+    svr_reset_hist(&cpu_capture_wait_hist);
+
+    // The accumulate stage is not started without motion blur.
+    svr_reset_hist(&cpu_accum_stage.wait_hist);
+    svr_reset_hist(&cpu_convert_stage.wait_hist);
+
+    // The trace is ended when the movie has been finished (see ffmpeg_end).
+    if (cpu_movie_profile.trace_enabled)
+    {
+        char trace_path[MAX_PATH];
+        StringCchPrintfA(trace_path, MAX_PATH, "%s.trace.json", cpu_movie_path);
+
+        svr_trace_name_thread("Game", -1);
+        svr_start_trace(trace_path);
+    }
+
+    if (cpu_movie_profile.mosample_enabled)
+    {
+        svr_band_pool_start(&cpu_mosample_band_pool, svr_calc_band_threads());
+        svr_stage_start(&cpu_accum_stage, cpu_movie_profile.pipeline_depth, accum_stage_fn, NULL);
+    }
+
+    svr_stage_start(&cpu_convert_stage, cpu_movie_profile.pipeline_depth, convert_stage_fn, NULL);
+
+    svr_start_rate(&cpu_encoder_rate, 0);
+
+    ret = true;
+    goto rexit;
+
+rfail:
+    free_all_dynamic_cpu_stuff();
+
+rexit:
+    return ret;
+}
+
+// Splits a send buffer into the planes of the movie pixel format.
+void cpu_get_send_buf_planes(ThreadPipeData* pipe_data, u8** planes)
+{
+    s32 offset = 0;
+
+    for (s32 i = 0; i < cpu_used_pxconv_planes; i++)
+    {
+        planes[i] = pipe_data->ptr + offset;
+        offset += cpu_pxconv_plane_sizes[i];
+    }
+}
+
+// Converts a captured frame and sends it.
+void cpu_encode_video_frame(CpuPipeBuf* buf)
+{
+    ThreadPipeData pipe_data;
+    ffmpeg_acquire_send_buf(&pipe_data);
+
+    u8* planes[3];
+    cpu_get_send_buf_planes(&pipe_data, planes);
+
+    svr_start_prof(&cpu_pxconv_prof);
+    svr_start_hist(&cpu_pxconv_hist);
+    svr_trace_begin("Pxconv");
+
+    svr_pxconv_from_bgra8(cpu_movie_pxconv, (u8*)buf->mem, 4 * cpu_movie_width, cpu_movie_width, cpu_movie_height, planes);
+
+    svr_trace_end("Pxconv");
+    svr_end_hist(&cpu_pxconv_hist);
+    svr_end_prof(&cpu_pxconv_prof);
+
+    pipe_data.num_frames = buf->num_frames;
+
+    ffmpeg_submit_send_buf(&pipe_data);
+}
+
+// Adds the last sample to a work buffer and sends it.
+void cpu_encode_mosample_frame(CpuPipeBuf* buf)
+{
+    const u8* sample = (const u8*)buf->sample->mem;
+    s32 sample_pitch = 4 * cpu_movie_width;
+    float weight = buf->sample_weight;
+
+    ThreadPipeData pipe_data;
+    ffmpeg_acquire_send_buf(&pipe_data);
+
+    u8* planes[3];
+    cpu_get_send_buf_planes(&pipe_data, planes);
+
+    svr_start_prof(&cpu_pxconv_prof);
+    svr_start_hist(&cpu_pxconv_hist);
+    svr_trace_begin("Pxconv");
+
+    if (cpu_movie_profile.mosample_fixed_point)
+    {
+        svr_pxconv_from_mosample_fixed16(cpu_movie_pxconv, (u16*)buf->mem, cpu_work_buf_pitch, sample, sample_pitch, weight, cpu_movie_width, cpu_movie_height, planes);
+    }
+
+    else
+    {
+        svr_pxconv_from_mosample_float32(cpu_movie_pxconv, (float*)buf->mem, cpu_work_buf_pitch, sample, sample_pitch, weight, cpu_movie_width, cpu_movie_height, planes);
+    }
+
+    svr_trace_end("Pxconv");
+    svr_end_hist(&cpu_pxconv_hist);
+    svr_end_prof(&cpu_pxconv_prof);
+
+    // A video frame that is repeated is still only converted once.
+    pipe_data.num_frames = buf->num_frames;
+
+    ffmpeg_submit_send_buf(&pipe_data);
+}
+
+void mosample_band_fn(s32 start_row, s32 end_row, void* user)
+{
+    if (cpu_movie_profile.mosample_fixed_point)
+    {
+        u16* work_buf = (u16*)cpu_cur_work_buf->mem;
+        svr_mosample_bgra8_fixed16(work_buf, cpu_work_buf_pitch, cpu_mosample_source, 4 * cpu_movie_width, cpu_movie_width, start_row, end_row, cpu_mosample_weight);
+    }
+
+    else
+    {
+        float* work_buf = (float*)cpu_cur_work_buf->mem;
+        svr_mosample_bgra8(work_buf, cpu_work_buf_pitch, cpu_mosample_source, 4 * cpu_movie_width, cpu_movie_width, start_row, end_row, cpu_mosample_weight);
+    }
+}
+
+// Same as motion_sample.hlsl.
+void cpu_motion_sample(const u8* bgra, float weight)
+{
+    svr_start_prof(&cpu_mosample_prof);
+    svr_start_hist(&cpu_mosample_hist);
+    svr_trace_begin("Mosample");
+
+    cpu_mosample_source = bgra;
+    cpu_mosample_weight = weight;
+
+    svr_band_pool_run(&cpu_mosample_band_pool, cpu_movie_height, mosample_band_fn, NULL);
+
+    svr_trace_end("Mosample");
+    svr_end_hist(&cpu_mosample_hist);
+    svr_end_prof(&cpu_mosample_prof);
+}
+
+// Same as mosample_game_frame in game_proc.
+// Returns true if the captured frame became the last sample of a video frame, which the convert stage will give back.
+bool cpu_mosample_game_frame(CpuPipeBuf* capture_buf)
+{
+    const u8* bgra = (const u8*)capture_buf->mem;
+    SvrMosampleStep* step = &capture_buf->mosample_step;
+
+    if (step->num_frames == 0)
+    {
+        if (step->weight > 0.0f)
+        {
+            cpu_motion_sample(bgra, step->weight);
+        }
+
+        return false;
+    }
+
+    // The last sample is added in the convert stage.
+    cpu_cur_work_buf->sample = capture_buf;
+    cpu_cur_work_buf->sample_weight = step->weight;
+
+    // The work buffer is converted in the next stage, continue in the other one.
+
+    cpu_cur_work_buf->num_frames = step->num_frames;
+    svr_stage_push(&cpu_convert_stage, cpu_cur_work_buf);
+
+    // Work buffers are cleared by the convert stage.
+    cpu_cur_work_buf = (CpuPipeBuf*)svr_pool_take(&cpu_work_pool);
+
+    // The convert stage only reads the captured frame, so it can be used here at the same time.
+    if (step->next_weight > 0.0f)
+    {
+        cpu_motion_sample(bgra, step->next_weight);
+    }
+
+    return true;
+}
+
+void accum_stage_fn(void* item, void* user)
+{
+    CpuPipeBuf* buf = (CpuPipeBuf*)item;
+
+    if (!cpu_mosample_game_frame(buf))
+    {
+        svr_pool_put(&cpu_capture_pool, buf);
+    }
+}
+
+void convert_stage_fn(void* item, void* user)
+{
+    CpuPipeBuf* buf = (CpuPipeBuf*)item;
+
+    if (cpu_movie_profile.mosample_enabled)
+    {
+        cpu_encode_mosample_frame(buf);
+
+        svr_pool_put(&cpu_capture_pool, buf->sample);
+        buf->sample = NULL;
+
+        svr_pool_put(&cpu_work_pool, buf);
+    }
+
+    else
+    {
+        cpu_encode_video_frame(buf);
+        svr_pool_put(&cpu_capture_pool, buf);
+    }
+}
+
+void proc_cpu_frame(const u8* bgra, s32 pitch)
+{
+    svr_start_prof(&cpu_frame_prof);
+    svr_start_hist(&cpu_frame_hist);
+    svr_trace_begin("Frame");
+
+    SvrMosampleStep step = {};
+
+    if (cpu_movie_profile.mosample_enabled)
+    {
+        step = svr_mosample_sched_advance(&cpu_mosample_sched, cpu_mosample_advance);
+        cpu_mosample_advance = 1;
+
+        cpu_movie_subframes += (step.weight > 0.0f) + (step.num_frames > 0 && step.next_weight > 0.0f);
+
+        // Outside of the exposure, there is no need to copy it.
+        if (step.num_frames == 0 && step.weight == 0.0f)
+        {
+            svr_trace_end("Frame");
+            svr_end_hist(&cpu_frame_hist);
+            svr_end_prof(&cpu_frame_prof);
+            return;
+        }
+    }
+
+    // The frames are made by the stages, but how many there will be is known now.
+    cpu_movie_frames_given += cpu_movie_profile.mosample_enabled ? step.num_frames : 1;
+
+    svr_start_hist(&cpu_capture_wait_hist);
+    svr_trace_begin("Queue wait");
+
+    CpuPipeBuf* buf = (CpuPipeBuf*)svr_pool_take(&cpu_capture_pool);
+
+    svr_trace_end("Queue wait");
+    svr_end_hist(&cpu_capture_wait_hist);
+
+    buf->mosample_step = step;
+
+    svr_trace_begin("Copy");
+
+    for (s32 y = 0; y < cpu_movie_height; y++)
+    {
+        memcpy((u8*)buf->mem + (y * 4 * cpu_movie_width), bgra + (y * pitch), 4 * cpu_movie_width);
+    }
+
+    svr_trace_end("Copy");
+
+    if (cpu_movie_profile.mosample_enabled)
+    {
+        svr_stage_push(&cpu_accum_stage, buf);
+    }
+
+    else
+    {
+        svr_stage_push(&cpu_convert_stage, buf);
+    }
+
+    svr_trace_end("Frame");
+    svr_end_hist(&cpu_frame_hist);
+    svr_end_prof(&cpu_frame_prof);
+
+    if (svr_shared_stats_due())
+    {
+        SvrStats stats;
+        proc_cpu_get_stats(&stats);
+        svr_publish_stats(&stats);
+    }
+}
+
+void proc_cpu_give_audio(SvrWaveSample* samples, s32 num_samples)
+{
+    ffmpeg_give_audio(samples, num_samples);
+}
+
+bool proc_cpu_rotate_output(const char* dest)
+{
+    char path[MAX_PATH];
+    build_movie_path(cpu_resource_path, dest, path, MAX_PATH);
+
+    return ffmpeg_rotate_output(path, cpu_movie_frames_given);
+}
+
+// The encoder side fills in the rest when the movie has been finished.
+void fill_cpu_proc_report(ProcReport* report)
+{
+    report->backend = "CPU";
+    report->width = cpu_movie_width;
+    report->height = cpu_movie_height;
+    report->subframes = cpu_movie_subframes;
+
+    report->frame = cpu_frame_hist;
+    report->mosample = cpu_mosample_hist;
+    report->pxconv = cpu_pxconv_hist;
+
+    // Frames are given by the game and not downloaded. The game thread waits for a capture buffer and for the first stage.
+    report->queue_wait = cpu_capture_wait_hist;
+    svr_merge_hist(&report->queue_wait, cpu_movie_profile.mosample_enabled ? &cpu_accum_stage.wait_hist : &cpu_convert_stage.wait_hist);
+}
+
+void proc_cpu_end()
+{
+    // Stages must be stopped in order as they push to each other.
+    // The work buffer that is being accumulated into is not a complete frame and is skipped.
+
+    svr_stage_stop(&cpu_accum_stage);
+    svr_stage_stop(&cpu_convert_stage);
+
+    svr_band_pool_stop(&cpu_mosample_band_pool);
+
+    ProcReport* report = ffmpeg_get_report();
+
+    if (report)
+    {
+        fill_cpu_proc_report(report);
+    }
+
+    ffmpeg_end();
+
+    free_all_dynamic_cpu_stuff();
+
+    // No movie is active now.
+    SvrStats stats = {};
+    svr_publish_stats(&stats);
+
+    show_hist("Frame", &cpu_frame_hist);
+    show_hist("Waiting for a capture buffer", &cpu_capture_wait_hist);
+    show_hist("Waiting for the accumulate stage", &cpu_accum_stage.wait_hist);
+    show_hist("Waiting for the convert stage", &cpu_convert_stage.wait_hist);
+    show_hist("Mosample", &cpu_mosample_hist);
+    show_hist("Pxconv", &cpu_pxconv_hist);
+
+    if (svr_prof_enabled)
+    {
+        game_log("Total work time: %lld\n", cpu_frame_prof.total);
+        game_log("Total accumulate stage time: %lld\n", cpu_accum_stage.prof.total);
+        game_log("Total convert stage time: %lld\n", cpu_convert_stage.prof.total);
+
+        if (cpu_pxconv_prof.runs > 0) game_log("Pxconv: %lld\n", cpu_pxconv_prof.total / cpu_pxconv_prof.runs);
+        if (cpu_mosample_prof.runs > 0) game_log("Mosample: %lld\n", cpu_mosample_prof.total / cpu_mosample_prof.runs);
+    }
+
+    svr_reset_prof(&cpu_frame_prof);
+    svr_reset_prof(&cpu_pxconv_prof);
+    svr_reset_prof(&cpu_mosample_prof);
+    svr_reset_prof(&cpu_accum_stage.prof);
+    svr_reset_prof(&cpu_convert_stage.prof);
+}
+
+s32 proc_cpu_next_frame_needed()
+{
+    if (!cpu_movie_profile.mosample_enabled)
+    {
+        return 1;
+    }
+
+    cpu_mosample_advance = svr_mosample_sched_next_needed(&cpu_mosample_sched);
+    return cpu_mosample_advance;
+}
+
+s32 proc_cpu_get_game_rate()
+{
+    if (cpu_movie_profile.mosample_enabled)
+    {
+        return cpu_movie_profile.movie_fps * cpu_movie_profile.mosample_mult;
+    }
+
+    return cpu_movie_profile.movie_fps;
+}
+
+void proc_cpu_get_latency(ProcLatency* latency)
+{
+    FfmpegLatency ffmpeg_latency;
+    ffmpeg_get_latency(&ffmpeg_latency);
+
+    *latency = {};
+
+    svr_merge_hist(&latency->frame, &cpu_frame_hist);
+    svr_merge_hist(&latency->mosample, &cpu_mosample_hist);
+    svr_merge_hist(&latency->pxconv, &cpu_pxconv_hist);
+    svr_merge_hist(&latency->queue_wait, &cpu_capture_wait_hist);
+    svr_merge_hist(&latency->queue_wait, &cpu_accum_stage.wait_hist);
+    svr_merge_hist(&latency->queue_wait, &cpu_convert_stage.wait_hist);
+    svr_merge_hist(&latency->write, &ffmpeg_latency.write);
+    svr_merge_hist(&latency->send_wait, &ffmpeg_latency.send_wait);
+}
+
+void proc_cpu_get_stats(SvrStats* stats)
+{
+    FfmpegStats ffmpeg_stats;
+    ffmpeg_get_stats(&ffmpeg_stats);
+
+    *stats = {};
+
+    stats->movie_active = 1;
+    stats->frames_submitted = ffmpeg_stats.frames_submitted;
+    stats->frames_encoded = ffmpeg_stats.frames_written;
+    stats->subframes_accumulated = cpu_movie_subframes;
+    stats->write_queue_depth = ffmpeg_stats.write_queue_depth;
+    stats->read_queue_depth = ffmpeg_stats.read_queue_depth;
+
+    // The game thread waits for a capture buffer and only pushes to the first stage, the convert stage is pushed to by the accumulate stage with motion blur.
+    stats->stall_time_us = cpu_capture_wait_hist.total + (cpu_movie_profile.mosample_enabled ? cpu_accum_stage.wait_hist.total : cpu_convert_stage.wait_hist.total);
+
+    stats->encoder_fps = svr_update_rate(&cpu_encoder_rate, ffmpeg_stats.frames_written);
+    stats->audio_samples_written = ffmpeg_stats.audio_samples_written;
+}
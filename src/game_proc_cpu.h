@@ -0,0 +1,35 @@
+#pragma once
+#include "svr_common.h"
+#include "game_proc.h"
+
+// Headless proc backend.
+// This does the same work as game_proc (motion sampling, pixel format conversion and sending to ffmpeg) but everything is done on the CPU
+// with frames that are already in system memory. There is no D3D11 here so this can run without a GPU or a game, which makes it useful
+// for measuring the throughput of the pipeline and for comparing the output between changes.
+// This is what svr_headless.exe runs movies with, which can also compare the output to the shaders (see headless_main.cpp).
+// Velo is not available here since it is rasterized with D2D1.
+
+struct SvrWaveSample;
+
+bool proc_cpu_init(const char* resource_path);
+bool proc_cpu_start(const char* dest, const char* profile, s32 width, s32 height);
+
+// Frames must be BGRA8 and of the same size that was given when starting. The pitch is in bytes.
+// The frame is copied and processed on other threads, so the memory can be reused as soon as this returns.
+void proc_cpu_frame(const u8* bgra, s32 pitch);
+
+// Same as svr_next_frame_needed.
+s32 proc_cpu_next_frame_needed();
+
+void proc_cpu_give_audio(SvrWaveSample* samples, s32 num_samples);
+
+// Same as svr_rotate_output.
+bool proc_cpu_rotate_output(const char* dest);
+void proc_cpu_end();
+s32 proc_cpu_get_game_rate();
+
+// Same as proc_get_latency.
+void proc_cpu_get_latency(ProcLatency* latency);
+
+// Same as proc_get_stats.
+void proc_cpu_get_stats(SvrStats* stats);
@@ -0,0 +1,3852 @@
+#include "game_proc_ffmpeg.h"
+#include "game_shared.h"
+#include "game_proc_profile.h"
+#include "svr_prof.h"
+#include "svr_stream.h"
+#include "svr_sem.h"
+#include "svr_api.h"
+#include "svr_capture.h"
+#include "svr_net.h"
+#include "svr_trace.h"
+#include "svr_hist.h"
+#include "game_proc_report.h"
+#include <Windows.h>
+#include <strsafe.h>
+#include <malloc.h>
+#include <assert.h>
+#include <intrin.h>
+
+// Don't use fatal process ending errors in here as this is used both in standalone and in integration.
+
+// -------------------------------------------------
+
+struct PxConvText
+{
+    const char* format;
+    const char* color_space;
+};
+
+// Names for ffmpeg.
+// Must be synchronized with PxConv.
+PxConvText PXCONV_FFMPEG_TEXT_TABLE[] = {
+    PxConvText { "yuv420p", "bt470bg" },
+    PxConvText { "yuv444p", "bt470bg" },
+    PxConvText { "nv12", "bt470bg" },
+    PxConvText { "nv21", "bt470bg" },
+
+    PxConvText { "yuv420p", "bt709" },
+    PxConvText { "yuv444p", "bt709" },
+    PxConvText { "nv12", "bt709" },
+    PxConvText { "nv21", "bt709" },
+
+    PxConvText { "bgr0", NULL },
+};
+// -------------------------------------------------
+
+// Everything about a movie is in a session, so that a movie can be finished in the background while the next one is made.
+// When a movie ends, its session is given to a finalizer thread which writes the rest of the frames, waits for the ffmpeg processes,
+// joins the parts and frees the buffers. The game can start a new session right away.
+// The game thread only uses the session of the movie that is being made, and a finalizing session is only used by its finalizer and lane threads.
+// Send buffers are acquired and submitted by the thread that submits the frames, which is not the game thread: it is the serialize stage
+// of game_proc, or the stage that converts the frames in game_proc_cpu. Only one thread does this at a time, and the game thread only
+// starts the movie before that thread gets frames and ends it after that thread has been stopped.
+
+struct FfmpegSession;
+
+// With more than one lane, the movie is cut into parts of a few seconds that are encoded by several ffmpeg processes at once.
+// This is for the slow x264 presets, where a single ffmpeg cannot keep up even when it has every core.
+// Every part is a movie of its own which starts with a keyframe, so the parts can be joined at the end without encoding them again.
+// The parts are given out in turn, so part i is encoded by lane i % num_lanes. A lane has a thread and one process at a time,
+// and starts the process for its next part when it gets the first frame of it.
+// With one lane there is a single process for the whole movie that writes to the movie path directly, like there always was.
+// With encode workers, the parts are encoded on other computers instead and every lane is a connection to a worker (see svr_net.h).
+
+struct FfmpegLane
+{
+    FfmpegSession* session;
+
+    HANDLE thread;
+
+    // We write data to the ffmpeg process through this pipe.
+    // It is redirected to their stdin.
+    HANDLE write_pipe;
+    HANDLE proc;
+
+    // The part that the process is encoding, or -1 before the first one.
+    s32 segment;
+
+    // Set if a process could not be started or did not exit successfully. The parts are not joined then.
+    bool failed;
+
+    // Padded rows of planes are put together in here so they are not written one by one. Only used by the thread of the lane,
+    // and only when frames are written from planes. Rows are written one by one if this could not be allocated.
+    u8* write_stage;
+
+    // With encode workers, the connection to the worker and where it is. There is no process then.
+    SvrNetConn conn;
+    char worker_address[MAX_PATH];
+
+    // Frames that the worker has room for.
+    s32 credits;
+
+    // Set while the worker has a part of this lane that it has not sent back yet.
+    bool in_part;
+
+    // Pieces of the encoded parts are received in here.
+    u8* recv_buf;
+
+    // Only touched by the thread of the lane while it is running, and added up at the end.
+    SvrProf write_prof;
+    s64 bytes_written;
+    s64 frames_written;
+
+    // Time that every frame took to be written. This can be read while the lane is running.
+    SvrHist write_hist;
+
+    // Times the lane had to wait for the worker to have room for a frame, and how long that took in microseconds.
+    s64 credit_waits;
+    s64 credit_wait_time;
+    s64 bytes_received;
+
+    // For the report. When the lane got to the end of the movie, the CPU time of its processes, and the time it took to finish
+    // the process of a part and start the next one. Times are in microseconds.
+    s64 write_end_time;
+    s64 encoder_cpu_time;
+    s64 part_switch_time;
+
+    // Queues and semaphore for communicating between the thread that submits the frames and the lane thread.
+    SvrAsyncStream<ThreadPipeData> write_queue;
+    SvrAsyncStream<ThreadPipeData> read_queue;
+
+    // Semaphore that is signalled when there are frames to send to ffmpeg (pulls from write_queue).
+    // This is incremented by the thread that submits the frames when it has added a frame to the write queue.
+    SvrSemaphore write_sem;
+};
+
+// The pipe buffer is made to hold a frame (up to this size) so that a write can complete while ffmpeg is still reading the previous frame.
+// This used to be 4 KB, which meant that every frame was handed over in thousands of small pieces.
+const s32 MAX_PIPE_BUFFER_SIZE = 8 * 1024 * 1024;
+
+// Size of the memory that padded rows are put together in before being written.
+const s32 PIPE_WRITE_STAGE_SIZE = 256 * 1024;
+
+// How many completed buffers we keep in memory waiting to be sent to ffmpeg.
+const s32 MAX_BUFFERED_SEND_BUFS = 8;
+
+// More are used when encoding in parts so that a lane that is waiting for its previous process to finish does not stop the others.
+const s32 MAX_SEGMENTED_SEND_BUFS = 16;
+
+// Spilled and compressed frames are not in send buffers, and there can be this many more of them in the write queue of the first lane.
+const s32 MAX_QUEUED_FRAMES = 1024;
+
+// Send buffers can also be given by a size in the profile, and then there can be this many.
+const s32 MAX_POOLED_SEND_BUFS = 256;
+
+// The pool of a compressed queue is given out in blocks, and a frame is in as many blocks as it needs one after the other.
+// Blocks are larger for larger pools, so that there are never more frames than fit in the write queue.
+const s32 MIN_COMPRESS_BLOCK_SIZE = 64 * 1024;
+
+// Audio is kept until ffmpeg has opened the pipe (see the audio state below).
+const s32 AUDIO_BUFFERED_SAMPLES = 32768;
+
+// Enough for a few seconds, so the game does not wait for ffmpeg to read the audio when it is busy with the video.
+const s32 AUDIO_PIPE_BUFFER_SIZE = 1024 * 1024;
+
+// How long to wait for ffmpeg to open the audio pipe when the samples kept until then are full, in milliseconds.
+// ffmpeg opens it right after it has started reading the video, so if it has not by then it is stuck and the audio is dropped
+// instead of holding up the game.
+const DWORD AUDIO_CONNECT_TIMEOUT = 10000;
+
+// Files that the movie can be continued in before the frames have gotten to them (see ffmpeg_rotate_output).
+const s32 MAX_PENDING_OUTPUTS = 4;
+
+// Processes of earlier files that can still be finishing. The lane waits for the oldest one when there are more.
+const s32 MAX_RETIRED_PROCS = 4;
+
+// Room for the command line of an ffmpeg process.
+const s32 FFMPEG_ARGS_SIZE = 1024;
+
+// A file that the movie is continued in. The process is started by the game thread and taken by the lane
+// when it gets to the first frame of it.
+struct FfmpegOutput
+{
+    char path[MAX_PATH];
+
+    // If the process was started ahead of time, it writes to this file instead and it is moved to the path when the process has finished.
+    // Empty if the process writes to the path.
+    char warm_path[MAX_PATH];
+
+    HANDLE proc;
+    HANDLE write_pipe;
+
+    // Frames of the movie that come before this file.
+    s64 start_frame;
+};
+
+// ffmpeg processes can be started before they are needed, so that a movie or a new file of it does not have to wait for ffmpeg to be loaded
+// (see encoder_prewarm in the profile). ffmpeg is given everything on its command line, so a warm process is started with the arguments
+// of the movie that is being made, and with a file and an audio pipe of its own. It is only used if a movie would have started it with the same
+// arguments, and the file is then moved to the path of the movie when the process has finished. ffmpeg does not open its output before it has
+// been given video, so a warm process that is never used leaves nothing behind. Only used when the movie is written by one ffmpeg process.
+struct FfmpegWarmProc
+{
+    HANDLE proc;
+    HANDLE write_pipe;
+
+    char path[MAX_PATH];
+    char audio_pipe_name[MAX_PATH];
+
+    // What the process was started with, compared with what a movie would start it with.
+    char args[FFMPEG_ARGS_SIZE];
+};
+
+struct FfmpegSession
+{
+    // The queues and the audio buffer are made the first time the session is used, and are kept for the next movies.
+    bool inited;
+
+    // Set from the start of the movie until it has been finished.
+    bool in_use;
+
+    // The thread that finishes the movie, or NULL if the movie is still being made or was finished by the game thread.
+    HANDLE finalize_thread;
+
+    // -------------------------------------------------
+    // Movie state.
+
+    FfmpegStartData movie;
+
+    // Copied so the start data does not have to stay alive, as the game will have moved on to the next movie when this one is finished.
+    MovieProfile profile;
+    char resource_path[MAX_PATH];
+    char movie_path[MAX_PATH];
+
+    SvrProf write_prof;
+
+    // Written to the pipe by the ffmpeg thread, for the write rate.
+    s64 bytes_written;
+
+    // Time that the thread that submits the frames waited for a send buffer, which is 0 when there was one right away.
+    SvrHist send_wait_hist;
+
+    // Written to the audio pipe or file, for the stats.
+    s64 audio_samples_written;
+
+    // For the report. When the movie was started and how long that took the game thread, and when the ffmpeg thread
+    // saw that ffmpeg had read the first frame. Times are in microseconds.
+    s64 start_time;
+    s64 start_duration;
+    s64 first_read_time;
+    bool started_warm;
+
+    // Sampled by the thread that submits the frames while the movie is being made, filled in by the game thread when the movie ends,
+    // and used by the finalizer after (see report_enabled in the profile).
+    // The movie ends when the game ends it, and the output ends when the last frame has been written.
+    ProcReport report;
+    s64 next_queue_sample_time;
+    s64 end_time;
+    s64 output_end_time;
+
+    // -------------------------------------------------
+    // Segmented encoding.
+
+    FfmpegLane lanes[MAX_ENCODER_SEGMENTS];
+    s32 num_lanes;
+
+    // Set when the movie is encoded in parts, by several processes here or by encode workers.
+    bool use_segments;
+
+    // The parts are encoded by workers on other computers (see encoder_workers in the profile).
+    bool use_workers;
+
+    // Added up from the lanes at the end, for the report.
+    s64 credit_waits;
+    s64 credit_wait_time;
+    s64 bytes_received;
+
+    // CPU time of the ffmpeg processes in microseconds. The processes of earlier files are added when they are closed.
+    s64 encoder_cpu_time;
+
+    // Video frames in a part.
+    s32 segment_frames;
+
+    // The encoder threads are split between the processes.
+    s32 threads_per_proc;
+
+    // Only used by the thread that submits the frames, for giving the frames to the lanes. The stats also read frames_submitted.
+    // With one lane this is the file that the frames go in instead (see the rotation state below).
+    s32 segment;
+    s64 segment_start;
+    s64 frames_submitted;
+
+    // -------------------------------------------------
+    // Rotation state.
+
+    // With one ffmpeg process, the movie can be continued in a new file without stopping it (see ffmpeg_rotate_output).
+    // The process of the next file is started by the game thread, and the lane switches to it when it gets to the first frame of it.
+    // The process of the file before is then left to finish on its own, and is only waited for when the movie ends.
+
+    // Files that have been started and that the lane has not switched to yet. File i of the movie is in place i % MAX_PENDING_OUTPUTS.
+    FfmpegOutput outputs[MAX_PENDING_OUTPUTS];
+
+    // Only used by the game thread. How many files there are, the first one included, and the newest one.
+    s32 num_outputs;
+    s64 output_start;
+    char output_path[MAX_PATH];
+
+    // Set by the game thread when a file has been started, for the thread that submits the frames.
+    SvrAtom32 started_outputs;
+
+    // Free places for files. Given back by the lane when it has switched to a file.
+    SvrSemaphore output_sem;
+
+    // Only used by the lane. The paths of the file that it is writing (the process is in the lane),
+    // and the processes of the files before and which files they are.
+    FfmpegOutput lane_output;
+    FfmpegOutput retired_procs[MAX_RETIRED_PROCS];
+    s32 retired_outputs[MAX_RETIRED_PROCS];
+    s32 num_retired_procs;
+
+    // -------------------------------------------------
+    // Capture state.
+
+    // With an intermediate capture, the ffmpeg thread compresses the frames into a file instead of giving them to ffmpeg,
+    // and they are encoded later by svr_encoder.exe (see svr_capture.h). There is no ffmpeg process then.
+    bool use_capture;
+
+    HANDLE capture_file;
+    char capture_path[MAX_PATH];
+
+    SvrCaptureHeader capture_header;
+
+    // Where the next record goes.
+    s64 capture_offset;
+
+    // Frames since the last keyframe.
+    s32 capture_chunk_pos;
+
+    // The frame before is kept for the difference, as the send buffers are reused.
+    u8* capture_prev_frame;
+    u8* capture_scratch;
+    u8* capture_dest;
+
+    SvrCaptureIndexEntry* capture_index;
+    s32 capture_index_size;
+    s32 capture_index_capacity;
+
+    // -------------------------------------------------
+    // Audio state.
+
+    // Audio is given to ffmpeg as a second input through a named pipe, so it is encoded and muxed together with the video
+    // and the movie does not need to be remuxed after. ffmpeg opens the pipe by its name when it gets to that input,
+    // which is after it has started reading the video. Samples are kept here until then.
+    // After that they are written every frame, as ffmpeg has to have the audio for the video it gets to be able to interleave them.
+
+    HANDLE audio_pipe;
+    char audio_pipe_name[MAX_PATH];
+
+    // Used for both the connection and the writes.
+    OVERLAPPED audio_overlapped;
+    bool audio_connected;
+
+    SvrWaveSample* audio_buf;
+    s32 audio_num_samples;
+
+    // Set when ffmpeg did not open the pipe in time, after which it is not waited for again.
+    // Samples that did not fit until then are dropped, and how many is logged when the audio of the file ends.
+    bool audio_connect_timed_out;
+    s64 audio_samples_dropped;
+
+    // The process that opens the pipe, which is the one of the newest file. It is only closed by the lane after a later file has been started,
+    // or when the movie ends before the lane got to the newest file (see end_unused_outputs), which also ends the audio.
+    HANDLE audio_reader;
+
+    // When encoding in parts, audio is written to this file instead and added when the parts are joined.
+    // ffmpeg only reads the pipe when it gets to that input, and it is not known which process that would be.
+    HANDLE audio_file;
+    char audio_file_path[MAX_PATH];
+
+    // -------------------------------------------------
+    // FFmpeg process communication.
+
+    // The buffers that are sent to the ffmpeg process.
+    // For SW encoding these buffers are uncompressed frames of equal size.
+    ThreadPipeData send_bufs[MAX_POOLED_SEND_BUFS];
+    s32 num_send_bufs;
+
+    // Most send buffers that were acquired and not yet written at the same time. Only used by the thread that submits the frames.
+    s32 peak_send_bufs;
+
+    // Semaphore that is signalled when there are frames available to download into (pulls from the read queue of any lane).
+    // This is incremented by the lane threads when they have sent a frame to the ffmpeg process.
+    SvrSemaphore read_sem;
+
+    // Times that all send buffers were in use and there was nowhere else to put the frame, so the game had to wait for ffmpeg.
+    s64 num_stalls;
+
+    // -------------------------------------------------
+    // Spill state.
+
+    // When all send buffers are waiting to be written, frames can be put in a file on the disk instead of waiting for ffmpeg.
+    // Spilled frames go through the write queue like the others, so the ffmpeg thread takes them out of the file when it gets to them
+    // and the order stays the same. The file is only mapped one slot at a time, so it does not take the address space of the game.
+    // This is for when ffmpeg is slower than the game for a while. If it is slower for the whole movie, the file will fill up too.
+    // The file is not used when encoding in parts, as that already has its own buffering.
+
+    HANDLE spill_file;
+    HANDLE spill_mapping;
+    char spill_path[MAX_PATH];
+
+    // Views must start at the allocation granularity, so the slots are a bit larger than a frame.
+    s32 spill_slot_size;
+    s32 spill_num_slots;
+
+    // Slots are taken in turn by the thread that submits the frames and given back in the same order by the ffmpeg thread.
+    s32 spill_next_slot;
+
+    // Signalled when a spilled frame has been written and its slot can be used again.
+    SvrSemaphore spill_sem;
+
+    // Only used by the thread that submits the frames, for the report.
+    s64 spill_frames;
+    s32 spill_peak_slots;
+
+    // -------------------------------------------------
+    // Compressed queue state.
+
+    // With a compressed queue, frames are compressed when they are submitted and put in a pool of memory, and the ffmpeg thread
+    // decompresses them just before they are written. This uses the codec of intermediate captures (the difference to the frame before,
+    // compressed with LZ4), which is a lot faster than the encoder. Many more frames fit in the memory of the send buffers this way,
+    // which matters as the game is a 32-bit process. How many more depends on how much of the picture changes between frames.
+    // There is only one frame to fill then, and the game waits for room in the pool instead of waiting for a send buffer.
+    // Not used when encoding in parts or with a capture (which is already compressed).
+
+    u8* compress_pool;
+    s32 compress_block_size;
+    s32 compress_num_blocks;
+
+    // Only used by the thread that submits the frames. Block where the next frame goes.
+    s32 compress_next_block;
+
+    // Free blocks. They are given back by the ffmpeg thread in the same order as they were taken.
+    SvrSemaphore compress_block_sem;
+
+    // Only used by the thread that submits the frames. The previous frame is kept for the difference, and the two are swapped after every frame
+    // so that the difference can be made in place of the previous frame.
+    u8* compress_frame;
+    u8* compress_prev_frame;
+    u8* compress_dest;
+    bool compress_has_prev;
+
+    // Only used by the ffmpeg thread. The previous frame is decompressed on top of.
+    u8* decompress_frame;
+    u8* decompress_scratch;
+
+    // For the report. Times are in microseconds.
+    s64 compress_frames;
+    s64 compress_bytes;
+    s64 compress_time;
+    s64 decompress_time;
+    s32 compress_peak_blocks;
+
+    // -------------------------------------------------
+    // Send buffer pool state.
+
+    // The send buffers can be given as a size in the profile instead of always being 8 frames. They are then in memory of the system
+    // (backed by the page file) which is only mapped into the game while a frame is filled or written, as the 32-bit address space of the
+    // game runs out long before the memory of the system does. The game maps a buffer when it is acquired and unmaps it when it is submitted,
+    // and the ffmpeg thread maps it again to write it. Writes from planes do not need the buffer to be mapped.
+    // Not used with a compressed queue.
+
+    // Set for the movie, the mapping is closed before the report.
+    bool use_pool;
+
+    HANDLE pool_mapping;
+
+    // Views must start at the allocation granularity, so the buffers are a bit larger than a frame.
+    s32 pool_slot_size;
+
+    // Views of the pool that are mapped right now, by any thread.
+    SvrAtom32 pool_mapped_views;
+    SvrAtom32 pool_peak_views;
+};
+
+// One for the movie that is being made, and the rest for movies that are finishing.
+const s32 MAX_FFMPEG_SESSIONS = MAX_FINALIZING_MOVIES + 1;
+
+FfmpegSession ffmpeg_sessions[MAX_FFMPEG_SESSIONS];
+
+// The session of the movie that is being made. Set by the game thread when the movie starts and ends,
+// and read by the thread that submits the frames in between.
+FfmpegSession* ffmpeg_session;
+
+// -------------------------------------------------
+
+PxConv calc_encoder_pxconv(MovieProfile* profile)
+{
+    // We don't allow the pixel format and color space to be selectable anymore, but we will keep the support in for now.
+
+    if (!strcmp(profile->sw_encoder, "libx264rgb"))
+    {
+        return PXCONV_BGR0;
+    }
+
+    return PXCONV_NV12_601;
+}
+
+void build_movie_path(const char* resource_path, const char* dest, char* buf, s32 buf_size)
+{
+    buf[0] = 0;
+    StringCchCatA(buf, buf_size, resource_path);
+    StringCchCatA(buf, buf_size, "\\movies\\");
+    CreateDirectoryA(buf, NULL);
+    StringCchCatA(buf, buf_size, dest);
+}
+
+// The queues cannot be freed, so they are made once for every session that gets used.
+void init_session(FfmpegSession* ses)
+{
+    if (ses->inited)
+    {
+        return;
+    }
+
+    for (s32 i = 0; i < MAX_ENCODER_SEGMENTS; i++)
+    {
+        FfmpegLane& lane = ses->lanes[i];
+
+        lane.session = ses;
+
+        // Room for the stop sentinel too. Spilled and compressed frames only go to the first lane.
+        lane.write_queue.init(MAX_POOLED_SEND_BUFS + 1 + (i == 0 ? MAX_QUEUED_FRAMES : 0));
+
+        // Any lane can end up with all of the buffers.
+        lane.read_queue.init(MAX_POOLED_SEND_BUFS);
+    }
+
+    ses->audio_buf = (SvrWaveSample*)_aligned_malloc(sizeof(SvrWaveSample) * AUDIO_BUFFERED_SAMPLES, 16);
+
+    ses->inited = true;
+}
+
+void ffmpeg_init()
+{
+    // The others are made when there is a movie finishing while the next one starts.
+    init_session(&ffmpeg_sessions[0]);
+
+    // For the encode workers. Connecting to them fails later if this does.
+    svr_net_init();
+}
+
+void ffmpeg_get_buf_stats(FfmpegBufStats* stats)
+{
+    FfmpegSession* ses = ffmpeg_session;
+
+    stats->num_bufs = ses->num_send_bufs;
+    stats->buf_size = ses->movie.frame_size;
+    stats->peak_used_bufs = ses->peak_send_bufs;
+    stats->peak_mapped_bufs = ses->use_pool ? svr_atom_read(&ses->pool_peak_views) : ses->num_send_bufs;
+}
+
+void show_hist(const char* name, SvrHist* hist)
+{
+    SvrHistStats stats;
+    svr_calc_hist_stats(hist, &stats);
+
+    if (stats.count == 0)
+    {
+        return;
+    }
+
+    char buf[256];
+    svr_format_hist_stats(&stats, buf, SVR_ARRAY_SIZE(buf));
+
+    game_log("%s: %s\n", name, buf);
+}
+
+// The lanes can still be running.
+void calc_session_latency(FfmpegSession* ses, FfmpegLatency* latency)
+{
+    svr_reset_hist(&latency->write);
+    svr_reset_hist(&latency->send_wait);
+
+    for (s32 i = 0; i < ses->num_lanes; i++)
+    {
+        svr_merge_hist(&latency->write, &ses->lanes[i].write_hist);
+    }
+
+    svr_merge_hist(&latency->send_wait, &ses->send_wait_hist);
+}
+
+void ffmpeg_get_latency(FfmpegLatency* latency)
+{
+    if (ffmpeg_session == NULL)
+    {
+        svr_reset_hist(&latency->write);
+        svr_reset_hist(&latency->send_wait);
+        return;
+    }
+
+    calc_session_latency(ffmpeg_session, latency);
+}
+
+// Frames waiting to be written, and free send buffers.
+void calc_queue_depths(FfmpegSession* ses, s32* write_depth, s32* read_depth)
+{
+    *write_depth = 0;
+    *read_depth = 0;
+
+    for (s32 i = 0; i < ses->num_lanes; i++)
+    {
+        *write_depth += ses->lanes[i].write_queue.read_buffer_health();
+        *read_depth += ses->lanes[i].read_queue.read_buffer_health();
+    }
+}
+
+// The frames are counted by the threads that submit and write them. In a 32-bit process the halves of a count can be read
+// between two writes, but the high half only changes after 4 billion frames.
+void ffmpeg_get_stats(FfmpegStats* stats)
+{
+    FfmpegSession* ses = ffmpeg_session;
+
+    *stats = {};
+
+    if (ses == NULL)
+    {
+        return;
+    }
+
+    stats->frames_submitted = ses->frames_submitted;
+    stats->audio_samples_written = ses->audio_samples_written;
+
+    calc_queue_depths(ses, &stats->write_queue_depth, &stats->read_queue_depth);
+
+    for (s32 i = 0; i < ses->num_lanes; i++)
+    {
+        stats->frames_written += ses->lanes[i].frames_written;
+    }
+}
+
+ProcReport* ffmpeg_get_report()
+{
+    FfmpegSession* ses = ffmpeg_session;
+
+    if (ses == NULL || !ses->profile.report_enabled)
+    {
+        return NULL;
+    }
+
+    return &ses->report;
+}
+
+// Only used by the thread that submits the frames, when a send buffer is acquired.
+void sample_report_queues(FfmpegSession* ses)
+{
+    ProcReport* report = &ses->report;
+
+    s64 now = svr_prof_get_real_time();
+
+    if (now < ses->next_queue_sample_time)
+    {
+        return;
+    }
+
+    // Every other sample is kept, so the ones that are left are as far apart as the samples will be from now on.
+    if (report->num_queue_samples == MAX_REPORT_QUEUE_SAMPLES)
+    {
+        for (s32 i = 0; i < MAX_REPORT_QUEUE_SAMPLES / 2; i++)
+        {
+            report->queue_samples[i] = report->queue_samples[i * 2];
+        }
+
+        report->num_queue_samples = MAX_REPORT_QUEUE_SAMPLES / 2;
+        report->queue_sample_interval *= 2;
+    }
+
+    ProcQueueSample* sample = &report->queue_samples[report->num_queue_samples];
+    sample->time = now - ses->start_time;
+    calc_queue_depths(ses, &sample->write_depth, &sample->read_depth);
+
+    report->num_queue_samples++;
+
+    ses->next_queue_sample_time = now + report->queue_sample_interval;
+}
+
+// Shows how fast frames were written to ffmpeg, and how often the encoder had to be waited for.
+// This is shown when the movie has been finished, which can be after the next movie has started.
+void show_session_report(FfmpegSession* ses)
+{
+    FfmpegLatency latency;
+    calc_session_latency(ses, &latency);
+
+    show_hist("Writing a frame", &latency.write);
+    show_hist("Waiting for a send buffer", &latency.send_wait);
+
+    if (ses->write_prof.runs > 0)
+    {
+        game_log("Write: %lld\n", ses->write_prof.total / ses->write_prof.runs);
+    }
+
+    // Prof time is in microseconds.
+    if (ses->write_prof.total > 0)
+    {
+        game_log("Write rate: %0.2f GB/s\n", (double)ses->bytes_written / ((double)ses->write_prof.total * 1000.0));
+    }
+
+    if (ses->use_workers && ses->write_prof.total > 0)
+    {
+        double sent_mb = (double)ses->bytes_written / (1024.0 * 1024.0);
+        double received_mb = (double)ses->bytes_received / (1024.0 * 1024.0);
+        double send_rate = sent_mb / ((double)ses->write_prof.total / 1000000.0);
+
+        game_log("Sent %0.1f MB to %d encoder workers at %0.1f MB/s, and received %0.1f MB of encoded parts\n", sent_mb, ses->num_lanes, send_rate, received_mb);
+        game_log("Waited for room on the encoder workers %lld times (%0.2f ms)\n", ses->credit_waits, (double)ses->credit_wait_time / 1000.0);
+    }
+
+
+    if (ses->use_pool)
+    {
+        s32 peak_views = svr_atom_read(&ses->pool_peak_views);
+        double peak_mb = ((double)peak_views * ses->pool_slot_size) / (1024.0 * 1024.0);
+
+        game_log("At most %d of %d send buffers were in use and %d were mapped (%0.1f MB)\n", ses->peak_send_bufs, ses->num_send_bufs, peak_views, peak_mb);
+    }
+
+    if (ses->first_read_time != 0)
+    {
+        double start_ms = (double)ses->start_duration / 1000.0;
+        double first_read_ms = (double)(ses->first_read_time - ses->start_time) / 1000.0;
+
+        game_log("Starting %sffmpeg took %0.2f ms, and it had read the first frame after %0.2f ms\n", ses->started_warm ? "warm " : "", start_ms, first_read_ms);
+    }
+
+    if (ses->num_stalls > 0)
+    {
+        game_log("Waited for ffmpeg %lld times\n", ses->num_stalls);
+    }
+
+    if (ses->spill_frames > 0)
+    {
+        s64 spill_mb = (ses->spill_frames * ses->movie.frame_size) / (1024 * 1024);
+        game_log("Spilled %lld frames (%lld MB) to disk, at most %d at once\n", ses->spill_frames, spill_mb, ses->spill_peak_slots);
+    }
+
+    if (ses->compress_frames > 0)
+    {
+        double ratio = (double)(ses->compress_frames * ses->movie.frame_size) / (double)ses->compress_bytes;
+        double peak_mb = ((double)ses->compress_peak_blocks * ses->compress_block_size) / (1024.0 * 1024.0);
+
+        game_log("Compressed the queue by %0.2fx, at most %0.1f MB of it was used\n", ratio, peak_mb);
+        game_log("Compression took %lld us and decompression took %lld us per frame\n", ses->compress_time / ses->compress_frames, ses->decompress_time / ses->compress_frames);
+    }
+}
+
+// -------------------------------------------------
+
+// Puts the planes in the send buffer.
+void copy_pipe_planes(ThreadPipeData* pipe_data)
+{
+    u8* dest_ptr = pipe_data->ptr;
+
+    for (s32 i = 0; i < pipe_data->num_planes; i++)
+    {
+        PipePlane& plane = pipe_data->planes[i];
+
+        u8* source_ptr = plane.ptr;
+
+        for (s32 j = 0; j < plane.rows; j++)
+        {
+            memcpy(dest_ptr, source_ptr, plane.row_size);
+
+            source_ptr += plane.pitch;
+            dest_ptr += plane.row_size;
+        }
+    }
+}
+
+// Pipes cannot gather, so padded rows are put together in the stage and written in larger pieces.
+// Without a stage (or with rows that are larger than it) they are written one by one.
+void write_pipe_planes(HANDLE pipe, ThreadPipeData* pipe_data, u8* stage)
+{
+    for (s32 i = 0; i < pipe_data->num_planes; i++)
+    {
+        PipePlane& plane = pipe_data->planes[i];
+
+        if (plane.pitch == plane.row_size)
+        {
+            WriteFile(pipe, plane.ptr, plane.row_size * plane.rows, NULL, NULL);
+            continue;
+        }
+
+        u8* ptr = plane.ptr;
+
+        if (stage == NULL || plane.row_size > PIPE_WRITE_STAGE_SIZE)
+        {
+            for (s32 j = 0; j < plane.rows; j++)
+            {
+                WriteFile(pipe, ptr, plane.row_size, NULL, NULL);
+                ptr += plane.pitch;
+            }
+
+            continue;
+        }
+
+        s32 stage_rows = PIPE_WRITE_STAGE_SIZE / plane.row_size;
+
+        for (s32 j = 0; j < plane.rows; j += stage_rows)
+        {
+            s32 num_rows = plane.rows - j;
+
+            if (num_rows > stage_rows)
+            {
+                num_rows = stage_rows;
+            }
+
+            u8* dest_ptr = stage;
+
+            for (s32 k = 0; k < num_rows; k++)
+            {
+                memcpy(dest_ptr, ptr, plane.row_size);
+
+                ptr += plane.pitch;
+                dest_ptr += plane.row_size;
+            }
+
+            WriteFile(pipe, stage, num_rows * plane.row_size, NULL, NULL);
+        }
+    }
+}
+
+bool start_ffmpeg_proc(FfmpegLane* lane, s32 segment);
+void end_ffmpeg_proc(FfmpegLane* lane);
+void switch_ffmpeg_output(FfmpegLane* lane, s32 output);
+void end_retired_procs(FfmpegSession* ses, s32 max_left);
+void move_warm_output(FfmpegOutput* output);
+bool start_worker_part(FfmpegLane* lane, s32 segment);
+void end_worker_part(FfmpegLane* lane);
+void write_worker_frame(FfmpegLane* lane, ThreadPipeData* pipe_data);
+void close_worker_lane(FfmpegLane* lane);
+void write_capture_frame(FfmpegLane* lane, ThreadPipeData* pipe_data);
+u8* map_spill_slot(FfmpegSession* ses, s32 slot, DWORD access);
+void map_send_buf(FfmpegSession* ses, ThreadPipeData* pipe_data, DWORD access);
+void unmap_send_buf(FfmpegSession* ses, ThreadPipeData* pipe_data);
+void close_audio_pipe(FfmpegSession* ses);
+
+// Gives a frame to the ffmpeg process of a lane (or to the capture).
+void write_lane_frame(FfmpegLane* lane, ThreadPipeData* pipe_data)
+{
+    FfmpegSession* ses = lane->session;
+
+    if (ses->use_capture)
+    {
+        write_capture_frame(lane, pipe_data);
+    }
+
+    else if (pipe_data->segment != lane->segment && !ses->use_segments)
+    {
+        // First frame of the next file of the movie.
+        switch_ffmpeg_output(lane, pipe_data->segment);
+    }
+
+    else if (pipe_data->segment != lane->segment)
+    {
+        // First frame of the next part of this lane. The process of the previous part has to finish first,
+        // so there are never more processes than lanes.
+        s64 switch_start = svr_prof_get_real_time();
+
+        end_ffmpeg_proc(lane);
+
+        if (!start_ffmpeg_proc(lane, pipe_data->segment))
+        {
+            lane->failed = true;
+        }
+
+        lane->part_switch_time += svr_prof_get_real_time() - switch_start;
+    }
+
+    if (ses->use_workers)
+    {
+        write_worker_frame(lane, pipe_data);
+        return;
+    }
+
+    // This will not return until the data has been read by the remote process.
+    // Writing with pipes is very inconsistent and can wary with several milliseconds.
+    // It has been tested to use overlapped I/O with completion routines but that was also too inconsistent and way too complicated.
+    // For SW encoding this will take about 300 - 6000 us (always sending the same size).
+
+    // There is some issue with writing with pipes that if it starts off slower than it should be, then it will forever be slow until the computer restarts.
+    // Therefore it is useful to measure this.
+
+    // Raw video has no way of saying that a frame is repeated, so the same data is written again.
+
+    for (s32 i = 0; i < pipe_data->num_frames && lane->write_pipe; i++)
+    {
+        svr_start_prof(&lane->write_prof);
+        svr_start_hist(&lane->write_hist);
+        svr_trace_begin("Pipe write");
+
+        if (pipe_data->num_planes == 0)
+        {
+            WriteFile(lane->write_pipe, pipe_data->ptr, pipe_data->size, NULL, NULL);
+        }
+
+        else
+        {
+            write_pipe_planes(lane->write_pipe, pipe_data, lane->write_stage);
+        }
+
+        svr_trace_end("Pipe write");
+        svr_end_hist(&lane->write_hist);
+        svr_end_prof(&lane->write_prof);
+
+        lane->bytes_written += pipe_data->size;
+        lane->frames_written++;
+
+        // The pipe holds one frame, so ffmpeg has started to read when the second one has been written.
+        if (lane->frames_written == 2 && !ses->use_segments)
+        {
+            ses->first_read_time = svr_prof_get_real_time();
+        }
+    }
+}
+
+// This thread will write data to the ffmpeg process of a lane.
+// Writing to the pipe is real slow and we want to buffer up a few to send which it can work on.
+DWORD WINAPI ffmpeg_thread_proc(LPVOID lpParameter)
+{
+    FfmpegLane* lane = (FfmpegLane*)lpParameter;
+    FfmpegSession* ses = lane->session;
+
+    svr_trace_name_thread("ffmpeg lane", (s32)(lane - ses->lanes));
+
+    lane->write_stage = NULL;
+
+    if (ses->movie.planes_only)
+    {
+        lane->write_stage = (u8*)malloc(PIPE_WRITE_STAGE_SIZE);
+    }
+
+    while (true)
+    {
+        svr_sem_wait(&lane->write_sem);
+
+        ThreadPipeData pipe_data;
+        bool res1 = lane->write_queue.pull(&pipe_data);
+        assert(res1);
+
+        // The send buffers have no memory when only planes are written, but those frames always have planes.
+        if (pipe_data.ptr == NULL && pipe_data.num_planes == 0)
+        {
+            lane->write_end_time = svr_prof_get_real_time();
+            break;
+        }
+
+        if (pipe_data.compressed_size > 0)
+        {
+            s64 start_time = svr_prof_get_real_time();
+
+            bool res2 = svr_capture_decompress(pipe_data.ptr, pipe_data.compressed_size, pipe_data.compressed_keyframe, ses->movie.frame_size, ses->decompress_scratch, ses->decompress_frame);
+            assert(res2);
+
+            ses->decompress_time += svr_prof_get_real_time() - start_time;
+
+            // The blocks can be used again while the frame is being written.
+            for (s32 i = 0; i < pipe_data.compressed_blocks; i++)
+            {
+                svr_sem_release(&ses->compress_block_sem);
+            }
+
+            pipe_data.ptr = ses->decompress_frame;
+
+            write_lane_frame(lane, &pipe_data);
+            continue;
+        }
+
+        if (pipe_data.spill_slot != -1)
+        {
+            // The slot was unmapped when it was submitted, so it is mapped again to be read.
+            // Spilled frames are not send buffers and are not given back to the game thread.
+            pipe_data.ptr = map_spill_slot(ses, pipe_data.spill_slot, FILE_MAP_READ);
+
+            if (pipe_data.ptr)
+            {
+                write_lane_frame(lane, &pipe_data);
+                UnmapViewOfFile(pipe_data.ptr);
+            }
+
+            else
+            {
+                game_log("Could not map spilled frame (%lu)\n", GetLastError());
+            }
+
+            svr_sem_release(&ses->spill_sem);
+            continue;
+        }
+
+        // Buffers in the pool are only mapped while they are written.
+        bool map_buf = pipe_data.pool_slot != -1 && pipe_data.num_planes == 0;
+
+        if (map_buf)
+        {
+            map_send_buf(ses, &pipe_data, FILE_MAP_READ);
+        }
+
+        write_lane_frame(lane, &pipe_data);
+
+        if (map_buf)
+        {
+            unmap_send_buf(ses, &pipe_data);
+        }
+
+        if (pipe_data.written_fn)
+        {
+            pipe_data.written_fn(pipe_data.written_user);
+        }
+
+        lane->read_queue.push(&pipe_data);
+
+        svr_sem_release(&ses->read_sem);
+    }
+
+    // Close the process of the last part.
+    end_ffmpeg_proc(lane);
+
+    // And the ones of the files before when the movie was continued in new files.
+    end_retired_procs(ses, 0);
+
+    if (lane->write_stage)
+    {
+        free(lane->write_stage);
+        lane->write_stage = NULL;
+    }
+
+    return 0;
+}
+
+// Parameters regarding the input (the stuff we are sending).
+// These are also kept in intermediate captures, so they must not depend on how the frames are sent.
+void build_ffmpeg_input_args(FfmpegSession* ses, char* full_args, s32 full_args_size)
+{
+    const s32 ARGS_BUF_SIZE = 128;
+
+    char buf[ARGS_BUF_SIZE];
+
+    MovieProfile* profile = ses->movie.profile;
+
+    PxConvText& pxconv_text = PXCONV_FFMPEG_TEXT_TABLE[ses->movie.pxconv];
+
+    // We are sending uncompressed frames.
+    StringCchCatA(full_args, full_args_size, " -f rawvideo -vcodec rawvideo");
+
+    // Pixel format that goes through the pipe.
+    StringCchPrintfA(buf, ARGS_BUF_SIZE, " -pix_fmt %s", pxconv_text.format);
+    StringCchCatA(full_args, full_args_size, buf);
+
+    // Video size.
+    StringCchPrintfA(buf, ARGS_BUF_SIZE, " -s %dx%d", ses->movie.width, ses->movie.height);
+    StringCchCatA(full_args, full_args_size, buf);
+
+    // Input frame rate.
+    StringCchPrintfA(buf, ARGS_BUF_SIZE, " -r %d", profile->movie_fps);
+    StringCchCatA(full_args, full_args_size, buf);
+}
+
+// Parameters regarding the video output from the profile.
+// These are also kept in intermediate captures.
+void build_ffmpeg_output_args(FfmpegSession* ses, char* full_args, s32 full_args_size)
+{
+    const s32 ARGS_BUF_SIZE = 128;
+
+    char buf[ARGS_BUF_SIZE];
+
+    MovieProfile* profile = ses->movie.profile;
+
+    PxConvText& pxconv_text = PXCONV_FFMPEG_TEXT_TABLE[ses->movie.pxconv];
+
+    // Output video codec.
+    StringCchPrintfA(buf, ARGS_BUF_SIZE, " -vcodec %s", profile->sw_encoder);
+    StringCchCatA(full_args, full_args_size, buf);
+
+    if (pxconv_text.color_space)
+    {
+        // Output video color space (only for YUV).
+        StringCchPrintfA(buf, ARGS_BUF_SIZE, " -colorspace %s", pxconv_text.color_space);
+        StringCchCatA(full_args, full_args_size, buf);
+    }
+
+    // Output video framerate.
+    StringCchPrintfA(buf, ARGS_BUF_SIZE, " -framerate %d", profile->movie_fps);
+    StringCchCatA(full_args, full_args_size, buf);
+
+    // Output quality factor.
+    StringCchPrintfA(buf, ARGS_BUF_SIZE, " -crf %d", profile->sw_crf);
+    StringCchCatA(full_args, full_args_size, buf);
+
+    // Output x264 preset.
+    StringCchPrintfA(buf, ARGS_BUF_SIZE, " -preset %s", profile->sw_x264_preset);
+    StringCchCatA(full_args, full_args_size, buf);
+
+    if (profile->sw_x264_intra)
+    {
+        StringCchCatA(full_args, full_args_size, " -x264-params keyint=1");
+    }
+}
+
+// The video is written to the given path. The audio is read from the named pipe if there is one.
+// Encode workers make the same arguments themselves (see build_worker_args in encoder_main.cpp), so changes here go there too.
+void build_ffmpeg_process_args(FfmpegSession* ses, char* full_args, s32 full_args_size, const char* dest_path, const char* audio_pipe_name)
+{
+    const s32 ARGS_BUF_SIZE = 128;
+
+    char buf[ARGS_BUF_SIZE];
+
+    MovieProfile* profile = ses->movie.profile;
+
+    StringCchCatA(full_args, full_args_size, "-hide_banner");
+
+    #if 1
+    StringCchCatA(full_args, full_args_size, " -loglevel quiet");
+    #else
+    StringCchCatA(full_args, full_args_size, " -loglevel debug");
+    #endif
+
+    build_ffmpeg_input_args(ses, full_args, full_args_size);
+
+    if (ses->use_segments)
+    {
+        // ffmpeg reads every input on its own thread ahead of the encoder, up to this many frames.
+        // When this holds a whole part, the part is handed over as fast as the pipe goes and the lane can move on while the
+        // encoder is still working on it. This is what lets the processes encode at the same time instead of waiting for each other.
+        // The frames are kept in the memory of the ffmpeg process and not in ours.
+        StringCchPrintfA(buf, ARGS_BUF_SIZE, " -thread_queue_size %d", ses->segment_frames);
+        StringCchCatA(full_args, full_args_size, buf);
+    }
+
+    // Overwrite existing, and read from stdin.
+    StringCchCatA(full_args, full_args_size, " -y -i -");
+
+    if (audio_pipe_name)
+    {
+        // Audio is the second input (see create_audio).
+        StringCchCatA(full_args, full_args_size, " -f s16le -ar 44100 -ac 2");
+
+        // There is a thread for every input that reads ahead this many packets. Both inputs are fed at the same time, so
+        // this has to be enough that the audio can keep up while the video is encoded.
+        StringCchCatA(full_args, full_args_size, " -thread_queue_size 1024");
+
+        StringCchPrintfA(buf, ARGS_BUF_SIZE, " -i \"%s\"", audio_pipe_name);
+        StringCchCatA(full_args, full_args_size, buf);
+    }
+
+    // Parameters below here is regarding the output (the stuff that will be written to the file).
+
+    // Number of encoding threads, or 0 for auto.
+    // We used to allow this to be configured, its intended purpose was for game multiprocessing (opening multiple games) but
+    // there are too many problems in the Source engine that we cannot control. It leads to many buggy and weird scenarios (like animations not playing or demos jumping).
+    // When encoding in parts, the processes share the threads that a single one would have used.
+    StringCchPrintfA(buf, ARGS_BUF_SIZE, " -threads %d", ses->threads_per_proc);
+    StringCchCatA(full_args, full_args_size, buf);
+
+    build_ffmpeg_output_args(ses, full_args, full_args_size);
+
+    if (audio_pipe_name)
+    {
+        // Output audio codec.
+        StringCchPrintfA(buf, ARGS_BUF_SIZE, " -acodec aac -b:a %dk", profile->audio_bitrate);
+        StringCchCatA(full_args, full_args_size, buf);
+    }
+
+    // The path can be specified as relative here because we set the working directory of the ffmpeg process
+    // to the SVR directory.
+
+    StringCchCatA(full_args, full_args_size, " \"");
+    StringCchCatA(full_args, full_args_size, dest_path);
+    StringCchCatA(full_args, full_args_size, "\"");
+}
+
+void build_segment_path(FfmpegSession* ses, s32 segment, char* buf, s32 buf_size)
+{
+    svr_build_part_path(ses->movie_path, segment, buf, buf_size);
+}
+
+// We start a separate process for two reasons:
+// 1) Source is a 32-bit engine, and it was common to run out of memory in games such as CSGO that uses a lot of memory.
+// 2) The ffmpeg API is horrible to work with with an incredible amount of pitfalls that will grant you a media that is slighly incorrect
+//    and there is no reliable documentation.
+// Data is sent to this process through a pipe that we create.
+// For SW encoding we send uncompressed frames which are then encoded and muxed in the ffmpeg process.
+// A lane starts one of these for every part it encodes, or just one for the whole movie when there are no parts.
+bool launch_ffmpeg_proc(FfmpegSession* ses, char* full_args, HANDLE* proc, HANDLE* write_pipe)
+{
+    bool ret = false;
+
+    STARTUPINFOA start_info = {};
+    DWORD create_flags = 0;
+
+    HANDLE read_h = NULL;
+    HANDLE write_h = NULL;
+
+    SECURITY_ATTRIBUTES sa;
+    PROCESS_INFORMATION proc_info;
+
+    char full_ffmpeg_path[MAX_PATH];
+
+    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
+    sa.lpSecurityDescriptor = NULL;
+    sa.bInheritHandle = TRUE;
+
+    if (!CreatePipe(&read_h, &write_h, &sa, (DWORD)svr_min(ses->movie.frame_size, MAX_PIPE_BUFFER_SIZE)))
+    {
+        svr_log("ERROR: Could not create ffmpeg process pipes (%lu)\n", GetLastError());
+        goto rfail;
+    }
+
+    // Since we start the ffmpeg process with inherited handles, it would try to inherit the writing endpoint of this pipe too.
+    // We have to remove the inheritance of this pipe. Otherwise it's never able to exit.
+    SetHandleInformation(write_h, HANDLE_FLAG_INHERIT, 0);
+
+    #if 1
+    create_flags |= CREATE_NO_WINDOW;
+    #endif
+
+    // Working directory for the FFmpeg process should be in the SVR directory.
+
+    full_ffmpeg_path[0] = 0;
+    StringCchCatA(full_ffmpeg_path, MAX_PATH, ses->resource_path);
+    StringCchCatA(full_ffmpeg_path, MAX_PATH, "\\ffmpeg.exe");
+
+    start_info.cb = sizeof(STARTUPINFOA);
+    start_info.hStdInput = read_h;
+    start_info.dwFlags |= STARTF_USESTDHANDLES;
+
+    if (!CreateProcessA(full_ffmpeg_path, full_args, NULL, NULL, TRUE, create_flags, NULL, ses->resource_path, &start_info, &proc_info))
+    {
+        svr_log("ERROR: Could not create ffmpeg process (%lu)\n", GetLastError());
+        goto rfail;
+    }
+
+    *proc = proc_info.hProcess;
+    CloseHandle(proc_info.hThread);
+
+    *write_pipe = write_h;
+
+    ret = true;
+    goto rexit;
+
+rfail:
+    if (write_h) CloseHandle(write_h);
+
+rexit:
+    if (read_h) CloseHandle(read_h);
+
+    return ret;
+}
+
+bool create_ffmpeg_proc(FfmpegSession* ses, const char* dest_path, const char* audio_pipe_name, HANDLE* proc, HANDLE* write_pipe)
+{
+    char full_args[FFMPEG_ARGS_SIZE];
+    full_args[0] = 0;
+
+    build_ffmpeg_process_args(ses, full_args, FFMPEG_ARGS_SIZE, dest_path, audio_pipe_name);
+
+    return launch_ffmpeg_proc(ses, full_args, proc, write_pipe);
+}
+
+bool start_ffmpeg_proc(FfmpegLane* lane, s32 segment)
+{
+    FfmpegSession* ses = lane->session;
+
+    char dest_path[MAX_PATH];
+
+    if (ses->use_workers)
+    {
+        return start_worker_part(lane, segment);
+    }
+
+    if (ses->use_segments)
+    {
+        build_segment_path(ses, segment, dest_path, MAX_PATH);
+    }
+
+    else
+    {
+        StringCchCopyA(dest_path, MAX_PATH, ses->movie_path);
+    }
+
+    if (!create_ffmpeg_proc(ses, dest_path, ses->audio_pipe ? ses->audio_pipe_name : NULL, &lane->proc, &lane->write_pipe))
+    {
+        return false;
+    }
+
+    lane->segment = segment;
+
+    return true;
+}
+
+// Kernel and user time that a process has used, in microseconds.
+s64 get_proc_cpu_time(HANDLE proc)
+{
+    FILETIME create_time;
+    FILETIME exit_time;
+    FILETIME kernel_time;
+    FILETIME user_time;
+
+    if (!GetProcessTimes(proc, &create_time, &exit_time, &kernel_time, &user_time))
+    {
+        return 0;
+    }
+
+    // In 100 ns units.
+    s64 kernel = ((s64)kernel_time.dwHighDateTime << 32) | kernel_time.dwLowDateTime;
+    s64 user = ((s64)user_time.dwHighDateTime << 32) | user_time.dwLowDateTime;
+
+    return (kernel + user) / 10;
+}
+
+void end_ffmpeg_proc(FfmpegLane* lane)
+{
+    FfmpegSession* ses = lane->session;
+
+    if (ses->use_workers)
+    {
+        end_worker_part(lane);
+        return;
+    }
+
+    if (lane->proc == NULL)
+    {
+        return;
+    }
+
+    // Close our end of the pipe.
+    // This will mark the completion of the stream, and the process will finish its work.
+    CloseHandle(lane->write_pipe);
+    lane->write_pipe = NULL;
+
+    WaitForSingleObject(lane->proc, INFINITE);
+
+    DWORD exit_code = 0;
+    GetExitCodeProcess(lane->proc, &exit_code);
+
+    // Parts that are not complete cannot be joined.
+    if (ses->use_segments && exit_code != 0)
+    {
+        game_log("ffmpeg exited with code %lu for part %d\n", exit_code, lane->segment + 1);
+        lane->failed = true;
+    }
+
+    lane->encoder_cpu_time += get_proc_cpu_time(lane->proc);
+
+    CloseHandle(lane->proc);
+    lane->proc = NULL;
+
+    if (!ses->use_segments)
+    {
+        move_warm_output(&ses->lane_output);
+    }
+}
+
+// Waits for the processes of the files before until at most this many are left. The ones that have exited are closed either way.
+void end_retired_procs(FfmpegSession* ses, s32 max_left)
+{
+    s32 num_kept = 0;
+
+    for (s32 i = 0; i < ses->num_retired_procs; i++)
+    {
+        FfmpegOutput* retired = &ses->retired_procs[i];
+
+        // The oldest ones are waited for if too many would be left.
+        bool must_end = num_kept + (ses->num_retired_procs - i) > max_left;
+
+        if (WaitForSingleObject(retired->proc, must_end ? INFINITE : 0) != WAIT_OBJECT_0)
+        {
+            ses->retired_procs[num_kept] = *retired;
+            ses->retired_outputs[num_kept] = ses->retired_outputs[i];
+            num_kept++;
+            continue;
+        }
+
+        DWORD exit_code = 0;
+        GetExitCodeProcess(retired->proc, &exit_code);
+
+        if (exit_code != 0)
+        {
+            game_log("ffmpeg exited with code %lu for file %d of the movie\n", exit_code, ses->retired_outputs[i] + 1);
+        }
+
+        // Only the lane closes these when there is one.
+        ses->encoder_cpu_time += get_proc_cpu_time(retired->proc);
+
+        CloseHandle(retired->proc);
+        retired->proc = NULL;
+
+        move_warm_output(retired);
+    }
+
+    ses->num_retired_procs = num_kept;
+}
+
+// The process of the file before has all of its frames, so it is left to finish on its own while the lane goes on with the next file.
+void switch_ffmpeg_output(FfmpegLane* lane, s32 output)
+{
+    FfmpegSession* ses = lane->session;
+
+    // Every file has frames, so they are switched to one after the other.
+    assert(output == lane->segment + 1);
+
+    // This will mark the completion of the stream for the process of the file before.
+    CloseHandle(lane->write_pipe);
+    lane->write_pipe = NULL;
+
+    end_retired_procs(ses, MAX_RETIRED_PROCS - 1);
+
+    FfmpegOutput* retired = &ses->retired_procs[ses->num_retired_procs];
+    *retired = ses->lane_output;
+    retired->proc = lane->proc;
+
+    ses->retired_outputs[ses->num_retired_procs] = lane->segment;
+    ses->num_retired_procs++;
+
+    FfmpegOutput& next = ses->outputs[output % MAX_PENDING_OUTPUTS];
+
+    lane->proc = next.proc;
+    lane->write_pipe = next.write_pipe;
+    lane->segment = output;
+
+    ses->lane_output = next;
+    ses->lane_output.proc = NULL;
+    ses->lane_output.write_pipe = NULL;
+
+    next.proc = NULL;
+    next.write_pipe = NULL;
+
+    // The place can be used for a later file.
+    svr_sem_release(&ses->output_sem);
+}
+
+// Files that were started but that no frames got to, as the movie ended first. Their processes would never get any video,
+// so they are stopped and what they made is removed.
+void end_unused_outputs(FfmpegSession* ses)
+{
+    for (s32 i = ses->segment + 1; i < ses->num_outputs; i++)
+    {
+        FfmpegOutput& output = ses->outputs[i % MAX_PENDING_OUTPUTS];
+
+        TerminateProcess(output.proc, 1);
+        WaitForSingleObject(output.proc, INFINITE);
+
+        // The audio pipe is for the newest file, so there is nothing left to read it.
+        // end_audio would otherwise wait for the closed process.
+        if (output.proc == ses->audio_reader)
+        {
+            if (ses->audio_pipe)
+            {
+                close_audio_pipe(ses);
+            }
+
+            ses->audio_reader = NULL;
+        }
+
+        CloseHandle(output.proc);
+        CloseHandle(output.write_pipe);
+
+        output.proc = NULL;
+        output.write_pipe = NULL;
+
+        DeleteFileA(output.warm_path[0] ? output.warm_path : output.path);
+
+        game_log("No frames were given to %s\n", output.path);
+    }
+}
+
+void end_ffmpeg_lanes(FfmpegSession* ses)
+{
+    // The write queues have room for the sentinel.
+    for (s32 i = 0; i < ses->num_lanes; i++)
+    {
+        FfmpegLane& lane = ses->lanes[i];
+
+        ThreadPipeData pipe_data = {};
+
+        lane.write_queue.push(&pipe_data);
+
+        svr_sem_release(&lane.write_sem);
+    }
+
+    s32 num_returned_bufs = 0;
+
+    for (s32 i = 0; i < ses->num_lanes; i++)
+    {
+        FfmpegLane& lane = ses->lanes[i];
+
+        // The thread ends the process of its last part before it exits.
+        WaitForSingleObject(lane.thread, INFINITE);
+
+        CloseHandle(lane.thread);
+        lane.thread = NULL;
+
+        if (ses->use_workers)
+        {
+            close_worker_lane(&lane);
+        }
+
+        // Both queues should not be updated anymore at this point so they should be the same when observed.
+        // Since we exit with a sentinel value, the semaphores will be out of sync from the queues but they are reinit on movie start.
+        assert(lane.write_queue.read_buffer_health() == 0);
+        num_returned_bufs += lane.read_queue.read_buffer_health();
+
+        ses->write_prof.runs += lane.write_prof.runs;
+        ses->write_prof.total += lane.write_prof.total;
+        ses->bytes_written += lane.bytes_written;
+
+        ses->credit_waits += lane.credit_waits;
+        ses->credit_wait_time += lane.credit_wait_time;
+        ses->bytes_received += lane.bytes_received;
+
+        ses->encoder_cpu_time += lane.encoder_cpu_time;
+
+        if (lane.write_end_time > ses->output_end_time)
+        {
+            ses->output_end_time = lane.write_end_time;
+        }
+    }
+
+    assert(num_returned_bufs == ses->num_send_bufs);
+}
+
+// -------------------------------------------------
+
+// Only used by the game thread.
+FfmpegWarmProc ffmpeg_warm_procs[MAX_WARM_ENCODERS];
+s32 ffmpeg_num_warm_procs;
+
+// For the names of the files and audio pipes of the warm processes.
+s32 ffmpeg_warm_counter;
+
+const char* find_path_extension(const char* path)
+{
+    const char* ext = strrchr(path, '.');
+    const char* dir_end = strrchr(path, '\\');
+
+    if (ext == NULL || (dir_end && dir_end > ext))
+    {
+        ext = path + strlen(path);
+    }
+
+    return ext;
+}
+
+// The process has not been given video, so it has not made its file.
+void end_warm_proc(FfmpegWarmProc* warm)
+{
+    TerminateProcess(warm->proc, 1);
+    WaitForSingleObject(warm->proc, INFINITE);
+
+    CloseHandle(warm->proc);
+    CloseHandle(warm->write_pipe);
+
+    warm->proc = NULL;
+    warm->write_pipe = NULL;
+}
+
+// Starts processes with the arguments of this movie until there are as many as the profile wants.
+// Files that are named like the given one can use them.
+void warm_ffmpeg_procs(FfmpegSession* ses, const char* like_path)
+{
+    if (ses->use_segments || ses->use_capture)
+    {
+        return;
+    }
+
+    while (ffmpeg_num_warm_procs < ses->movie.profile->encoder_prewarm)
+    {
+        FfmpegWarmProc* warm = &ffmpeg_warm_procs[ffmpeg_num_warm_procs];
+
+        // ffmpeg picks the container by the extension.
+        char name[MAX_PATH];
+        StringCchPrintfA(name, MAX_PATH, "svr_warm_%lu_%d%s", GetCurrentProcessId(), ffmpeg_warm_counter, find_path_extension(like_path));
+
+        build_movie_path(ses->resource_path, name, warm->path, MAX_PATH);
+
+        // The pipe is made when the process is taken, which is before it is given video.
+        StringCchPrintfA(warm->audio_pipe_name, MAX_PATH, "\\\\.\\pipe\\svr_audio_warm_%lu_%d", GetCurrentProcessId(), ffmpeg_warm_counter);
+
+        ffmpeg_warm_counter++;
+
+        warm->args[0] = 0;
+        build_ffmpeg_process_args(ses, warm->args, FFMPEG_ARGS_SIZE, warm->path, ses->movie.profile->audio_enabled ? warm->audio_pipe_name : NULL);
+
+        // The command line given to CreateProcess can be changed by it.
+        char full_args[FFMPEG_ARGS_SIZE];
+        StringCchCopyA(full_args, FFMPEG_ARGS_SIZE, warm->args);
+
+        if (!launch_ffmpeg_proc(ses, full_args, &warm->proc, &warm->write_pipe))
+        {
+            break;
+        }
+
+        ffmpeg_num_warm_procs++;
+    }
+}
+
+// Takes a warm process if it was started with the arguments that the file would be started with.
+// The ones that were not are ended, as they were started for a movie that is made differently.
+bool take_warm_proc(FfmpegSession* ses, const char* dest_path, bool with_audio, FfmpegWarmProc* dest)
+{
+    bool found = false;
+    s32 num_kept = 0;
+
+    for (s32 i = 0; i < ffmpeg_num_warm_procs; i++)
+    {
+        FfmpegWarmProc* warm = &ffmpeg_warm_procs[i];
+
+        char full_args[FFMPEG_ARGS_SIZE];
+        full_args[0] = 0;
+
+        build_ffmpeg_process_args(ses, full_args, FFMPEG_ARGS_SIZE, warm->path, with_audio ? warm->audio_pipe_name : NULL);
+
+        bool same = !strcmp(full_args, warm->args) && !_stricmp(find_path_extension(warm->path), find_path_extension(dest_path));
+
+        // It could have exited while it was waiting.
+        bool running = WaitForSingleObject(warm->proc, 0) == WAIT_TIMEOUT;
+
+        if (!same || !running)
+        {
+            end_warm_proc(warm);
+        }
+
+        else if (!found)
+        {
+            *dest = *warm;
+            found = true;
+        }
+
+        else
+        {
+            ffmpeg_warm_procs[num_kept] = *warm;
+            num_kept++;
+        }
+    }
+
+    ffmpeg_num_warm_procs = num_kept;
+
+    return found;
+}
+
+// A file that was written by a warm process is given its name when the process has finished.
+void move_warm_output(FfmpegOutput* output)
+{
+    if (output->warm_path[0] == 0)
+    {
+        return;
+    }
+
+    if (!MoveFileExA(output->warm_path, output->path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED))
+    {
+        game_log("Could not move %s to %s (%lu)\n", output->warm_path, output->path, GetLastError());
+    }
+
+    output->warm_path[0] = 0;
+}
+
+// -------------------------------------------------
+
+// With encode workers, the frames of a part are sent to the worker of the lane instead of being written to a process here.
+// The worker has room for a few frames at a time and says when it has more (see svr_net.h), so the lane waits for the worker
+// in the same place where it would wait for a pipe. When the part has ended, the lane receives the encoded part from the worker
+// and writes it where a process here would have, so the parts are joined like they always are.
+// A lane that loses its worker fails like a process that could not be started, and the parts are then kept.
+
+// The addresses are separated by spaces. Every address is a lane, so the same worker can be given more than once to have it
+// encode that many parts at once.
+s32 parse_worker_addresses(FfmpegSession* ses)
+{
+    const char* it = ses->movie.profile->encoder_workers;
+    s32 num_workers = 0;
+
+    while (true)
+    {
+        while (*it == ' ' || *it == ',')
+        {
+            it++;
+        }
+
+        const char* start = it;
+
+        while (*it && *it != ' ' && *it != ',')
+        {
+            it++;
+        }
+
+        if (it == start)
+        {
+            break;
+        }
+
+        if (num_workers == MAX_ENCODER_SEGMENTS)
+        {
+            game_log("Only %d encoder workers can be used at once\n", MAX_ENCODER_SEGMENTS);
+            break;
+        }
+
+        StringCchCopyNA(ses->lanes[num_workers].worker_address, MAX_PATH, start, it - start);
+        num_workers++;
+    }
+
+    return num_workers;
+}
+
+void close_worker_lane(FfmpegLane* lane)
+{
+    svr_net_close(&lane->conn);
+
+    if (lane->recv_buf)
+    {
+        free(lane->recv_buf);
+        lane->recv_buf = NULL;
+    }
+}
+
+// The worker says how many frames it has room for when it has checked the secret.
+bool connect_worker_lane(FfmpegLane* lane)
+{
+    FfmpegSession* ses = lane->session;
+
+    SvrNetHeader header;
+
+    if (!svr_net_connect(&lane->conn, lane->worker_address))
+    {
+        game_log("Could not connect to encoder worker %s\n", lane->worker_address);
+        return false;
+    }
+
+    // A worker that stops answering would otherwise hold up the lane, and with it the end of the movie, forever.
+    svr_net_set_timeout(&lane->conn, SVR_NET_TIMEOUT);
+
+    if (!svr_net_hello(&lane->conn, ses->movie.profile->encoder_workers_secret))
+    {
+        game_log("Encoder worker %s did not answer, or is of another version\n", lane->worker_address);
+        svr_net_close(&lane->conn);
+        return false;
+    }
+
+    lane->recv_buf = (u8*)malloc(SVR_NET_CHUNK_SIZE);
+
+    // The worker closes the connection if the secret is not the same.
+    if (!svr_net_recv(&lane->conn, &header, lane->recv_buf, SVR_NET_CHUNK_SIZE) || header.type != SVR_NET_CREDIT)
+    {
+        game_log("Encoder worker %s did not take the secret\n", lane->worker_address);
+        close_worker_lane(lane);
+        return false;
+    }
+
+    lane->credits = header.value;
+
+    return true;
+}
+
+// The connection cannot be used anymore after this, as it is not known where in the messages it is.
+void lose_worker(FfmpegLane* lane)
+{
+    if (lane->conn.sock && lane->conn.timed_out)
+    {
+        game_log("Encoder worker %s has not answered in %d seconds\n", lane->worker_address, SVR_NET_TIMEOUT / 1000);
+    }
+
+    else if (lane->conn.sock)
+    {
+        game_log("Lost the connection to encoder worker %s\n", lane->worker_address);
+    }
+
+    svr_net_close(&lane->conn);
+
+    lane->in_part = false;
+    lane->failed = true;
+}
+
+// The worker makes the same arguments as build_ffmpeg_process_args from these. The audio is added when the parts are joined.
+bool start_worker_part(FfmpegLane* lane, s32 segment)
+{
+    FfmpegSession* ses = lane->session;
+
+    MovieProfile* profile = ses->movie.profile;
+    PxConvText& pxconv_text = PXCONV_FFMPEG_TEXT_TABLE[ses->movie.pxconv];
+
+    SvrNetPartStart start = {};
+    start.part = segment;
+    start.frame_size = ses->movie.frame_size;
+    StringCchCopyA(start.extension, SVR_NET_MAX_EXTENSION, find_path_extension(ses->movie_path));
+
+    StringCchCopyA(start.pix_fmt, SVR_NET_MAX_NAME, pxconv_text.format);
+    start.width = ses->movie.width;
+    start.height = ses->movie.height;
+    start.fps = profile->movie_fps;
+
+    StringCchCopyA(start.codec, SVR_NET_MAX_NAME, profile->sw_encoder);
+    StringCchCopyA(start.color_space, SVR_NET_MAX_NAME, pxconv_text.color_space ? pxconv_text.color_space : "");
+    StringCchCopyA(start.preset, SVR_NET_MAX_NAME, profile->sw_x264_preset);
+    start.crf = profile->sw_crf;
+    start.intra = profile->sw_x264_intra;
+
+    start.queue_frames = ses->segment_frames;
+
+    lane->segment = segment;
+
+    if (!svr_net_send(&lane->conn, SVR_NET_PART_START, 0, &start, sizeof(SvrNetPartStart)))
+    {
+        lose_worker(lane);
+        return false;
+    }
+
+    lane->in_part = true;
+
+    return true;
+}
+
+// Receives messages until the worker has room for a frame.
+bool wait_for_worker_credits(FfmpegLane* lane)
+{
+    s64 start_time = svr_prof_get_real_time();
+
+    lane->credit_waits++;
+
+    svr_trace_begin("Credit wait");
+
+    while (lane->credits == 0)
+    {
+        SvrNetHeader header;
+
+        if (!svr_net_recv(&lane->conn, &header, lane->recv_buf, SVR_NET_CHUNK_SIZE) || header.type != SVR_NET_CREDIT)
+        {
+            svr_trace_end("Credit wait");
+            return false;
+        }
+
+        lane->credits += header.value;
+    }
+
+    svr_trace_end("Credit wait");
+
+    lane->credit_wait_time += svr_prof_get_real_time() - start_time;
+
+    return true;
+}
+
+// A repeated frame is only sent once, and the worker gives it to ffmpeg again.
+void write_worker_frame(FfmpegLane* lane, ThreadPipeData* pipe_data)
+{
+    if (!lane->in_part)
+    {
+        return;
+    }
+
+    if (lane->credits == 0 && !wait_for_worker_credits(lane))
+    {
+        lose_worker(lane);
+        return;
+    }
+
+    svr_start_prof(&lane->write_prof);
+    svr_start_hist(&lane->write_hist);
+    svr_trace_begin("Worker send");
+
+    bool res = svr_net_send(&lane->conn, SVR_NET_FRAME, pipe_data->num_frames, pipe_data->ptr, pipe_data->size);
+
+    svr_trace_end("Worker send");
+    svr_end_hist(&lane->write_hist);
+    svr_end_prof(&lane->write_prof);
+
+    if (!res)
+    {
+        lose_worker(lane);
+        return;
+    }
+
+    lane->credits--;
+    lane->bytes_written += pipe_data->size;
+    lane->frames_written += pipe_data->num_frames;
+}
+
+// Waits for the worker to finish the part and writes it where a process here would have.
+void end_worker_part(FfmpegLane* lane)
+{
+    FfmpegSession* ses = lane->session;
+
+    HANDLE file = NULL;
+    char path[MAX_PATH];
+
+    if (!lane->in_part)
+    {
+        return;
+    }
+
+    lane->in_part = false;
+
+    if (!svr_net_send(&lane->conn, SVR_NET_PART_END, 0, NULL, 0))
+    {
+        lose_worker(lane);
+        return;
+    }
+
+    build_segment_path(ses, lane->segment, path, MAX_PATH);
+
+    file = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    // The part is still received so that the connection can be used for the next one.
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        game_log("Could not create part %s (%lu)\n", path, GetLastError());
+        file = NULL;
+        lane->failed = true;
+    }
+
+    while (true)
+    {
+        SvrNetHeader header;
+
+        if (!svr_net_recv(&lane->conn, &header, lane->recv_buf, SVR_NET_CHUNK_SIZE))
+        {
+            lose_worker(lane);
+            break;
+        }
+
+        if (header.type == SVR_NET_CREDIT)
+        {
+            lane->credits += header.value;
+        }
+
+        else if (header.type == SVR_NET_PART_DATA)
+        {
+            if (file)
+            {
+                WriteFile(file, lane->recv_buf, header.size, NULL, NULL);
+            }
+
+            lane->bytes_received += header.size;
+        }
+
+        else if (header.type == SVR_NET_PART_DONE)
+        {
+            // Parts that are not complete cannot be joined.
+            if (header.value != 0)
+            {
+                game_log("ffmpeg exited with code %d for part %d on encoder worker %s\n", header.value, lane->segment + 1, lane->worker_address);
+                lane->failed = true;
+            }
+
+            break;
+        }
+
+        else
+        {
+            lose_worker(lane);
+            break;
+        }
+    }
+
+    if (file)
+    {
+        CloseHandle(file);
+    }
+}
+
+// Connects the lanes to their workers. The first part is started after this like the first process would be.
+bool connect_worker_lanes(FfmpegSession* ses)
+{
+    for (s32 i = 0; i < ses->num_lanes; i++)
+    {
+        if (!connect_worker_lane(&ses->lanes[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// -------------------------------------------------
+
+// The path is set at the start of the movie, as the audio file is named after it.
+bool start_capture(FfmpegSession* ses)
+{
+    ses->capture_file = CreateFileA(ses->capture_path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (ses->capture_file == INVALID_HANDLE_VALUE)
+    {
+        ses->capture_file = NULL;
+        game_log("Could not create capture file %s (%lu)\n", ses->capture_path, GetLastError());
+        return false;
+    }
+
+    MovieProfile* profile = ses->movie.profile;
+
+    ses->capture_header = {};
+    ses->capture_header.magic = SVR_CAPTURE_MAGIC;
+    ses->capture_header.version = SVR_CAPTURE_VERSION;
+    ses->capture_header.width = ses->movie.width;
+    ses->capture_header.height = ses->movie.height;
+    ses->capture_header.fps = profile->movie_fps;
+    ses->capture_header.frame_size = ses->movie.frame_size;
+
+    // A chunk of a second can be found and decompressed quickly, and does not add many keyframes.
+    ses->capture_header.chunk_frames = profile->movie_fps;
+
+    ses->capture_header.audio_bitrate = profile->audio_enabled ? profile->audio_bitrate : 0;
+
+    build_ffmpeg_input_args(ses, ses->capture_header.input_args, SVR_CAPTURE_MAX_ARGS);
+    build_ffmpeg_output_args(ses, ses->capture_header.output_args, SVR_CAPTURE_MAX_ARGS);
+
+    // Written again with the index at the end.
+    DWORD written;
+    WriteFile(ses->capture_file, &ses->capture_header, sizeof(SvrCaptureHeader), &written, NULL);
+
+    ses->capture_offset = sizeof(SvrCaptureHeader);
+    ses->capture_chunk_pos = 0;
+
+    ses->capture_prev_frame = (u8*)malloc(ses->movie.frame_size);
+    ses->capture_scratch = (u8*)malloc(ses->movie.frame_size);
+    ses->capture_dest = (u8*)malloc(svr_capture_bound(ses->movie.frame_size));
+
+    ses->capture_index = NULL;
+    ses->capture_index_size = 0;
+    ses->capture_index_capacity = 0;
+
+    return true;
+}
+
+// Called on the ffmpeg thread instead of writing to ffmpeg.
+void write_capture_frame(FfmpegLane* lane, ThreadPipeData* pipe_data)
+{
+    FfmpegSession* ses = lane->session;
+
+    // Nothing more can be written after a failed write, as the records would not be where the index says.
+    if (lane->failed)
+    {
+        return;
+    }
+
+    svr_start_prof(&lane->write_prof);
+    svr_start_hist(&lane->write_hist);
+
+    // Chunks are counted in frames of the movie, so repeated frames count too.
+    bool keyframe = ses->capture_chunk_pos == 0;
+
+    ses->capture_chunk_pos += pipe_data->num_frames;
+
+    if (ses->capture_chunk_pos >= ses->capture_header.chunk_frames)
+    {
+        ses->capture_chunk_pos = 0;
+    }
+
+    SvrCaptureRecord record = {};
+    record.num_frames = pipe_data->num_frames;
+    record.flags = keyframe ? SVR_CAPTURE_KEYFRAME : 0;
+    record.size = svr_capture_compress(pipe_data->ptr, keyframe ? NULL : ses->capture_prev_frame, pipe_data->size, ses->capture_scratch, ses->capture_dest);
+
+    DWORD written;
+    bool res = WriteFile(ses->capture_file, &record, sizeof(SvrCaptureRecord), &written, NULL);
+    res = res && WriteFile(ses->capture_file, ses->capture_dest, record.size, &written, NULL);
+
+    if (!res)
+    {
+        game_log("Could not write to capture file (%lu)\n", GetLastError());
+        lane->failed = true;
+        return;
+    }
+
+    memcpy(ses->capture_prev_frame, pipe_data->ptr, pipe_data->size);
+
+    if (ses->capture_index_size == ses->capture_index_capacity)
+    {
+        ses->capture_index_capacity = ses->capture_index_capacity > 0 ? ses->capture_index_capacity * 2 : 4096;
+        ses->capture_index = (SvrCaptureIndexEntry*)realloc(ses->capture_index, sizeof(SvrCaptureIndexEntry) * ses->capture_index_capacity);
+    }
+
+    SvrCaptureIndexEntry& entry = ses->capture_index[ses->capture_index_size];
+    entry = {};
+    entry.offset = ses->capture_offset;
+    entry.size = record.size;
+    entry.num_frames = record.num_frames;
+    entry.flags = record.flags;
+
+    ses->capture_index_size++;
+    ses->capture_offset += sizeof(SvrCaptureRecord) + record.size;
+
+    svr_end_hist(&lane->write_hist);
+    svr_end_prof(&lane->write_prof);
+
+    lane->bytes_written += pipe_data->size;
+    lane->frames_written += pipe_data->num_frames;
+}
+
+void end_capture(FfmpegSession* ses)
+{
+    FfmpegLane& lane = ses->lanes[0];
+
+    if (!lane.failed)
+    {
+        DWORD written;
+        WriteFile(ses->capture_file, ses->capture_index, sizeof(SvrCaptureIndexEntry) * ses->capture_index_size, &written, NULL);
+
+        ses->capture_header.index_offset = ses->capture_offset;
+        ses->capture_header.num_records = ses->capture_index_size;
+
+        SetFilePointer(ses->capture_file, 0, NULL, FILE_BEGIN);
+        WriteFile(ses->capture_file, &ses->capture_header, sizeof(SvrCaptureHeader), &written, NULL);
+
+        game_log("Captured %lld frames to %s\n", lane.frames_written, ses->capture_path);
+        game_log("Use svr_encoder.exe --transcode to encode it\n");
+    }
+
+    else
+    {
+        game_log("The capture is not complete, only the frames before the failed write can be encoded\n");
+    }
+
+    CloseHandle(ses->capture_file);
+    ses->capture_file = NULL;
+}
+
+void free_capture(FfmpegSession* ses)
+{
+    if (ses->capture_file)
+    {
+        CloseHandle(ses->capture_file);
+        ses->capture_file = NULL;
+    }
+
+    free(ses->capture_prev_frame);
+    free(ses->capture_scratch);
+    free(ses->capture_dest);
+    free(ses->capture_index);
+
+    ses->capture_prev_frame = NULL;
+    ses->capture_scratch = NULL;
+    ses->capture_dest = NULL;
+    ses->capture_index = NULL;
+}
+
+// -------------------------------------------------
+
+// The file is next to the movie, as the movies directory is expected to be on a disk that is fast enough for the movie.
+// It is removed by the system when it is closed, also if the game exits without ending the movie.
+bool create_spill(FfmpegSession* ses)
+{
+    MovieProfile* profile = ses->movie.profile;
+
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+
+    s32 granularity = (s32)info.dwAllocationGranularity;
+
+    ses->spill_slot_size = ((ses->movie.frame_size + granularity - 1) / granularity) * granularity;
+
+    s64 spill_size = (s64)profile->encoder_spill_size * 1024 * 1024;
+    s64 num_slots = spill_size / ses->spill_slot_size;
+
+    if (num_slots > MAX_QUEUED_FRAMES)
+    {
+        num_slots = MAX_QUEUED_FRAMES;
+    }
+
+    if (num_slots == 0)
+    {
+        game_log("The spill size is less than a frame, frames will not be spilled\n");
+        return true;
+    }
+
+    ses->spill_num_slots = (s32)num_slots;
+    spill_size = (s64)ses->spill_num_slots * ses->spill_slot_size;
+
+    StringCchPrintfA(ses->spill_path, MAX_PATH, "%s.spill", ses->movie_path);
+
+    ses->spill_file = CreateFileA(ses->spill_path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+
+    if (ses->spill_file == INVALID_HANDLE_VALUE)
+    {
+        ses->spill_file = NULL;
+        game_log("Could not create spill file %s (%lu)\n", ses->spill_path, GetLastError());
+        return false;
+    }
+
+    // This makes the file as large as the mapping.
+    ses->spill_mapping = CreateFileMappingA(ses->spill_file, NULL, PAGE_READWRITE, (DWORD)(spill_size >> 32), (DWORD)spill_size, NULL);
+
+    if (ses->spill_mapping == NULL)
+    {
+        game_log("Could not map spill file %s (%lu)\n", ses->spill_path, GetLastError());
+        return false;
+    }
+
+    svr_sem_init(&ses->spill_sem, ses->spill_num_slots, ses->spill_num_slots);
+
+    ses->spill_next_slot = 0;
+
+    return true;
+}
+
+// Used by both the thread that submits the frames and the ffmpeg thread, for different slots.
+u8* map_spill_slot(FfmpegSession* ses, s32 slot, DWORD access)
+{
+    s64 offset = (s64)slot * ses->spill_slot_size;
+    return (u8*)MapViewOfFile(ses->spill_mapping, access, (DWORD)(offset >> 32), (DWORD)offset, ses->movie.frame_size);
+}
+
+// Returns false if the frame has to go in a send buffer after all.
+bool spill_send_buf(FfmpegSession* ses, ThreadPipeData* pipe_data)
+{
+    if (!svr_sem_try_wait(&ses->spill_sem))
+    {
+        return false;
+    }
+
+    pipe_data->ptr = map_spill_slot(ses, ses->spill_next_slot, FILE_MAP_WRITE);
+
+    if (pipe_data->ptr == NULL)
+    {
+        svr_sem_release(&ses->spill_sem);
+        return false;
+    }
+
+    pipe_data->size = ses->movie.frame_size;
+    pipe_data->spill_slot = ses->spill_next_slot;
+    pipe_data->pool_slot = -1;
+
+    ses->spill_next_slot = (ses->spill_next_slot + 1) % ses->spill_num_slots;
+
+    // The count can only go up from the ffmpeg thread after this, so this can be lower than it was but not higher.
+    s32 used_slots = ses->spill_num_slots - ses->spill_sem.count;
+
+    if (used_slots > ses->spill_peak_slots)
+    {
+        ses->spill_peak_slots = used_slots;
+    }
+
+    return true;
+}
+
+void free_spill(FfmpegSession* ses)
+{
+    if (ses->spill_mapping)
+    {
+        CloseHandle(ses->spill_mapping);
+        ses->spill_mapping = NULL;
+    }
+
+    if (ses->spill_file)
+    {
+        CloseHandle(ses->spill_file);
+        ses->spill_file = NULL;
+    }
+
+    ses->spill_num_slots = 0;
+}
+
+// -------------------------------------------------
+
+bool create_compress(FfmpegSession* ses)
+{
+    MovieProfile* profile = ses->movie.profile;
+
+    s64 pool_size = (s64)profile->encoder_compressed_queue * 1024 * 1024;
+
+    // A frame that does not fit at the end of the pool skips those blocks, which can be as many as it needs itself.
+    // With room for two of the largest frames, the blocks for a frame can always be taken.
+    s64 min_pool_size = 2 * (s64)(svr_capture_bound(ses->movie.frame_size) + MIN_COMPRESS_BLOCK_SIZE);
+
+    if (pool_size < min_pool_size)
+    {
+        game_log("The compressed queue must be at least %lld MB for this resolution\n", (min_pool_size + (1024 * 1024) - 1) / (1024 * 1024));
+        pool_size = min_pool_size;
+    }
+
+    ses->compress_block_size = MIN_COMPRESS_BLOCK_SIZE;
+
+    if (pool_size / ses->compress_block_size > MAX_QUEUED_FRAMES)
+    {
+        ses->compress_block_size = (s32)((pool_size + MAX_QUEUED_FRAMES - 1) / MAX_QUEUED_FRAMES);
+    }
+
+    ses->compress_num_blocks = (s32)(pool_size / ses->compress_block_size);
+
+    ses->compress_pool = (u8*)malloc((size_t)ses->compress_num_blocks * ses->compress_block_size);
+
+    ses->compress_frame = (u8*)malloc(ses->movie.frame_size);
+    ses->compress_prev_frame = (u8*)malloc(ses->movie.frame_size);
+    ses->compress_dest = (u8*)malloc(svr_capture_bound(ses->movie.frame_size));
+
+    ses->decompress_frame = (u8*)malloc(ses->movie.frame_size);
+    ses->decompress_scratch = (u8*)malloc(ses->movie.frame_size);
+
+    if (ses->compress_pool == NULL || ses->compress_frame == NULL || ses->compress_prev_frame == NULL || ses->compress_dest == NULL || ses->decompress_frame == NULL || ses->decompress_scratch == NULL)
+    {
+        game_log("Could not allocate %lld MB for the compressed queue\n", pool_size / (1024 * 1024));
+        return false;
+    }
+
+    svr_sem_init(&ses->compress_block_sem, ses->compress_num_blocks, ses->compress_num_blocks);
+
+    ses->compress_next_block = 0;
+    ses->compress_has_prev = false;
+
+    return true;
+}
+
+// Puts the frame in the pool. The frame must be in compress_frame.
+void compress_send_buf(FfmpegSession* ses, ThreadPipeData* pipe_data)
+{
+    s64 start_time = svr_prof_get_real_time();
+
+    // The first frame does not have a frame before it.
+    u8* prev = ses->compress_has_prev ? ses->compress_prev_frame : NULL;
+
+    s32 size = svr_capture_compress(ses->compress_frame, prev, ses->movie.frame_size, ses->compress_prev_frame, ses->compress_dest);
+
+    ses->compress_time += svr_prof_get_real_time() - start_time;
+
+    pipe_data->compressed_size = size;
+    pipe_data->compressed_keyframe = prev == NULL;
+
+    // The frame that was just compressed is the one before the next.
+    u8* temp = ses->compress_prev_frame;
+    ses->compress_prev_frame = ses->compress_frame;
+    ses->compress_frame = temp;
+
+    ses->compress_has_prev = true;
+
+    s32 num_blocks = (size + ses->compress_block_size - 1) / ses->compress_block_size;
+
+    // A frame has to be in blocks one after the other, so the blocks at the end are skipped if it does not fit there.
+    // They are given back together with the frame.
+    pipe_data->compressed_blocks = num_blocks;
+
+    if (ses->compress_next_block + num_blocks > ses->compress_num_blocks)
+    {
+        pipe_data->compressed_blocks += ses->compress_num_blocks - ses->compress_next_block;
+        ses->compress_next_block = 0;
+    }
+
+    bool stalled = false;
+
+    for (s32 i = 0; i < pipe_data->compressed_blocks; i++)
+    {
+        if (!svr_sem_try_wait(&ses->compress_block_sem))
+        {
+            // Waiting for room in the pool is the same as waiting for a send buffer.
+            if (!stalled)
+            {
+                svr_start_hist(&ses->send_wait_hist);
+                svr_trace_begin("Queue wait");
+            }
+
+            stalled = true;
+            svr_sem_wait(&ses->compress_block_sem);
+        }
+    }
+
+    if (stalled)
+    {
+        svr_trace_end("Queue wait");
+        svr_end_hist(&ses->send_wait_hist);
+
+        ses->num_stalls++;
+    }
+
+    else
+    {
+        svr_hist_add(&ses->send_wait_hist, 0);
+    }
+
+    // The count can only go up from the ffmpeg thread after this, so this can be lower than it was but not higher.
+    s32 used_blocks = ses->compress_num_blocks - ses->compress_block_sem.count;
+
+    if (used_blocks > ses->compress_peak_blocks)
+    {
+        ses->compress_peak_blocks = used_blocks;
+    }
+
+    pipe_data->ptr = ses->compress_pool + (size_t)ses->compress_next_block * ses->compress_block_size;
+    memcpy(pipe_data->ptr, ses->compress_dest, size);
+
+    ses->compress_next_block += num_blocks;
+
+    if (ses->compress_next_block == ses->compress_num_blocks)
+    {
+        ses->compress_next_block = 0;
+    }
+
+    ses->compress_frames++;
+    ses->compress_bytes += size;
+}
+
+void free_compress(FfmpegSession* ses)
+{
+    free(ses->compress_pool);
+    free(ses->compress_frame);
+    free(ses->compress_prev_frame);
+    free(ses->compress_dest);
+    free(ses->decompress_frame);
+    free(ses->decompress_scratch);
+
+    ses->compress_pool = NULL;
+    ses->compress_frame = NULL;
+    ses->compress_prev_frame = NULL;
+    ses->compress_dest = NULL;
+    ses->decompress_frame = NULL;
+    ses->decompress_scratch = NULL;
+
+    ses->compress_num_blocks = 0;
+}
+
+// -------------------------------------------------
+
+bool create_send_buf_pool(FfmpegSession* ses)
+{
+    MovieProfile* profile = ses->movie.profile;
+
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+
+    s32 granularity = (s32)info.dwAllocationGranularity;
+
+    ses->pool_slot_size = ((ses->movie.frame_size + granularity - 1) / granularity) * granularity;
+
+    s64 pool_size = (s64)profile->encoder_buffer_size * 1024 * 1024;
+    s64 num_bufs = pool_size / ses->pool_slot_size;
+
+    // With less, the game would wait for every frame to be written.
+    if (num_bufs < 2)
+    {
+        game_log("The send buffer size is less than 2 frames, 2 frames are used\n");
+        num_bufs = 2;
+    }
+
+    if (num_bufs > MAX_POOLED_SEND_BUFS)
+    {
+        num_bufs = MAX_POOLED_SEND_BUFS;
+    }
+
+    pool_size = num_bufs * ses->pool_slot_size;
+
+    // Not named and not backed by a file, so this is memory in the page file that goes away when it is closed.
+    ses->pool_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(pool_size >> 32), (DWORD)pool_size, NULL);
+
+    if (ses->pool_mapping == NULL)
+    {
+        game_log("Could not create %lld MB of send buffers (%lu)\n", pool_size / (1024 * 1024), GetLastError());
+        return false;
+    }
+
+    ses->num_send_bufs = (s32)num_bufs;
+
+    svr_atom_set(&ses->pool_mapped_views, 0);
+    svr_atom_set(&ses->pool_peak_views, 0);
+
+    return true;
+}
+
+// Used by the thread that submits the frames and the ffmpeg threads, for different buffers.
+// The address space can run out for a moment, but the other threads unmap their buffers soon after, so this waits until it can be mapped.
+void map_send_buf(FfmpegSession* ses, ThreadPipeData* pipe_data, DWORD access)
+{
+    s64 offset = (s64)pipe_data->pool_slot * ses->pool_slot_size;
+
+    u8* ptr = (u8*)MapViewOfFile(ses->pool_mapping, access, (DWORD)(offset >> 32), (DWORD)offset, ses->movie.frame_size);
+
+    if (ptr == NULL)
+    {
+        game_log("Could not map send buffer (%lu), waiting for address space\n", GetLastError());
+
+        while (ptr == NULL)
+        {
+            Sleep(10);
+            ptr = (u8*)MapViewOfFile(ses->pool_mapping, access, (DWORD)(offset >> 32), (DWORD)offset, ses->movie.frame_size);
+        }
+    }
+
+    pipe_data->ptr = ptr;
+
+    s32 views = svr_atom_add(&ses->pool_mapped_views, 1) + 1;
+    s32 peak_views = svr_atom_read(&ses->pool_peak_views);
+
+    while (views > peak_views && !svr_atom_cmpxchg(&ses->pool_peak_views, &peak_views, views))
+    {
+    }
+}
+
+// The pointer is kept, as an entry in the write queue without one is the stop sentinel.
+void unmap_send_buf(FfmpegSession* ses, ThreadPipeData* pipe_data)
+{
+    UnmapViewOfFile(pipe_data->ptr);
+    svr_atom_sub(&ses->pool_mapped_views, 1);
+}
+
+void free_send_buf_pool(FfmpegSession* ses)
+{
+    if (ses->pool_mapping)
+    {
+        CloseHandle(ses->pool_mapping);
+        ses->pool_mapping = NULL;
+    }
+}
+
+// -------------------------------------------------
+
+void free_all_ffmpeg_bufs(FfmpegSession* ses)
+{
+    for (s32 i = 0; i < MAX_POOLED_SEND_BUFS; i++)
+    {
+        ThreadPipeData& pipe_data = ses->send_bufs[i];
+
+        // Buffers in the pool are only pointers to where they were mapped last.
+        if (pipe_data.ptr && pipe_data.pool_slot == -1)
+        {
+            free(pipe_data.ptr);
+        }
+
+        pipe_data = {};
+    }
+
+    if (ses->audio_pipe)
+    {
+        CloseHandle(ses->audio_pipe);
+        ses->audio_pipe = NULL;
+    }
+
+    if (ses->audio_overlapped.hEvent)
+    {
+        CloseHandle(ses->audio_overlapped.hEvent);
+        ses->audio_overlapped.hEvent = NULL;
+    }
+
+    if (ses->audio_file)
+    {
+        CloseHandle(ses->audio_file);
+        ses->audio_file = NULL;
+    }
+
+    free_capture(ses);
+    free_spill(ses);
+    free_compress(ses);
+    free_send_buf_pool(ses);
+}
+
+// -------------------------------------------------
+
+// Every file of the movie has its own pipe, as the process of the file before can still be reading its pipe when the next one is started.
+void build_audio_pipe_name(FfmpegSession* ses, s32 output, char* buf, s32 buf_size)
+{
+    // Unique for every movie and game process, also when the previous movie is still being finished.
+    StringCchPrintfA(buf, buf_size, "\\\\.\\pipe\\svr_audio_%lu_%lu_%d_%d", GetCurrentProcessId(), GetTickCount(), (s32)(ses - ffmpeg_sessions), output);
+}
+
+// Returns NULL if the pipe could not be created. This is separate from create_audio_with_pipe so that a new file can be given up on
+// before the audio of the file before has been ended (see ffmpeg_rotate_output).
+HANDLE create_audio_pipe(const char* pipe_name)
+{
+    // Overlapped so that we can wait for ffmpeg to connect later without holding up the start.
+    HANDLE pipe = CreateNamedPipeA(pipe_name, PIPE_ACCESS_OUTBOUND | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE, PIPE_TYPE_BYTE | PIPE_WAIT, 1, AUDIO_PIPE_BUFFER_SIZE, 0, 0, NULL);
+
+    if (pipe == INVALID_HANDLE_VALUE)
+    {
+        game_log("Could not create audio pipe %s (%lu)\n", pipe_name, GetLastError());
+        return NULL;
+    }
+
+    return pipe;
+}
+
+// The session owns the pipe after this, also when this fails.
+bool create_audio_with_pipe(FfmpegSession* ses, const char* pipe_name, HANDLE pipe)
+{
+    StringCchCopyA(ses->audio_pipe_name, MAX_PATH, pipe_name);
+
+    ses->audio_pipe = pipe;
+
+    ses->audio_overlapped = {};
+    ses->audio_overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+
+    ses->audio_connected = false;
+    ses->audio_num_samples = 0;
+    ses->audio_connect_timed_out = false;
+    ses->audio_samples_dropped = 0;
+
+    if (!ConnectNamedPipe(ses->audio_pipe, &ses->audio_overlapped))
+    {
+        DWORD error = GetLastError();
+
+        if (error == ERROR_PIPE_CONNECTED)
+        {
+            ses->audio_connected = true;
+        }
+
+        else if (error != ERROR_IO_PENDING)
+        {
+            game_log("Could not wait for audio pipe connection (%lu)\n", error);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool create_audio(FfmpegSession* ses, const char* pipe_name)
+{
+    HANDLE pipe = create_audio_pipe(pipe_name);
+
+    if (pipe == NULL)
+    {
+        return false;
+    }
+
+    return create_audio_with_pipe(ses, pipe_name, pipe);
+}
+
+bool create_audio_file(FfmpegSession* ses)
+{
+    if (ses->use_capture)
+    {
+        svr_capture_build_audio_path(ses->capture_path, ses->audio_file_path, MAX_PATH);
+    }
+
+    else
+    {
+        StringCchPrintfA(ses->audio_file_path, MAX_PATH, "%s.audio.raw", ses->movie_path);
+    }
+
+    ses->audio_file = CreateFileA(ses->audio_file_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (ses->audio_file == INVALID_HANDLE_VALUE)
+    {
+        ses->audio_file = NULL;
+        game_log("Could not create audio file %s (%lu)\n", ses->audio_file_path, GetLastError());
+        return false;
+    }
+
+    return true;
+}
+
+// Returns true if ffmpeg has opened the audio pipe. Can wait for it for a while (see AUDIO_CONNECT_TIMEOUT), unless the process has exited.
+bool check_audio_connection(FfmpegSession* ses, bool wait)
+{
+    if (ses->audio_connected)
+    {
+        return true;
+    }
+
+    if (wait && !ses->audio_connect_timed_out)
+    {
+        // There is only an audio pipe when there is one process for the whole movie, or for every file of it.
+        HANDLE handles[] = { ses->audio_overlapped.hEvent, ses->audio_reader };
+
+        DWORD res = WaitForMultipleObjects(2, handles, FALSE, AUDIO_CONNECT_TIMEOUT);
+
+        if (res == WAIT_TIMEOUT)
+        {
+            game_log("ERROR: ffmpeg has not opened the audio pipe after %lu ms, the audio is dropped until it does\n", AUDIO_CONNECT_TIMEOUT);
+            ses->audio_connect_timed_out = true;
+            return false;
+        }
+
+        if (res != WAIT_OBJECT_0)
+        {
+            return false;
+        }
+    }
+
+    DWORD unused;
+    ses->audio_connected = GetOverlappedResult(ses->audio_pipe, &ses->audio_overlapped, &unused, FALSE);
+
+    return ses->audio_connected;
+}
+
+void write_audio_samples(FfmpegSession* ses)
+{
+    DWORD size = sizeof(SvrWaveSample) * ses->audio_num_samples;
+    DWORD written;
+
+    ses->audio_samples_written += ses->audio_num_samples;
+    ses->audio_num_samples = 0;
+
+    svr_trace_begin("Audio write");
+
+    // Written to the pipe buffer right away unless ffmpeg is far behind.
+    if (WriteFile(ses->audio_pipe, ses->audio_buf, size, NULL, &ses->audio_overlapped) || GetLastError() == ERROR_IO_PENDING)
+    {
+        GetOverlappedResult(ses->audio_pipe, &ses->audio_overlapped, &written, TRUE);
+    }
+
+    svr_trace_end("Audio write");
+}
+
+void ffmpeg_give_audio(SvrWaveSample* samples, s32 num_samples)
+{
+    FfmpegSession* ses = ffmpeg_session;
+
+    if (ses->audio_file)
+    {
+        DWORD written;
+        WriteFile(ses->audio_file, samples, sizeof(SvrWaveSample) * num_samples, &written, NULL);
+        ses->audio_samples_written += num_samples;
+        return;
+    }
+
+    if (ses->audio_pipe == NULL)
+    {
+        return;
+    }
+
+    while (num_samples > 0)
+    {
+        if (ses->audio_num_samples == AUDIO_BUFFERED_SAMPLES)
+        {
+            // ffmpeg has had more than enough video to get to the audio by now.
+            if (check_audio_connection(ses, true))
+            {
+                write_audio_samples(ses);
+            }
+
+            // Dropped instead of waiting for an ffmpeg that is stuck or has exited.
+            else
+            {
+                ses->audio_samples_dropped += ses->audio_num_samples;
+                ses->audio_num_samples = 0;
+            }
+        }
+
+        s32 num = svr_min(num_samples, AUDIO_BUFFERED_SAMPLES - ses->audio_num_samples);
+
+        memcpy(ses->audio_buf + ses->audio_num_samples, samples, sizeof(SvrWaveSample) * num);
+        ses->audio_num_samples += num;
+
+        samples += num;
+        num_samples -= num;
+    }
+
+    if (check_audio_connection(ses, false))
+    {
+        write_audio_samples(ses);
+    }
+}
+
+// This is the end of the audio for ffmpeg, without waiting for it or writing what is left.
+void close_audio_pipe(FfmpegSession* ses)
+{
+    CloseHandle(ses->audio_pipe);
+    ses->audio_pipe = NULL;
+
+    // A new one is made for the pipe of the next file.
+    CloseHandle(ses->audio_overlapped.hEvent);
+    ses->audio_overlapped.hEvent = NULL;
+
+    ses->audio_connected = false;
+    ses->audio_num_samples = 0;
+}
+
+// Must be done before ending the video, as ffmpeg will not finish until the audio has ended.
+void end_audio(FfmpegSession* ses)
+{
+    if (ses->audio_file)
+    {
+        // The name is kept for when the parts are joined.
+        CloseHandle(ses->audio_file);
+        ses->audio_file = NULL;
+        return;
+    }
+
+    // The pipe for a new file may not have been created.
+    if (ses->audio_pipe == NULL)
+    {
+        return;
+    }
+
+    // ffmpeg would fail to open the input if the pipe was closed before it got to it.
+    if (check_audio_connection(ses, true))
+    {
+        if (ses->audio_num_samples > 0)
+        {
+            write_audio_samples(ses);
+        }
+    }
+
+    else
+    {
+        ses->audio_samples_dropped += ses->audio_num_samples;
+    }
+
+    if (ses->audio_samples_dropped > 0)
+    {
+        game_log("ERROR: %lld audio samples were dropped from %s because ffmpeg did not open the audio pipe\n", ses->audio_samples_dropped, ses->audio_pipe_name);
+    }
+
+    close_audio_pipe(ses);
+}
+
+// -------------------------------------------------
+
+// Joins the parts into the movie and adds the audio.
+// The video is copied so this is only as slow as the disk.
+bool join_segments(FfmpegSession* ses, s32 num_segments)
+{
+    const s32 FULL_ARGS_SIZE = 2048;
+    const s32 ARGS_BUF_SIZE = 128;
+
+    bool ret = false;
+
+    STARTUPINFOA start_info = {};
+    DWORD create_flags = 0;
+
+    char full_args[FULL_ARGS_SIZE];
+    full_args[0] = 0;
+
+    char buf[ARGS_BUF_SIZE];
+
+    PROCESS_INFORMATION proc_info;
+    DWORD exit_code = 0;
+
+    char full_ffmpeg_path[MAX_PATH];
+    char list_path[MAX_PATH];
+
+    StringCchPrintfA(list_path, MAX_PATH, "%s.parts.txt", ses->movie_path);
+
+    if (!svr_write_part_list(list_path, ses->movie_path, num_segments))
+    {
+        game_log("Could not create part list %s (%lu)\n", list_path, GetLastError());
+        goto rexit;
+    }
+
+    #if 1
+    create_flags |= CREATE_NO_WINDOW;
+    #endif
+
+    full_ffmpeg_path[0] = 0;
+    StringCchCatA(full_ffmpeg_path, MAX_PATH, ses->resource_path);
+    StringCchCatA(full_ffmpeg_path, MAX_PATH, "\\ffmpeg.exe");
+
+    start_info.cb = sizeof(STARTUPINFOA);
+
+    StringCchCatA(full_args, FULL_ARGS_SIZE, "-hide_banner -loglevel quiet");
+
+    // The paths in the list are full paths, which are not allowed by default.
+    StringCchCatA(full_args, FULL_ARGS_SIZE, " -f concat -safe 0 -i \"");
+    StringCchCatA(full_args, FULL_ARGS_SIZE, list_path);
+    StringCchCatA(full_args, FULL_ARGS_SIZE, "\"");
+
+    if (ses->movie.profile->audio_enabled)
+    {
+        StringCchCatA(full_args, FULL_ARGS_SIZE, " -f s16le -ar 44100 -ac 2 -i \"");
+        StringCchCatA(full_args, FULL_ARGS_SIZE, ses->audio_file_path);
+        StringCchCatA(full_args, FULL_ARGS_SIZE, "\" -map 0:v -map 1:a");
+    }
+
+    StringCchCatA(full_args, FULL_ARGS_SIZE, " -vcodec copy");
+
+    if (ses->movie.profile->audio_enabled)
+    {
+        StringCchPrintfA(buf, ARGS_BUF_SIZE, " -acodec aac -b:a %dk", ses->movie.profile->audio_bitrate);
+        StringCchCatA(full_args, FULL_ARGS_SIZE, buf);
+    }
+
+    StringCchCatA(full_args, FULL_ARGS_SIZE, " -y \"");
+    StringCchCatA(full_args, FULL_ARGS_SIZE, ses->movie_path);
+    StringCchCatA(full_args, FULL_ARGS_SIZE, "\"");
+
+    if (!CreateProcessA(full_ffmpeg_path, full_args, NULL, NULL, FALSE, create_flags, NULL, ses->resource_path, &start_info, &proc_info))
+    {
+        game_log("Could not create ffmpeg process for joining the parts (%lu)\n", GetLastError());
+        goto rexit;
+    }
+
+    CloseHandle(proc_info.hThread);
+
+    WaitForSingleObject(proc_info.hProcess, INFINITE);
+    GetExitCodeProcess(proc_info.hProcess, &exit_code);
+    CloseHandle(proc_info.hProcess);
+
+    if (exit_code != 0)
+    {
+        game_log("ffmpeg exited with code %lu when joining the parts\n", exit_code);
+        goto rexit;
+    }
+
+    ret = true;
+
+rexit:
+    DeleteFileA(list_path);
+    return ret;
+}
+
+void end_segments(FfmpegSession* ses)
+{
+    s64 frames_written = 0;
+    bool failed = false;
+
+    for (s32 i = 0; i < ses->num_lanes; i++)
+    {
+        frames_written += ses->lanes[i].frames_written;
+        failed |= ses->lanes[i].failed;
+    }
+
+    s32 num_segments = ses->segment + 1;
+
+    // Every frame that was given must have gone to a part, otherwise the movie would be shorter than it should.
+    if (frames_written != ses->frames_submitted)
+    {
+        game_log("Only %lld of %lld frames were encoded in parts\n", frames_written, ses->frames_submitted);
+        failed = true;
+    }
+
+    if (failed || !join_segments(ses, num_segments))
+    {
+        game_log("Could not join the parts of the movie, they are kept next to it\n");
+        return;
+    }
+
+    for (s32 i = 0; i < num_segments; i++)
+    {
+        char path[MAX_PATH];
+        build_segment_path(ses, i, path, MAX_PATH);
+        DeleteFileA(path);
+    }
+
+    if (ses->movie.profile->audio_enabled)
+    {
+        DeleteFileA(ses->audio_file_path);
+    }
+
+    game_log("Joined %d parts with %lld frames\n", num_segments, frames_written);
+}
+
+// -------------------------------------------------
+
+// Fills in the encoder side of the report that the proc backend started, and writes it next to the movie.
+void write_session_report(FfmpegSession* ses)
+{
+    ProcReport* report = &ses->report;
+
+    FfmpegLatency latency;
+    calc_session_latency(ses, &latency);
+
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+
+    report->output = "pipe";
+
+    if (ses->use_workers)
+    {
+        report->output = "workers";
+    }
+
+    else if (ses->use_capture)
+    {
+        report->output = "capture";
+    }
+
+    report->num_lanes = ses->num_lanes;
+    report->direct_writes = ses->movie.planes_only;
+
+    report->duration = ses->end_time - ses->start_time;
+    report->output_duration = ses->output_end_time - ses->start_time;
+
+    report->frames_submitted = ses->frames_submitted;
+    report->frames_written = 0;
+
+    for (s32 i = 0; i < ses->num_lanes; i++)
+    {
+        report->frames_written += ses->lanes[i].frames_written;
+        report->part_switch_time += ses->lanes[i].part_switch_time;
+    }
+
+    report->bytes_written = ses->bytes_written;
+    report->audio_samples_written = ses->audio_samples_written;
+
+    report->write = latency.write;
+    report->send_wait = latency.send_wait;
+
+    report->num_send_bufs = ses->num_send_bufs;
+    report->peak_send_bufs = ses->peak_send_bufs;
+    report->num_stalls = ses->num_stalls;
+    report->spill_frames = ses->spill_frames;
+    report->spill_peak_slots = ses->spill_peak_slots;
+    report->credit_waits = ses->credit_waits;
+    report->credit_wait_time = ses->credit_wait_time;
+
+    // The encoding is done on other computers or later.
+    report->encoder_cpu_time = ses->use_workers || ses->use_capture ? -1 : ses->encoder_cpu_time;
+    report->num_cpus = info.dwNumberOfProcessors;
+
+    char reason[512];
+    ProcBottleneck bottleneck = classify_proc_bottleneck(report, reason, SVR_ARRAY_SIZE(reason));
+
+    game_log("The movie was limited by the %s: %s\n", get_proc_bottleneck_name(bottleneck), reason);
+
+    char path[MAX_PATH];
+    StringCchPrintfA(path, MAX_PATH, "%s.report.json", ses->movie_path);
+
+    if (write_proc_report(path, ses->movie_path, &ses->profile, report, bottleneck, reason))
+    {
+        game_log("Wrote report to %s\n", path);
+    }
+
+    else
+    {
+        game_log("Could not write report to %s\n", path);
+    }
+}
+
+// Finishes a movie. This is done by a finalizer thread, or by the game thread if movies are not finished in the background.
+void finalize_session(FfmpegSession* ses)
+{
+    // The audio of a file that was never given any video would not be opened.
+    end_unused_outputs(ses);
+
+    if (ses->movie.profile->audio_enabled)
+    {
+        end_audio(ses);
+    }
+
+    end_ffmpeg_lanes(ses);
+
+    if (ses->use_capture)
+    {
+        end_capture(ses);
+    }
+
+    else if (ses->use_segments)
+    {
+        end_segments(ses);
+    }
+
+    show_session_report(ses);
+
+    if (ses->profile.report_enabled)
+    {
+        write_session_report(ses);
+    }
+
+    free_all_ffmpeg_bufs(ses);
+
+    // Ended here and not when the movie ends, so that the lanes and the finalizer are in the trace until the end
+    // and the threads of the movie are done with it when it is written.
+    if (ses->profile.trace_enabled)
+    {
+        char trace_path[MAX_PATH];
+        StringCchPrintfA(trace_path, MAX_PATH, "%s.trace.json", ses->movie_path);
+
+        if (svr_end_trace())
+        {
+            game_log("Wrote trace to %s\n", trace_path);
+        }
+
+        else
+        {
+            game_log("Could not write trace to %s\n", trace_path);
+        }
+    }
+}
+
+DWORD WINAPI ffmpeg_finalize_proc(LPVOID lpParameter)
+{
+    FfmpegSession* ses = (FfmpegSession*)lpParameter;
+
+    s64 start_time = svr_prof_get_real_time();
+
+    svr_trace_name_thread("Finalizer", -1);
+
+    finalize_session(ses);
+
+    // Prof time is in microseconds.
+    game_log("Finished %s in the background after %0.2f seconds\n", ses->movie_path, (double)(svr_prof_get_real_time() - start_time) / 1000000.0);
+
+    return 0;
+}
+
+// Gives back the sessions of the movies that have been finished in the background.
+void reclaim_finalized_sessions()
+{
+    for (s32 i = 0; i < MAX_FFMPEG_SESSIONS; i++)
+    {
+        FfmpegSession* ses = &ffmpeg_sessions[i];
+
+        if (ses->finalize_thread && WaitForSingleObject(ses->finalize_thread, 0) == WAIT_OBJECT_0)
+        {
+            CloseHandle(ses->finalize_thread);
+            ses->finalize_thread = NULL;
+
+            ses->in_use = false;
+        }
+    }
+}
+
+// Waits until at most this many movies are being finished in the background.
+void wait_for_finalizing_sessions(s32 max_finalizing)
+{
+    while (true)
+    {
+        reclaim_finalized_sessions();
+
+        HANDLE threads[MAX_FFMPEG_SESSIONS];
+        s32 num_threads = 0;
+
+        for (s32 i = 0; i < MAX_FFMPEG_SESSIONS; i++)
+        {
+            if (ffmpeg_sessions[i].finalize_thread)
+            {
+                threads[num_threads] = ffmpeg_sessions[i].finalize_thread;
+                num_threads++;
+            }
+        }
+
+        if (num_threads <= max_finalizing)
+        {
+            break;
+        }
+
+        WaitForMultipleObjects(num_threads, threads, FALSE, INFINITE);
+    }
+}
+
+// A movie that is being finished would be written over by a new movie with the same name.
+void wait_for_finalizing_movie(const char* movie_path)
+{
+    for (s32 i = 0; i < MAX_FFMPEG_SESSIONS; i++)
+    {
+        FfmpegSession* ses = &ffmpeg_sessions[i];
+
+        if (ses->finalize_thread && !_stricmp(ses->movie_path, movie_path))
+        {
+            game_log("Waiting for the previous %s to be finished\n", movie_path);
+            WaitForSingleObject(ses->finalize_thread, INFINITE);
+        }
+    }
+}
+
+// -------------------------------------------------
+
+bool ffmpeg_start(FfmpegStartData* data)
+{
+    bool ret = false;
+
+    FfmpegSession* ses = NULL;
+
+    s64 start_time = svr_prof_get_real_time();
+
+    FfmpegWarmProc warm;
+    bool use_warm = false;
+
+    wait_for_finalizing_movie(data->movie_path);
+
+    // The trace of a movie is ended by its finalizer, and only one trace can be made at a time.
+    // The threads of this movie would otherwise be writing to it while it is written.
+    if (svr_trace_enabled)
+    {
+        wait_for_finalizing_sessions(0);
+    }
+
+    reclaim_finalized_sessions();
+
+    // There is always one that is free, as only so many movies can be finished at once.
+    for (s32 i = 0; i < MAX_FFMPEG_SESSIONS && ses == NULL; i++)
+    {
+        if (!ffmpeg_sessions[i].in_use)
+        {
+            ses = &ffmpeg_sessions[i];
+        }
+    }
+
+    assert(ses);
+
+    init_session(ses);
+
+    ses->in_use = true;
+    ffmpeg_session = ses;
+
+    ses->movie = *data;
+
+    // The profile is read again by the next movie, which can start before this one is finished.
+    ses->profile = *data->profile;
+
+    StringCchCopyA(ses->resource_path, MAX_PATH, data->resource_path);
+    StringCchCopyA(ses->movie_path, MAX_PATH, data->movie_path);
+
+    ses->movie.profile = &ses->profile;
+    ses->movie.resource_path = ses->resource_path;
+    ses->movie.movie_path = ses->movie_path;
+
+    ses->num_lanes = ses->movie.profile->encoder_segments;
+    ses->use_capture = ses->movie.profile->encoder_intermediate;
+    ses->use_workers = false;
+
+    if (ses->use_capture)
+    {
+        // Captures are encoded in parts later, which is not to be done now.
+        ses->num_lanes = 1;
+
+        StringCchPrintfA(ses->capture_path, MAX_PATH, "%s%s", ses->movie_path, SVR_CAPTURE_EXTENSION);
+    }
+
+    if (ses->movie.profile->encoder_workers[0])
+    {
+        if (ses->use_capture)
+        {
+            game_log("Encoder workers are not used with an intermediate capture\n");
+        }
+
+        else if (strlen(ses->movie.profile->encoder_workers_secret) < SVR_NET_MIN_SECRET)
+        {
+            game_log("ERROR: Encoder workers need encoder_workers_secret to be at least %d characters, the movie is encoded here\n", SVR_NET_MIN_SECRET);
+        }
+
+        else
+        {
+            // There is a lane for every worker instead of the number of parts at once in the profile.
+            s32 num_workers = parse_worker_addresses(ses);
+
+            if (num_workers > 0)
+            {
+                ses->num_lanes = num_workers;
+                ses->use_workers = true;
+            }
+        }
+    }
+
+    ses->use_segments = ses->num_lanes > 1 || ses->use_workers;
+
+    ses->threads_per_proc = 0;
+
+    // Workers have the cores of their own computers.
+    if (ses->num_lanes > 1 && !ses->use_workers)
+    {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+
+        // x264 uses 1.5 threads per core on its own, which is split between the processes.
+        ses->threads_per_proc = (s32)(info.dwNumberOfProcessors * 3 / 2) / ses->num_lanes;
+        svr_clamp(&ses->threads_per_proc, 1, INT32_MAX);
+    }
+
+    ses->segment_frames = ses->movie.profile->encoder_segment_length * ses->movie.profile->movie_fps;
+    ses->segment = 0;
+    ses->segment_start = 0;
+    ses->frames_submitted = 0;
+    ses->audio_samples_written = 0;
+
+    ses->num_outputs = 1;
+    ses->output_start = 0;
+    StringCchCopyA(ses->output_path, MAX_PATH, ses->movie_path);
+
+    svr_atom_set(&ses->started_outputs, 1);
+    svr_sem_init(&ses->output_sem, MAX_PENDING_OUTPUTS, MAX_PENDING_OUTPUTS);
+
+    ses->num_retired_procs = 0;
+
+    StringCchCopyA(ses->lane_output.path, MAX_PATH, ses->movie_path);
+    ses->lane_output.warm_path[0] = 0;
+
+    ses->start_time = start_time;
+    ses->first_read_time = 0;
+    ses->end_time = 0;
+    ses->output_end_time = 0;
+
+    if (ses->movie.profile->report_enabled)
+    {
+        ses->report = {};
+        ses->report.queue_sample_interval = REPORT_QUEUE_SAMPLE_INTERVAL;
+        ses->next_queue_sample_time = start_time;
+    }
+
+    if (!ses->use_segments && !ses->use_capture)
+    {
+        // The process is already running if one was started with the same arguments after the movie before.
+        use_warm = take_warm_proc(ses, ses->movie_path, ses->movie.profile->audio_enabled, &warm);
+    }
+
+    else if (ses->movie.profile->encoder_prewarm > 0)
+    {
+        game_log("ffmpeg is not started ahead of time when encoding in parts or with an intermediate capture\n");
+    }
+
+    ses->started_warm = use_warm;
+
+    if (ses->movie.profile->audio_enabled)
+    {
+        bool audio_res;
+
+        if (ses->use_segments || ses->use_capture)
+        {
+            audio_res = create_audio_file(ses);
+        }
+
+        else
+        {
+            // The warm process already has the name of its pipe.
+            char audio_pipe_name[MAX_PATH];
+
+            if (use_warm)
+            {
+                StringCchCopyA(audio_pipe_name, MAX_PATH, warm.audio_pipe_name);
+            }
+
+            else
+            {
+                build_audio_pipe_name(ses, 0, audio_pipe_name, MAX_PATH);
+            }
+
+            audio_res = create_audio(ses, audio_pipe_name);
+        }
+
+        if (!audio_res)
+        {
+            goto rfail;
+        }
+    }
+
+    ses->spill_frames = 0;
+    ses->spill_peak_slots = 0;
+
+    ses->compress_frames = 0;
+    ses->compress_bytes = 0;
+    ses->compress_time = 0;
+    ses->decompress_time = 0;
+    ses->compress_peak_blocks = 0;
+
+    if (ses->movie.profile->encoder_compressed_queue > 0)
+    {
+        if (ses->use_segments || ses->use_capture)
+        {
+            game_log("The queue is not compressed when encoding in parts or with an intermediate capture\n");
+        }
+
+        // The send buffers are used instead.
+        else if (!create_compress(ses))
+        {
+            free_compress(ses);
+        }
+    }
+
+    if (ses->movie.profile->encoder_spill_size > 0)
+    {
+        if (ses->use_segments)
+        {
+            game_log("Frames are not spilled when encoding in parts\n");
+        }
+
+        else if (ses->compress_pool)
+        {
+            game_log("Frames are not spilled when the queue is compressed\n");
+        }
+
+        // The movie can still be made without it, only slower.
+        else if (!create_spill(ses))
+        {
+            free_spill(ses);
+        }
+    }
+
+    // The lanes finish out of order, so the planes are copied into the send buffers when encoding in parts (see take_pipe_planes).
+    // Captures and the compressed queue are compressed from the memory of the frame too, and a spilled frame gives its planes back right away.
+    ses->movie.planes_only = data->planes_only && !ses->use_segments && !ses->use_capture && !ses->compress_pool && !ses->spill_mapping;
+
+    // We have a controlled environment until the lane threads are started.
+    // Set the semaphore and queues to known states.
+
+    ses->num_send_bufs = ses->use_segments ? MAX_SEGMENTED_SEND_BUFS : MAX_BUFFERED_SEND_BUFS;
+    ses->num_stalls = 0;
+
+    ses->peak_send_bufs = 0;
+
+    // The pool takes the place of the send buffers.
+    if (ses->compress_pool)
+    {
+        ses->num_send_bufs = 0;
+    }
+
+    if (ses->movie.profile->encoder_buffer_size > 0)
+    {
+        if (ses->compress_pool)
+        {
+            game_log("The send buffer size is not used when the queue is compressed\n");
+        }
+
+        else if (ses->movie.planes_only)
+        {
+            game_log("The send buffer size is not used with direct writes, as the send buffers have no memory then\n");
+        }
+
+        // The usual buffers are used instead.
+        else if (!create_send_buf_pool(ses))
+        {
+            free_send_buf_pool(ses);
+        }
+    }
+
+    ses->use_pool = ses->pool_mapping != NULL;
+
+    svr_sem_init(&ses->read_sem, ses->num_send_bufs, ses->num_send_bufs);
+
+    for (s32 i = 0; i < ses->num_lanes; i++)
+    {
+        FfmpegLane& lane = ses->lanes[i];
+
+        svr_sem_init(&lane.write_sem, 0, ses->num_send_bufs + ses->spill_num_slots + ses->compress_num_blocks + 1);
+
+        // Need to overwrite with new data.
+        lane.read_queue.reset();
+        lane.write_queue.reset();
+
+        lane.segment = -1;
+        lane.failed = false;
+        lane.write_prof = {};
+        lane.bytes_written = 0;
+        lane.frames_written = 0;
+
+        lane.conn = {};
+        lane.credits = 0;
+        lane.in_part = false;
+        lane.credit_waits = 0;
+        lane.credit_wait_time = 0;
+        lane.bytes_received = 0;
+        lane.write_end_time = 0;
+        lane.encoder_cpu_time = 0;
+        lane.part_switch_time = 0;
+
+        svr_reset_hist(&lane.write_hist);
+    }
+
+    svr_reset_prof(&ses->write_prof);
+    ses->bytes_written = 0;
+
+    svr_reset_hist(&ses->send_wait_hist);
+
+    ses->credit_waits = 0;
+    ses->credit_wait_time = 0;
+    ses->bytes_received = 0;
+    ses->encoder_cpu_time = 0;
+
+    // Each buffer contains 1 uncompressed frame.
+
+    for (s32 i = 0; i < ses->num_send_bufs; i++)
+    {
+        ThreadPipeData pipe_data = {};
+        pipe_data.size = ses->movie.frame_size;
+        pipe_data.spill_slot = -1;
+        pipe_data.pool_slot = -1;
+
+        // Buffers in the pool are mapped when they are acquired.
+        if (ses->pool_mapping)
+        {
+            pipe_data.pool_slot = i;
+        }
+
+        // Frames are written from their planes.
+        else if (!ses->movie.planes_only)
+        {
+            pipe_data.ptr = (u8*)malloc(ses->movie.frame_size);
+        }
+
+        ses->send_bufs[i] = pipe_data;
+    }
+
+    // They are given back to any lane, so they can start in any of them.
+    for (s32 i = 0; i < ses->num_send_bufs; i++)
+    {
+        ses->lanes[0].read_queue.push(&ses->send_bufs[i]);
+    }
+
+    if (ses->use_workers && !connect_worker_lanes(ses))
+    {
+        goto rfail;
+    }
+
+    if (ses->use_capture)
+    {
+        if (!start_capture(ses))
+        {
+            goto rfail;
+        }
+    }
+
+    else if (use_warm)
+    {
+        // The file is moved to the movie path when the process has finished.
+        ses->lanes[0].proc = warm.proc;
+        ses->lanes[0].write_pipe = warm.write_pipe;
+        ses->lanes[0].segment = 0;
+
+        StringCchCopyA(ses->lane_output.warm_path, MAX_PATH, warm.path);
+
+        use_warm = false;
+    }
+
+    // The first process is started here so that we know right away if ffmpeg cannot be started.
+    // The others are started by the lanes when they get their first frame.
+    else if (!start_ffmpeg_proc(&ses->lanes[0], 0))
+    {
+        goto rfail;
+    }
+
+    ses->audio_reader = ses->lanes[0].proc;
+
+    _ReadWriteBarrier();
+
+    for (s32 i = 0; i < ses->num_lanes; i++)
+    {
+        ses->lanes[i].thread = CreateThread(NULL, 0, ffmpeg_thread_proc, &ses->lanes[i], 0, NULL);
+    }
+
+    ses->start_duration = svr_prof_get_real_time() - start_time;
+
+    ret = true;
+    goto rexit;
+
+rfail:
+    if (use_warm)
+    {
+        end_warm_proc(&warm);
+    }
+
+    if (ses->use_workers)
+    {
+        for (s32 i = 0; i < ses->num_lanes; i++)
+        {
+            close_worker_lane(&ses->lanes[i]);
+        }
+    }
+
+    free_all_ffmpeg_bufs(ses);
+
+    ses->in_use = false;
+    ffmpeg_session = NULL;
+
+rexit:
+    return ret;
+}
+
+void ffmpeg_acquire_send_buf(ThreadPipeData* pipe_data)
+{
+    FfmpegSession* ses = ffmpeg_session;
+
+    if (ses->profile.report_enabled)
+    {
+        sample_report_queues(ses);
+    }
+
+    if (ses->compress_pool)
+    {
+        // The frame is compressed into the pool when it is submitted, so the same memory is filled every time.
+        pipe_data->ptr = ses->compress_frame;
+        pipe_data->size = ses->movie.frame_size;
+        pipe_data->spill_slot = -1;
+        pipe_data->pool_slot = -1;
+    }
+
+    else
+    {
+        bool has_buf = svr_sem_try_wait(&ses->read_sem);
+
+        // All send buffers are waiting to be written. The frame is spilled if there is room, otherwise we have to wait.
+        if (!has_buf && !(ses->spill_mapping && spill_send_buf(ses, pipe_data)))
+        {
+            ses->num_stalls++;
+
+            svr_start_hist(&ses->send_wait_hist);
+            svr_trace_begin("Queue wait");
+
+            svr_sem_wait(&ses->read_sem);
+
+            svr_trace_end("Queue wait");
+            svr_end_hist(&ses->send_wait_hist);
+
+            has_buf = true;
+        }
+
+        else
+        {
+            svr_hist_add(&ses->send_wait_hist, 0);
+        }
+
+        if (has_buf)
+        {
+            // Buffers are pushed before the semaphore is released, so one of the lanes has one.
+            bool res1 = false;
+
+            for (s32 i = 0; i < ses->num_lanes && !res1; i++)
+            {
+                res1 = ses->lanes[i].read_queue.pull(pipe_data);
+            }
+
+            assert(res1);
+
+            // The count can only go up from the ffmpeg threads after this, so this can be lower than it was but not higher.
+            s32 used_bufs = ses->num_send_bufs - ses->read_sem.count;
+
+            if (used_bufs > ses->peak_send_bufs)
+            {
+                ses->peak_send_bufs = used_bufs;
+            }
+
+            svr_trace_counter("Send buffers in use", used_bufs);
+
+            if (pipe_data->pool_slot != -1)
+            {
+                map_send_buf(ses, pipe_data, FILE_MAP_WRITE);
+            }
+        }
+    }
+
+    pipe_data->num_planes = 0;
+    pipe_data->num_frames = 1;
+    pipe_data->segment = 0;
+    pipe_data->compressed_size = 0;
+    pipe_data->compressed_blocks = 0;
+    pipe_data->compressed_keyframe = false;
+    pipe_data->written_fn = NULL;
+    pipe_data->written_user = NULL;
+}
+
+// The memory of the planes is owned by the caller and has to be given back in the same order as it was submitted,
+// which the lanes would not do.
+void take_pipe_planes(ThreadPipeData* pipe_data)
+{
+    if (pipe_data->num_planes > 0)
+    {
+        copy_pipe_planes(pipe_data);
+        pipe_data->num_planes = 0;
+    }
+
+    if (pipe_data->written_fn)
+    {
+        pipe_data->written_fn(pipe_data->written_user);
+        pipe_data->written_fn = NULL;
+    }
+}
+
+void ffmpeg_submit_send_buf(ThreadPipeData* pipe_data)
+{
+    FfmpegSession* ses = ffmpeg_session;
+
+    FfmpegLane* lane = &ses->lanes[0];
+
+    if (ses->use_capture)
+    {
+        // Frames are compressed from the send buffer.
+        take_pipe_planes(pipe_data);
+    }
+
+    if (ses->compress_pool)
+    {
+        // The planes are given back in order as they are taken right away.
+        take_pipe_planes(pipe_data);
+        compress_send_buf(ses, pipe_data);
+    }
+
+    if (ses->spill_mapping)
+    {
+        // A spilled frame gives its planes back now, so any frames before it that are still waiting to be written from
+        // their planes would be given back out of order. With spilling, planes are always put in the buffer.
+        take_pipe_planes(pipe_data);
+
+        if (pipe_data->spill_slot != -1)
+        {
+            // Mapped again by the ffmpeg thread when it gets to it.
+            UnmapViewOfFile(pipe_data->ptr);
+            ses->spill_frames++;
+        }
+    }
+
+    if (ses->use_segments)
+    {
+        take_pipe_planes(pipe_data);
+
+        // Repeated frames are kept together, so a part can be a bit longer than the others.
+        if (ses->frames_submitted - ses->segment_start >= ses->segment_frames)
+        {
+            ses->segment++;
+            ses->segment_start = ses->frames_submitted;
+        }
+
+        pipe_data->segment = ses->segment;
+        lane = &ses->lanes[ses->segment % ses->num_lanes];
+    }
+
+    else
+    {
+        // Frames go in the next file from the frame that it was started at.
+        while (ses->segment + 1 < svr_atom_load(&ses->started_outputs) && ses->frames_submitted >= ses->outputs[(ses->segment + 1) % MAX_PENDING_OUTPUTS].start_frame)
+        {
+            ses->segment++;
+        }
+
+        pipe_data->segment = ses->segment;
+    }
+
+    if (pipe_data->pool_slot != -1)
+    {
+        // Mapped again by the ffmpeg thread if it is written from the buffer.
+        unmap_send_buf(ses, pipe_data);
+    }
+
+    ses->frames_submitted += pipe_data->num_frames;
+
+    lane->write_queue.push(pipe_data);
+
+    svr_sem_release(&lane->write_sem);
+}
+
+bool ffmpeg_rotate_output(const char* movie_path, s64 start_frame)
+{
+    FfmpegSession* ses = ffmpeg_session;
+
+    if (ses->use_segments || ses->use_capture)
+    {
+        game_log("The movie can only be continued in a new file when it is written by one ffmpeg process\n");
+        return false;
+    }
+
+    // The process of the file before would never get its video.
+    if (start_frame == ses->output_start)
+    {
+        game_log("No frames have been given to %s yet\n", ses->output_path);
+        return false;
+    }
+
+    if (!_stricmp(movie_path, ses->output_path))
+    {
+        game_log("%s is already being written\n", movie_path);
+        return false;
+    }
+
+    // The audio of the file before is ended here, and it could have to wait for video that has not been given yet.
+    if (ses->audio_pipe && !check_audio_connection(ses, false))
+    {
+        game_log("The audio of %s has not been opened by ffmpeg yet\n", ses->output_path);
+        return false;
+    }
+
+    wait_for_finalizing_movie(movie_path);
+
+    // Only so many files can be started before the frames have gotten to them.
+    svr_sem_wait(&ses->output_sem);
+
+    FfmpegOutput* output = &ses->outputs[ses->num_outputs % MAX_PENDING_OUTPUTS];
+
+    FfmpegWarmProc warm;
+    bool use_warm = take_warm_proc(ses, movie_path, ses->audio_pipe != NULL, &warm);
+
+    char audio_pipe_name[MAX_PATH];
+    HANDLE audio_pipe = NULL;
+
+    if (ses->audio_pipe)
+    {
+        if (use_warm)
+        {
+            StringCchCopyA(audio_pipe_name, MAX_PATH, warm.audio_pipe_name);
+        }
+
+        else
+        {
+            build_audio_pipe_name(ses, ses->num_outputs, audio_pipe_name, MAX_PATH);
+        }
+
+        // Made before anything is changed, so the frames and the audio can keep going to the file before if this fails.
+        audio_pipe = create_audio_pipe(audio_pipe_name);
+
+        if (audio_pipe == NULL)
+        {
+            if (use_warm)
+            {
+                end_warm_proc(&warm);
+            }
+
+            svr_sem_release(&ses->output_sem);
+            return false;
+        }
+    }
+
+    output->warm_path[0] = 0;
+
+    if (use_warm)
+    {
+        output->proc = warm.proc;
+        output->write_pipe = warm.write_pipe;
+
+        StringCchCopyA(output->warm_path, MAX_PATH, warm.path);
+    }
+
+    // The process is started now so the lane can switch to it right away. It waits for its video until then.
+    else if (!create_ffmpeg_proc(ses, movie_path, ses->audio_pipe ? audio_pipe_name : NULL, &output->proc, &output->write_pipe))
+    {
+        if (audio_pipe)
+        {
+            CloseHandle(audio_pipe);
+        }
+
+        svr_sem_release(&ses->output_sem);
+        return false;
+    }
+
+    // The new process only opens its audio pipe after it has gotten video, which cannot happen before it is published below.
+    if (ses->audio_pipe)
+    {
+        end_audio(ses);
+
+        ses->audio_reader = output->proc;
+
+        // The audio of the file before has been ended, so the new file is still used, and the audio of it is dropped
+        // when ffmpeg does not open the pipe (see check_audio_connection).
+        if (!create_audio_with_pipe(ses, audio_pipe_name, audio_pipe))
+        {
+            game_log("ERROR: The audio of %s could not be started\n", movie_path);
+        }
+    }
+
+    StringCchCopyA(output->path, MAX_PATH, movie_path);
+    output->start_frame = start_frame;
+
+    StringCchCopyA(ses->output_path, MAX_PATH, movie_path);
+    ses->output_start = start_frame;
+    ses->num_outputs++;
+
+    svr_atom_store(&ses->started_outputs, ses->num_outputs);
+
+    game_log("Continuing the movie in %s from frame %lld\n", movie_path, start_frame);
+
+    // For the next file.
+    warm_ffmpeg_procs(ses, movie_path);
+
+    return true;
+}
+
+void ffmpeg_end()
+{
+    FfmpegSession* ses = ffmpeg_session;
+    ffmpeg_session = NULL;
+
+    ses->end_time = svr_prof_get_real_time();
+
+    // Started while the game is between movies, so the next movie does not have to wait for ffmpeg.
+    warm_ffmpeg_procs(ses, ses->output_path);
+
+    s32 max_finalizing = ses->profile.encoder_max_finalizing;
+
+    if (max_finalizing > 0)
+    {
+        // The game has to wait here if there are already too many movies being finished.
+        wait_for_finalizing_sessions(max_finalizing - 1);
+
+        ses->finalize_thread = CreateThread(NULL, 0, ffmpeg_finalize_proc, ses, 0, NULL);
+
+        if (ses->finalize_thread)
+        {
+            game_log("Finishing %s in the background\n", ses->movie_path);
+            return;
+        }
+
+        game_log("Could not create thread for finishing the movie in the background (%lu)\n", GetLastError());
+    }
+
+    finalize_session(ses);
+
+    ses->in_use = false;
+}
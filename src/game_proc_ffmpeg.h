@@ -0,0 +1,167 @@
+#pragma once
+#include "svr_common.h"
+#include "svr_pxconv.h"
+#include "svr_hist.h"
+
+// Encoder side of the proc layer, shared by the proc backends (game_proc and game_proc_cpu).
+// This owns the ffmpeg processes, the threads that write to them, the buffers of converted frames waiting to be sent, and the audio output.
+
+struct MovieProfile;
+struct SvrWaveSample;
+struct ProcReport;
+
+// Memory that is written to ffmpeg directly instead of from a send buffer, such as mapped textures.
+struct PipePlane
+{
+    u8* ptr;
+    s32 row_size;
+    s32 rows;
+
+    // Rows are put together before they are written if this is not the same as the row size.
+    s32 pitch;
+};
+
+struct ThreadPipeData
+{
+    u8* ptr;
+    s32 size;
+
+    // If there are planes, these are written instead of the send buffer.
+    PipePlane planes[3];
+    s32 num_planes;
+
+    // How many frames of the movie this is. A repeated frame is only converted and put in a send buffer once,
+    // and the same data is written again.
+    s32 num_frames;
+
+    // Which part of the movie this is in when encoding in parts. Set when submitted.
+    s32 segment;
+
+    // Which slot of the spill file the frame is in, or -1 if it is in a send buffer. Set when acquired.
+    s32 spill_slot;
+
+    // Which buffer of the send buffer pool this is, or -1 if the memory is not in the pool.
+    // Buffers in the pool are only mapped between being acquired and submitted, and ptr is not valid after that.
+    s32 pool_slot;
+
+    // If the queue is compressed, ptr is the compressed frame in the pool and this is its size. Set when submitted.
+    s32 compressed_size;
+
+    // Blocks of the pool that are given back when the frame has been decompressed.
+    s32 compressed_blocks;
+
+    // The first frame is not the difference to the frame before.
+    bool compressed_keyframe;
+
+    // Called on the ffmpeg thread when the data has been written.
+    void(*written_fn)(void* user);
+    void* written_user;
+};
+
+// What the encoder needs to know about the movie.
+struct FfmpegStartData
+{
+    const char* resource_path; // SVR directory. This is where ffmpeg.exe is.
+    const char* movie_path;
+    MovieProfile* profile;
+    PxConv pxconv;
+    s32 width;
+    s32 height;
+    s32 frame_size; // Combined size of all planes in one converted frame.
+
+    // Every frame is submitted with planes, so the send buffers get no memory.
+    // They are still acquired and submitted to limit how many frames can be waiting.
+    bool planes_only;
+};
+
+// The pixel format to use for the encoder in the profile.
+PxConv calc_encoder_pxconv(MovieProfile* profile);
+
+// Builds the full path to a movie in the movies directory of SVR (and creates the directory).
+void build_movie_path(const char* resource_path, const char* dest, char* buf, s32 buf_size);
+
+// To be called once at proc init.
+void ffmpeg_init();
+
+bool ffmpeg_start(FfmpegStartData* data);
+
+// Waits for a free buffer to put a converted frame in. Every acquired buffer must be submitted.
+// If spilling is enabled and all buffers are in use, a view of the spill file is given instead of waiting.
+// The buffer can also be submitted with planes to write from other memory, the size must then still be the size of a frame.
+// The number of frames is 1 unless changed.
+void ffmpeg_acquire_send_buf(ThreadPipeData* pipe_data);
+
+// Queues a filled buffer to be sent to the ffmpeg process.
+// These two are called by one thread for the whole movie, which does not have to be the thread that starts and ends it.
+void ffmpeg_submit_send_buf(ThreadPipeData* pipe_data);
+
+void ffmpeg_give_audio(SvrWaveSample* samples, s32 num_samples);
+
+// Continues the movie in a new file, from the given frame of the movie on. This is how many frames have been given so far,
+// counting repeated frames. The ffmpeg process of the new file is started right away and the frames go to it when they get there,
+// so the new file starts with a keyframe. The file before is finished by its own process without being waited for.
+// Only possible when the movie is written by one ffmpeg process, and at least one frame must be given between two of these.
+// Returns false if the movie was not continued in a new file, the frames then keep going to the file before.
+bool ffmpeg_rotate_output(const char* movie_path, s64 start_frame);
+
+// Sends the remaining frames, waits for the ffmpeg processes to finish, and joins the parts if the movie was encoded in parts.
+// Unless disabled in the profile, this is done by a finalizer thread and the next movie can be started right away.
+// The finalizer owns the rest of the movie, so frames that were submitted with planes must have been written before this is called.
+// How fast frames were written and how often the encoder had to be waited for is shown when the movie has been finished,
+// and the trace is written then if the profile has trace_enabled.
+void ffmpeg_end();
+
+// Waits until at most this many movies are being finished in the background.
+void wait_for_finalizing_sessions(s32 max_finalizing);
+
+// Use of the send buffers in the movie that is being made.
+struct FfmpegBufStats
+{
+    s32 num_bufs;
+    s32 buf_size;
+
+    // Most buffers that were acquired and not yet written at the same time.
+    s32 peak_used_bufs;
+
+    // Most buffers that were mapped into the address space at the same time. All of them are when they are not in the pool.
+    s32 peak_mapped_bufs;
+};
+
+void ffmpeg_get_buf_stats(FfmpegBufStats* stats);
+
+// Times of the movie that is being made, in microseconds. This can be called while frames are being written.
+// Both are empty when no movie is being made.
+struct FfmpegLatency
+{
+    // Writing a frame to ffmpeg (or sending it to a worker, or writing it to the capture).
+    SvrHist write;
+
+    // Waiting for a send buffer when acquiring one.
+    SvrHist send_wait;
+};
+
+void ffmpeg_get_latency(FfmpegLatency* latency);
+
+// Counters of the movie that is being made, for svr_get_stats. This can be called while frames are being written.
+// All are 0 when no movie is being made.
+struct FfmpegStats
+{
+    // Counting repeated frames.
+    s64 frames_submitted;
+    s64 frames_written;
+
+    // Frames in the write queues of the lanes, and free send buffers in the read queues.
+    s32 write_queue_depth;
+    s32 read_queue_depth;
+
+    s64 audio_samples_written;
+};
+
+void ffmpeg_get_stats(FfmpegStats* stats);
+
+// The report of the movie that is being made, which the proc backend fills in its part of before ffmpeg_end (see game_proc_report.h).
+// The rest is filled in and the report is written when the movie has been finished. NULL when the report is not enabled in the profile.
+ProcReport* ffmpeg_get_report();
+
+// Shows the percentiles of a histogram in the log, if it has any times.
+void show_hist(const char* name, SvrHist* hist);
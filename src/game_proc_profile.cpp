@@ -225,6 +225,25 @@ bool read_profile(const char* full_profile_path, MovieProfile* p)
     SvrIniLine ini_line = svr_alloc_ini_line();
     SvrIniTokenType ini_token_type;
 
+    // Options that were added later and may not be in older profiles.
+    p->pipeline_depth = 4;
+    p->encoder_direct_writes = 1;
+    p->mosample_fixed_point = 0;
+    p->audio_bitrate = 320;
+    p->encoder_segments = 1;
+    p->encoder_segment_length = 2;
+    p->encoder_intermediate = 0;
+    p->encoder_spill_size = 0;
+    p->encoder_compressed_queue = 0;
+    p->encoder_buffer_size = 0;
+    p->encoder_max_finalizing = 1;
+    p->encoder_prewarm = 0;
+    p->encoder_workers[0] = 0;
+    p->encoder_workers_secret[0] = 0;
+    p->trace_enabled = 0;
+    p->profiling_enabled = 0;
+    p->report_enabled = 0;
+
     #define OPT_S32(NAME, VAR, MIN, MAX) (!strcmp(ini_line.title, NAME)) { VAR = atoi_in_range(&ini_line, MIN, MAX); }
     #define OPT_COLOR(NAME, VAR) (!strcmp(ini_line.title, NAME)) { make_color(&ini_line, VAR); }
     #define OPT_VEC2(NAME, VAR) (!strcmp(ini_line.title, NAME)) { make_vec2(&ini_line, VAR); }
@@ -243,6 +262,7 @@ bool read_profile(const char* full_profile_path, MovieProfile* p)
         else if OPT_S32("motion_blur_enabled", p->mosample_enabled, 0, 1)
         else if OPT_S32("motion_blur_fps_mult", p->mosample_mult, 2, INT32_MAX)
         else if OPT_FLOAT("motion_blur_exposure", p->mosample_exposure, 0.0f, 1.0f)
+        else if OPT_S32("motion_blur_fixed_point", p->mosample_fixed_point, 0, 1)
         else if OPT_S32("velo_enabled", p->veloc_enabled, 0, 1)
         else if OPT_STR("velo_font", p->veloc_font, MAX_VELOC_FONT_NAME)
         else if OPT_S32("velo_font_size", p->veloc_font_size, 16, 192)
@@ -253,6 +273,22 @@ bool read_profile(const char* full_profile_path, MovieProfile* p)
         else if OPT_STR_MAP("velo_font_weight", p->veloc_font_weight, FONT_WEIGHT_TABLE, DWRITE_FONT_WEIGHT_BOLD)
         else if OPT_VEC2("velo_align", p->veloc_align)
         else if OPT_S32("audio_enabled", p->audio_enabled, 0, 1)
+        else if OPT_S32("audio_bitrate", p->audio_bitrate, 64, 512)
+        else if OPT_S32("pipeline_depth", p->pipeline_depth, 1, MAX_PIPELINE_DEPTH)
+        else if OPT_S32("encoder_direct_writes", p->encoder_direct_writes, 0, 1)
+        else if OPT_S32("encoder_segments", p->encoder_segments, 1, MAX_ENCODER_SEGMENTS)
+        else if OPT_S32("encoder_segment_length", p->encoder_segment_length, 1, 60)
+        else if OPT_S32("encoder_intermediate", p->encoder_intermediate, 0, 1)
+        else if OPT_S32("encoder_spill_size", p->encoder_spill_size, 0, 65536)
+        else if OPT_S32("encoder_compressed_queue", p->encoder_compressed_queue, 0, 2048)
+        else if OPT_S32("encoder_buffer_size", p->encoder_buffer_size, 0, 16384)
+        else if OPT_S32("encoder_max_finalizing", p->encoder_max_finalizing, 0, MAX_FINALIZING_MOVIES)
+        else if OPT_S32("encoder_prewarm", p->encoder_prewarm, 0, MAX_WARM_ENCODERS)
+        else if OPT_STR("encoder_workers", p->encoder_workers, MAX_ENCODER_WORKERS_LENGTH)
+        else if OPT_STR("encoder_workers_secret", p->encoder_workers_secret, MAX_ENCODER_WORKERS_SECRET_LENGTH)
+        else if OPT_S32("trace_enabled", p->trace_enabled, 0, 1)
+        else if OPT_S32("profiling_enabled", p->profiling_enabled, 0, 1)
+        else if OPT_S32("report_enabled", p->report_enabled, 0, 1)
     }
 
     svr_free_ini_line(&ini_line);
@@ -268,3 +304,20 @@ bool read_profile(const char* full_profile_path, MovieProfile* p)
 
     return true;
 }
+
+bool read_profile_by_name(const char* resource_path, const char* name, MovieProfile* p)
+{
+    if (*name == 0)
+    {
+        name = "default";
+    }
+
+    char full_profile_path[MAX_PATH];
+    full_profile_path[0] = 0;
+    StringCchCatA(full_profile_path, MAX_PATH, resource_path);
+    StringCchCatA(full_profile_path, MAX_PATH, "\\data\\profiles\\");
+    StringCchCatA(full_profile_path, MAX_PATH, name);
+    StringCchCatA(full_profile_path, MAX_PATH, ".ini");
+
+    return read_profile(full_profile_path, p);
+}
@@ -2,6 +2,12 @@
 #include "svr_common.h"
 
 const s32 MAX_VELOC_FONT_NAME = 128;
+const s32 MAX_PIPELINE_DEPTH = 16;
+const s32 MAX_ENCODER_SEGMENTS = 16;
+const s32 MAX_FINALIZING_MOVIES = 4;
+const s32 MAX_WARM_ENCODERS = 4;
+const s32 MAX_ENCODER_WORKERS_LENGTH = 512;
+const s32 MAX_ENCODER_WORKERS_SECRET_LENGTH = 128;
 
 struct MovieProfile
 {
@@ -17,6 +23,7 @@ struct MovieProfile
     s32 mosample_enabled;
     s32 mosample_mult;
     float mosample_exposure;
+    s32 mosample_fixed_point;
 
     // Veloc:
     s32 veloc_enabled;
@@ -31,6 +38,27 @@ struct MovieProfile
 
     // Audio:
     s32 audio_enabled;
+    s32 audio_bitrate;
+
+    // Pipeline:
+    s32 pipeline_depth;
+    s32 encoder_direct_writes;
+    s32 encoder_segments;
+    s32 encoder_segment_length;
+    s32 encoder_intermediate;
+    s32 encoder_spill_size;
+    s32 encoder_compressed_queue;
+    s32 encoder_buffer_size;
+    s32 encoder_max_finalizing;
+    s32 encoder_prewarm;
+    char encoder_workers[MAX_ENCODER_WORKERS_LENGTH];
+    char encoder_workers_secret[MAX_ENCODER_WORKERS_SECRET_LENGTH];
+    s32 trace_enabled;
+    s32 profiling_enabled;
+    s32 report_enabled;
 };
 
 bool read_profile(const char* full_profile_path, MovieProfile* p);
+
+// Reads a profile from the profiles directory in SVR. An empty name selects the default profile.
+bool read_profile_by_name(const char* resource_path, const char* name, MovieProfile* p);
@@ -0,0 +1,302 @@
+#include "game_proc_report.h"
+#include "game_proc_profile.h"
+#include <Windows.h>
+#include <strsafe.h>
+#include <malloc.h>
+#include <string.h>
+#include <stb_sprintf.h>
+
+// Share of the time that the game thread has to wait for the pipeline for the pipeline to be what limited the movie.
+const double REPORT_WAIT_SHARE = 0.1;
+
+// Share of the cores that the encoder processes have to use for the encoder to be the slowest.
+// The encoder does not use every core all of the time even when it cannot keep up, as the game and SVR use some of them.
+const double REPORT_ENCODER_CPU_SHARE = 0.5;
+
+// Names in the report. Must be synchronized with ProcBottleneck.
+const char* PROC_BOTTLENECK_NAMES[] = {
+    "game",
+    "readback",
+    "conversion",
+    "pipe",
+    "encoder",
+};
+
+double calc_report_share(s64 part, s64 whole)
+{
+    return whole > 0 ? (double)part / (double)whole : 0.0;
+}
+
+const char* get_proc_bottleneck_name(ProcBottleneck bottleneck)
+{
+    return PROC_BOTTLENECK_NAMES[bottleneck];
+}
+
+// When the game thread waits, something after it in the pipeline is slower. The step that puts the frames in the send buffers waits for one
+// when the encoder side cannot keep up, so if that is not what held the game thread back, the steps in between were the slowest.
+// The encoder side is slow both when the encoder is and when getting the frames to it is. For ffmpeg here that is told apart by how much
+// of the CPU ffmpeg used, and for the encode workers by how much of the time was spent waiting for them to have room.
+// With direct writes the download slots take the place of the send buffers, as a slot is held until the encoder side has written its frame.
+ProcBottleneck classify_proc_bottleneck(ProcReport* report, char* reason, s32 reason_size)
+{
+    s64 game_wait = report->readback_wait.total + report->queue_wait.total;
+    double game_wait_share = calc_report_share(game_wait, report->duration);
+
+    if (game_wait_share < REPORT_WAIT_SHARE)
+    {
+        StringCchPrintfA(reason, reason_size, "The game thread only waited for the pipeline %0.1f%% of the time", game_wait_share * 100.0);
+        return PROC_BOTTLENECK_GAME;
+    }
+
+    if (report->readback_wait.total * 2 >= game_wait)
+    {
+        double readback_share = calc_report_share(report->readback_wait.total, game_wait);
+        StringCchPrintfA(reason, reason_size, "The game thread waited for the pipeline %0.1f%% of the time, and %0.1f%% of that was for the GPU to be done with the downloads", game_wait_share * 100.0, readback_share * 100.0);
+        return PROC_BOTTLENECK_READBACK;
+    }
+
+    s64 send_wait = report->send_wait.total;
+    const char* send_wait_name = "a send buffer";
+
+    if (report->direct_writes)
+    {
+        send_wait += report->slot_wait.total;
+        send_wait_name = "a send buffer or a download slot being written";
+    }
+
+    // This can be more than the game thread waited, as the steps in between have their own buffers.
+    double send_wait_share = calc_report_share(send_wait, game_wait);
+
+    if (send_wait_share < 0.5)
+    {
+        StringCchPrintfA(reason, reason_size, "The game thread waited for the pipeline %0.1f%% of the time, but %s was only waited for %0.1f%% as long", game_wait_share * 100.0, send_wait_name, send_wait_share * 100.0);
+        return PROC_BOTTLENECK_CONVERSION;
+    }
+
+    if (!strcmp(report->output, "workers"))
+    {
+        double credit_share = calc_report_share(report->credit_wait_time, report->write.total + report->credit_wait_time);
+
+        if (credit_share >= 0.5)
+        {
+            StringCchPrintfA(reason, reason_size, "Waiting for %s was %0.1f%% as long as the game thread waited, and %0.1f%% of the time getting frames to the encode workers was waiting for them to have room", send_wait_name, send_wait_share * 100.0, credit_share * 100.0);
+            return PROC_BOTTLENECK_ENCODER;
+        }
+
+        StringCchPrintfA(reason, reason_size, "Waiting for %s was %0.1f%% as long as the game thread waited, and %0.1f%% of the time getting frames to the encode workers was sending them", send_wait_name, send_wait_share * 100.0, (1.0 - credit_share) * 100.0);
+        return PROC_BOTTLENECK_PIPE;
+    }
+
+    if (!strcmp(report->output, "capture"))
+    {
+        StringCchPrintfA(reason, reason_size, "Waiting for %s was %0.1f%% as long as the game thread waited, and the frames are written to an intermediate capture", send_wait_name, send_wait_share * 100.0);
+        return PROC_BOTTLENECK_PIPE;
+    }
+
+    double cpu_share = calc_report_share(report->encoder_cpu_time, report->output_duration * report->num_cpus);
+
+    if (cpu_share >= REPORT_ENCODER_CPU_SHARE)
+    {
+        StringCchPrintfA(reason, reason_size, "Waiting for %s was %0.1f%% as long as the game thread waited, and ffmpeg used %0.1f%% of the CPU", send_wait_name, send_wait_share * 100.0, cpu_share * 100.0);
+        return PROC_BOTTLENECK_ENCODER;
+    }
+
+    StringCchPrintfA(reason, reason_size, "Waiting for %s was %0.1f%% as long as the game thread waited, but ffmpeg only used %0.1f%% of the CPU", send_wait_name, send_wait_share * 100.0, cpu_share * 100.0);
+    return PROC_BOTTLENECK_PIPE;
+}
+
+// -------------------------------------------------
+
+// The report is put together in this and written at the end.
+struct ReportWriter
+{
+    char* buf;
+    s32 used;
+    s32 size;
+
+    bool failed;
+};
+
+void report_write(ReportWriter* w, const char* format, ...)
+{
+    va_list va;
+    va_start(va, format);
+
+    s32 left = w->size - w->used;
+    s32 len = stbsp_vsnprintf(w->buf + w->used, left, format, va);
+
+    va_end(va);
+
+    if (len >= left)
+    {
+        w->failed = true;
+        return;
+    }
+
+    w->used += len;
+}
+
+// Paths have backslashes that must be escaped.
+void report_write_string(ReportWriter* w, const char* name, const char* value)
+{
+    report_write(w, "\"%s\": \"", name);
+
+    for (const char* c = value; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            report_write(w, "\\%c", *c);
+        }
+
+        else if ((u8)*c < 0x20)
+        {
+            report_write(w, "\\u%04x", (u8)*c);
+        }
+
+        else
+        {
+            report_write(w, "%c", *c);
+        }
+    }
+
+    report_write(w, "\"");
+}
+
+void report_write_hist(ReportWriter* w, const char* name, SvrHist* hist, bool last)
+{
+    SvrHistStats stats;
+    svr_calc_hist_stats(hist, &stats);
+
+    report_write(w, "    \"%s\": { \"count\": %lld, \"total_us\": %lld, \"mean_us\": %lld, \"p50_us\": %lld, \"p90_us\": %lld, \"p99_us\": %lld, \"p999_us\": %lld, \"max_us\": %lld }%s\n",
+                 name, stats.count, hist->total, stats.mean, stats.p50, stats.p90, stats.p99, stats.p999, stats.max, last ? "" : ",");
+}
+
+bool write_proc_report(const char* path, const char* movie_path, MovieProfile* profile, ProcReport* report, ProcBottleneck bottleneck, const char* reason)
+{
+    const s32 REPORT_BUF_SIZE = 256 * 1024;
+
+    // Prof time is in microseconds.
+    double output_secs = (double)report->output_duration / 1000000.0;
+    double encoder_fps = output_secs > 0.0 ? (double)report->frames_written / output_secs : 0.0;
+    double write_mb_per_sec = output_secs > 0.0 ? ((double)report->bytes_written / (1024.0 * 1024.0)) / output_secs : 0.0;
+
+    ReportWriter w = {};
+    w.buf = (char*)malloc(REPORT_BUF_SIZE);
+    w.size = REPORT_BUF_SIZE;
+
+    report_write(&w, "{\n");
+
+    report_write(&w, "  ");
+    report_write_string(&w, "movie", movie_path);
+    report_write(&w, ",\n");
+
+    report_write(&w, "  \"bottleneck\": \"%s\",\n", get_proc_bottleneck_name(bottleneck));
+
+    report_write(&w, "  ");
+    report_write_string(&w, "bottleneck_reason", reason);
+    report_write(&w, ",\n");
+
+    report_write(&w, "  \"settings\": {\n");
+    report_write(&w, "    \"backend\": \"%s\",\n", report->backend);
+    report_write(&w, "    \"width\": %d,\n", report->width);
+    report_write(&w, "    \"height\": %d,\n", report->height);
+    report_write(&w, "    \"video_fps\": %d,\n", profile->movie_fps);
+    report_write(&w, "    \"video_encoder\": \"%s\",\n", profile->sw_encoder);
+    report_write(&w, "    \"video_x264_crf\": %d,\n", profile->sw_crf);
+    report_write(&w, "    \"video_x264_preset\": \"%s\",\n", profile->sw_x264_preset);
+    report_write(&w, "    \"video_x264_intra\": %d,\n", profile->sw_x264_intra);
+    report_write(&w, "    \"motion_blur_enabled\": %d,\n", profile->mosample_enabled);
+    report_write(&w, "    \"motion_blur_fps_mult\": %d,\n", profile->mosample_mult);
+    report_write(&w, "    \"motion_blur_exposure\": %0.3f,\n", profile->mosample_exposure);
+    report_write(&w, "    \"motion_blur_fixed_point\": %d,\n", profile->mosample_fixed_point);
+    report_write(&w, "    \"audio_enabled\": %d,\n", profile->audio_enabled);
+    report_write(&w, "    \"pipeline_depth\": %d,\n", profile->pipeline_depth);
+    report_write(&w, "    \"encoder_segments\": %d,\n", profile->encoder_segments);
+    report_write(&w, "    \"encoder_segment_length\": %d,\n", profile->encoder_segment_length);
+    report_write(&w, "    \"encoder_intermediate\": %d,\n", profile->encoder_intermediate);
+    report_write(&w, "    \"encoder_spill_size\": %d,\n", profile->encoder_spill_size);
+    report_write(&w, "    \"encoder_compressed_queue\": %d,\n", profile->encoder_compressed_queue);
+    report_write(&w, "    \"encoder_buffer_size\": %d,\n", profile->encoder_buffer_size);
+    report_write(&w, "    \"output\": \"%s\",\n", report->output);
+    report_write(&w, "    \"direct_writes\": %d,\n", report->direct_writes);
+    report_write(&w, "    \"encoder_lanes\": %d\n", report->num_lanes);
+    report_write(&w, "  },\n");
+
+    report_write(&w, "  \"frames\": {\n");
+    report_write(&w, "    \"submitted\": %lld,\n", report->frames_submitted);
+    report_write(&w, "    \"written\": %lld,\n", report->frames_written);
+    report_write(&w, "    \"subframes_accumulated\": %lld,\n", report->subframes);
+    report_write(&w, "    \"audio_samples_written\": %lld\n", report->audio_samples_written);
+    report_write(&w, "  },\n");
+
+    report_write(&w, "  \"duration_us\": %lld,\n", report->duration);
+    report_write(&w, "  \"output_duration_us\": %lld,\n", report->output_duration);
+
+    report_write(&w, "  \"encoder\": {\n");
+    report_write(&w, "    \"fps\": %0.2f,\n", encoder_fps);
+    report_write(&w, "    \"bytes_written\": %lld,\n", report->bytes_written);
+    report_write(&w, "    \"write_mb_per_sec\": %0.1f,\n", write_mb_per_sec);
+    report_write(&w, "    \"cpu_time_us\": %lld,\n", report->encoder_cpu_time);
+    report_write(&w, "    \"num_cpus\": %d\n", report->num_cpus);
+    report_write(&w, "  },\n");
+
+    report_write(&w, "  \"times\": {\n");
+    report_write_hist(&w, "frame", &report->frame, false);
+    report_write_hist(&w, "mosample", &report->mosample, false);
+    report_write_hist(&w, "pxconv", &report->pxconv, false);
+    report_write_hist(&w, "download", &report->download, false);
+    report_write_hist(&w, "readback_wait", &report->readback_wait, false);
+    report_write_hist(&w, "queue_wait", &report->queue_wait, false);
+    report_write_hist(&w, "slot_wait", &report->slot_wait, false);
+    report_write_hist(&w, "send_wait", &report->send_wait, false);
+    report_write_hist(&w, "write", &report->write, true);
+    report_write(&w, "  },\n");
+
+    report_write(&w, "  \"stalls\": {\n");
+    report_write(&w, "    \"game_wait_us\": %lld,\n", report->readback_wait.total + report->queue_wait.total);
+    report_write(&w, "    \"send_buffer_stalls\": %lld,\n", report->num_stalls);
+    report_write(&w, "    \"send_buffer_wait_us\": %lld,\n", report->send_wait.total);
+    report_write(&w, "    \"spilled_frames\": %lld,\n", report->spill_frames);
+    report_write(&w, "    \"spill_peak_slots\": %d,\n", report->spill_peak_slots);
+    report_write(&w, "    \"worker_credit_waits\": %lld,\n", report->credit_waits);
+    report_write(&w, "    \"worker_credit_wait_us\": %lld,\n", report->credit_wait_time);
+    report_write(&w, "    \"part_switch_us\": %lld\n", report->part_switch_time);
+    report_write(&w, "  },\n");
+
+    // Samples are written as [time, write depth, read depth] to keep the file small.
+    report_write(&w, "  \"queues\": {\n");
+    report_write(&w, "    \"send_buffers\": %d,\n", report->num_send_bufs);
+    report_write(&w, "    \"peak_send_buffers_used\": %d,\n", report->peak_send_bufs);
+    report_write(&w, "    \"sample_interval_us\": %lld,\n", report->queue_sample_interval);
+    report_write(&w, "    \"sample_fields\": [\"time_us\", \"write_queue_depth\", \"read_queue_depth\"],\n");
+    report_write(&w, "    \"samples\": [");
+
+    for (s32 i = 0; i < report->num_queue_samples; i++)
+    {
+        ProcQueueSample* sample = &report->queue_samples[i];
+        report_write(&w, "%s\n      [%lld, %d, %d]", i > 0 ? "," : "", sample->time, sample->write_depth, sample->read_depth);
+    }
+
+    report_write(&w, "\n    ]\n");
+    report_write(&w, "  }\n");
+    report_write(&w, "}\n");
+
+    bool ret = false;
+
+    if (!w.failed)
+    {
+        HANDLE file = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            DWORD written;
+            ret = WriteFile(file, w.buf, w.used, &written, NULL);
+
+            CloseHandle(file);
+        }
+    }
+
+    free(w.buf);
+
+    return ret;
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include "svr_common.h"
+#include "svr_hist.h"
+
+// Report of a movie that is written next to it as JSON when the movie has been finished (see report_enabled in the profile).
+// This has the settings of the movie, the times of every step, how full the queues were over the movie, how often and how long
+// the pipeline had to wait, how fast the encoder was, and what the movie was waiting for the most (see ProcBottleneck).
+// The proc backend fills in its part when the movie ends, and the encoder side fills in the rest when the movie has been finished.
+
+struct MovieProfile;
+
+// What limited how fast the movie was made, decided from where the time was spent waiting.
+enum ProcBottleneck
+{
+    // The game thread rarely had to wait for the pipeline, so the game itself was the slowest.
+    PROC_BOTTLENECK_GAME,
+
+    // The game thread waited for the GPU to be done with the downloads of the frames.
+    PROC_BOTTLENECK_READBACK,
+
+    // The game thread waited for the pipeline while the encoder side was rarely waited for, so the steps between them
+    // (motion sampling, pixel conversion or putting the frames in the send buffers) were the slowest.
+    PROC_BOTTLENECK_CONVERSION,
+
+    // The encoder side was busy with getting the frames out (through the pipe, over the network to the encode workers,
+    // or into an intermediate capture) while the encoder itself had time left.
+    PROC_BOTTLENECK_PIPE,
+
+    // The encoder could not keep up.
+    PROC_BOTTLENECK_ENCODER,
+};
+
+// The queues between the game and the encoder at a time of the movie.
+struct ProcQueueSample
+{
+    // Since the movie was started, in microseconds.
+    s64 time;
+
+    // Frames waiting to be written to the encoder, and send buffers that are free.
+    s32 write_depth;
+    s32 read_depth;
+};
+
+// The queues are sampled at most this many times. When there is no room left, every other sample is dropped and they are taken
+// half as often from then on, so a movie of any length fits.
+const s32 MAX_REPORT_QUEUE_SAMPLES = 512;
+
+// Time between the queue samples at the start of the movie, in microseconds.
+const s64 REPORT_QUEUE_SAMPLE_INTERVAL = 100000;
+
+// Times are in microseconds.
+struct ProcReport
+{
+    // -------------------------------------------------
+    // Filled in by the proc backend when the movie ends.
+
+    // GPU or CPU.
+    const char* backend;
+
+    s32 width;
+    s32 height;
+
+    // Samples of game frames that were added into frames of the movie with motion blur.
+    s64 subframes;
+
+    SvrHist frame;
+    SvrHist mosample;
+    SvrHist pxconv;
+    SvrHist download;
+
+    // Time the game thread waited for the GPU to be done with a download. Only on the GPU.
+    SvrHist readback_wait;
+
+    // Time the game thread waited for room in the next step of the pipeline.
+    SvrHist queue_wait;
+
+    // The part of the queue wait that was for a download slot to be given back. Only on the GPU.
+    SvrHist slot_wait;
+
+    // -------------------------------------------------
+    // Filled in by the encoder side.
+
+    // pipe, workers or capture.
+    const char* output;
+    s32 num_lanes;
+
+    // The frames were written to the encoder straight from the download slots, so a slot is only given back when its frame has been written.
+    bool direct_writes;
+
+    // From when the movie was started until it ended, and until the last frame had been written.
+    s64 duration;
+    s64 output_duration;
+
+    // Counting repeated frames.
+    s64 frames_submitted;
+    s64 frames_written;
+    s64 bytes_written;
+    s64 audio_samples_written;
+
+    // Writing the frames, and waiting for a send buffer (which is done by the step before the encoder side).
+    SvrHist write;
+    SvrHist send_wait;
+
+    s32 num_send_bufs;
+    s32 peak_send_bufs;
+    s64 num_stalls;
+    s64 spill_frames;
+    s32 spill_peak_slots;
+
+    // Waiting for the encode workers to have room for a frame.
+    s64 credit_waits;
+    s64 credit_wait_time;
+
+    // Finishing the process of a part and starting the next one when encoding in parts here.
+    s64 part_switch_time;
+
+    // CPU time of the encoder processes here, or -1 if they are not here.
+    s64 encoder_cpu_time;
+    s32 num_cpus;
+
+    ProcQueueSample queue_samples[MAX_REPORT_QUEUE_SAMPLES];
+    s32 num_queue_samples;
+    s64 queue_sample_interval;
+};
+
+// Decides what limited the movie, and writes why in the reason.
+ProcBottleneck classify_proc_bottleneck(ProcReport* report, char* reason, s32 reason_size);
+
+const char* get_proc_bottleneck_name(ProcBottleneck bottleneck);
+
+// Writes the report to the path as JSON, with what limited the movie as given by classify_proc_bottleneck. Returns false if it could not be written.
+bool write_proc_report(const char* path, const char* movie_path, MovieProfile* profile, ProcReport* report, ProcBottleneck bottleneck, const char* reason);
@@ -27,6 +27,12 @@ void game_console_msg(const char* format, ...)
 
 void game_console_msg_v(const char* format, va_list va)
 {
+    // There is no game console when running headless.
+    if (console_msg_fn == NULL)
+    {
+        return;
+    }
+
     char buf[1024];
     stbsp_vsnprintf(buf, 1024, format, va);
 
@@ -345,6 +345,8 @@ FnHook snd_tx_stereo_hook;
 FnHook snd_mix_chans_hook;
 FnHook snd_device_tx_hook;
 
+FnHook exit_process_hook;
+
 bool snd_is_painting;
 bool snd_listener_underwater;
 
@@ -1056,6 +1058,25 @@ void end_the_movie()
     run_user_cfgs_for_event("end");
 }
 
+void WINAPI exit_process_override(UINT exit_code)
+{
+    // Movies may still be finished in the background, and these threads would be ended by the original function.
+
+    if (svr_movie_active())
+    {
+        game_log("Game exited while making a movie, the movie will not be finished\n");
+    }
+
+    else
+    {
+        svr_shutdown();
+    }
+
+    using ExitProcessFn = void(WINAPI*)(UINT exit_code);
+    ExitProcessFn org_fn = (ExitProcessFn)exit_process_hook.original;
+    org_fn(exit_code);
+}
+
 void __cdecl end_movie_override(void* args)
 {
     // We don't want to call the original function for this command.
@@ -1608,6 +1629,12 @@ void create_game_hooks()
         hook_function(get_snd_tx_stereo_override(), &snd_tx_stereo_hook);
     }
 
+    // The game quits by ending the process, which would end the threads that finish movies in the background.
+    FnOverride exit_ov;
+    exit_ov.target = GetProcAddress(GetModuleHandleA("kernel32.dll"), "ExitProcess");
+    exit_ov.hook = exit_process_override;
+    hook_function(exit_ov, &exit_process_hook);
+
     // Hooking the D3D9Ex present function to skip presenting is not worthwhile as it does not improve the game frame time.
 
     patch_cvar_restrict();
@@ -1650,6 +1677,12 @@ DWORD WINAPI standalone_init_async(void* param)
         enable_autostop = false;
     }
 
+    if (strstr(start_args, "-svrprof"))
+    {
+        svr_log("Profiling is enabled for all movies\n");
+        svr_prof_launch_enabled = true;
+    }
+
     MH_Initialize();
 
     create_game_hooks();
@@ -1662,6 +1695,8 @@ DWORD WINAPI standalone_init_async(void* param)
 
     svr_init_prof();
 
+    svr_log("Using %s for profiling\n", svr_prof_get_clock_name());
+
     // It's useful to show that we have loaded when in standalone mode.
     // This message may not be the latest message but at least it's in there.
 
@@ -0,0 +1,136 @@
+#include "headless_gpu.h"
+#include "game_proc.h"
+#include "game_shared.h"
+#include <d3d11.h>
+#include <stdio.h>
+
+// Shader backend for svr_headless.exe.
+
+ID3D11Device* gpu_device;
+ID3D11DeviceContext* gpu_context;
+
+// Stands in for the game content, which is where the game would have rendered the frame.
+ID3D11Texture2D* gpu_content_tex;
+ID3D11ShaderResourceView* gpu_content_srv;
+ID3D11RenderTargetView* gpu_content_rtv;
+
+bool create_gpu_device(D3D_DRIVER_TYPE type)
+{
+    // Same as what svr_init creates for D3D9Ex games.
+    UINT device_create_flags = D3D11_CREATE_DEVICE_SINGLETHREADED | D3D11_CREATE_DEVICE_BGRA_SUPPORT;
+
+    const D3D_FEATURE_LEVEL DEVICE_LEVELS[] = {
+        D3D_FEATURE_LEVEL_11_0
+    };
+
+    D3D_FEATURE_LEVEL created_device_level;
+
+    HRESULT hr = D3D11CreateDevice(NULL, type, NULL, device_create_flags, DEVICE_LEVELS, 1, D3D11_SDK_VERSION, &gpu_device, &created_device_level, &gpu_context);
+
+    if (FAILED(hr))
+    {
+        printf("Could not create %s D3D11 device (%#x)\n", type == D3D_DRIVER_TYPE_WARP ? "a WARP" : "a hardware", hr);
+        return false;
+    }
+
+    return true;
+}
+
+bool headless_gpu_init(const char* resource_path)
+{
+    if (!create_gpu_device(D3D_DRIVER_TYPE_HARDWARE))
+    {
+        if (!create_gpu_device(D3D_DRIVER_TYPE_WARP))
+        {
+            return false;
+        }
+
+        printf("Using WARP for the shaders\n");
+    }
+
+    return proc_init(resource_path, gpu_device);
+}
+
+void free_gpu_content()
+{
+    if (gpu_content_rtv) gpu_content_rtv->Release();
+    if (gpu_content_srv) gpu_content_srv->Release();
+    if (gpu_content_tex) gpu_content_tex->Release();
+
+    gpu_content_rtv = NULL;
+    gpu_content_srv = NULL;
+    gpu_content_tex = NULL;
+}
+
+bool headless_gpu_start(const char* dest, const char* profile, s32 width, s32 height)
+{
+    bool ret = false;
+    HRESULT hr;
+
+    D3D11_TEXTURE2D_DESC tex_desc = {};
+    tex_desc.Width = width;
+    tex_desc.Height = height;
+    tex_desc.MipLevels = 1;
+    tex_desc.ArraySize = 1;
+    tex_desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    tex_desc.SampleDesc.Count = 1;
+    tex_desc.Usage = D3D11_USAGE_DEFAULT;
+    tex_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+
+    hr = gpu_device->CreateTexture2D(&tex_desc, NULL, &gpu_content_tex);
+
+    if (FAILED(hr))
+    {
+        printf("Could not create the content texture (%#x)\n", hr);
+        goto rfail;
+    }
+
+    gpu_device->CreateShaderResourceView(gpu_content_tex, NULL, &gpu_content_srv);
+    gpu_device->CreateRenderTargetView(gpu_content_tex, NULL, &gpu_content_rtv);
+
+    if (!proc_start(gpu_device, gpu_context, dest, profile, gpu_content_srv))
+    {
+        goto rfail;
+    }
+
+    ret = true;
+    goto rexit;
+
+rfail:
+    free_gpu_content();
+
+rexit:
+    return ret;
+}
+
+void headless_gpu_frame(const u8* bgra, s32 pitch)
+{
+    gpu_context->UpdateSubresource(gpu_content_tex, 0, NULL, bgra, pitch, 0);
+    proc_frame(gpu_context, gpu_content_srv, gpu_content_rtv);
+}
+
+s32 headless_gpu_next_frame_needed()
+{
+    return proc_next_frame_needed();
+}
+
+void headless_gpu_give_audio(SvrWaveSample* samples, s32 num_samples)
+{
+    proc_give_audio(samples, num_samples);
+}
+
+bool headless_gpu_rotate_output(const char* dest)
+{
+    return proc_rotate_output(gpu_context, dest);
+}
+
+void headless_gpu_end()
+{
+    proc_end(gpu_context);
+    free_gpu_content();
+}
+
+s32 headless_gpu_get_game_rate()
+{
+    return proc_get_game_rate();
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "svr_common.h"
+
+// The shader backend (game_proc) for svr_headless.exe.
+// Frames come from system memory like with game_proc_cpu, and are put in a texture on a D3D11 device of our own that stands in for the game content.
+// A hardware device is used when there is one, otherwise WARP.
+
+struct SvrWaveSample;
+
+bool headless_gpu_init(const char* resource_path);
+bool headless_gpu_start(const char* dest, const char* profile, s32 width, s32 height);
+
+// Frames must be BGRA8 and of the same size that was given when starting. The pitch is in bytes.
+void headless_gpu_frame(const u8* bgra, s32 pitch);
+
+s32 headless_gpu_next_frame_needed();
+void headless_gpu_give_audio(SvrWaveSample* samples, s32 num_samples);
+bool headless_gpu_rotate_output(const char* dest);
+void headless_gpu_end();
+s32 headless_gpu_get_game_rate();
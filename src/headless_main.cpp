@@ -0,0 +1,1083 @@
+#include "svr_common.h"
+#include "svr_logging.h"
+#include "svr_prof.h"
+#include "svr_api.h"
+#include "game_proc_cpu.h"
+#include "game_proc_ffmpeg.h"
+#include "headless_gpu.h"
+#include "svr_pxconv.h"
+#include "svr_mosample.h"
+#include <Windows.h>
+#include <strsafe.h>
+#include <Shlwapi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+
+// Headless driver (svr_headless.exe).
+// Runs movies through the processing without a game, with frames that are made up here. This can use the CPU backend (game_proc_cpu)
+// or the shaders (game_proc) on a D3D11 device of our own, so the two can be compared byte for byte.
+// Put next to svr_game.dll in the SVR directory, as data\shaders, data\profiles, ffmpeg.exe and svr_encoder.exe are taken from there.
+//
+// svr_headless.exe run <movie> [options]
+// svr_headless.exe compare <movie> [options]
+// svr_headless.exe diff <file> <file>
+// svr_headless.exe selftest [--bench]
+//
+// Movies are made in a directory of their own (headless or headless_standin next to this), with its own log and profile.
+//
+// When this exe is named ffmpeg.exe it is a stand-in for ffmpeg instead, which writes the raw video that it gets to the output
+// without encoding it, so the frames that were made can be compared. Video from a concat list is joined the same way, and the audio
+// (the second input) is written next to the output with .aud added. With --standin, a copy of this is used as ffmpeg.exe.
+
+// Name of the profile that is made in the work directory from the given profile and the changes to it.
+const char* HEADLESS_PROFILE_NAME = "svr_headless";
+
+const s32 HEADLESS_MAX_PROFILE_CHANGES = 64;
+const s32 HEADLESS_AUDIO_RATE = 44100;
+
+struct HeadlessOpts
+{
+    bool use_gpu;
+    const char* profile;
+    const char* profile_changes[HEADLESS_MAX_PROFILE_CHANGES];
+    s32 num_profile_changes;
+    s32 width;
+    s32 height;
+    s64 frames;
+    bool skip;
+    bool audio;
+    s32 rotate;
+    s32 movies;
+    bool standin;
+    s32 standin_delay;
+    s32 standin_rate;
+};
+
+// The two backends are driven the same way.
+struct HeadlessBackend
+{
+    const char* name;
+    bool(*init)(const char* resource_path);
+    bool(*start)(const char* dest, const char* profile, s32 width, s32 height);
+    void(*frame)(const u8* bgra, s32 pitch);
+    s32(*next_frame_needed)();
+    void(*give_audio)(SvrWaveSample* samples, s32 num_samples);
+    bool(*rotate_output)(const char* dest);
+    void(*end)();
+    s32(*get_game_rate)();
+};
+
+const HeadlessBackend CPU_BACKEND = {
+    "CPU",
+    proc_cpu_init,
+    proc_cpu_start,
+    proc_cpu_frame,
+    proc_cpu_next_frame_needed,
+    proc_cpu_give_audio,
+    proc_cpu_rotate_output,
+    proc_cpu_end,
+    proc_cpu_get_game_rate,
+};
+
+const HeadlessBackend GPU_BACKEND = {
+    "shader",
+    headless_gpu_init,
+    headless_gpu_start,
+    headless_gpu_frame,
+    headless_gpu_next_frame_needed,
+    headless_gpu_give_audio,
+    headless_gpu_rotate_output,
+    headless_gpu_end,
+    headless_gpu_get_game_rate,
+};
+
+char headless_exe_dir[MAX_PATH];
+char headless_work_dir[MAX_PATH];
+
+// -------------------------------------------------
+// Stand-in ffmpeg.
+
+struct StandinAudio
+{
+    char path[MAX_PATH];
+    char dest[MAX_PATH];
+};
+
+// Reads and writes until the input ends. Writing can be made slower to act like an encoder that cannot keep up.
+bool standin_copy(HANDLE in, HANDLE out, s32 rate)
+{
+    const s32 BUF_SIZE = 1024 * 64;
+
+    u8* buf = (u8*)malloc(BUF_SIZE);
+
+    if (buf == NULL)
+    {
+        return false;
+    }
+
+    bool ret = true;
+    s64 total = 0;
+    u64 start_time = GetTickCount64();
+
+    while (true)
+    {
+        DWORD read;
+
+        if (!ReadFile(in, buf, BUF_SIZE, &read, NULL) || read == 0)
+        {
+            break;
+        }
+
+        if (!WriteFile(out, buf, read, NULL, NULL))
+        {
+            ret = false;
+            break;
+        }
+
+        total += read;
+
+        // The rate is in kilobytes per millisecond.
+        if (rate > 0)
+        {
+            s64 due = total / (rate * 1024LL);
+            s64 taken = (s64)(GetTickCount64() - start_time);
+
+            if (due > taken)
+            {
+                Sleep((DWORD)(due - taken));
+            }
+        }
+    }
+
+    free(buf);
+
+    return ret;
+}
+
+// The audio pipe is made by the game before we are started, but the other end is opened here like ffmpeg does.
+DWORD WINAPI standin_audio_proc(LPVOID lpParameter)
+{
+    StandinAudio* audio = (StandinAudio*)lpParameter;
+
+    HANDLE in = CreateFileA(audio->path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+
+    // The pipe can be busy for a moment.
+    for (s32 i = 0; i < 100 && in == INVALID_HANDLE_VALUE && GetLastError() == ERROR_PIPE_BUSY; i++)
+    {
+        WaitNamedPipeA(audio->path, 100);
+        in = CreateFileA(audio->path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    }
+
+    if (in == INVALID_HANDLE_VALUE)
+    {
+        return 1;
+    }
+
+    HANDLE out = CreateFileA(audio->dest, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (out == INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(in);
+        return 1;
+    }
+
+    bool res = standin_copy(in, out, 0);
+
+    CloseHandle(out);
+    CloseHandle(in);
+
+    return res ? 0 : 1;
+}
+
+// Appends every file in a list that was made by svr_write_part_list.
+bool standin_concat(const char* list_path, HANDLE out)
+{
+    bool ret = false;
+
+    char* list = NULL;
+    DWORD list_size = 0;
+    char* line = NULL;
+
+    HANDLE h = CreateFileA(list_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+
+    if (h == INVALID_HANDLE_VALUE)
+    {
+        goto rfail;
+    }
+
+    list_size = GetFileSize(h, NULL);
+    list = (char*)malloc(list_size + 1);
+
+    if (list == NULL || !ReadFile(h, list, list_size, &list_size, NULL))
+    {
+        goto rfail;
+    }
+
+    list[list_size] = 0;
+    line = list;
+
+    while (*line)
+    {
+        char path[MAX_PATH];
+        s32 path_size = 0;
+
+        const char* prefix = "file '";
+        s32 prefix_size = (s32)strlen(prefix);
+
+        if (strncmp(line, prefix, prefix_size))
+        {
+            goto rfail;
+        }
+
+        // Quotes in the path are ended, escaped and started again.
+        char* c = line + prefix_size;
+
+        while (*c && path_size < MAX_PATH - 1)
+        {
+            if (!strncmp(c, "'\\''", 4))
+            {
+                path[path_size] = '\'';
+                path_size++;
+                c += 4;
+            }
+
+            else if (*c == '\'')
+            {
+                c++;
+                break;
+            }
+
+            else
+            {
+                path[path_size] = *c;
+                path_size++;
+                c++;
+            }
+        }
+
+        path[path_size] = 0;
+
+        HANDLE part = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+
+        if (part == INVALID_HANDLE_VALUE)
+        {
+            goto rfail;
+        }
+
+        bool res = standin_copy(part, out, 0);
+        CloseHandle(part);
+
+        if (!res)
+        {
+            goto rfail;
+        }
+
+        while (*c && *c != '\n')
+        {
+            c++;
+        }
+
+        line = *c ? c + 1 : c;
+    }
+
+    ret = true;
+
+rfail:
+    if (h != INVALID_HANDLE_VALUE) CloseHandle(h);
+    free(list);
+
+    return ret;
+}
+
+s32 get_env_s32(const char* name)
+{
+    char buf[32];
+
+    if (GetEnvironmentVariableA(name, buf, sizeof(buf)) == 0)
+    {
+        return 0;
+    }
+
+    return atoi(buf);
+}
+
+// The arguments are the ones that the game or svr_encoder.exe would give to ffmpeg. Only the inputs and the output are looked at.
+s32 standin_main(s32 argc, char** argv)
+{
+    const char* video_input = NULL;
+    const char* video_format = NULL;
+    StandinAudio audio = {};
+    HANDLE audio_thread = NULL;
+    const char* format = NULL;
+    const char* dest;
+    HANDLE out;
+    bool res;
+
+    // Every command is kept so the arguments can be checked afterwards.
+    char args_path[MAX_PATH];
+    GetModuleFileNameA(NULL, args_path, MAX_PATH);
+    PathRemoveFileSpecA(args_path);
+    StringCchCatA(args_path, MAX_PATH, "\\standin_args.txt");
+
+    HANDLE args_file = CreateFileA(args_path, FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (args_file != INVALID_HANDLE_VALUE)
+    {
+        const char* cmd_line = GetCommandLineA();
+        WriteFile(args_file, cmd_line, (DWORD)strlen(cmd_line), NULL, NULL);
+        WriteFile(args_file, "\r\n", 2, NULL, NULL);
+        CloseHandle(args_file);
+    }
+
+    if (argc < 2)
+    {
+        return 1;
+    }
+
+    for (s32 i = 1; i < argc - 2; i++)
+    {
+        if (!strcmp(argv[i], "-f"))
+        {
+            format = argv[i + 1];
+        }
+
+        else if (!strcmp(argv[i], "-i"))
+        {
+            if (video_input == NULL)
+            {
+                video_input = argv[i + 1];
+                video_format = format;
+            }
+
+            else
+            {
+                StringCchCopyA(audio.path, MAX_PATH, argv[i + 1]);
+            }
+
+            format = NULL;
+        }
+    }
+
+    dest = argv[argc - 1];
+
+    if (video_input == NULL)
+    {
+        return 1;
+    }
+
+    Sleep(get_env_s32("SVR_STANDIN_DELAY"));
+
+    if (audio.path[0])
+    {
+        StringCchPrintfA(audio.dest, MAX_PATH, "%s.aud", dest);
+
+        if (!strncmp(audio.path, "\\\\.\\pipe\\", 9))
+        {
+            audio_thread = CreateThread(NULL, 0, standin_audio_proc, &audio, 0, NULL);
+        }
+
+        else
+        {
+            CopyFileA(audio.path, audio.dest, FALSE);
+        }
+    }
+
+    out = CreateFileA(dest, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (out == INVALID_HANDLE_VALUE)
+    {
+        return 1;
+    }
+
+    if (video_format && !strcmp(video_format, "concat"))
+    {
+        res = standin_concat(video_input, out);
+    }
+
+    else
+    {
+        res = standin_copy(GetStdHandle(STD_INPUT_HANDLE), out, get_env_s32("SVR_STANDIN_RATE"));
+    }
+
+    CloseHandle(out);
+
+    if (audio_thread)
+    {
+        WaitForSingleObject(audio_thread, INFINITE);
+        CloseHandle(audio_thread);
+    }
+
+    return res ? 0 : 1;
+}
+
+// -------------------------------------------------
+// Work directory.
+
+void build_headless_path(const char* dir, const char* name, char* buf, s32 buf_size)
+{
+    StringCchPrintfA(buf, buf_size, "%s\\%s", dir, name);
+}
+
+bool copy_headless_files(const char* from_dir, const char* to_dir)
+{
+    char pattern[MAX_PATH];
+    build_headless_path(from_dir, "*", pattern, MAX_PATH);
+
+    WIN32_FIND_DATAA find_data;
+    HANDLE find_h = FindFirstFileA(pattern, &find_data);
+
+    if (find_h == INVALID_HANDLE_VALUE)
+    {
+        printf("There is nothing in %s\n", from_dir);
+        return false;
+    }
+
+    bool ret = true;
+
+    do
+    {
+        if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        {
+            continue;
+        }
+
+        char from_path[MAX_PATH];
+        char to_path[MAX_PATH];
+        build_headless_path(from_dir, find_data.cFileName, from_path, MAX_PATH);
+        build_headless_path(to_dir, find_data.cFileName, to_path, MAX_PATH);
+
+        if (!CopyFileA(from_path, to_path, FALSE))
+        {
+            printf("Could not copy %s (%lu)\n", from_path, GetLastError());
+            ret = false;
+        }
+    }
+    while (FindNextFileA(find_h, &find_data));
+
+    FindClose(find_h);
+
+    return ret;
+}
+
+// The profile that is given is copied with the changes after it, as the last value of an option is the one that is used.
+bool write_headless_profile(HeadlessOpts* opts)
+{
+    bool ret = false;
+
+    char from_path[MAX_PATH];
+    char to_path[MAX_PATH];
+    HANDLE h = INVALID_HANDLE_VALUE;
+
+    StringCchPrintfA(from_path, MAX_PATH, "%s\\data\\profiles\\%s.ini", headless_exe_dir, opts->profile);
+    StringCchPrintfA(to_path, MAX_PATH, "%s\\data\\profiles\\%s.ini", headless_work_dir, HEADLESS_PROFILE_NAME);
+
+    if (!CopyFileA(from_path, to_path, FALSE))
+    {
+        printf("Could not copy the profile %s (%lu)\n", from_path, GetLastError());
+        goto rfail;
+    }
+
+    h = CreateFileA(to_path, FILE_APPEND_DATA, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (h == INVALID_HANDLE_VALUE)
+    {
+        printf("Could not open %s (%lu)\n", to_path, GetLastError());
+        goto rfail;
+    }
+
+    WriteFile(h, "\r\n", 2, NULL, NULL);
+
+    for (s32 i = 0; i < opts->num_profile_changes; i++)
+    {
+        WriteFile(h, opts->profile_changes[i], (DWORD)strlen(opts->profile_changes[i]), NULL, NULL);
+        WriteFile(h, "\r\n", 2, NULL, NULL);
+    }
+
+    ret = true;
+
+rfail:
+    if (h != INVALID_HANDLE_VALUE) CloseHandle(h);
+
+    return ret;
+}
+
+// Everything is put in a directory of its own so the stand-in and the real ffmpeg are never mixed up.
+bool prepare_work_dir(HeadlessOpts* opts)
+{
+    char path[MAX_PATH];
+    char from_path[MAX_PATH];
+
+    build_headless_path(headless_exe_dir, opts->standin ? "headless_standin" : "headless", headless_work_dir, MAX_PATH);
+
+    const char* DIRS[] = {
+        "",
+        "\\data",
+        "\\data\\profiles",
+        "\\data\\shaders",
+        "\\movies",
+    };
+
+    for (s32 i = 0; i < SVR_ARRAY_SIZE(DIRS); i++)
+    {
+        StringCchPrintfA(path, MAX_PATH, "%s%s", headless_work_dir, DIRS[i]);
+        CreateDirectoryA(path, NULL);
+    }
+
+    StringCchPrintfA(from_path, MAX_PATH, "%s\\data\\shaders", headless_exe_dir);
+    StringCchPrintfA(path, MAX_PATH, "%s\\data\\shaders", headless_work_dir);
+
+    if (!copy_headless_files(from_path, path))
+    {
+        return false;
+    }
+
+    // For movies that are captured first.
+    build_headless_path(headless_exe_dir, "svr_encoder.exe", from_path, MAX_PATH);
+    build_headless_path(headless_work_dir, "svr_encoder.exe", path, MAX_PATH);
+    CopyFileA(from_path, path, FALSE);
+
+    build_headless_path(headless_work_dir, "ffmpeg.exe", path, MAX_PATH);
+
+    if (opts->standin)
+    {
+        GetModuleFileNameA(NULL, from_path, MAX_PATH);
+
+        if (!CopyFileA(from_path, path, FALSE))
+        {
+            printf("Could not copy the stand-in ffmpeg (%lu)\n", GetLastError());
+            return false;
+        }
+
+        // Inherited by the stand-in.
+        char value[32];
+        StringCchPrintfA(value, sizeof(value), "%d", opts->standin_delay);
+        SetEnvironmentVariableA("SVR_STANDIN_DELAY", value);
+
+        StringCchPrintfA(value, sizeof(value), "%d", opts->standin_rate);
+        SetEnvironmentVariableA("SVR_STANDIN_RATE", value);
+    }
+
+    // The real ffmpeg is large so it is only linked or copied once.
+    else if (GetFileAttributesA(path) == INVALID_FILE_ATTRIBUTES)
+    {
+        build_headless_path(headless_exe_dir, "ffmpeg.exe", from_path, MAX_PATH);
+
+        if (!CreateHardLinkA(path, from_path, NULL) && !CopyFileA(from_path, path, TRUE))
+        {
+            printf("Could not copy %s (%lu)\n", from_path, GetLastError());
+            return false;
+        }
+    }
+
+    if (!write_headless_profile(opts))
+    {
+        return false;
+    }
+
+    build_headless_path(headless_work_dir, "data\\SVR_LOG.txt", path, MAX_PATH);
+    svr_init_log(path, false);
+
+    return true;
+}
+
+// -------------------------------------------------
+// Running movies.
+
+// Bars that move with the game frame so that motion sampling has something to blend, and noise on top so that
+// every bit of the conversion gets used.
+void fill_headless_frame(u8* bgra, s32 pitch, s32 width, s32 height, s64 game_frame)
+{
+    u32 seed = (u32)game_frame * 7919u + 1;
+
+    for (s32 y = 0; y < height; y++)
+    {
+        u8* row = bgra + (s64)y * pitch;
+
+        for (s32 x = 0; x < width; x++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+
+            u8 noise = (u8)(seed >> 26);
+            s32 bar = (s32)(((x + game_frame * 8) / 64) & 1);
+
+            row[x * 4 + 0] = (u8)((x + game_frame) ^ noise);
+            row[x * 4 + 1] = (u8)(y + bar * 128);
+            row[x * 4 + 2] = bar ? 255 - noise : noise;
+            row[x * 4 + 3] = 255;
+        }
+    }
+}
+
+// The audio that the game would have mixed for one game frame. Every sample is numbered so that lost or repeated audio can be seen.
+void give_headless_audio(const HeadlessBackend* backend, SvrWaveSample* samples, s32 game_rate, s64 game_frame)
+{
+    s64 start = game_frame * HEADLESS_AUDIO_RATE / game_rate;
+    s64 end = (game_frame + 1) * HEADLESS_AUDIO_RATE / game_rate;
+
+    s32 num_samples = (s32)(end - start);
+
+    for (s32 i = 0; i < num_samples; i++)
+    {
+        samples[i].l = (short)(start + i);
+        samples[i].r = (short)-(start + i);
+    }
+
+    backend->give_audio(samples, num_samples);
+}
+
+bool run_headless_movie(const HeadlessBackend* backend, HeadlessOpts* opts, const char* dest)
+{
+    bool ret = false;
+
+    s32 pitch = opts->width * 4;
+    u8* frame = (u8*)malloc((s64)pitch * opts->height);
+    SvrWaveSample* samples = (SvrWaveSample*)malloc(sizeof(SvrWaveSample) * HEADLESS_AUDIO_RATE);
+
+    s32 game_rate;
+    s64 game_frame = 0;
+    s64 frames_given = 0;
+    s32 num_rotations = 0;
+    s64 start_time;
+    s64 end_time;
+    double run_secs;
+
+    if (frame == NULL || samples == NULL)
+    {
+        printf("Could not allocate the frame\n");
+        goto rfail;
+    }
+
+    if (!backend->start(dest, HEADLESS_PROFILE_NAME, opts->width, opts->height))
+    {
+        printf("Could not start %s, see the log\n", dest);
+        goto rfail;
+    }
+
+    game_rate = backend->get_game_rate();
+    start_time = svr_prof_get_real_time();
+
+    while (game_frame < opts->frames)
+    {
+        s32 advance = opts->skip ? backend->next_frame_needed() : 1;
+
+        // The game still mixes audio for the frames that are not rendered.
+        if (opts->audio)
+        {
+            for (s32 i = 0; i < advance; i++)
+            {
+                give_headless_audio(backend, samples, game_rate, game_frame + i);
+            }
+        }
+
+        game_frame += advance;
+
+        if (opts->rotate > 0 && frames_given > 0 && frames_given % opts->rotate == 0)
+        {
+            num_rotations++;
+
+            char rotate_dest[MAX_PATH];
+            StringCchPrintfA(rotate_dest, MAX_PATH, "r%d_%s", num_rotations, dest);
+
+            if (!backend->rotate_output(rotate_dest))
+            {
+                printf("Could not continue in %s\n", rotate_dest);
+            }
+        }
+
+        fill_headless_frame(frame, pitch, opts->width, opts->height, game_frame);
+        backend->frame(frame, pitch);
+
+        frames_given++;
+    }
+
+    backend->end();
+
+    end_time = svr_prof_get_real_time();
+
+    // Includes waiting for the encoder at the end, unless the movie is finished in the background.
+    run_secs = (double)(end_time - start_time) / 1000000.0;
+
+    printf("%s: %lld frames given for %lld game frames in %lld ms with the %s backend (%0.1f fps)\n", dest, frames_given, game_frame, (end_time - start_time) / 1000, backend->name, run_secs > 0.0 ? (double)frames_given / run_secs : 0.0);
+
+    ret = true;
+
+rfail:
+    free(frame);
+    free(samples);
+
+    return ret;
+}
+
+bool run_headless(const HeadlessBackend* backend, HeadlessOpts* opts, const char* dest)
+{
+    if (!backend->init(headless_work_dir))
+    {
+        printf("Could not start the %s backend, see the log\n", backend->name);
+        return false;
+    }
+
+    bool ret = true;
+
+    for (s32 i = 0; i < opts->movies && ret; i++)
+    {
+        char movie_dest[MAX_PATH];
+
+        if (i == 0)
+        {
+            StringCchCopyA(movie_dest, MAX_PATH, dest);
+        }
+
+        else
+        {
+            StringCchPrintfA(movie_dest, MAX_PATH, "m%d_%s", i + 1, dest);
+        }
+
+        ret = run_headless_movie(backend, opts, movie_dest);
+    }
+
+    // Movies may still be finished in the background.
+    wait_for_finalizing_sessions(0);
+
+    return ret;
+}
+
+// -------------------------------------------------
+// Comparing.
+
+bool diff_headless_files(const char* path_a, const char* path_b)
+{
+    const s32 BUF_SIZE = 1024 * 1024;
+
+    bool ret = false;
+
+    u8* buf_a = (u8*)malloc(BUF_SIZE);
+    u8* buf_b = (u8*)malloc(BUF_SIZE);
+
+    s64 offset = 0;
+    s64 size_a = 0;
+    s64 size_b = 0;
+    s64 first_diff = -1;
+    s64 num_diffs = 0;
+    s32 max_diff = 0;
+
+    HANDLE a = CreateFileA(path_a, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    HANDLE b = CreateFileA(path_b, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+
+    if (buf_a == NULL || buf_b == NULL)
+    {
+        printf("Could not allocate the buffers\n");
+        goto rfail;
+    }
+
+    if (a == INVALID_HANDLE_VALUE || b == INVALID_HANDLE_VALUE)
+    {
+        printf("Could not open %s\n", a == INVALID_HANDLE_VALUE ? path_a : path_b);
+        goto rfail;
+    }
+
+    while (true)
+    {
+        DWORD read_a = 0;
+        DWORD read_b = 0;
+
+        ReadFile(a, buf_a, BUF_SIZE, &read_a, NULL);
+        ReadFile(b, buf_b, BUF_SIZE, &read_b, NULL);
+
+        DWORD common = read_a < read_b ? read_a : read_b;
+
+        for (DWORD i = 0; i < common; i++)
+        {
+            s32 diff = abs((s32)buf_a[i] - (s32)buf_b[i]);
+
+            if (diff > 0)
+            {
+                if (first_diff < 0)
+                {
+                    first_diff = offset + i;
+                }
+
+                num_diffs++;
+
+                if (diff > max_diff)
+                {
+                    max_diff = diff;
+                }
+            }
+        }
+
+        offset += common;
+        size_a += read_a;
+        size_b += read_b;
+
+        if (read_a == 0 && read_b == 0)
+        {
+            break;
+        }
+    }
+
+    if (size_a != size_b)
+    {
+        printf("%s is %lld bytes and %s is %lld bytes, %lld of the first %lld bytes differ\n", path_a, size_a, path_b, size_b, num_diffs, offset);
+        goto rfail;
+    }
+
+    if (num_diffs > 0)
+    {
+        printf("%s and %s differ in %lld of %lld bytes, first at %lld, by up to %d\n", path_a, path_b, num_diffs, offset, first_diff, max_diff);
+        goto rfail;
+    }
+
+    printf("%s and %s are the same (%lld bytes)\n", path_a, path_b, offset);
+
+    ret = true;
+
+rfail:
+    if (a != INVALID_HANDLE_VALUE) CloseHandle(a);
+    if (b != INVALID_HANDLE_VALUE) CloseHandle(b);
+
+    free(buf_a);
+    free(buf_b);
+
+    return ret;
+}
+
+// Both backends make the same movie with the stand-in, which keeps the frames as they were given to ffmpeg.
+bool compare_headless(HeadlessOpts* opts, const char* dest)
+{
+    char cpu_dest[MAX_PATH];
+    char gpu_dest[MAX_PATH];
+    StringCchPrintfA(cpu_dest, MAX_PATH, "cpu_%s", dest);
+    StringCchPrintfA(gpu_dest, MAX_PATH, "gpu_%s", dest);
+
+    if (!run_headless(&CPU_BACKEND, opts, cpu_dest))
+    {
+        return false;
+    }
+
+    if (!run_headless(&GPU_BACKEND, opts, gpu_dest))
+    {
+        return false;
+    }
+
+    char cpu_path[MAX_PATH];
+    char gpu_path[MAX_PATH];
+    StringCchPrintfA(cpu_path, MAX_PATH, "%s\\movies\\%s", headless_work_dir, cpu_dest);
+    StringCchPrintfA(gpu_path, MAX_PATH, "%s\\movies\\%s", headless_work_dir, gpu_dest);
+
+    bool ret = diff_headless_files(cpu_path, gpu_path);
+
+    if (opts->audio)
+    {
+        StringCchCatA(cpu_path, MAX_PATH, ".aud");
+        StringCchCatA(gpu_path, MAX_PATH, ".aud");
+
+        ret &= diff_headless_files(cpu_path, gpu_path);
+    }
+
+    return ret;
+}
+
+// -------------------------------------------------
+// Self tests.
+
+// The conversions and motion sampling of every instruction set that the CPU has are checked against the reference.
+// What failed is written to the log next to this.
+bool run_self_tests(bool bench)
+{
+    char log_path[MAX_PATH];
+    build_headless_path(headless_exe_dir, "svr_selftest.txt", log_path, MAX_PATH);
+    svr_init_log(log_path, false);
+
+    svr_pxconv_init();
+    svr_mosample_init();
+
+    printf("Testing with up to %s%s\n", svr_get_simd_level_name(svr_get_simd_level()), bench ? ", this takes a while" : "");
+
+    bool pxconv_ok = svr_pxconv_self_test(bench);
+    printf("Pixel conversion: %s\n", pxconv_ok ? "passed" : "FAILED");
+
+    bool mosample_ok = svr_mosample_self_test(bench);
+    printf("Motion sampling: %s\n", mosample_ok ? "passed" : "FAILED");
+
+    bool fixed_error_ok = svr_mosample_fixed_error_test();
+    printf("Fixed point error bound: %s\n", fixed_error_ok ? "passed" : "FAILED");
+
+    printf("See %s\n", log_path);
+
+    return pxconv_ok && mosample_ok && fixed_error_ok;
+}
+
+// -------------------------------------------------
+
+void show_headless_usage()
+{
+    printf("Usage:\n");
+    printf("svr_headless.exe run <movie> [options]      Makes a movie in the headless directory\n");
+    printf("svr_headless.exe compare <movie> [options]  Makes the movie with the CPU and with the shaders and compares them\n");
+    printf("svr_headless.exe diff <file> <file>         Compares two files byte for byte\n");
+    printf("svr_headless.exe selftest [--bench]         Checks the CPU conversions against the reference, and shows how fast they are with --bench\n");
+    printf("\n");
+    printf("Options:\n");
+    printf("--gpu                 Use the shaders on a D3D11 device instead of the CPU\n");
+    printf("--profile <name>      Profile in data\\profiles to start from (default)\n");
+    printf("--set <option=value>  Changes an option of the profile, can be given many times\n");
+    printf("--size <w>x<h>        Size of the frames (1280x720)\n");
+    printf("--frames <n>          Number of game frames (300)\n");
+    printf("--skip                Only render the frames that are needed, like a game that uses svr_next_frame_needed\n");
+    printf("--audio               Give audio for every game frame\n");
+    printf("--rotate <n>          Continue in a new movie every n frames (svr_rotate_output)\n");
+    printf("--movies <n>          Number of movies to make one after the other (1)\n");
+    printf("--standin             Use the stand-in ffmpeg, which writes the raw video and audio (always used by compare)\n");
+    printf("--standin-delay <ms>  Time that the stand-in waits before it reads anything\n");
+    printf("--standin-rate <n>    Kilobytes per millisecond that the stand-in reads at most\n");
+}
+
+bool parse_headless_opts(s32 argc, char** argv, HeadlessOpts* opts)
+{
+    opts->profile = "default";
+    opts->width = 1280;
+    opts->height = 720;
+    opts->frames = 300;
+    opts->movies = 1;
+
+    for (s32 i = 3; i < argc; i++)
+    {
+        const char* opt = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (!strcmp(opt, "--gpu")) opts->use_gpu = true;
+        else if (!strcmp(opt, "--skip")) opts->skip = true;
+        else if (!strcmp(opt, "--audio")) opts->audio = true;
+        else if (!strcmp(opt, "--standin")) opts->standin = true;
+
+        else if (value == NULL)
+        {
+            printf("%s needs a value\n", opt);
+            return false;
+        }
+
+        else
+        {
+            if (!strcmp(opt, "--profile")) opts->profile = value;
+            else if (!strcmp(opt, "--frames")) opts->frames = _atoi64(value);
+            else if (!strcmp(opt, "--rotate")) opts->rotate = atoi(value);
+            else if (!strcmp(opt, "--movies")) opts->movies = atoi(value);
+            else if (!strcmp(opt, "--standin-delay")) opts->standin_delay = atoi(value);
+            else if (!strcmp(opt, "--standin-rate")) opts->standin_rate = atoi(value);
+
+            else if (!strcmp(opt, "--size"))
+            {
+                if (sscanf(value, "%dx%d", &opts->width, &opts->height) != 2 || opts->width <= 0 || opts->height <= 0)
+                {
+                    printf("The size must be given as <w>x<h>\n");
+                    return false;
+                }
+            }
+
+            else if (!strcmp(opt, "--set"))
+            {
+                if (opts->num_profile_changes == HEADLESS_MAX_PROFILE_CHANGES || strchr(value, '=') == NULL)
+                {
+                    printf("Options must be given as <option=value>, at most %d\n", HEADLESS_MAX_PROFILE_CHANGES);
+                    return false;
+                }
+
+                opts->profile_changes[opts->num_profile_changes] = value;
+                opts->num_profile_changes++;
+            }
+
+            else
+            {
+                printf("Unknown option %s\n", opt);
+                return false;
+            }
+
+            i++;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    char exe_path[MAX_PATH];
+    GetModuleFileNameA(NULL, exe_path, MAX_PATH);
+
+    if (!_stricmp(PathFindFileNameA(exe_path), "ffmpeg.exe"))
+    {
+        return standin_main(argc, argv);
+    }
+
+    StringCchCopyA(headless_exe_dir, MAX_PATH, exe_path);
+    PathRemoveFileSpecA(headless_exe_dir);
+
+    if (argc == 4 && !strcmp(argv[1], "diff"))
+    {
+        return diff_headless_files(argv[2], argv[3]) ? 0 : 1;
+    }
+
+    if (argc >= 2 && argc <= 3 && !strcmp(argv[1], "selftest"))
+    {
+        if (argc == 3 && strcmp(argv[2], "--bench"))
+        {
+            show_headless_usage();
+            return 1;
+        }
+
+        svr_init_prof();
+
+        bool res = run_self_tests(argc == 3);
+
+        svr_shutdown_log();
+
+        return res ? 0 : 1;
+    }
+
+    if (argc < 3 || (strcmp(argv[1], "run") && strcmp(argv[1], "compare")))
+    {
+        show_headless_usage();
+        return 1;
+    }
+
+    HeadlessOpts opts = {};
+
+    if (!parse_headless_opts(argc, argv, &opts))
+    {
+        return 1;
+    }
+
+    bool compare = !strcmp(argv[1], "compare");
+
+    // The frames can only be compared when nothing is encoded.
+    if (compare)
+    {
+        opts.standin = true;
+    }
+
+    svr_init_prof();
+
+    if (!prepare_work_dir(&opts))
+    {
+        return 1;
+    }
+
+    printf("Working in %s\n", headless_work_dir);
+
+    bool res;
+
+    if (compare)
+    {
+        res = compare_headless(&opts, argv[2]);
+    }
+
+    else
+    {
+        res = run_headless(opts.use_gpu ? &GPU_BACKEND : &CPU_BACKEND, &opts, argv[2]);
+    }
+
+    svr_shutdown_log();
+
+    return res ? 0 : 1;
+}
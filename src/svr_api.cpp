@@ -27,6 +27,9 @@ ID3D11RenderTargetView* svr_content_rtv;
 
 bool svr_movie_running;
 
+// Set between svr_pause and svr_resume.
+bool svr_movie_paused;
+
 // -------------------------------------------------
 
 int svr_api_version()
@@ -260,15 +263,21 @@ void svr_stop()
         return;
     }
 
-    proc_end();
+    proc_end(svr_d3d11_context);
 
     free_all_dynamic_svr_stuff();
 
     svr_movie_running = false;
+    svr_movie_paused = false;
 }
 
 void svr_frame()
 {
+    if (svr_movie_paused)
+    {
+        return;
+    }
+
     // If we are a D3D9Ex game, we have to copy over the game content texture to the D3D11 texture.
     if (svr_d3d9ex_device)
     {
@@ -282,6 +291,23 @@ void svr_frame()
     proc_frame(svr_d3d11_context, svr_content_srv, svr_content_rtv);
 }
 
+int svr_next_frame_needed()
+{
+    if (!svr_movie_running)
+    {
+        OutputDebugStringA("SVR (svr_next_frame_needed): Movie is not started. It is not allowed to call this now\n");
+        return 1;
+    }
+
+    // The game frames that are not used are not counted while paused.
+    if (svr_movie_paused)
+    {
+        return 1;
+    }
+
+    return proc_next_frame_needed();
+}
+
 bool svr_is_velo_enabled()
 {
     return proc_is_velo_enabled();
@@ -294,10 +320,74 @@ bool svr_is_audio_enabled()
 
 void svr_give_velocity(float* xyz)
 {
+    if (svr_movie_paused)
+    {
+        return;
+    }
+
     proc_give_velocity(xyz);
 }
 
 void svr_give_audio(SvrWaveSample* samples, int num_samples)
 {
+    if (svr_movie_paused)
+    {
+        return;
+    }
+
     proc_give_audio(samples, num_samples);
 }
+
+void svr_pause()
+{
+    if (!svr_movie_running)
+    {
+        OutputDebugStringA("SVR (svr_pause): Movie is not started. It is not allowed to call this now\n");
+        return;
+    }
+
+    svr_movie_paused = true;
+}
+
+void svr_resume()
+{
+    if (!svr_movie_running)
+    {
+        OutputDebugStringA("SVR (svr_resume): Movie is not started. It is not allowed to call this now\n");
+        return;
+    }
+
+    svr_movie_paused = false;
+}
+
+bool svr_rotate_output(const char* movie_name)
+{
+    if (!svr_movie_running)
+    {
+        OutputDebugStringA("SVR (svr_rotate_output): Movie is not started. It is not allowed to call this now\n");
+        return false;
+    }
+
+    return proc_rotate_output(svr_d3d11_context, movie_name);
+}
+
+void svr_get_stats(SvrStats* stats)
+{
+    if (!svr_movie_running)
+    {
+        *stats = {};
+        return;
+    }
+
+    proc_get_stats(stats);
+}
+
+void svr_shutdown()
+{
+    if (svr_movie_running)
+    {
+        OutputDebugStringA("SVR (svr_shutdown): Movie is still started. svr_stop should be called before this\n");
+    }
+
+    proc_shutdown();
+}
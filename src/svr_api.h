@@ -10,7 +10,10 @@
 // 3) Call svr_start when movie production should start.
 // 4a) Call svr_frame for all frames where movie production is active.
 // 4b) Optionally call svr_give_velocity before svr_frame.
+// 4c) Optionally call svr_next_frame_needed before svr_frame to skip rendering frames that are not used.
 // 5) Call svr_stop when movie production should stop.
+// 6) Call svr_shutdown once when the game exits.
+// Optionally call svr_get_stats at any time to see how the movie is going.
 
 // Programming errors are printed to the debugger output (prefixed with "SVR (<function name>):").
 // User or system errors will print messages to SVR_LOG.txt (for standalone SVR) and/or to the game console (if available at the time of error).
@@ -29,7 +32,7 @@ extern "C"
 
 // To be increased when something in the interface changes. Internal DLL changes (svr_dll_version) does not have to up this.
 // The API must not be used if the DLL API version does not match the client header API version.
-const int SVR_API_VERSION = 1;
+const int SVR_API_VERSION = 4;
 
 struct IUnknown;
 struct IDirect3DSurface9;
@@ -53,6 +56,58 @@ struct SvrWaveSample
     short r;
 };
 
+// How the movie that is being made is going. The counters are for the whole movie, and are all 0 when no movie is being made.
+struct SvrStats
+{
+    // Set while a movie is being made.
+    int movie_active;
+
+    // Frames of the movie that have been given to the encoder, counting repeated frames.
+    long long frames_submitted;
+
+    // Frames of the movie that have been written to the encoder, counting repeated frames. The encoder can still be working on them.
+    long long frames_encoded;
+
+    // Samples of game frames that have been added into frames of the movie with motion blur.
+    // A game frame at the end of a frame of the movie can also be added into the next one. Always 0 without motion blur.
+    long long subframes_accumulated;
+
+    // Frames that are waiting to be written to the encoder.
+    int write_queue_depth;
+
+    // Buffers that have been written to the encoder and are free for the next frames.
+    int read_queue_depth;
+
+    // Time in microseconds that the game thread has waited for the rest of the pipeline to have room for a frame.
+    long long stall_time_us;
+
+    // Frames written to the encoder per second, over about the last second.
+    double encoder_fps;
+
+    // Audio samples that have been written to the encoder.
+    long long audio_samples_written;
+};
+
+// The stats are also kept in named shared memory while SVR is loaded, so another process can read them without going through the game.
+// The name is this prefix followed by the process id of the game, such as "Local\SVR_STATS_1234". Open it with OpenFileMappingA
+// and MapViewOfFile with FILE_MAP_READ. The stats are updated a few times per second while a movie is being made.
+#define SVR_SHARED_STATS_PREFIX "Local\\SVR_STATS_"
+
+const unsigned int SVR_SHARED_STATS_MAGIC = 0x53525653; // SVRS
+
+struct SvrSharedStats
+{
+    // Set to SVR_SHARED_STATS_MAGIC and SVR_API_VERSION when the memory has been set up.
+    unsigned int magic;
+    int api_version;
+
+    // Odd while the stats are being written. Read this before and after copying the stats,
+    // and copy them again if it was odd or if it changed.
+    volatile long sequence;
+
+    SvrStats stats;
+};
+
 // For checking mismatch between built DLL and client header.
 // Always call this and ensure that the versions match (compare to SVR_API_VERSION). The API should not be used if these mismatch, as it will most likely crash!
 // You should not call svr_init (or any function at all) if there is a mismatch.
@@ -120,6 +175,16 @@ SVR_API void svr_stop();
 // This must only be called if svr_movie_active returns true.
 SVR_API void svr_frame();
 
+// With motion blur, the game frames before the exposure of every video frame are not used at all.
+// Returns how many game frames ahead the next frame that is used is, which is 1 when the next game frame is used.
+// Calling this is optional. If this is called, the next call to svr_frame counts as that many game frames and the game must have
+// moved ahead by all of them in one step without rendering the ones in between. For Source games this can be done by setting
+// host_framerate to the returned value divided by svr_get_game_rate (as a frame time) for the next frame.
+// If this is not called, svr_frame must be called for every game frame like before.
+// Always returns 1 without motion blur.
+// This must only be called if svr_movie_active returns true.
+SVR_API int svr_next_frame_needed();
+
 // Returns if velo is enabled in the active profile.
 // Must only be called after svr_start.
 SVR_API bool svr_is_velo_enabled();
@@ -135,4 +200,30 @@ SVR_API void svr_give_velocity(float* xyz);
 // Give audio samples to write. This must be 16 bit samples at 44100 hz.
 SVR_API void svr_give_audio(SvrWaveSample* samples, int num_samples);
 
+// Stops giving frames and audio to the movie until svr_resume is called, without ending the movie.
+// The encoder and everything else that was made for the movie is kept, so the movie continues right away when resumed.
+// The time in between is cut out of the movie. While paused, svr_frame, svr_give_velocity and svr_give_audio do nothing
+// and svr_next_frame_needed returns 1. The game can run at any rate while paused, but host_framerate must be set back before resuming.
+// These must only be called if svr_movie_active returns true.
+SVR_API void svr_pause();
+SVR_API void svr_resume();
+
+// Continues the movie in a new file with this name, without ending the movie. The name is the same as for svr_start.
+// Frames from the next call to svr_frame go in the new file, and audio from the next call to svr_give_audio.
+// The encoder for the new file is started right away and the file before is finished in the background, so there is no wait like with svr_stop and svr_start.
+// This can be done while paused to split the movie into clips.
+// Only possible when the movie is written by a single ffmpeg process, so not when encoding in parts or with an intermediate capture.
+// At least one frame must have been given since the movie was started or last continued in a new file.
+// Returns false if the movie was not continued in a new file, the frames then keep going to the file before.
+// This must only be called if svr_movie_active returns true.
+SVR_API bool svr_rotate_output(const char* movie_name);
+
+// Returns how the movie is going, see SvrStats. Can be called when no movie is being made.
+SVR_API void svr_get_stats(SvrStats* stats);
+
+// To be called once when the game exits, before the process is ended.
+// Movies that were stopped may still be finished in the background (the last frames encoded and the parts joined) after svr_stop has returned.
+// This waits for them so they are not cut off. A movie that is still being made when this is called is not finished, so call svr_stop before this.
+SVR_API void svr_shutdown();
+
 }
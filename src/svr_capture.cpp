@@ -0,0 +1,385 @@
+#include "svr_capture.h"
+#include <Windows.h>
+#include <strsafe.h>
+#include <string.h>
+#include <intrin.h>
+
+// The compression is the LZ4 block format. There are no dependencies in the tree for it so this is a small version of it.
+// It is greedy and only looks at the latest position for every hash, which is enough when the frames are mostly made of
+// runs of 0 from the difference to the frame before.
+
+// The hash table is on the stack (4 bytes per entry).
+const s32 LZ_HASH_BITS = 14;
+
+const s32 LZ_MIN_MATCH = 4;
+
+// The format requires the last bytes to be literals, and that the last match starts a bit before the end.
+const s32 LZ_LAST_LITERALS = 5;
+const s32 LZ_MATCH_LIMIT = 12;
+
+const s32 LZ_MAX_OFFSET = 65535;
+
+inline u32 lz_read_u32(const u8* p)
+{
+    u32 v;
+    memcpy(&v, p, sizeof(u32));
+    return v;
+}
+
+inline u32 lz_hash(u32 v)
+{
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// Lengths that do not fit in the token continue in bytes of 255 until one that is less.
+inline u8* lz_write_length(u8* op, s32 len)
+{
+    while (len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+
+    *op++ = (u8)len;
+    return op;
+}
+
+inline bool lz_read_length(const u8** ip, const u8* ip_end, s32* len)
+{
+    u32 b;
+
+    do
+    {
+        if (*ip >= ip_end)
+        {
+            return false;
+        }
+
+        b = **ip;
+        (*ip)++;
+
+        *len += b;
+    }
+    while (b == 255);
+
+    return true;
+}
+
+u8* lz_write_sequence(u8* op, const u8* literals, s32 lit_len, s32 offset, s32 match_len)
+{
+    u8* token = op++;
+
+    *token = (u8)((lit_len >= 15 ? 15 : lit_len) << 4);
+
+    if (lit_len >= 15)
+    {
+        op = lz_write_length(op, lit_len - 15);
+    }
+
+    memcpy(op, literals, lit_len);
+    op += lit_len;
+
+    // The last sequence only has literals.
+    if (offset == 0)
+    {
+        return op;
+    }
+
+    *op++ = (u8)(offset & 255);
+    *op++ = (u8)(offset >> 8);
+
+    match_len -= LZ_MIN_MATCH;
+
+    *token |= (u8)(match_len >= 15 ? 15 : match_len);
+
+    if (match_len >= 15)
+    {
+        op = lz_write_length(op, match_len - 15);
+    }
+
+    return op;
+}
+
+s32 lz_compress(const u8* source, s32 size, u8* dest)
+{
+    u32 table[1 << LZ_HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    const u8* ip = source;
+    const u8* anchor = source;
+    const u8* end = source + size;
+
+    // Matches cannot go into the last literals.
+    const u8* match_end = end - LZ_LAST_LITERALS;
+
+    u8* op = dest;
+
+    if (size > LZ_MATCH_LIMIT)
+    {
+        ip++;
+
+        while (ip + LZ_MATCH_LIMIT <= end)
+        {
+            u32 seq = lz_read_u32(ip);
+            u32 h = lz_hash(seq);
+
+            const u8* ref = source + table[h];
+            table[h] = (u32)(ip - source);
+
+            if (ref >= ip || ip - ref > LZ_MAX_OFFSET || lz_read_u32(ref) != seq)
+            {
+                // Move faster through data that does not compress.
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            while (ip > anchor && ref > source && ip[-1] == ref[-1])
+            {
+                ip--;
+                ref--;
+            }
+
+            const u8* mp = ip + LZ_MIN_MATCH;
+            const u8* mr = ref + LZ_MIN_MATCH;
+
+            // Long matches are common (runs of 0 are most of a frame), so they are compared 4 bytes at a time.
+            bool mismatch = false;
+
+            while (!mismatch && mp + 4 <= match_end)
+            {
+                u32 diff = lz_read_u32(mp) ^ lz_read_u32(mr);
+
+                if (diff != 0)
+                {
+                    unsigned long first_bit;
+                    _BitScanForward(&first_bit, diff);
+
+                    mp += first_bit / 8;
+                    mismatch = true;
+                }
+
+                else
+                {
+                    mp += 4;
+                    mr += 4;
+                }
+            }
+
+            while (!mismatch && mp < match_end && *mp == *mr)
+            {
+                mp++;
+                mr++;
+            }
+
+            op = lz_write_sequence(op, anchor, (s32)(ip - anchor), (s32)(ip - ref), (s32)(mp - ip));
+
+            ip = mp;
+            anchor = ip;
+
+            if (ip + LZ_MATCH_LIMIT <= end)
+            {
+                table[lz_hash(lz_read_u32(ip - 2))] = (u32)(ip - 2 - source);
+            }
+        }
+    }
+
+    op = lz_write_sequence(op, anchor, (s32)(end - anchor), 0, 0);
+
+    return (s32)(op - dest);
+}
+
+bool lz_decompress(const u8* source, s32 source_size, u8* dest, s32 size)
+{
+    const u8* ip = source;
+    const u8* ip_end = source + source_size;
+
+    u8* op = dest;
+    u8* op_end = dest + size;
+
+    while (ip < ip_end)
+    {
+        u32 token = *ip++;
+
+        s32 lit_len = token >> 4;
+
+        if (lit_len == 15 && !lz_read_length(&ip, ip_end, &lit_len))
+        {
+            return false;
+        }
+
+        if (lit_len > ip_end - ip || lit_len > op_end - op)
+        {
+            return false;
+        }
+
+        memcpy(op, ip, lit_len);
+        op += lit_len;
+        ip += lit_len;
+
+        // The last sequence only has literals.
+        if (ip == ip_end)
+        {
+            break;
+        }
+
+        if (ip_end - ip < 2)
+        {
+            return false;
+        }
+
+        s32 offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+
+        if (offset == 0 || offset > op - dest)
+        {
+            return false;
+        }
+
+        s32 match_len = token & 15;
+
+        if (match_len == 15 && !lz_read_length(&ip, ip_end, &match_len))
+        {
+            return false;
+        }
+
+        match_len += LZ_MIN_MATCH;
+
+        if (match_len > op_end - op)
+        {
+            return false;
+        }
+
+        const u8* mp = op - offset;
+
+        if (offset >= match_len)
+        {
+            memcpy(op, mp, match_len);
+        }
+
+        // Runs of the same byte, which is what most of a difference is.
+        else if (offset == 1)
+        {
+            memset(op, mp[0], match_len);
+        }
+
+        else
+        {
+            // Overlapping matches repeat the bytes before.
+            for (s32 i = 0; i < match_len; i++)
+            {
+                op[i] = mp[i];
+            }
+        }
+
+        op += match_len;
+    }
+
+    return op == op_end;
+}
+
+s32 svr_capture_bound(s32 size)
+{
+    return size + (size / 255) + 16;
+}
+
+s32 svr_capture_compress(const u8* frame, const u8* prev, s32 size, u8* scratch, u8* dest)
+{
+    if (prev == NULL)
+    {
+        return lz_compress(frame, size, dest);
+    }
+
+    for (s32 i = 0; i < size; i++)
+    {
+        scratch[i] = frame[i] - prev[i];
+    }
+
+    return lz_compress(scratch, size, dest);
+}
+
+bool svr_capture_decompress(const u8* source, s32 source_size, bool keyframe, s32 size, u8* scratch, u8* dest)
+{
+    if (keyframe)
+    {
+        return lz_decompress(source, source_size, dest, size);
+    }
+
+    if (!lz_decompress(source, source_size, scratch, size))
+    {
+        return false;
+    }
+
+    for (s32 i = 0; i < size; i++)
+    {
+        dest[i] += scratch[i];
+    }
+
+    return true;
+}
+
+void svr_capture_build_audio_path(const char* capture_path, char* buf, s32 buf_size)
+{
+    StringCchPrintfA(buf, buf_size, "%s.audio.raw", capture_path);
+}
+
+// -------------------------------------------------
+
+void svr_build_part_path(const char* movie_path, s32 part, char* buf, s32 buf_size)
+{
+    const char* ext = strrchr(movie_path, '.');
+    const char* dir_end = strrchr(movie_path, '\\');
+
+    if (ext == NULL || (dir_end && dir_end > ext))
+    {
+        ext = movie_path + strlen(movie_path);
+    }
+
+    StringCchPrintfA(buf, buf_size, "%.*s.part%04d%s", (s32)(ext - movie_path), movie_path, part + 1, ext);
+}
+
+bool svr_write_part_list(const char* list_path, const char* movie_path, s32 num_parts)
+{
+    HANDLE h = CreateFileA(list_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, NULL);
+
+    if (h == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    for (s32 i = 0; i < num_parts; i++)
+    {
+        char path[MAX_PATH];
+        svr_build_part_path(movie_path, i, path, MAX_PATH);
+
+        // Quotes in the path have to be ended, escaped and started again.
+        char line[MAX_PATH * 4 + 16];
+        StringCchCopyA(line, sizeof(line), "file '");
+
+        s32 line_size = (s32)strlen(line);
+
+        for (char* c = path; *c; c++)
+        {
+            if (*c == '\'')
+            {
+                memcpy(line + line_size, "'\\''", 4);
+                line_size += 4;
+            }
+
+            else
+            {
+                line[line_size] = *c;
+                line_size++;
+            }
+        }
+
+        line[line_size] = '\'';
+        line[line_size + 1] = '\n';
+        line_size += 2;
+
+        DWORD written;
+        WriteFile(h, line, line_size, &written, NULL);
+    }
+
+    CloseHandle(h);
+    return true;
+}
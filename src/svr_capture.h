@@ -0,0 +1,96 @@
+#pragma once
+#include "svr_common.h"
+
+// Intermediate capture file, for recording as fast as the game can go and encoding later (see encoder_main.cpp).
+// This is written by the game instead of giving the frames to ffmpeg, and is read back by svr_encoder.exe.
+//
+// The file starts with the header, followed by the frames one after the other, followed by the index.
+// Every frame is compressed on its own with a fast LZ77 codec (the LZ4 block format), which is much faster than the disk.
+// Frames that are not keyframes are stored as the difference to the frame before, which makes the parts of the screen that do
+// not change compress to almost nothing. There is a keyframe every chunk of frames so that the file can be split up at those
+// and the chunks encoded at the same time.
+//
+// The index has an entry for every frame and the header says where it is. It is written last, so if the game stopped before
+// that the index is 0 and the frames are found by going through the file instead (every frame starts with a record).
+
+const u32 SVR_CAPTURE_MAGIC = 0x43525653; // SVRC
+const u32 SVR_CAPTURE_VERSION = 1;
+
+const s32 SVR_CAPTURE_MAX_ARGS = 256;
+
+// Put after the name of the movie, so the movie is the name of the capture without this.
+const char* const SVR_CAPTURE_EXTENSION = ".svrc";
+
+// The frame does not depend on the frame before.
+const u32 SVR_CAPTURE_KEYFRAME = 1 << 0;
+
+struct SvrCaptureHeader
+{
+    u32 magic;
+    u32 version;
+
+    s32 width;
+    s32 height;
+    s32 fps;
+
+    // Size of an uncompressed frame.
+    s32 frame_size;
+
+    // How many frames there are in a chunk.
+    s32 chunk_frames;
+
+    // If audio is enabled, it is in a file next to this one (see svr_capture_build_audio_path).
+    s32 audio_bitrate;
+
+    // The ffmpeg arguments for the frames in this file and for the encoder settings of the profile.
+    char input_args[SVR_CAPTURE_MAX_ARGS];
+    char output_args[SVR_CAPTURE_MAX_ARGS];
+
+    // Written when the file is finished.
+    s64 index_offset;
+    s32 num_records;
+    s32 pad;
+};
+
+// Before every frame in the file.
+struct SvrCaptureRecord
+{
+    s32 size; // Compressed size that comes after this.
+    s32 num_frames; // How many frames of the movie this is (repeated frames are only stored once).
+    u32 flags;
+    u32 pad;
+};
+
+// For every frame in the index.
+struct SvrCaptureIndexEntry
+{
+    s64 offset; // Where the record is.
+    s32 size;
+    s32 num_frames;
+    u32 flags;
+    u32 pad;
+};
+
+// Largest size a frame can compress to.
+s32 svr_capture_bound(s32 size);
+
+// Compresses a frame into dest, which must be svr_capture_bound in size. Returns the compressed size.
+// If prev is not NULL, the difference to it is compressed, which needs scratch memory of the frame size (this can be prev itself).
+s32 svr_capture_compress(const u8* frame, const u8* prev, s32 size, u8* scratch, u8* dest);
+
+// Decompresses a frame into dest. Returns false if the data is corrupt.
+// If the frame is not a keyframe, dest must have the frame before, and scratch memory of the frame size is needed.
+bool svr_capture_decompress(const u8* source, s32 source_size, bool keyframe, s32 size, u8* scratch, u8* dest);
+
+// The audio of a capture is raw 16-bit stereo samples at 44100 Hz.
+void svr_capture_build_audio_path(const char* capture_path, char* buf, s32 buf_size);
+
+// -------------------------------------------------
+
+// Movies that are encoded in parts (both in the game and from captures) have the parts next to the movie, as movie.part0001.mp4 and so on.
+// The parts are joined with the concat demuxer of ffmpeg, which reads a list of them.
+
+void svr_build_part_path(const char* movie_path, s32 part, char* buf, s32 buf_size);
+
+// Writes the list of parts for the concat demuxer.
+bool svr_write_part_list(const char* list_path, const char* movie_path, s32 num_parts);
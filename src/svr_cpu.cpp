@@ -0,0 +1,94 @@
+#include "svr_cpu.h"
+#include <intrin.h>
+
+const char* SIMD_LEVEL_NAMES[] = {
+    "none", // SVR_SIMD_NONE
+    "SSE4.1", // SVR_SIMD_SSE41
+    "AVX2", // SVR_SIMD_AVX2
+    "AVX-512", // SVR_SIMD_AVX512
+};
+
+SvrSimdLevel svr_get_simd_level()
+{
+    s32 regs[4];
+
+    __cpuid(regs, 0);
+
+    s32 max_leaf = regs[0];
+
+    if (max_leaf < 1)
+    {
+        return SVR_SIMD_NONE;
+    }
+
+    __cpuid(regs, 1);
+
+    bool has_sse41 = regs[2] & (1 << 19);
+    bool has_osxsave = regs[2] & (1 << 27);
+    bool has_avx = regs[2] & (1 << 28);
+
+    if (!has_sse41)
+    {
+        return SVR_SIMD_NONE;
+    }
+
+    // The OS must also save the larger registers on context switches.
+
+    if (!has_osxsave || !has_avx)
+    {
+        return SVR_SIMD_SSE41;
+    }
+
+    u64 xcr0 = _xgetbv(0);
+
+    bool os_ymm = (xcr0 & 0x06) == 0x06;
+    bool os_zmm = (xcr0 & 0xe6) == 0xe6;
+
+    if (!os_ymm || max_leaf < 7)
+    {
+        return SVR_SIMD_SSE41;
+    }
+
+    __cpuidex(regs, 7, 0);
+
+    bool has_avx2 = regs[1] & (1 << 5);
+    bool has_avx512f = regs[1] & (1 << 16);
+    bool has_avx512dq = regs[1] & (1 << 17);
+    bool has_avx512bw = regs[1] & (1 << 30);
+    bool has_avx512vl = regs[1] & (1u << 31);
+
+    if (!has_avx2)
+    {
+        return SVR_SIMD_SSE41;
+    }
+
+    // The AVX512 files are built with /arch:AVX512, which lets the compiler use DQ, BW and VL too and not just the foundation.
+
+    if (!has_avx512f || !has_avx512dq || !has_avx512bw || !has_avx512vl || !os_zmm)
+    {
+        return SVR_SIMD_AVX2;
+    }
+
+    return SVR_SIMD_AVX512;
+}
+
+const char* svr_get_simd_level_name(SvrSimdLevel level)
+{
+    return SIMD_LEVEL_NAMES[level];
+}
+
+bool svr_has_invariant_tsc()
+{
+    s32 regs[4];
+
+    __cpuid(regs, 0x80000000);
+
+    if ((u32)regs[0] < 0x80000007)
+    {
+        return false;
+    }
+
+    __cpuid(regs, 0x80000007);
+
+    return regs[3] & (1 << 8);
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "svr_common.h"
+
+// Instruction sets that vectorized code can be selected by at runtime.
+// The project is built for SSE2, so anything above that has to be checked for before it is used.
+// Each level includes the ones below it.
+
+enum SvrSimdLevel
+{
+    SVR_SIMD_NONE = 0,
+    SVR_SIMD_SSE41,
+    SVR_SIMD_AVX2,
+    SVR_SIMD_AVX512,
+
+    SVR_NUM_SIMD_LEVELS,
+};
+
+// The highest level that both the CPU and the OS support.
+SvrSimdLevel svr_get_simd_level();
+
+const char* svr_get_simd_level_name(SvrSimdLevel level);
+
+// If the TSC runs at the same rate in all power states, so it can be used as a clock.
+bool svr_has_invariant_tsc();
@@ -0,0 +1,167 @@
+#include "svr_hist.h"
+#include "svr_prof.h"
+#include <string.h>
+#include <strsafe.h>
+#include <intrin.h>
+
+s32 calc_hist_bucket(s64 value)
+{
+    if (value < SVR_HIST_SUB_BUCKETS)
+    {
+        return value < 0 ? 0 : (s32)value;
+    }
+
+    unsigned long high_bit;
+    _BitScanReverse64(&high_bit, (u64)value);
+
+    if (high_bit >= (unsigned long)SVR_HIST_MAX_BITS)
+    {
+        return SVR_HIST_NUM_BUCKETS - 1;
+    }
+
+    // The bits below the highest bit pick the bucket between two powers of 2.
+    s32 shift = (s32)high_bit - SVR_HIST_SUB_BITS;
+    s32 sub = (s32)(value >> shift) & (SVR_HIST_SUB_BUCKETS - 1);
+
+    return (shift + 1) * SVR_HIST_SUB_BUCKETS + sub;
+}
+
+// Highest time that goes in a bucket.
+s64 calc_hist_bucket_limit(s32 bucket)
+{
+    if (bucket < SVR_HIST_SUB_BUCKETS)
+    {
+        return bucket;
+    }
+
+    s32 shift = bucket / SVR_HIST_SUB_BUCKETS - 1;
+    s64 sub = bucket & (SVR_HIST_SUB_BUCKETS - 1);
+
+    return ((SVR_HIST_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+void svr_hist_add(SvrHist* hist, s64 value)
+{
+    hist->counts[calc_hist_bucket(value)]++;
+    hist->total += value;
+
+    if (value > hist->max)
+    {
+        hist->max = value;
+    }
+}
+
+void svr_start_hist(SvrHist* hist)
+{
+    hist->start = svr_prof_get_real_time();
+}
+
+void svr_end_hist(SvrHist* hist)
+{
+    svr_hist_add(hist, svr_prof_get_real_time() - hist->start);
+}
+
+void svr_reset_hist(SvrHist* hist)
+{
+    memset(hist->counts, 0, sizeof(hist->counts));
+    hist->total = 0;
+    hist->max = 0;
+}
+
+void svr_merge_hist(SvrHist* dest, SvrHist* source)
+{
+    for (s32 i = 0; i < SVR_HIST_NUM_BUCKETS; i++)
+    {
+        dest->counts[i] += source->counts[i];
+    }
+
+    dest->total += source->total;
+
+    s64 max = source->max;
+
+    if (max > dest->max)
+    {
+        dest->max = max;
+    }
+}
+
+// The counts are read once, as they can change while this is running.
+s64 calc_hist_count(SvrHist* hist, s64* counts)
+{
+    s64 count = 0;
+
+    for (s32 i = 0; i < SVR_HIST_NUM_BUCKETS; i++)
+    {
+        counts[i] = hist->counts[i];
+        count += counts[i];
+    }
+
+    return count;
+}
+
+s64 find_hist_percentile(s64* counts, s64 count, s64 max, double percentile)
+{
+    // Rank of the time in the percentile, counting from 1.
+    s64 rank = (s64)(percentile * (double)count + 0.5);
+
+    if (rank < 1)
+    {
+        rank = 1;
+    }
+
+    s64 seen = 0;
+
+    for (s32 i = 0; i < SVR_HIST_NUM_BUCKETS; i++)
+    {
+        seen += counts[i];
+
+        if (seen >= rank)
+        {
+            s64 limit = calc_hist_bucket_limit(i);
+
+            // No time in the bucket can be above the highest time.
+            return limit < max ? limit : max;
+        }
+    }
+
+    return max;
+}
+
+s64 svr_calc_hist_percentile(SvrHist* hist, double percentile)
+{
+    s64 counts[SVR_HIST_NUM_BUCKETS];
+    s64 count = calc_hist_count(hist, counts);
+
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    return find_hist_percentile(counts, count, hist->max, percentile);
+}
+
+void svr_calc_hist_stats(SvrHist* hist, SvrHistStats* stats)
+{
+    s64 counts[SVR_HIST_NUM_BUCKETS];
+
+    *stats = {};
+
+    stats->count = calc_hist_count(hist, counts);
+    stats->max = hist->max;
+
+    if (stats->count == 0)
+    {
+        return;
+    }
+
+    stats->mean = hist->total / stats->count;
+    stats->p50 = find_hist_percentile(counts, stats->count, stats->max, 0.5);
+    stats->p90 = find_hist_percentile(counts, stats->count, stats->max, 0.9);
+    stats->p99 = find_hist_percentile(counts, stats->count, stats->max, 0.99);
+    stats->p999 = find_hist_percentile(counts, stats->count, stats->max, 0.999);
+}
+
+void svr_format_hist_stats(SvrHistStats* stats, char* buf, s32 buf_size)
+{
+    StringCchPrintfA(buf, buf_size, "p50 %lld us, p90 %lld us, p99 %lld us, p99.9 %lld us, max %lld us (%lld times)", stats->p50, stats->p90, stats->p99, stats->p999, stats->max, stats->count);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "svr_common.h"
+
+// Histogram of times for seeing how uneven something is, which an average hides (writing to pipes can take 300 us
+// most of the time and then several milliseconds now and then).
+// Unlike SvrProf this is always enabled. Times are in microseconds like svr_prof_get_real_time.
+//
+// The buckets are spaced by powers of 2 with 16 buckets between every power, so a time is kept to within 1/16 of itself.
+// Times below 16 us are kept exactly. Adding a time is only a few instructions and never allocates or waits.
+//
+// Only 1 thread can add to a histogram, but any thread can read it while times are being added.
+// The numbers that are read then are not from one exact moment, which does not matter for this.
+
+const s32 SVR_HIST_SUB_BITS = 4;
+const s32 SVR_HIST_SUB_BUCKETS = 1 << SVR_HIST_SUB_BITS;
+
+// Times are kept up to 2^36 us (about 19 hours), longer times are put in the last bucket.
+const s32 SVR_HIST_MAX_BITS = 36;
+const s32 SVR_HIST_NUM_BUCKETS = (SVR_HIST_MAX_BITS - SVR_HIST_SUB_BITS + 1) * SVR_HIST_SUB_BUCKETS;
+
+struct SvrHist
+{
+    s64 counts[SVR_HIST_NUM_BUCKETS];
+
+    s64 total;
+    s64 max;
+
+    // For svr_start_hist and svr_end_hist.
+    s64 start;
+};
+
+// What a histogram says about the times in it. The percentiles are the highest time of the bucket they are in.
+struct SvrHistStats
+{
+    s64 count;
+    s64 mean;
+    s64 p50;
+    s64 p90;
+    s64 p99;
+    s64 p999;
+    s64 max;
+};
+
+void svr_hist_add(SvrHist* hist, s64 value);
+
+// Adds the time between these.
+void svr_start_hist(SvrHist* hist);
+void svr_end_hist(SvrHist* hist);
+
+void svr_reset_hist(SvrHist* hist);
+
+// Adds the times of another histogram, which can still be added to.
+void svr_merge_hist(SvrHist* dest, SvrHist* source);
+
+void svr_calc_hist_stats(SvrHist* hist, SvrHistStats* stats);
+
+// Percentile between 0 and 1.
+s64 svr_calc_hist_percentile(SvrHist* hist, double percentile);
+
+// Writes the stats as text, such as "p50 812 us, p90 1204 us, p99 3001 us, p99.9 6004 us, max 7012 us (300 times)".
+void svr_format_hist_stats(SvrHistStats* stats, char* buf, s32 buf_size);
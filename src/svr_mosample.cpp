@@ -0,0 +1,455 @@
+#include "svr_mosample_impl.h"
+#include "svr_mosample_sched.h"
+#include "svr_stage.h"
+#include "svr_logging.h"
+#include "svr_prof.h"
+#include <smmintrin.h>
+#include <string.h>
+#include <malloc.h>
+
+// The project is built with fast floating point, which allows the compiler to reorder and contract the operations below.
+// The operations here have to be done exactly as written to get the same rounding for every instruction set.
+#pragma float_control(precise, on, push)
+#pragma fp_contract(off)
+
+static inline void mosample_channel_sse41(float* dest, __m128i value, __m128 norm, __m128 weight)
+{
+    __m128 sum = _mm_add_ps(_mm_loadu_ps(dest), _mm_mul_ps(_mm_div_ps(_mm_cvtepi32_ps(value), norm), weight));
+    _mm_storeu_ps(dest, sum);
+}
+
+// With SSE4.1 (4 pixels at a time).
+void mosample_row_sse41(float* dest, const u8* source, s32 width, float weight)
+{
+    __m128 norm = _mm_set1_ps(255.0f);
+    __m128 w = _mm_set1_ps(weight);
+    __m128i mask = _mm_set1_epi32(0xff);
+
+    s32 x = 0;
+
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i px = _mm_loadu_si128((const __m128i*)(source + (x * 4)));
+
+        mosample_channel_sse41(dest + x, _mm_and_si128(_mm_srli_epi32(px, 16), mask), norm, w);
+        mosample_channel_sse41(dest + width + x, _mm_and_si128(_mm_srli_epi32(px, 8), mask), norm, w);
+        mosample_channel_sse41(dest + (width * 2) + x, _mm_and_si128(px, mask), norm, w);
+    }
+
+    mosample_row_reference(dest, source, x, width, weight);
+}
+
+void mosample_row_none(float* dest, const u8* source, s32 width, float weight)
+{
+    mosample_row_reference(dest, source, 0, width, weight);
+}
+
+static inline void mosample_fixed_channel_sse41(u16* dest, __m128i value, __m128 scale, __m128i max)
+{
+    __m128i product = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(value), scale));
+    __m128i acc = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)dest));
+    __m128i sum = _mm_min_epi32(_mm_add_epi32(acc, product), max);
+    _mm_storel_epi64((__m128i*)dest, _mm_packus_epi32(sum, sum));
+}
+
+// With SSE4.1 (4 pixels at a time).
+void mosample_fixed_row_sse41(u16* dest, const u8* source, s32 width, float scale)
+{
+    __m128 s = _mm_set1_ps(scale);
+    __m128i mask = _mm_set1_epi32(0xff);
+    __m128i max = _mm_set1_epi32(65535);
+
+    s32 x = 0;
+
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i px = _mm_loadu_si128((const __m128i*)(source + (x * 4)));
+
+        mosample_fixed_channel_sse41(dest + x, _mm_and_si128(_mm_srli_epi32(px, 16), mask), s, max);
+        mosample_fixed_channel_sse41(dest + width + x, _mm_and_si128(_mm_srli_epi32(px, 8), mask), s, max);
+        mosample_fixed_channel_sse41(dest + (width * 2) + x, _mm_and_si128(px, mask), s, max);
+    }
+
+    mosample_fixed_row_reference(dest, source, x, width, scale);
+}
+
+void mosample_fixed_row_none(u16* dest, const u8* source, s32 width, float scale)
+{
+    mosample_fixed_row_reference(dest, source, 0, width, scale);
+}
+
+// Row functions for each instruction set.
+extern const MosampleRowFn MOSAMPLE_ROW_FNS[] = {
+    mosample_row_none, // SVR_SIMD_NONE
+    mosample_row_sse41, // SVR_SIMD_SSE41
+    mosample_row_avx2, // SVR_SIMD_AVX2
+    mosample_row_avx512, // SVR_SIMD_AVX512
+};
+
+extern const MosampleFixedRowFn MOSAMPLE_FIXED_ROW_FNS[] = {
+    mosample_fixed_row_none, // SVR_SIMD_NONE
+    mosample_fixed_row_sse41, // SVR_SIMD_SSE41
+    mosample_fixed_row_avx2, // SVR_SIMD_AVX2
+    mosample_fixed_row_avx512, // SVR_SIMD_AVX512
+};
+
+SvrSimdLevel mosample_simd_level;
+
+void svr_mosample_init()
+{
+    mosample_simd_level = svr_get_simd_level();
+}
+
+SvrSimdLevel svr_mosample_get_simd_level()
+{
+    return mosample_simd_level;
+}
+
+void mosample_level(SvrSimdLevel level, float* dest, s32 dest_pitch, const u8* source, s32 source_pitch, s32 width, s32 start_row, s32 end_row, float weight)
+{
+    MosampleRowFn row_fn = MOSAMPLE_ROW_FNS[level];
+
+    for (s32 y = start_row; y < end_row; y++)
+    {
+        float* dest_row = (float*)((u8*)dest + (y * dest_pitch));
+        const u8* source_row = source + (y * source_pitch);
+
+        row_fn(dest_row, source_row, width, weight);
+    }
+}
+
+void svr_mosample_bgra8(float* dest, s32 dest_pitch, const u8* source, s32 source_pitch, s32 width, s32 start_row, s32 end_row, float weight)
+{
+    mosample_level(mosample_simd_level, dest, dest_pitch, source, source_pitch, width, start_row, end_row, weight);
+}
+
+void mosample_fixed_level(SvrSimdLevel level, u16* dest, s32 dest_pitch, const u8* source, s32 source_pitch, s32 width, s32 start_row, s32 end_row, float weight)
+{
+    MosampleFixedRowFn row_fn = MOSAMPLE_FIXED_ROW_FNS[level];
+
+    float scale = mosample_fixed_scale(weight);
+
+    for (s32 y = start_row; y < end_row; y++)
+    {
+        u16* dest_row = (u16*)((u8*)dest + (y * dest_pitch));
+        const u8* source_row = source + (y * source_pitch);
+
+        row_fn(dest_row, source_row, width, scale);
+    }
+}
+
+void svr_mosample_bgra8_fixed16(u16* dest, s32 dest_pitch, const u8* source, s32 source_pitch, s32 width, s32 start_row, s32 end_row, float weight)
+{
+    mosample_fixed_level(mosample_simd_level, dest, dest_pitch, source, source_pitch, width, start_row, end_row, weight);
+}
+
+// -------------------------------------------------
+
+struct MosampleBenchData
+{
+    SvrSimdLevel level;
+    bool fixed;
+    void* dest;
+    const u8* source;
+    s32 width;
+    float weight;
+};
+
+void mosample_bench_band_fn(s32 start_row, s32 end_row, void* user)
+{
+    MosampleBenchData* data = (MosampleBenchData*)user;
+
+    if (data->fixed)
+    {
+        mosample_fixed_level(data->level, (u16*)data->dest, data->width * 3 * sizeof(u16), data->source, data->width * 4, data->width, start_row, end_row, data->weight);
+    }
+
+    else
+    {
+        mosample_level(data->level, (float*)data->dest, data->width * 3 * sizeof(float), data->source, data->width * 4, data->width, start_row, end_row, data->weight);
+    }
+}
+
+// Accumulates samples of the test frame with both kinds of buffers and returns the largest difference in 8-bit steps.
+float mosample_fixed_error(const u8* source, s32 width, s32 height, const float* weights, s32 num_samples, float* float_mem, u16* fixed_mem)
+{
+    s32 float_pitch = width * 3 * sizeof(float);
+    s32 fixed_pitch = width * 3 * sizeof(u16);
+
+    memset(float_mem, 0, float_pitch * height);
+    memset(fixed_mem, 0, fixed_pitch * height);
+
+    for (s32 i = 0; i < num_samples; i++)
+    {
+        const u8* sample = source + (i * 4);
+
+        mosample_level(SVR_SIMD_NONE, float_mem, float_pitch, sample, width * 4, width, 0, height, weights[i]);
+        mosample_fixed_level(SVR_SIMD_NONE, fixed_mem, fixed_pitch, sample, width * 4, width, 0, height, weights[i]);
+    }
+
+    double max_error = 0.0;
+
+    for (s32 y = 0; y < height; y++)
+    {
+        const float* float_row = (const float*)((const u8*)float_mem + (y * float_pitch));
+        const u16* fixed_row = (const u16*)((const u8*)fixed_mem + (y * fixed_pitch));
+
+        for (s32 c = 0; c < 3; c++)
+        {
+            for (s32 x = 0; x < width; x++)
+            {
+                double fixed_v = (double)fixed_row[(c * width) + x] / 256.0;
+                double float_v = (double)float_row[(c * width) + x] * 255.0;
+                double error = fixed_v > float_v ? fixed_v - float_v : float_v - fixed_v;
+
+                if (error > max_error)
+                {
+                    max_error = error;
+                }
+            }
+        }
+    }
+
+    return (float)max_error;
+}
+
+// Logs how many samples per second can be done at 1080p and 1440p.
+void mosample_bench(SvrSimdLevel max_level, const u8* source, float* test_mem)
+{
+    const s32 BENCH_SIZES[][2] = { { 1920, 1080 }, { 2560, 1440 } };
+    const s32 NUM_BENCH_SIZES = SVR_ARRAY_SIZE(BENCH_SIZES);
+
+    const s32 BENCH_SAMPLES = 60;
+
+    SvrBandPool band_pool = {};
+    svr_band_pool_start(&band_pool, svr_calc_band_threads());
+
+    for (s32 s = 0; s < NUM_BENCH_SIZES; s++)
+    {
+        for (s32 l = SVR_SIMD_NONE; l <= max_level; l++)
+        {
+            for (s32 f = 0; f < 2; f++)
+            {
+                for (s32 b = 0; b < 2; b++)
+                {
+                    bool use_bands = b == 1;
+
+                    MosampleBenchData data;
+                    data.level = (SvrSimdLevel)l;
+                    data.fixed = f == 1;
+                    data.dest = test_mem;
+                    data.source = source;
+                    data.width = BENCH_SIZES[s][0];
+                    data.weight = 1.0f / BENCH_SAMPLES;
+
+                    s32 height = BENCH_SIZES[s][1];
+
+                    s64 start = svr_prof_get_real_time();
+
+                    for (s32 i = 0; i < BENCH_SAMPLES; i++)
+                    {
+                        if (use_bands) svr_band_pool_run(&band_pool, height, mosample_bench_band_fn, &data);
+                        else mosample_bench_band_fn(0, height, &data);
+                    }
+
+                    s64 time = svr_prof_get_real_time() - start;
+
+                    double rate = ((double)BENCH_SAMPLES * 1000000.0) / (double)time;
+
+                    // The source is read and every pixel of the buffer is loaded and stored.
+                    s32 px_traffic = 4 + (2 * (3 * (data.fixed ? sizeof(u16) : sizeof(float))));
+                    double traffic = ((double)data.width * height * px_traffic) / (1024.0 * 1024.0);
+
+                    svr_log("Motion sampling %dx%d into %s with %s on %d threads: %.1f samples/s, %.1f MB per sample, %.2f GB/s\n", data.width, height, data.fixed ? "fixed point" : "float", svr_get_simd_level_name((SvrSimdLevel)l), use_bands ? band_pool.num_threads + 1 : 1, rate, traffic, (traffic * rate) / 1024.0);
+                }
+            }
+        }
+    }
+
+    svr_band_pool_stop(&band_pool);
+}
+
+bool svr_mosample_self_test(bool bench)
+{
+    // Odd sizes are here so the ends of the rows are tested too.
+    const s32 TEST_SIZES[][2] = { { 1, 1 }, { 3, 5 }, { 67, 33 }, { 1921, 1081 } };
+    const s32 NUM_TEST_SIZES = SVR_ARRAY_SIZE(TEST_SIZES);
+
+    const s32 TEST_SAMPLES = 7;
+
+    const s32 MAX_WIDTH = 2560;
+    const s32 MAX_HEIGHT = 1440;
+
+    s32 num_px = MAX_WIDTH * MAX_HEIGHT;
+
+    // The source needs room for the shifted samples.
+    u8* source = (u8*)malloc((num_px + 256) * 4);
+    float* ref_mem = (float*)malloc(num_px * 3 * sizeof(float));
+    float* test_mem = (float*)malloc(num_px * 3 * sizeof(float));
+
+    SvrSimdLevel max_level = svr_get_simd_level();
+
+    s32 num_fails = 0;
+
+    u32 seed = 1;
+
+    if (source == NULL || ref_mem == NULL || test_mem == NULL)
+    {
+        svr_log("Could not allocate the motion sampling test\n");
+        num_fails++;
+        goto rexit;
+    }
+
+    for (s32 i = 0; i < (num_px + 256) * 4; i++)
+    {
+        seed = (seed * 1664525) + 1013904223;
+        source[i] = (u8)(seed >> 24);
+    }
+
+    for (s32 l = SVR_SIMD_SSE41; l <= max_level; l++)
+    {
+        for (s32 s = 0; s < NUM_TEST_SIZES; s++)
+        {
+            for (s32 f = 0; f < 2; f++)
+            {
+                bool fixed = f == 1;
+
+                s32 width = TEST_SIZES[s][0];
+                s32 height = TEST_SIZES[s][1];
+                s32 pitch = width * 4;
+                s32 dest_pitch = fixed ? width * 3 * sizeof(u16) : width * 3 * sizeof(float);
+                s32 size = dest_pitch * height;
+
+                memset(ref_mem, 0, size);
+                memset(test_mem, 0, size);
+
+                // Weights that are not exact in binary, like with a real exposure.
+                for (s32 i = 0; i < TEST_SAMPLES; i++)
+                {
+                    float weight = 1.0f / TEST_SAMPLES;
+                    const u8* sample = source + (i * 4);
+
+                    if (fixed)
+                    {
+                        mosample_fixed_level(SVR_SIMD_NONE, (u16*)ref_mem, dest_pitch, sample, pitch, width, 0, height, weight);
+                        mosample_fixed_level((SvrSimdLevel)l, (u16*)test_mem, dest_pitch, sample, pitch, width, 0, height, weight);
+                    }
+
+                    else
+                    {
+                        mosample_level(SVR_SIMD_NONE, ref_mem, dest_pitch, sample, pitch, width, 0, height, weight);
+                        mosample_level((SvrSimdLevel)l, test_mem, dest_pitch, sample, pitch, width, 0, height, weight);
+                    }
+                }
+
+                if (memcmp(ref_mem, test_mem, size))
+                {
+                    svr_log("Motion sampling into %s with %s at %dx%d is not the same as the reference\n", fixed ? "fixed point" : "float", svr_get_simd_level_name((SvrSimdLevel)l), width, height);
+                    num_fails++;
+                }
+            }
+        }
+    }
+
+    svr_log("Motion sampling test done with %d failures\n", num_fails);
+
+    if (bench)
+    {
+        mosample_bench(max_level, source, test_mem);
+    }
+
+rexit:
+    free(source);
+    free(ref_mem);
+    free(test_mem);
+
+    return num_fails == 0;
+}
+
+bool svr_mosample_fixed_error_test()
+{
+    // Video frames to check the fixed point error with, as mosample_mult and mosample_exposure. The weights come from
+    // the same schedule as in a movie, so exposures that do not line up with the game frames give uneven weights.
+    struct ErrorCase
+    {
+        s32 mult;
+        float exposure;
+    };
+
+    const ErrorCase ERROR_CASES[] = { { 7, 1.0f }, { 60, 1.0f }, { 255, 1.0f }, { 7, 0.6f }, { 60, 0.5f }, { 100, 0.37f } };
+    const s32 NUM_ERROR_CASES = SVR_ARRAY_SIZE(ERROR_CASES);
+
+    const s32 MAX_SAMPLES = 255;
+
+    const s32 WIDTH = 1921;
+    const s32 HEIGHT = 1081;
+
+    s32 num_px = WIDTH * HEIGHT;
+
+    // The source is shifted by one pixel for every sample, so the samples are different from each other like in a moving scene.
+    u8* source = (u8*)malloc((num_px + MAX_SAMPLES) * 4);
+    float* float_mem = (float*)malloc(num_px * 3 * sizeof(float));
+    u16* fixed_mem = (u16*)malloc(num_px * 3 * sizeof(u16));
+
+    s32 num_fails = 0;
+
+    u32 seed = 1;
+
+    if (source == NULL || float_mem == NULL || fixed_mem == NULL)
+    {
+        svr_log("Could not allocate the fixed point error test\n");
+        num_fails++;
+        goto rexit;
+    }
+
+    for (s32 i = 0; i < (num_px + MAX_SAMPLES) * 4; i++)
+    {
+        seed = (seed * 1664525) + 1013904223;
+        source[i] = (u8)(seed >> 24);
+    }
+
+    for (s32 i = 0; i < NUM_ERROR_CASES; i++)
+    {
+        const ErrorCase& ec = ERROR_CASES[i];
+
+        float weights[MAX_SAMPLES];
+        s32 num_samples = 0;
+
+        SvrMosampleSched sched;
+        svr_mosample_sched_init(&sched, ec.mult, ec.exposure);
+
+        // Game frames that are outside of the exposure are not sampled.
+        for (s32 j = 0; j < ec.mult; j++)
+        {
+            SvrMosampleStep step = svr_mosample_sched_advance(&sched, 1);
+
+            if (step.weight > 0.0f)
+            {
+                weights[num_samples] = step.weight;
+                num_samples++;
+            }
+        }
+
+        // See svr_mosample.h. The float accumulation is not exact either, which the small extra covers.
+        float max_error = mosample_fixed_error(source, WIDTH, HEIGHT, weights, num_samples, float_mem, fixed_mem);
+        float bound = (num_samples / 512.0f) + 0.001f;
+
+        svr_log("Motion sampling into fixed point with mult %d and exposure %.2f (%d samples) is off by up to %.4f steps (limit %.4f)\n", ec.mult, ec.exposure, num_samples, max_error, bound);
+
+        if (max_error > bound)
+        {
+            num_fails++;
+        }
+    }
+
+    svr_log("Fixed point error test done with %d failures\n", num_fails);
+
+rexit:
+    free(source);
+    free(float_mem);
+    free(fixed_mem);
+
+    return num_fails == 0;
+}
+
+#pragma float_control(pop)
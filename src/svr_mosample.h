@@ -0,0 +1,44 @@
+#pragma once
+#include "svr_common.h"
+#include "svr_cpu.h"
+
+// Motion sampling for frames in system memory. This is the CPU equivalent of motion_sample.hlsl.
+// Frames are accumulated into a buffer of floats where every row holds the R, G and B channels one after the other,
+// each as width values. Alpha is dropped. This way a vector holds the same channel of 4, 8 or 16 pixels.
+//
+// The result is the same to the bit as adding (source / 255) * weight one channel at a time, for every instruction set.
+// Compared to the shader there can be a difference of up to 2 ulp per sample, as the GPU is allowed to be off by that much
+// in the unorm to float conversion and may fuse the multiply and add. With weights that add up to 1, which is the case
+// for a whole video frame, the accumulated values will differ by less than 1e-6 (0.0003 of one 8-bit step).
+
+// Frames can also be accumulated into 16-bit fixed point channels, which cuts the memory traffic of a sample from
+// 28 bytes per pixel (source, load and store of the floats) to 16. The rows are laid out the same as the floats.
+// This is what svr_pxconv_from_fixed16 reads.
+// A value is the 8-bit source value in 8.8 fixed point, so 65280 is 1. For every sample, (source * weight * 256) is rounded
+// to the nearest integer and added, saturating at 65535. The weight must be between 0 and 1.
+//
+// Rounding the products instead of the weights keeps the error of every sample within half a fixed point step,
+// no matter how small the weight is. After n samples the result is therefore within n / 512 of an 8-bit step of the
+// float accumulation, which is 0.12 steps for 60 samples per frame and stays below half a step for fewer than 256 samples.
+// Weights that add up to 1 cannot saturate with up to 510 samples, and then only for values that are clamped to 1 anyway.
+
+// To be called once before accumulating. Selects the instruction set to use.
+void svr_mosample_init();
+
+SvrSimdLevel svr_mosample_get_simd_level();
+
+// Adds the rows from start_row to end_row of a BGRA8 frame multiplied by weight into a float frame (see above).
+// Rows are given so that a frame can be split up between threads (see SvrBandPool). The pitches are in bytes.
+void svr_mosample_bgra8(float* dest, s32 dest_pitch, const u8* source, s32 source_pitch, s32 width, s32 start_row, s32 end_row, float weight);
+
+// Same as above but into a fixed point buffer, which takes 6 bytes per pixel instead of 12 (see below).
+void svr_mosample_bgra8_fixed16(u16* dest, s32 dest_pitch, const u8* source, s32 source_pitch, s32 width, s32 start_row, s32 end_row, float weight);
+
+// Checks that every instruction set that the CPU has gives the same result as the reference. With bench, also logs how many
+// samples per second can be done at 1080p and 1440p for both kinds of buffers, with and without splitting between threads.
+// Returns false if any check failed. Run by svr_headless.exe selftest.
+bool svr_mosample_self_test(bool bench);
+
+// Checks that the fixed point accumulation stays within the error above compared to the floats, for video frames with
+// weights from svr_mosample_sched. Returns false if it does not. Run by svr_headless.exe selftest.
+bool svr_mosample_fixed_error_test();
@@ -0,0 +1,66 @@
+#include "svr_mosample_impl.h"
+#include <immintrin.h>
+
+// Motion sampling with AVX2 (8 pixels at a time).
+// This file is built with /arch:AVX2 and must only be called when the CPU has it.
+
+#pragma float_control(precise, on, push)
+#pragma fp_contract(off)
+
+static inline void mosample_channel_avx2(float* dest, __m256i value, __m256 norm, __m256 weight)
+{
+    __m256 sum = _mm256_add_ps(_mm256_loadu_ps(dest), _mm256_mul_ps(_mm256_div_ps(_mm256_cvtepi32_ps(value), norm), weight));
+    _mm256_storeu_ps(dest, sum);
+}
+
+void mosample_row_avx2(float* dest, const u8* source, s32 width, float weight)
+{
+    __m256 norm = _mm256_set1_ps(255.0f);
+    __m256 w = _mm256_set1_ps(weight);
+    __m256i mask = _mm256_set1_epi32(0xff);
+
+    s32 x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        __m256i px = _mm256_loadu_si256((const __m256i*)(source + (x * 4)));
+
+        mosample_channel_avx2(dest + x, _mm256_and_si256(_mm256_srli_epi32(px, 16), mask), norm, w);
+        mosample_channel_avx2(dest + width + x, _mm256_and_si256(_mm256_srli_epi32(px, 8), mask), norm, w);
+        mosample_channel_avx2(dest + (width * 2) + x, _mm256_and_si256(px, mask), norm, w);
+    }
+
+    mosample_row_reference(dest, source, x, width, weight);
+}
+
+static inline void mosample_fixed_channel_avx2(u16* dest, __m256i value, __m256 scale, __m256i max)
+{
+    __m256i product = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(value), scale));
+    __m256i acc = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)dest));
+    __m256i sum = _mm256_min_epi32(_mm256_add_epi32(acc, product), max);
+
+    // The packing instructions work within the 128-bit halves, so the halves are packed together instead.
+    _mm_storeu_si128((__m128i*)dest, _mm_packus_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1)));
+}
+
+void mosample_fixed_row_avx2(u16* dest, const u8* source, s32 width, float scale)
+{
+    __m256 s = _mm256_set1_ps(scale);
+    __m256i mask = _mm256_set1_epi32(0xff);
+    __m256i max = _mm256_set1_epi32(65535);
+
+    s32 x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        __m256i px = _mm256_loadu_si256((const __m256i*)(source + (x * 4)));
+
+        mosample_fixed_channel_avx2(dest + x, _mm256_and_si256(_mm256_srli_epi32(px, 16), mask), s, max);
+        mosample_fixed_channel_avx2(dest + width + x, _mm256_and_si256(_mm256_srli_epi32(px, 8), mask), s, max);
+        mosample_fixed_channel_avx2(dest + (width * 2) + x, _mm256_and_si256(px, mask), s, max);
+    }
+
+    mosample_fixed_row_reference(dest, source, x, width, scale);
+}
+
+#pragma float_control(pop)
@@ -0,0 +1,67 @@
+#include "svr_mosample_impl.h"
+#include <immintrin.h>
+
+// Motion sampling with AVX-512 (16 pixels at a time).
+// This file is built with /arch:AVX512 and must only be called when the CPU has it. The intrinsics are only from AVX-512F,
+// but the compiler can also use DQ, BW and VL in this file.
+
+#pragma float_control(precise, on, push)
+#pragma fp_contract(off)
+
+static inline void mosample_channel_avx512(float* dest, __m512i value, __m512 norm, __m512 weight)
+{
+    __m512 sum = _mm512_add_ps(_mm512_loadu_ps(dest), _mm512_mul_ps(_mm512_div_ps(_mm512_cvtepi32_ps(value), norm), weight));
+    _mm512_storeu_ps(dest, sum);
+}
+
+void mosample_row_avx512(float* dest, const u8* source, s32 width, float weight)
+{
+    __m512 norm = _mm512_set1_ps(255.0f);
+    __m512 w = _mm512_set1_ps(weight);
+    __m512i mask = _mm512_set1_epi32(0xff);
+
+    s32 x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        __m512i px = _mm512_loadu_si512((const void*)(source + (x * 4)));
+
+        mosample_channel_avx512(dest + x, _mm512_and_si512(_mm512_srli_epi32(px, 16), mask), norm, w);
+        mosample_channel_avx512(dest + width + x, _mm512_and_si512(_mm512_srli_epi32(px, 8), mask), norm, w);
+        mosample_channel_avx512(dest + (width * 2) + x, _mm512_and_si512(px, mask), norm, w);
+    }
+
+    mosample_row_reference(dest, source, x, width, weight);
+}
+
+static inline void mosample_fixed_channel_avx512(u16* dest, __m512i value, __m512 scale, __m512i max)
+{
+    __m512i product = _mm512_cvtps_epi32(_mm512_mul_ps(_mm512_cvtepi32_ps(value), scale));
+    __m512i acc = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)dest));
+
+    // The values are clamped before they are narrowed, as the saturating 16-bit operations would need AVX-512BW.
+    __m512i sum = _mm512_min_epi32(_mm512_add_epi32(acc, product), max);
+    _mm256_storeu_si256((__m256i*)dest, _mm512_cvtepi32_epi16(sum));
+}
+
+void mosample_fixed_row_avx512(u16* dest, const u8* source, s32 width, float scale)
+{
+    __m512 s = _mm512_set1_ps(scale);
+    __m512i mask = _mm512_set1_epi32(0xff);
+    __m512i max = _mm512_set1_epi32(65535);
+
+    s32 x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        __m512i px = _mm512_loadu_si512((const void*)(source + (x * 4)));
+
+        mosample_fixed_channel_avx512(dest + x, _mm512_and_si512(_mm512_srli_epi32(px, 16), mask), s, max);
+        mosample_fixed_channel_avx512(dest + width + x, _mm512_and_si512(_mm512_srli_epi32(px, 8), mask), s, max);
+        mosample_fixed_channel_avx512(dest + (width * 2) + x, _mm512_and_si512(px, mask), s, max);
+    }
+
+    mosample_fixed_row_reference(dest, source, x, width, scale);
+}
+
+#pragma float_control(pop)
@@ -0,0 +1,78 @@
+#pragma once
+#include "svr_mosample.h"
+#include <math.h>
+
+// Internal to the motion sampling.
+// Shared between svr_mosample.cpp and the vectorized rows in the svr_mosample_<instruction set>.cpp files.
+// Every file that uses this must keep precise floating point so the results are the same.
+// The functions here are static for the same reason as in svr_pxconv_impl.h.
+
+// Adds width pixels from a row into a float row (R, G and B one after the other).
+// The vectorized versions do the pixels that do not fill a whole vector with this.
+static inline void mosample_row_reference(float* dest, const u8* source, s32 start, s32 width, float weight)
+{
+    float* dest_r = dest;
+    float* dest_g = dest + width;
+    float* dest_b = dest + (width * 2);
+
+    for (s32 x = start; x < width; x++)
+    {
+        const u8* px = source + (x * 4);
+        dest_r[x] += ((float)px[2] / 255.0f) * weight;
+        dest_g[x] += ((float)px[1] / 255.0f) * weight;
+        dest_b[x] += ((float)px[0] / 255.0f) * weight;
+    }
+}
+
+typedef void(*MosampleRowFn)(float* dest, const u8* source, s32 width, float weight);
+
+// Indexed by SvrSimdLevel.
+extern const MosampleRowFn MOSAMPLE_ROW_FNS[];
+
+void mosample_row_sse41(float* dest, const u8* source, s32 width, float weight);
+void mosample_row_avx2(float* dest, const u8* source, s32 width, float weight);
+void mosample_row_avx512(float* dest, const u8* source, s32 width, float weight);
+
+// Adds one channel to a fixed point value. The vectorized versions round with the conversion instruction, which is
+// also round to nearest even.
+static inline u16 mosample_fixed_add(u16 acc, u8 value, float scale)
+{
+    s32 sum = (s32)acc + (s32)lrintf((float)value * scale);
+    return (u16)(sum < 65535 ? sum : 65535);
+}
+
+// Adds width pixels from a row into a fixed point row (R, G and B one after the other). The scale is the weight times 256.
+// The vectorized versions do the pixels that do not fill a whole vector with this.
+static inline void mosample_fixed_row_reference(u16* dest, const u8* source, s32 start, s32 width, float scale)
+{
+    u16* dest_r = dest;
+    u16* dest_g = dest + width;
+    u16* dest_b = dest + (width * 2);
+
+    for (s32 x = start; x < width; x++)
+    {
+        const u8* px = source + (x * 4);
+        dest_r[x] = mosample_fixed_add(dest_r[x], px[2], scale);
+        dest_g[x] = mosample_fixed_add(dest_g[x], px[1], scale);
+        dest_b[x] = mosample_fixed_add(dest_b[x], px[0], scale);
+    }
+}
+
+// The scale that the fixed point rows are given, so that the products are rounded the same everywhere.
+static inline float mosample_fixed_scale(float weight)
+{
+    return weight * 256.0f;
+}
+
+typedef void(*MosampleFixedRowFn)(u16* dest, const u8* source, s32 width, float scale);
+
+// Indexed by SvrSimdLevel.
+extern const MosampleFixedRowFn MOSAMPLE_FIXED_ROW_FNS[];
+
+void mosample_fixed_row_sse41(u16* dest, const u8* source, s32 width, float scale);
+void mosample_fixed_row_avx2(u16* dest, const u8* source, s32 width, float scale);
+void mosample_fixed_row_avx512(u16* dest, const u8* source, s32 width, float scale);
+
+// Same as svr_mosample_bgra8 and svr_mosample_bgra8_fixed16 but with a chosen instruction set.
+void mosample_level(SvrSimdLevel level, float* dest, s32 dest_pitch, const u8* source, s32 source_pitch, s32 width, s32 start_row, s32 end_row, float weight);
+void mosample_fixed_level(SvrSimdLevel level, u16* dest, s32 dest_pitch, const u8* source, s32 source_pitch, s32 width, s32 start_row, s32 end_row, float weight);
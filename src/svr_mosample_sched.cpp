@@ -0,0 +1,84 @@
+#include "svr_mosample_sched.h"
+#include <math.h>
+#include <assert.h>
+
+// The exposure is a float from the profile, this is how finely it is kept.
+const s64 MOSAMPLE_TICKS_PER_GAME_FRAME = 65536;
+
+void svr_mosample_sched_init(SvrMosampleSched* sched, s32 mult, float exposure)
+{
+    assert(mult > 0);
+
+    sched->game_frame_len = MOSAMPLE_TICKS_PER_GAME_FRAME;
+    sched->video_frame_len = MOSAMPLE_TICKS_PER_GAME_FRAME * mult;
+
+    s64 exposure_len = llround((double)exposure * (double)sched->video_frame_len);
+
+    if (exposure_len < 1)
+    {
+        exposure_len = 1;
+    }
+
+    if (exposure_len > sched->video_frame_len)
+    {
+        exposure_len = sched->video_frame_len;
+    }
+
+    sched->open_time = sched->video_frame_len - exposure_len;
+    sched->time = 0;
+}
+
+// How much of the time between start and end the shutter is open for, divided by the exposure.
+// The times are in the same video frame.
+static float calc_mosample_weight(SvrMosampleSched* sched, s64 start, s64 end)
+{
+    if (start < sched->open_time)
+    {
+        start = sched->open_time;
+    }
+
+    if (end <= start)
+    {
+        return 0.0f;
+    }
+
+    // Only one rounding to float at the end.
+    return (float)((double)(end - start) / (double)(sched->video_frame_len - sched->open_time));
+}
+
+SvrMosampleStep svr_mosample_sched_advance(SvrMosampleSched* sched, s32 num_game_frames)
+{
+    assert(num_game_frames > 0);
+
+    SvrMosampleStep ret = {};
+
+    s64 end = sched->time + (sched->game_frame_len * num_game_frames);
+
+    if (end < sched->video_frame_len)
+    {
+        ret.weight = calc_mosample_weight(sched, sched->time, end);
+        sched->time = end;
+        return ret;
+    }
+
+    ret.weight = calc_mosample_weight(sched, sched->time, sched->video_frame_len);
+    ret.num_frames = (s32)(end / sched->video_frame_len);
+
+    sched->time = end % sched->video_frame_len;
+
+    ret.next_weight = calc_mosample_weight(sched, 0, sched->time);
+
+    return ret;
+}
+
+s32 svr_mosample_sched_next_needed(SvrMosampleSched* sched)
+{
+    // The time is always at the end of a game frame so this divides evenly.
+    // The game frame that ends after the shutter opens is the first one that is used, and that cannot be after the end of the video frame.
+    if (sched->time >= sched->open_time)
+    {
+        return 1;
+    }
+
+    return (s32)((sched->open_time - sched->time) / sched->game_frame_len) + 1;
+}
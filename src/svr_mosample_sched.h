@@ -0,0 +1,50 @@
+#pragma once
+#include "svr_common.h"
+
+// Decides how much every game frame counts towards the motion blurred video frames.
+// A video frame is made of mosample_mult game frames, and a game frame stands for the time since the one before it.
+// The shutter is open for the last part of every video frame (the exposure), and the weight of a game frame is how much
+// of its time the shutter is open, divided by the exposure.
+//
+// Time is counted in integer ticks, so the ticks given to every video frame always add up to exactly its exposure and nothing
+// is lost or gained however long the movie is. The float weights made from them are rounded, so they only add up to about 1.
+// The exposure is rounded to a tick, which is 1/65536 of a game frame.
+// An exposure of 0 is the same as the shortest possible exposure, which only takes the last game frame.
+
+struct SvrMosampleSched
+{
+    // Lengths in ticks.
+    s64 game_frame_len;
+    s64 video_frame_len;
+
+    // When the shutter opens in the video frame.
+    s64 open_time;
+
+    // End of the latest game frame in the video frame.
+    s64 time;
+};
+
+// What to do with a game frame.
+struct SvrMosampleStep
+{
+    // How much this game frame counts towards the current video frame. Is 0 when it is not used at all.
+    float weight;
+
+    // How many video frames are completed by this game frame. The first one gets the weight above and the rest are repeats of it.
+    // This is only above 1 if more than a video frame is advanced at once.
+    s32 num_frames;
+
+    // When video frames are completed, how much this game frame counts towards the next video frame.
+    float next_weight;
+};
+
+void svr_mosample_sched_init(SvrMosampleSched* sched, s32 mult, float exposure);
+
+// Moves ahead by a number of game frames, where the game frames in between are skipped. This is 1 when every game frame is given.
+// The game frame that is moved to stands for all of the time, so skipping game frames will only leave out time if they
+// were outside of the exposure.
+SvrMosampleStep svr_mosample_sched_advance(SvrMosampleSched* sched, s32 num_game_frames);
+
+// How many game frames to move ahead by to get to the next game frame that is used. This is 1 when the next game frame is used.
+// Moving ahead by this will never complete more than one video frame, as the last game frame of a video frame is always used.
+s32 svr_mosample_sched_next_needed(SvrMosampleSched* sched);
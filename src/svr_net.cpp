@@ -0,0 +1,372 @@
+#include "svr_net.h"
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#include <bcrypt.h>
+#include <strsafe.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Sockets are kept as u64 outside of here so that the headers of Winsock do not have to be included before Windows.h everywhere.
+
+bool svr_net_init()
+{
+    WSADATA data;
+    return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+}
+
+// The host is 256 characters and the port is 16.
+void split_net_address(const char* address, char* host, char* port)
+{
+    StringCchCopyA(host, 256, address);
+    StringCchPrintfA(port, 16, "%d", (s32)SVR_NET_DEFAULT_PORT);
+
+    char* colon = strrchr(host, ':');
+
+    if (colon)
+    {
+        StringCchCopyA(port, 16, colon + 1);
+        *colon = 0;
+    }
+}
+
+bool svr_net_connect(SvrNetConn* conn, const char* address)
+{
+    bool ret = false;
+
+    *conn = {};
+
+    char host[256];
+    char port[16];
+
+    addrinfo hints = {};
+    addrinfo* results = NULL;
+
+    SOCKET sock = INVALID_SOCKET;
+
+    // Small messages like the end of a part are not held back to be sent together with the next.
+    BOOL no_delay = TRUE;
+
+    split_net_address(address, host, port);
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    if (getaddrinfo(host, port, &hints, &results) != 0)
+    {
+        goto rexit;
+    }
+
+    for (addrinfo* it = results; it; it = it->ai_next)
+    {
+        sock = socket(it->ai_family, it->ai_socktype, it->ai_protocol);
+
+        if (sock == INVALID_SOCKET)
+        {
+            continue;
+        }
+
+        if (connect(sock, it->ai_addr, (int)it->ai_addrlen) == 0)
+        {
+            break;
+        }
+
+        closesocket(sock);
+        sock = INVALID_SOCKET;
+    }
+
+    if (sock == INVALID_SOCKET)
+    {
+        goto rexit;
+    }
+
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&no_delay, sizeof(no_delay));
+
+    conn->sock = (u64)sock;
+
+    ret = true;
+
+rexit:
+    if (results) freeaddrinfo(results);
+
+    return ret;
+}
+
+u64 svr_net_listen(const char* address)
+{
+    char host[256];
+    char port[16];
+
+    addrinfo hints = {};
+    addrinfo* results = NULL;
+
+    SOCKET sock = INVALID_SOCKET;
+
+    split_net_address(address, host, port);
+
+    // Only numeric addresses so that it is clear which network this can be reached from.
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICHOST;
+
+    if (getaddrinfo(host, port, &hints, &results) != 0)
+    {
+        return 0;
+    }
+
+    sock = socket(results->ai_family, results->ai_socktype, results->ai_protocol);
+
+    if (sock != INVALID_SOCKET && (bind(sock, results->ai_addr, (int)results->ai_addrlen) != 0 || listen(sock, SOMAXCONN) != 0))
+    {
+        closesocket(sock);
+        sock = INVALID_SOCKET;
+    }
+
+    freeaddrinfo(results);
+
+    if (sock == INVALID_SOCKET)
+    {
+        return 0;
+    }
+
+    return (u64)sock;
+}
+
+bool svr_net_accept(u64 listen_sock, SvrNetConn* conn)
+{
+    *conn = {};
+
+    SOCKET sock = accept((SOCKET)listen_sock, NULL, NULL);
+
+    if (sock == INVALID_SOCKET)
+    {
+        return false;
+    }
+
+    BOOL no_delay = TRUE;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&no_delay, sizeof(no_delay));
+
+    conn->sock = (u64)sock;
+    return true;
+}
+
+void svr_net_close(SvrNetConn* conn)
+{
+    if (conn->sock)
+    {
+        closesocket((SOCKET)conn->sock);
+        conn->sock = 0;
+    }
+}
+
+void svr_net_close_listen(u64 listen_sock)
+{
+    closesocket((SOCKET)listen_sock);
+}
+
+void svr_net_set_timeout(SvrNetConn* conn, s32 ms)
+{
+    DWORD timeout = (DWORD)ms;
+
+    setsockopt((SOCKET)conn->sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+    setsockopt((SOCKET)conn->sock, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+}
+
+// send and recv can do less than what they were given.
+
+bool send_all(SvrNetConn* conn, const void* data, s32 size)
+{
+    const char* ptr = (const char*)data;
+
+    while (size > 0)
+    {
+        int sent = send((SOCKET)conn->sock, ptr, size, 0);
+
+        if (sent <= 0)
+        {
+            conn->timed_out = WSAGetLastError() == WSAETIMEDOUT;
+            return false;
+        }
+
+        ptr += sent;
+        size -= sent;
+    }
+
+    return true;
+}
+
+bool recv_all(SvrNetConn* conn, void* data, s32 size)
+{
+    char* ptr = (char*)data;
+
+    while (size > 0)
+    {
+        int got = recv((SOCKET)conn->sock, ptr, size, 0);
+
+        if (got <= 0)
+        {
+            conn->timed_out = got < 0 && WSAGetLastError() == WSAETIMEDOUT;
+            return false;
+        }
+
+        ptr += got;
+        size -= got;
+    }
+
+    return true;
+}
+
+bool svr_net_send(SvrNetConn* conn, SvrNetType type, s32 value, const void* data, s32 size)
+{
+    if (conn->sock == 0)
+    {
+        return false;
+    }
+
+    SvrNetHeader header;
+    header.magic = SVR_NET_MAGIC;
+    header.type = type;
+    header.seq = conn->send_seq;
+    header.size = size;
+    header.value = value;
+
+    conn->send_seq++;
+
+    if (!send_all(conn, &header, sizeof(SvrNetHeader)))
+    {
+        return false;
+    }
+
+    return size == 0 || send_all(conn, data, size);
+}
+
+bool svr_net_recv(SvrNetConn* conn, SvrNetHeader* header, void* buf, s32 buf_size)
+{
+    if (conn->sock == 0)
+    {
+        return false;
+    }
+
+    if (!recv_all(conn, header, sizeof(SvrNetHeader)))
+    {
+        return false;
+    }
+
+    if (header->magic != SVR_NET_MAGIC || header->seq != conn->recv_seq || header->size < 0 || header->size > buf_size)
+    {
+        return false;
+    }
+
+    conn->recv_seq++;
+
+    return header->size == 0 || recv_all(conn, buf, header->size);
+}
+
+// -------------------------------------------------
+
+// HMAC-SHA256 of the data with the secret as the key.
+bool make_net_answer(const char* secret, const u8* data, u8* dest)
+{
+    bool ret = false;
+
+    BCRYPT_ALG_HANDLE alg = NULL;
+    BCRYPT_HASH_HANDLE hash = NULL;
+
+    if (!BCRYPT_SUCCESS(BCryptOpenAlgorithmProvider(&alg, BCRYPT_SHA256_ALGORITHM, NULL, BCRYPT_ALG_HANDLE_HMAC_FLAG)))
+    {
+        goto rexit;
+    }
+
+    if (!BCRYPT_SUCCESS(BCryptCreateHash(alg, &hash, NULL, 0, (PUCHAR)secret, (ULONG)strlen(secret), 0)))
+    {
+        goto rexit;
+    }
+
+    if (!BCRYPT_SUCCESS(BCryptHashData(hash, (PUCHAR)data, SVR_NET_AUTH_SIZE, 0)))
+    {
+        goto rexit;
+    }
+
+    if (!BCRYPT_SUCCESS(BCryptFinishHash(hash, dest, SVR_NET_AUTH_SIZE, 0)))
+    {
+        goto rexit;
+    }
+
+    ret = true;
+
+rexit:
+    if (hash) BCryptDestroyHash(hash);
+    if (alg) BCryptCloseAlgorithmProvider(alg, 0);
+
+    return ret;
+}
+
+bool svr_net_hello(SvrNetConn* conn, const char* secret)
+{
+    SvrNetHeader header;
+
+    u8 challenge[SVR_NET_AUTH_SIZE];
+    u8 answer[SVR_NET_AUTH_SIZE];
+
+    if (!svr_net_recv(conn, &header, challenge, SVR_NET_AUTH_SIZE))
+    {
+        return false;
+    }
+
+    if (header.type != SVR_NET_CHALLENGE || header.size != SVR_NET_AUTH_SIZE || header.value != SVR_NET_VERSION)
+    {
+        return false;
+    }
+
+    if (!make_net_answer(secret, challenge, answer))
+    {
+        return false;
+    }
+
+    return svr_net_send(conn, SVR_NET_HELLO, SVR_NET_VERSION, answer, SVR_NET_AUTH_SIZE);
+}
+
+bool svr_net_check_hello(SvrNetConn* conn, const char* secret)
+{
+    SvrNetHeader header;
+
+    u8 challenge[SVR_NET_AUTH_SIZE];
+    u8 expected[SVR_NET_AUTH_SIZE];
+    u8 answer[SVR_NET_AUTH_SIZE];
+
+    u8 diff = 0;
+
+    if (!BCRYPT_SUCCESS(BCryptGenRandom(NULL, challenge, SVR_NET_AUTH_SIZE, BCRYPT_USE_SYSTEM_PREFERRED_RNG)))
+    {
+        return false;
+    }
+
+    if (!make_net_answer(secret, challenge, expected))
+    {
+        return false;
+    }
+
+    if (!svr_net_send(conn, SVR_NET_CHALLENGE, SVR_NET_VERSION, challenge, SVR_NET_AUTH_SIZE))
+    {
+        return false;
+    }
+
+    if (!svr_net_recv(conn, &header, answer, SVR_NET_AUTH_SIZE))
+    {
+        return false;
+    }
+
+    if (header.type != SVR_NET_HELLO || header.size != SVR_NET_AUTH_SIZE || header.value != SVR_NET_VERSION)
+    {
+        return false;
+    }
+
+    // Every byte is compared so that the time does not say how much of the answer was right.
+    for (s32 i = 0; i < SVR_NET_AUTH_SIZE; i++)
+    {
+        diff |= answer[i] ^ expected[i];
+    }
+
+    return diff == 0;
+}
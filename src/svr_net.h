@@ -0,0 +1,158 @@
+#pragma once
+#include "svr_common.h"
+
+// Connection between the game and an encode worker on another computer (see encoder_workers in the profile and encoder_main.cpp).
+// The game encodes the movie in parts like it does with several ffmpeg processes, but the parts are sent over TCP to
+// svr_encoder.exe --worker on the other computers, which run ffmpeg there and send the encoded parts back when they are done.
+// The parts are then joined by the game like it always does. The audio is never sent, it is added when the parts are joined.
+//
+// Every message starts with a header that says what it is and how much data comes after it. The messages in each direction
+// are numbered so that a connection that has lost its place is noticed right away.
+//
+// The worker only listens on the address it is started with, and a game must show that it has the same secret as the worker
+// before anything else is done. The worker sends random bytes and the game answers with an HMAC-SHA256 of them with the secret
+// as the key, so the secret itself is never sent. Nothing else is encrypted.
+// The worker does not run ffmpeg with arguments from the game. It makes them itself from the values in SvrNetPartStart,
+// and only allows values that SVR can make.
+//
+// The worker gives the game credits, one for every frame that it has room for. The game uses one for every frame it sends and
+// waits for more when it has none, and the worker gives one back when it has given a frame to ffmpeg. This way the game knows
+// when the network or the worker is what it is waiting for, and the worker never has more than that many frames from one game.
+
+const u32 SVR_NET_MAGIC = 0x4E525653; // SVRN
+
+// To be increased when the messages change. Games and workers of different versions cannot be used together.
+const s32 SVR_NET_VERSION = 2;
+
+// Used if the address has no port.
+const u16 SVR_NET_DEFAULT_PORT = 27750;
+
+// Frames that a worker has room for on every connection.
+const s32 SVR_NET_CREDITS = 8;
+
+// Size of the data messages of an encoded part.
+const s32 SVR_NET_CHUNK_SIZE = 1024 * 1024;
+
+const s32 SVR_NET_MAX_EXTENSION = 16;
+const s32 SVR_NET_MAX_NAME = 16;
+
+// Size of the random bytes of the worker and of the answer of the game.
+const s32 SVR_NET_AUTH_SIZE = 32;
+
+// Shortest secret that games and workers can be given.
+const s32 SVR_NET_MIN_SECRET = 8;
+
+// A game gives up on a worker that it has been waiting for this long (in milliseconds), and a worker gives up on a game that
+// has not answered its random bytes in this long.
+const s32 SVR_NET_TIMEOUT = 30000;
+
+// While ffmpeg is finishing a part, which can take longer than the timeout, the worker sends a credit of 0 this often (in milliseconds)
+// to show that it is still there.
+const s32 SVR_NET_KEEPALIVE = 5000;
+
+enum SvrNetType : u32
+{
+    // Worker to game. Random bytes that the game must answer, and the value is the version of the worker.
+    SVR_NET_CHALLENGE,
+
+    // Game to worker. The answer, and the value is the version of the game.
+    SVR_NET_HELLO,
+
+    // Game to worker. A new part starts, with a SvrNetPartStart.
+    SVR_NET_PART_START,
+
+    // Game to worker. A frame of the part, which is in the part as many times as the value says.
+    SVR_NET_FRAME,
+
+    // Game to worker. There are no more frames in the part. The worker finishes it and sends it back.
+    SVR_NET_PART_END,
+
+    // Worker to game. The value is how many more frames the game can send.
+    SVR_NET_CREDIT,
+
+    // Worker to game. The next piece of the encoded part.
+    SVR_NET_PART_DATA,
+
+    // Worker to game. All of the part has been sent, and the value is the exit code of ffmpeg.
+    SVR_NET_PART_DONE,
+};
+
+struct SvrNetHeader
+{
+    u32 magic;
+    SvrNetType type;
+    u32 seq;
+    s32 size;
+    s32 value;
+};
+
+// What the worker makes the ffmpeg arguments from. The names are the names in ffmpeg.
+struct SvrNetPartStart
+{
+    s32 part;
+    s32 frame_size;
+
+    // The worker writes the part to a file of its own with this extension, so that ffmpeg picks the same container.
+    char extension[SVR_NET_MAX_EXTENSION];
+
+    // The frames that are sent.
+    char pix_fmt[SVR_NET_MAX_NAME];
+    s32 width;
+    s32 height;
+    s32 fps;
+
+    // The video that is made from them. The color space is empty for RGB.
+    char codec[SVR_NET_MAX_NAME];
+    char color_space[SVR_NET_MAX_NAME];
+    char preset[SVR_NET_MAX_NAME];
+    s32 crf;
+    s32 intra;
+
+    // Frames that ffmpeg reads ahead of the encoder, which is the length of a part.
+    s32 queue_frames;
+};
+
+struct SvrNetConn
+{
+    // The socket, or 0 if not connected.
+    u64 sock;
+
+    // Numbers of the next message in each direction.
+    u32 send_seq;
+    u32 recv_seq;
+
+    // Set when sending or receiving failed because the other side took longer than the timeout.
+    bool timed_out;
+};
+
+// Must be called before anything else in here. Can be called more than once.
+bool svr_net_init();
+
+// The address is a host name or IP address, with a port after a colon if it is not the default port.
+bool svr_net_connect(SvrNetConn* conn, const char* address);
+
+// For the worker. The address is the IP address of this computer to listen on, with a port like for svr_net_connect.
+// Returns the listening socket, or 0 if it could not be made.
+u64 svr_net_listen(const char* address);
+
+// Waits for a connection on a listening socket.
+bool svr_net_accept(u64 listen_sock, SvrNetConn* conn);
+
+void svr_net_close(SvrNetConn* conn);
+void svr_net_close_listen(u64 listen_sock);
+
+// Longest time in milliseconds that sending or receiving can wait, or 0 to wait forever.
+void svr_net_set_timeout(SvrNetConn* conn, s32 ms);
+
+// For the game. Receives the random bytes of the worker and answers them with the secret.
+bool svr_net_hello(SvrNetConn* conn, const char* secret);
+
+// For the worker. Sends random bytes and returns true if the game answered them with the same secret and is of the same version.
+bool svr_net_check_hello(SvrNetConn* conn, const char* secret);
+
+// Sends a message with its data. The data can be NULL if the size is 0.
+bool svr_net_send(SvrNetConn* conn, SvrNetType type, s32 value, const void* data, s32 size);
+
+// Waits for the next message. The data is put in buf, which must have room for it. Returns false if the connection is lost
+// or the message is not the one that was expected next.
+bool svr_net_recv(SvrNetConn* conn, SvrNetHeader* header, void* buf, s32 buf_size);
@@ -1,41 +1,87 @@
 #include "svr_prof.h"
+#include "svr_cpu.h"
 #include <Windows.h>
+#include <intrin.h>
 
-LARGE_INTEGER prof_timer_freq;
+bool svr_prof_enabled;
+bool svr_prof_launch_enabled;
 
-s64 svr_prof_get_real_time()
+// Reading the TSC takes a fraction of the time of QueryPerformanceCounter.
+bool prof_use_tsc;
+
+// Ticks of the clock are turned into microseconds by multiplying with this and shifting down by PROF_TIME_SHIFT.
+// This avoids the divide of the counter frequency on every read. The multiply is 128-bit (_umul128), so the shift can be large:
+// with 48 the multiplier has more than 36 bits for clocks up to 4 GHz, so rounding it is off by less than a part in 10^10.
+// For clocks of at least 1 MHz the multiplier is at most 2^48, so the product of any tick count is below 2^112 and the shifted result fits.
+const s32 PROF_TIME_SHIFT = 48;
+u64 prof_time_mult;
+
+u64 prof_read_ticks()
 {
+    if (prof_use_tsc)
+    {
+        return __rdtsc();
+    }
+
     LARGE_INTEGER cur_time;
     QueryPerformanceCounter(&cur_time);
 
-    s64 ret = cur_time.QuadPart * 1000000;
-    ret = ret / prof_timer_freq.QuadPart;
-
-    return ret;
+    return cur_time.QuadPart;
 }
 
-void svr_init_prof()
+s64 svr_prof_get_real_time()
 {
-    QueryPerformanceFrequency(&prof_timer_freq);
-}
+    u64 high;
+    u64 low = _umul128(prof_read_ticks(), prof_time_mult, &high);
 
-#if SVR_PROF
+    return (s64)((high << (64 - PROF_TIME_SHIFT)) | (low >> PROF_TIME_SHIFT));
+}
 
-void svr_start_prof(SvrProf* prof)
+// The rate of the TSC is not given by the OS, so it is measured against QueryPerformanceCounter.
+u64 calibrate_tsc_freq(s64 qpc_freq)
 {
-    prof->start = svr_prof_get_real_time();
+    // Long enough for the error to be a few parts in a million.
+    const s64 CALIBRATE_US = 10000;
+
+    LARGE_INTEGER start_qpc;
+    LARGE_INTEGER cur_qpc;
+
+    QueryPerformanceCounter(&start_qpc);
+    u64 start_tsc = __rdtsc();
+
+    s64 end_qpc = start_qpc.QuadPart + (qpc_freq * CALIBRATE_US) / 1000000;
+
+    do
+    {
+        QueryPerformanceCounter(&cur_qpc);
+    }
+    while (cur_qpc.QuadPart < end_qpc);
+
+    u64 end_tsc = __rdtsc();
+
+    double secs = (double)(cur_qpc.QuadPart - start_qpc.QuadPart) / (double)qpc_freq;
+
+    return (u64)((double)(end_tsc - start_tsc) / secs);
 }
 
-void svr_end_prof(SvrProf* prof)
+void svr_init_prof()
 {
-    prof->runs++;
-    prof->total += (svr_prof_get_real_time() - prof->start);
+    LARGE_INTEGER qpc_freq;
+    QueryPerformanceFrequency(&qpc_freq);
+
+    u64 freq = qpc_freq.QuadPart;
+
+    prof_use_tsc = svr_has_invariant_tsc();
+
+    if (prof_use_tsc)
+    {
+        freq = calibrate_tsc_freq(qpc_freq.QuadPart);
+    }
+
+    prof_time_mult = (u64)((1000000.0 * (double)(1ULL << PROF_TIME_SHIFT)) / (double)freq + 0.5);
 }
 
-void svr_reset_prof(SvrProf* prof)
+const char* svr_prof_get_clock_name()
 {
-    prof->runs = 0;
-    prof->total = 0;
+    return prof_use_tsc ? "TSC" : "QueryPerformanceCounter";
 }
-
-#endif
@@ -1,9 +1,6 @@
 #pragma once
 #include "svr_common.h"
 
-// Disable for releases.
-#define SVR_PROF 0
-
 struct SvrProf
 {
     s64 start;
@@ -11,19 +8,40 @@ struct SvrProf
     s64 total;
 };
 
-void svr_init_prof();
-s64 svr_prof_get_real_time();
+// Profiling is enabled for a movie with profiling_enabled in the profile, or for all movies with -svrprof when the game is started.
+// Set by proc when a movie starts. When not enabled, svr_start_prof and svr_end_prof only check this.
+extern bool svr_prof_enabled;
 
-#if SVR_PROF
+// Set from -svrprof.
+extern bool svr_prof_launch_enabled;
 
-void svr_start_prof(SvrProf* prof);
-void svr_end_prof(SvrProf* prof);
-void svr_reset_prof(SvrProf* prof);
+// Must be called before any time is read.
+void svr_init_prof();
 
-#else
+// Time in microseconds. This is read from the TSC when it runs at a constant rate, otherwise from QueryPerformanceCounter.
+// Either way it is turned into microseconds with a multiply and a shift.
+s64 svr_prof_get_real_time();
 
-#define svr_start_prof()
-#define svr_end_prof()
-#define svr_reset_prof()
+// Name of the clock that is used, for the log.
+const char* svr_prof_get_clock_name();
 
-#endif
+inline void svr_start_prof(SvrProf* prof)
+{
+    prof->start = svr_prof_enabled ? svr_prof_get_real_time() : 0;
+}
+
+// Profiling can be enabled by the next movie while a thread of the movie before is between these, which is then not counted.
+inline void svr_end_prof(SvrProf* prof)
+{
+    if (svr_prof_enabled && prof->start > 0)
+    {
+        prof->runs++;
+        prof->total += (svr_prof_get_real_time() - prof->start);
+    }
+}
+
+inline void svr_reset_prof(SvrProf* prof)
+{
+    prof->runs = 0;
+    prof->total = 0;
+}
@@ -0,0 +1,970 @@
+#include "svr_pxconv_impl.h"
+#include "svr_mosample_impl.h"
+#include "svr_cpu.h"
+#include "svr_logging.h"
+#include "svr_prof.h"
+#include <assert.h>
+#include <string.h>
+#include <malloc.h>
+
+// The project is built with fast floating point, which allows the compiler to reorder and contract the operations below.
+// The operations here have to be done exactly as written to get the same rounding as the shaders.
+#pragma float_control(precise, on, push)
+#pragma fp_contract(off)
+
+s32 calc_format_planes(PxConv pxconv)
+{
+    switch (pxconv)
+    {
+        case PXCONV_YUV420_601:
+        case PXCONV_YUV444_601:
+        case PXCONV_YUV420_709:
+        case PXCONV_YUV444_709:
+        {
+            return 3;
+        }
+
+        case PXCONV_NV12_601:
+        case PXCONV_NV21_601:
+        case PXCONV_NV12_709:
+        case PXCONV_NV21_709:
+        {
+            return 2;
+        }
+
+        case PXCONV_BGR0:
+        {
+            return 1;
+        }
+    }
+
+    assert(false);
+    return 0;
+}
+
+void calc_plane_dims(PxConv pxconv, s32 width, s32 height, s32 plane, s32* out_width, s32* out_height)
+{
+    // Height and width chroma shifts for each plane dimension (luma is ignored, so set to 0).
+
+    const s32 YUV420_SHIFTS[3] = { 0, 1, 1 };
+    const s32 NV_SHIFTS[2] = { 0, 1 };
+
+    switch (pxconv)
+    {
+        case PXCONV_YUV420_601:
+        case PXCONV_YUV420_709:
+        {
+            assert(plane < 3);
+
+            *out_width = width >> YUV420_SHIFTS[plane];
+            *out_height = height >> YUV420_SHIFTS[plane];
+            break;
+        }
+
+        case PXCONV_NV12_601:
+        case PXCONV_NV21_601:
+        case PXCONV_NV12_709:
+        case PXCONV_NV21_709:
+        {
+            assert(plane < 2);
+
+            *out_width = width >> NV_SHIFTS[plane];
+            *out_height = height >> NV_SHIFTS[plane];
+            break;
+        }
+
+        case PXCONV_YUV444_601:
+        case PXCONV_YUV444_709:
+        {
+            assert(plane < 3);
+
+            *out_width = width;
+            *out_height = height;
+            break;
+        }
+
+        case PXCONV_BGR0:
+        {
+            assert(plane < 1);
+
+            *out_width = width;
+            *out_height = height;
+            break;
+        }
+
+        default:
+        {
+            assert(false);
+            break;
+        }
+    }
+}
+
+s32 calc_plane_pitch(PxConv pxconv, s32 width, s32 plane)
+{
+    s32 plane_width;
+    s32 plane_height;
+    calc_plane_dims(pxconv, width, 2, plane, &plane_width, &plane_height);
+
+    switch (pxconv)
+    {
+        case PXCONV_NV12_601:
+        case PXCONV_NV21_601:
+        case PXCONV_NV12_709:
+        case PXCONV_NV21_709:
+        {
+            // The second plane has U and V interleaved.
+            return plane == 0 ? plane_width : plane_width * 2;
+        }
+
+        case PXCONV_BGR0:
+        {
+            return plane_width * 4;
+        }
+    }
+
+    return plane_width;
+}
+
+// -------------------------------------------------
+
+// Reads pixels the same way a Texture2D<float4> would for a BGRA8 unorm texture. The output is in RGB order.
+struct PxConvSrcBgra8
+{
+    const u8* data;
+    s32 pitch;
+
+    inline void load(s32 x, s32 y, float* rgb) const
+    {
+        const u8* px = data + (y * pitch) + (x * 4);
+        rgb[0] = (float)px[2] / 255.0f;
+        rgb[1] = (float)px[1] / 255.0f;
+        rgb[2] = (float)px[0] / 255.0f;
+    }
+};
+
+// Reads pixels from a float buffer where every row has the R, G and B channels one after the other (see svr_mosample.h).
+struct PxConvSrcFloat32
+{
+    const u8* data;
+    s32 pitch;
+    s32 width;
+
+    inline void load(s32 x, s32 y, float* rgb) const
+    {
+        const float* row = (const float*)(data + (y * pitch));
+        rgb[0] = row[x];
+        rgb[1] = row[width + x];
+        rgb[2] = row[(width * 2) + x];
+    }
+};
+
+// Reads pixels from a fixed point buffer where every row has the R, G and B channels one after the other (see svr_mosample.h).
+struct PxConvSrcFixed16
+{
+    const u8* data;
+    s32 pitch;
+    s32 width;
+
+    inline void load(s32 x, s32 y, float* rgb) const
+    {
+        const u16* row = (const u16*)(data + (y * pitch));
+        rgb[0] = (float)row[x] / 65280.0f;
+        rgb[1] = (float)row[width + x] / 65280.0f;
+        rgb[2] = (float)row[(width * 2) + x] / 65280.0f;
+    }
+};
+
+// Must be synchronized with average_nearby_for_yuv in tex2vid.hlsl.
+// This averages the pixel with its right, bottom and bottom right neighbors, and is used for both luma and chroma.
+template <class Src>
+inline void pxconv_average_nearby(const Src& src, s32 x, s32 y, s32 width, s32 height, float* out)
+{
+    float base[3];
+    float topright[3];
+    float botleft[3];
+    float botright[3];
+
+    src.load(x, y, base);
+
+    bool has_right = x + 1 < width;
+    bool has_bottom = y + 1 < height;
+
+    if (has_right) src.load(x + 1, y, topright);
+    else memcpy(topright, base, sizeof(base));
+
+    if (has_bottom) src.load(x, y + 1, botleft);
+    else memcpy(botleft, base, sizeof(base));
+
+    if (has_right && has_bottom) src.load(x + 1, y + 1, botright);
+    else if (has_right) memcpy(botright, topright, sizeof(base));
+    else if (has_bottom) memcpy(botright, botleft, sizeof(base));
+    else memcpy(botright, base, sizeof(base));
+
+    for (s32 i = 0; i < 3; i++)
+    {
+        out[i] = (base[i] + topright[i] + botleft[i] + botright[i]) / 4.0f;
+    }
+}
+
+enum PxConvChromaLayout
+{
+    PXCONV_CHROMA_PLANAR, // U and V in separate planes.
+    PXCONV_CHROMA_UV, // U and V interleaved in one plane.
+    PXCONV_CHROMA_VU, // V and U interleaved in one plane.
+};
+
+// For YUV420, NV12 and NV21.
+// Luma is taken from the averaged 2x2 window at every pixel, same as the shaders.
+// Chroma is taken from the window at the top left pixel of every 2x2 block.
+template <class Src>
+void pxconv_subsampled(const Src& src, const PxConvCoeffs& c, PxConvChromaLayout layout, s32 width, s32 height, u8** planes)
+{
+    s32 chroma_width = width >> 1;
+    s32 chroma_height = height >> 1;
+
+    for (s32 y = 0; y < height; y++)
+    {
+        u8* dest_y = planes[0] + (y * width);
+
+        bool has_chroma_row = ((y & 1) == 0) && ((y >> 1) < chroma_height);
+
+        for (s32 x = 0; x < width; x++)
+        {
+            float rgb[3];
+            pxconv_average_nearby(src, x, y, width, height, rgb);
+
+            dest_y[x] = pxconv_calc_y(c, rgb);
+
+            if (!has_chroma_row || (x & 1) || (x >> 1) >= chroma_width)
+            {
+                continue;
+            }
+
+            u8 u;
+            u8 v;
+            pxconv_calc_uv(c, rgb, &u, &v);
+
+            s32 cx = x >> 1;
+            s32 cy = y >> 1;
+
+            switch (layout)
+            {
+                case PXCONV_CHROMA_PLANAR:
+                {
+                    planes[1][(cy * chroma_width) + cx] = u;
+                    planes[2][(cy * chroma_width) + cx] = v;
+                    break;
+                }
+
+                case PXCONV_CHROMA_UV:
+                {
+                    u8* dest_uv = planes[1] + (cy * chroma_width * 2) + (cx * 2);
+                    dest_uv[0] = u;
+                    dest_uv[1] = v;
+                    break;
+                }
+
+                case PXCONV_CHROMA_VU:
+                {
+                    u8* dest_vu = planes[1] + (cy * chroma_width * 2) + (cx * 2);
+                    dest_vu[0] = v;
+                    dest_vu[1] = u;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// For YUV444. No averaging here.
+template <class Src>
+void pxconv_yuv444(const Src& src, const PxConvCoeffs& c, s32 width, s32 height, u8** planes)
+{
+    for (s32 y = 0; y < height; y++)
+    {
+        s32 offset = y * width;
+
+        for (s32 x = 0; x < width; x++)
+        {
+            float rgb[3];
+            src.load(x, y, rgb);
+
+            planes[0][offset + x] = pxconv_calc_y(c, rgb);
+            pxconv_calc_uv(c, rgb, &planes[1][offset + x], &planes[2][offset + x]);
+        }
+    }
+}
+
+// For BGR0. Same as the swizzle and multiply in the shader.
+template <class Src>
+void pxconv_bgr0(const Src& src, s32 width, s32 height, u8** planes)
+{
+    for (s32 y = 0; y < height; y++)
+    {
+        u8* dest = planes[0] + (y * width * 4);
+
+        for (s32 x = 0; x < width; x++)
+        {
+            float rgb[3];
+            src.load(x, y, rgb);
+
+            pxconv_bgr0_px(rgb, dest);
+
+            dest += 4;
+        }
+    }
+}
+
+// Converts one pixel at a time in the same way as the shaders.
+// Used when the CPU has none of the instruction sets below, and to check them against.
+template <class Src>
+void pxconv_convert_reference(PxConv pxconv, const Src& src, s32 width, s32 height, u8** planes)
+{
+    switch (pxconv)
+    {
+        case PXCONV_YUV420_601: pxconv_subsampled(src, PXCONV_COEFFS_601, PXCONV_CHROMA_PLANAR, width, height, planes); break;
+        case PXCONV_YUV444_601: pxconv_yuv444(src, PXCONV_COEFFS_601, width, height, planes); break;
+        case PXCONV_NV12_601: pxconv_subsampled(src, PXCONV_COEFFS_601, PXCONV_CHROMA_UV, width, height, planes); break;
+        case PXCONV_NV21_601: pxconv_subsampled(src, PXCONV_COEFFS_601, PXCONV_CHROMA_VU, width, height, planes); break;
+
+        case PXCONV_YUV420_709: pxconv_subsampled(src, PXCONV_COEFFS_709, PXCONV_CHROMA_PLANAR, width, height, planes); break;
+        case PXCONV_YUV444_709: pxconv_yuv444(src, PXCONV_COEFFS_709, width, height, planes); break;
+        case PXCONV_NV12_709: pxconv_subsampled(src, PXCONV_COEFFS_709, PXCONV_CHROMA_UV, width, height, planes); break;
+        case PXCONV_NV21_709: pxconv_subsampled(src, PXCONV_COEFFS_709, PXCONV_CHROMA_VU, width, height, planes); break;
+
+        case PXCONV_BGR0: pxconv_bgr0(src, width, height, planes); break;
+
+        default: assert(false); break;
+    }
+}
+
+void pxconv_reference_from_bgra8(PxConv pxconv, const u8* source, s32 source_pitch, s32 width, s32 height, u8** planes)
+{
+    PxConvSrcBgra8 src;
+    src.data = source;
+    src.pitch = source_pitch;
+
+    pxconv_convert_reference(pxconv, src, width, height, planes);
+}
+
+void pxconv_reference_from_float32(PxConv pxconv, const float* source, s32 source_pitch, s32 width, s32 height, u8** planes)
+{
+    PxConvSrcFloat32 src;
+    src.data = (const u8*)source;
+    src.pitch = source_pitch;
+    src.width = width;
+
+    pxconv_convert_reference(pxconv, src, width, height, planes);
+}
+
+void pxconv_reference_from_fixed16(PxConv pxconv, const u16* source, s32 source_pitch, s32 width, s32 height, u8** planes)
+{
+    PxConvSrcFixed16 src;
+    src.data = (const u8*)source;
+    src.pitch = source_pitch;
+    src.width = width;
+
+    pxconv_convert_reference(pxconv, src, width, height, planes);
+}
+
+// -------------------------------------------------
+
+// Row conversions for each instruction set.
+const PxConvKernels* PXCONV_KERNELS_TABLE[] = {
+    NULL, // SVR_SIMD_NONE
+    &PXCONV_KERNELS_SSE41, // SVR_SIMD_SSE41
+    &PXCONV_KERNELS_AVX2, // SVR_SIMD_AVX2
+    &PXCONV_KERNELS_AVX512, // SVR_SIMD_AVX512
+};
+
+SvrSimdLevel pxconv_simd_level;
+
+// Memory of the rows that the vectorized conversions work in, for frames up to this width (see svr_pxconv_reserve).
+float* pxconv_rows_mem;
+s32 pxconv_rows_width;
+
+enum PxConvSrcFormat
+{
+    PXCONV_SRC_BGRA8,
+    PXCONV_SRC_FLOAT32,
+    PXCONV_SRC_FIXED16,
+
+    NUM_PXCONV_SRCS,
+};
+
+// Source data for the row conversions.
+struct PxConvRowSrc
+{
+    const u8* data;
+    s32 pitch;
+    PxConvSrcFormat format;
+
+    // For motion sampling work buffers, the last sample of the frame is added to every row when it is loaded.
+    // The row is cleared after it has been loaded, so the data is written to.
+    bool add_sample;
+    SvrSimdLevel level;
+    const u8* sample;
+    s32 sample_pitch;
+    float weight;
+};
+
+// Every row is loaded once in the row conversions, so the sample is added and the row is cleared while the row is in the cache.
+// Without this the whole work buffer would have to be brought in once for the sample, once for the conversion and once for the clear.
+void pxconv_add_sample_to_row(const PxConvRowSrc& src, s32 y, s32 width, u8* row)
+{
+    const u8* sample_row = src.sample + (y * src.sample_pitch);
+
+    if (src.format == PXCONV_SRC_FIXED16)
+    {
+        MOSAMPLE_FIXED_ROW_FNS[src.level]((u16*)row, sample_row, width, mosample_fixed_scale(src.weight));
+    }
+
+    else
+    {
+        MOSAMPLE_ROW_FNS[src.level]((float*)row, sample_row, width, src.weight);
+    }
+}
+
+void pxconv_load_row(const PxConvKernels* k, const PxConvRowSrc& src, s32 y, s32 width, PxConvRow* dest)
+{
+    const u8* row = src.data + (y * src.pitch);
+
+    if (src.add_sample)
+    {
+        pxconv_add_sample_to_row(src, y, width, (u8*)row);
+    }
+
+    switch (src.format)
+    {
+        case PXCONV_SRC_BGRA8: k->load_bgra8(row, width, dest); break;
+        case PXCONV_SRC_FLOAT32: k->load_float32((const float*)row, width, dest); break;
+        case PXCONV_SRC_FIXED16: k->load_fixed16((const u16*)row, width, dest); break;
+        default: assert(false); break;
+    }
+
+    if (src.add_sample)
+    {
+        s32 row_size = src.format == PXCONV_SRC_FIXED16 ? width * 3 * sizeof(u16) : width * 3 * sizeof(float);
+        memset((u8*)row, 0, row_size);
+    }
+}
+
+// For YUV420, NV12 and NV21. Rows are loaded once and the averages of the even rows are kept for the chroma.
+void pxconv_rows_subsampled(const PxConvKernels* k, const PxConvRowSrc& src, const PxConvCoeffs& c, PxConvChromaLayout layout, s32 width, s32 height, PxConvRow* rows, u8** planes)
+{
+    s32 chroma_width = width >> 1;
+    s32 chroma_height = height >> 1;
+
+    PxConvRow* top = &rows[0];
+    PxConvRow* bottom = &rows[1];
+    PxConvRow* avg = &rows[2];
+
+    pxconv_load_row(k, src, 0, width, top);
+
+    for (s32 y = 0; y < height; y++)
+    {
+        bool has_bottom = y + 1 < height;
+
+        if (has_bottom)
+        {
+            pxconv_load_row(k, src, y + 1, width, bottom);
+        }
+
+        bool has_chroma_row = ((y & 1) == 0) && ((y >> 1) < chroma_height);
+
+        k->luma(top, has_bottom ? bottom : top, width, &c, planes[0] + (y * width), has_chroma_row ? avg : NULL);
+
+        if (has_chroma_row)
+        {
+            s32 cy = y >> 1;
+
+            switch (layout)
+            {
+                case PXCONV_CHROMA_PLANAR:
+                {
+                    k->chroma_planar(avg, chroma_width, &c, planes[1] + (cy * chroma_width), planes[2] + (cy * chroma_width));
+                    break;
+                }
+
+                case PXCONV_CHROMA_UV:
+                case PXCONV_CHROMA_VU:
+                {
+                    k->chroma_interleaved(avg, chroma_width, &c, layout == PXCONV_CHROMA_VU, planes[1] + (cy * chroma_width * 2));
+                    break;
+                }
+            }
+        }
+
+        PxConvRow* temp = top;
+        top = bottom;
+        bottom = temp;
+    }
+}
+
+void pxconv_rows_yuv444(const PxConvKernels* k, const PxConvRowSrc& src, const PxConvCoeffs& c, s32 width, s32 height, PxConvRow* rows, u8** planes)
+{
+    for (s32 y = 0; y < height; y++)
+    {
+        s32 offset = y * width;
+
+        pxconv_load_row(k, src, y, width, &rows[0]);
+        k->yuv444(&rows[0], width, &c, planes[0] + offset, planes[1] + offset, planes[2] + offset);
+    }
+}
+
+void pxconv_rows_bgr0(const PxConvKernels* k, const PxConvRowSrc& src, s32 width, s32 height, PxConvRow* rows, u8** planes)
+{
+    for (s32 y = 0; y < height; y++)
+    {
+        pxconv_load_row(k, src, y, width, &rows[0]);
+        k->bgr0(&rows[0], width, planes[0] + (y * width * 4));
+    }
+}
+
+// How many rows the row conversions work in.
+const s32 PXCONV_NUM_ROWS = 3;
+
+void pxconv_convert_rows(const PxConvKernels* k, PxConv pxconv, const PxConvRowSrc& src, s32 width, s32 height, u8** planes)
+{
+    const s32 NUM_ROWS = PXCONV_NUM_ROWS;
+
+    // Rows are 1 pixel longer, see PxConvRow.
+    s32 row_width = width + 1;
+
+    // Room must have been made for the frame first.
+    if (width > pxconv_rows_width)
+    {
+        assert(false);
+        return;
+    }
+
+    float* mem = pxconv_rows_mem;
+
+    PxConvRow rows[NUM_ROWS];
+
+    for (s32 i = 0; i < NUM_ROWS; i++)
+    {
+        float* row_mem = mem + (row_width * 3 * i);
+
+        rows[i].r = row_mem;
+        rows[i].g = row_mem + row_width;
+        rows[i].b = row_mem + (row_width * 2);
+    }
+
+    switch (pxconv)
+    {
+        case PXCONV_YUV420_601: pxconv_rows_subsampled(k, src, PXCONV_COEFFS_601, PXCONV_CHROMA_PLANAR, width, height, rows, planes); break;
+        case PXCONV_YUV444_601: pxconv_rows_yuv444(k, src, PXCONV_COEFFS_601, width, height, rows, planes); break;
+        case PXCONV_NV12_601: pxconv_rows_subsampled(k, src, PXCONV_COEFFS_601, PXCONV_CHROMA_UV, width, height, rows, planes); break;
+        case PXCONV_NV21_601: pxconv_rows_subsampled(k, src, PXCONV_COEFFS_601, PXCONV_CHROMA_VU, width, height, rows, planes); break;
+
+        case PXCONV_YUV420_709: pxconv_rows_subsampled(k, src, PXCONV_COEFFS_709, PXCONV_CHROMA_PLANAR, width, height, rows, planes); break;
+        case PXCONV_YUV444_709: pxconv_rows_yuv444(k, src, PXCONV_COEFFS_709, width, height, rows, planes); break;
+        case PXCONV_NV12_709: pxconv_rows_subsampled(k, src, PXCONV_COEFFS_709, PXCONV_CHROMA_UV, width, height, rows, planes); break;
+        case PXCONV_NV21_709: pxconv_rows_subsampled(k, src, PXCONV_COEFFS_709, PXCONV_CHROMA_VU, width, height, rows, planes); break;
+
+        case PXCONV_BGR0: pxconv_rows_bgr0(k, src, width, height, rows, planes); break;
+
+        default: assert(false); break;
+    }
+}
+
+void pxconv_convert_level(SvrSimdLevel level, PxConv pxconv, const u8* source, s32 source_pitch, PxConvSrcFormat format, s32 width, s32 height, u8** planes)
+{
+    const PxConvKernels* k = PXCONV_KERNELS_TABLE[level];
+
+    if (k == NULL)
+    {
+        switch (format)
+        {
+            case PXCONV_SRC_BGRA8: pxconv_reference_from_bgra8(pxconv, source, source_pitch, width, height, planes); break;
+            case PXCONV_SRC_FLOAT32: pxconv_reference_from_float32(pxconv, (const float*)source, source_pitch, width, height, planes); break;
+            case PXCONV_SRC_FIXED16: pxconv_reference_from_fixed16(pxconv, (const u16*)source, source_pitch, width, height, planes); break;
+            default: assert(false); break;
+        }
+
+        return;
+    }
+
+    PxConvRowSrc src = {};
+    src.data = source;
+    src.pitch = source_pitch;
+    src.format = format;
+
+    pxconv_convert_rows(k, pxconv, src, width, height, planes);
+}
+
+// The format is the format of the work buffer, either PXCONV_SRC_FLOAT32 or PXCONV_SRC_FIXED16.
+void pxconv_convert_mosample_level(SvrSimdLevel level, PxConv pxconv, u8* work, s32 work_pitch, PxConvSrcFormat format, const u8* sample, s32 sample_pitch, float weight, s32 width, s32 height, u8** planes)
+{
+    const PxConvKernels* k = PXCONV_KERNELS_TABLE[level];
+
+    // The reference conversion goes pixel by pixel and needs the whole frame, so this is done in separate passes instead.
+    if (k == NULL)
+    {
+        if (format == PXCONV_SRC_FIXED16) mosample_fixed_level(level, (u16*)work, work_pitch, sample, sample_pitch, width, 0, height, weight);
+        else mosample_level(level, (float*)work, work_pitch, sample, sample_pitch, width, 0, height, weight);
+
+        pxconv_convert_level(level, pxconv, work, work_pitch, format, width, height, planes);
+
+        for (s32 y = 0; y < height; y++)
+        {
+            s32 row_size = format == PXCONV_SRC_FIXED16 ? width * 3 * sizeof(u16) : width * 3 * sizeof(float);
+            memset(work + (y * work_pitch), 0, row_size);
+        }
+
+        return;
+    }
+
+    PxConvRowSrc src = {};
+    src.data = work;
+    src.pitch = work_pitch;
+    src.format = format;
+    src.add_sample = true;
+    src.level = level;
+    src.sample = sample;
+    src.sample_pitch = sample_pitch;
+    src.weight = weight;
+
+    pxconv_convert_rows(k, pxconv, src, width, height, planes);
+}
+
+void svr_pxconv_init()
+{
+    pxconv_simd_level = svr_get_simd_level();
+}
+
+bool svr_pxconv_reserve(s32 width)
+{
+    if (width <= pxconv_rows_width)
+    {
+        return true;
+    }
+
+    // Rows are 1 pixel longer, see PxConvRow.
+    float* mem = (float*)malloc(sizeof(float) * (width + 1) * 3 * PXCONV_NUM_ROWS);
+
+    if (mem == NULL)
+    {
+        return false;
+    }
+
+    free(pxconv_rows_mem);
+
+    pxconv_rows_mem = mem;
+    pxconv_rows_width = width;
+
+    return true;
+}
+
+SvrSimdLevel svr_pxconv_get_simd_level()
+{
+    return pxconv_simd_level;
+}
+
+void svr_pxconv_from_bgra8(PxConv pxconv, const u8* source, s32 source_pitch, s32 width, s32 height, u8** planes)
+{
+    pxconv_convert_level(pxconv_simd_level, pxconv, source, source_pitch, PXCONV_SRC_BGRA8, width, height, planes);
+}
+
+void svr_pxconv_from_float32(PxConv pxconv, const float* source, s32 source_pitch, s32 width, s32 height, u8** planes)
+{
+    pxconv_convert_level(pxconv_simd_level, pxconv, (const u8*)source, source_pitch, PXCONV_SRC_FLOAT32, width, height, planes);
+}
+
+void svr_pxconv_from_fixed16(PxConv pxconv, const u16* source, s32 source_pitch, s32 width, s32 height, u8** planes)
+{
+    pxconv_convert_level(pxconv_simd_level, pxconv, (const u8*)source, source_pitch, PXCONV_SRC_FIXED16, width, height, planes);
+}
+
+void svr_pxconv_from_mosample_float32(PxConv pxconv, float* work, s32 work_pitch, const u8* sample, s32 sample_pitch, float weight, s32 width, s32 height, u8** planes)
+{
+    pxconv_convert_mosample_level(pxconv_simd_level, pxconv, (u8*)work, work_pitch, PXCONV_SRC_FLOAT32, sample, sample_pitch, weight, width, height, planes);
+}
+
+void svr_pxconv_from_mosample_fixed16(PxConv pxconv, u16* work, s32 work_pitch, const u8* sample, s32 sample_pitch, float weight, s32 width, s32 height, u8** planes)
+{
+    pxconv_convert_mosample_level(pxconv_simd_level, pxconv, (u8*)work, work_pitch, PXCONV_SRC_FIXED16, sample, sample_pitch, weight, width, height, planes);
+}
+
+// -------------------------------------------------
+
+const char* PXCONV_SRC_NAMES[] = {
+    "BGRA8", // PXCONV_SRC_BGRA8
+    "FLOAT32", // PXCONV_SRC_FLOAT32
+    "FIXED16", // PXCONV_SRC_FIXED16
+};
+
+const char* PXCONV_NAMES[] = {
+    "YUV420 601", // PXCONV_YUV420_601
+    "YUV444 601", // PXCONV_YUV444_601
+    "NV12 601", // PXCONV_NV12_601
+    "NV21 601", // PXCONV_NV21_601
+    "YUV420 709", // PXCONV_YUV420_709
+    "YUV444 709", // PXCONV_YUV444_709
+    "NV12 709", // PXCONV_NV12_709
+    "NV21 709", // PXCONV_NV21_709
+    "BGR0", // PXCONV_BGR0
+};
+
+// Sets the plane pointers for a tightly packed frame and returns the size of it.
+s32 pxconv_set_frame_planes(PxConv pxconv, s32 width, s32 height, u8* mem, u8** planes)
+{
+    s32 offset = 0;
+
+    for (s32 i = 0; i < calc_format_planes(pxconv); i++)
+    {
+        s32 plane_width;
+        s32 plane_height;
+        calc_plane_dims(pxconv, width, height, i, &plane_width, &plane_height);
+
+        planes[i] = mem + offset;
+        offset += calc_plane_pitch(pxconv, width, i) * plane_height;
+    }
+
+    return offset;
+}
+
+// Logs how fast the conversions are at 1080p.
+void pxconv_bench(SvrSimdLevel max_level, const u8* source_8, u8* test_mem, u8* test_work)
+{
+    const s32 BENCH_WIDTH = 1920;
+    const s32 BENCH_HEIGHT = 1080;
+    const s32 BENCH_RUNS = 10;
+
+    // Speed of going through the source frame.
+
+    for (s32 l = SVR_SIMD_NONE; l <= max_level; l++)
+    {
+        for (s32 p = 0; p < NUM_PXCONVS; p++)
+        {
+            u8* planes[3];
+            pxconv_set_frame_planes((PxConv)p, BENCH_WIDTH, BENCH_HEIGHT, test_mem, planes);
+
+            s64 start = svr_prof_get_real_time();
+
+            for (s32 i = 0; i < BENCH_RUNS; i++)
+            {
+                pxconv_convert_level((SvrSimdLevel)l, (PxConv)p, source_8, BENCH_WIDTH * 4, PXCONV_SRC_BGRA8, BENCH_WIDTH, BENCH_HEIGHT, planes);
+            }
+
+            s64 time = svr_prof_get_real_time() - start;
+
+            // Bytes per microsecond to GB/s.
+            double rate = ((double)BENCH_WIDTH * BENCH_HEIGHT * 4 * BENCH_RUNS) / (double)time / 1000.0;
+
+            svr_log("Pixel conversion %s with %s: %.2f GB/s\n", PXCONV_NAMES[p], svr_get_simd_level_name((SvrSimdLevel)l), rate);
+        }
+    }
+
+    // Time of the end of a motion sampled video frame, with the last sample, conversion and clear in separate passes and together.
+
+    for (s32 f = 0; f < 2; f++)
+    {
+        PxConvSrcFormat format = f == 1 ? PXCONV_SRC_FIXED16 : PXCONV_SRC_FLOAT32;
+        s32 work_pitch = format == PXCONV_SRC_FIXED16 ? BENCH_WIDTH * 3 * sizeof(u16) : BENCH_WIDTH * 3 * sizeof(float);
+        float weight = 1.0f / 60.0f;
+
+        u8* planes[3];
+        pxconv_set_frame_planes(PXCONV_NV12_601, BENCH_WIDTH, BENCH_HEIGHT, test_mem, planes);
+
+        s64 start = svr_prof_get_real_time();
+
+        for (s32 i = 0; i < BENCH_RUNS; i++)
+        {
+            if (format == PXCONV_SRC_FIXED16) mosample_fixed_level(max_level, (u16*)test_work, work_pitch, source_8, BENCH_WIDTH * 4, BENCH_WIDTH, 0, BENCH_HEIGHT, weight);
+            else mosample_level(max_level, (float*)test_work, work_pitch, source_8, BENCH_WIDTH * 4, BENCH_WIDTH, 0, BENCH_HEIGHT, weight);
+
+            pxconv_convert_level(max_level, PXCONV_NV12_601, test_work, work_pitch, format, BENCH_WIDTH, BENCH_HEIGHT, planes);
+            memset(test_work, 0, work_pitch * BENCH_HEIGHT);
+        }
+
+        s64 separate_time = svr_prof_get_real_time() - start;
+
+        start = svr_prof_get_real_time();
+
+        for (s32 i = 0; i < BENCH_RUNS; i++)
+        {
+            pxconv_convert_mosample_level(max_level, PXCONV_NV12_601, test_work, work_pitch, format, source_8, BENCH_WIDTH * 4, weight, BENCH_WIDTH, BENCH_HEIGHT, planes);
+        }
+
+        s64 fused_time = svr_prof_get_real_time() - start;
+
+        svr_log("End of motion sampled frame to %s from %s with %s: %lld us in separate passes, %lld us together\n", PXCONV_NAMES[PXCONV_NV12_601], PXCONV_SRC_NAMES[format], svr_get_simd_level_name(max_level), separate_time / BENCH_RUNS, fused_time / BENCH_RUNS);
+    }
+}
+
+bool svr_pxconv_self_test(bool bench)
+{
+    // Odd sizes are here so the ends of the rows and the last row are tested too.
+    const s32 TEST_SIZES[][2] = { { 1, 1 }, { 2, 2 }, { 3, 5 }, { 31, 17 }, { 67, 33 }, { 1921, 1081 } };
+    const s32 NUM_TEST_SIZES = SVR_ARRAY_SIZE(TEST_SIZES);
+
+    // Adding the last motion sample during the conversion must be the same as doing it in separate passes with the reference.
+    // The work buffer starts out as the float or fixed point source and must be cleared after.
+    const s32 MOSAMPLE_TEST_SIZES[][2] = { { 1, 1 }, { 3, 5 }, { 67, 33 } };
+    const s32 NUM_MOSAMPLE_TEST_SIZES = SVR_ARRAY_SIZE(MOSAMPLE_TEST_SIZES);
+
+    const s32 MAX_WIDTH = 1921;
+    const s32 MAX_HEIGHT = 1081;
+
+    s32 num_px = MAX_WIDTH * MAX_HEIGHT;
+
+    u8* source_8 = (u8*)malloc(num_px * 4);
+    float* source_32f = (float*)malloc(num_px * 3 * sizeof(float));
+    u16* source_16 = (u16*)malloc(num_px * 3 * sizeof(u16));
+
+    // Every format fits in the size of BGR0.
+    u8* ref_mem = (u8*)malloc(num_px * 4);
+    u8* test_mem = (u8*)malloc(num_px * 4);
+
+    u8* ref_work = (u8*)malloc(num_px * 3 * sizeof(float));
+    u8* test_work = (u8*)malloc(num_px * 3 * sizeof(float));
+
+    SvrSimdLevel max_level = svr_get_simd_level();
+
+    s32 num_fails = 0;
+
+    // Values outside of 0 to 1 can come from motion sampling, so the clamping is tested too.
+    u32 seed = 1;
+
+    if (source_8 == NULL || source_32f == NULL || source_16 == NULL || ref_mem == NULL || test_mem == NULL || ref_work == NULL || test_work == NULL || !svr_pxconv_reserve(MAX_WIDTH))
+    {
+        svr_log("Could not allocate the pixel conversion test\n");
+        num_fails++;
+        goto rexit;
+    }
+
+    for (s32 i = 0; i < num_px * 4; i++)
+    {
+        seed = (seed * 1664525) + 1013904223;
+        source_8[i] = (u8)(seed >> 24);
+    }
+
+    for (s32 i = 0; i < num_px * 3; i++)
+    {
+        seed = (seed * 1664525) + 1013904223;
+        source_32f[i] = ((float)(seed >> 8) / 16777216.0f) * 1.2f - 0.1f;
+    }
+
+    // Saturated fixed point values are above 1.
+    for (s32 i = 0; i < num_px * 3; i++)
+    {
+        seed = (seed * 1664525) + 1013904223;
+        source_16[i] = (u16)(seed >> 16);
+    }
+
+    for (s32 l = SVR_SIMD_SSE41; l <= max_level; l++)
+    {
+        for (s32 p = 0; p < NUM_PXCONVS; p++)
+        {
+            for (s32 s = 0; s < NUM_TEST_SIZES; s++)
+            {
+                for (s32 f = 0; f < NUM_PXCONV_SRCS; f++)
+                {
+                    PxConv pxconv = (PxConv)p;
+                    s32 width = TEST_SIZES[s][0];
+                    s32 height = TEST_SIZES[s][1];
+                    PxConvSrcFormat format = (PxConvSrcFormat)f;
+
+                    const u8* source = source_8;
+                    s32 source_pitch = width * 4;
+
+                    if (format == PXCONV_SRC_FLOAT32)
+                    {
+                        source = (const u8*)source_32f;
+                        source_pitch = width * 3 * sizeof(float);
+                    }
+
+                    else if (format == PXCONV_SRC_FIXED16)
+                    {
+                        source = (const u8*)source_16;
+                        source_pitch = width * 3 * sizeof(u16);
+                    }
+
+                    u8* ref_planes[3];
+                    u8* test_planes[3];
+                    s32 frame_size = pxconv_set_frame_planes(pxconv, width, height, ref_mem, ref_planes);
+                    pxconv_set_frame_planes(pxconv, width, height, test_mem, test_planes);
+
+                    memset(test_mem, 0xcd, frame_size);
+
+                    pxconv_convert_level(SVR_SIMD_NONE, pxconv, source, source_pitch, format, width, height, ref_planes);
+                    pxconv_convert_level((SvrSimdLevel)l, pxconv, source, source_pitch, format, width, height, test_planes);
+
+                    if (memcmp(ref_mem, test_mem, frame_size))
+                    {
+                        svr_log("Pixel conversion %s with %s from %s at %dx%d is not the same as the reference\n", PXCONV_NAMES[p], svr_get_simd_level_name((SvrSimdLevel)l), PXCONV_SRC_NAMES[f], width, height);
+                        num_fails++;
+                    }
+                }
+            }
+        }
+    }
+
+    for (s32 l = SVR_SIMD_NONE; l <= max_level; l++)
+    {
+        for (s32 p = 0; p < NUM_PXCONVS; p++)
+        {
+            for (s32 s = 0; s < NUM_MOSAMPLE_TEST_SIZES; s++)
+            {
+                for (s32 f = 0; f < 2; f++)
+                {
+                    PxConv pxconv = (PxConv)p;
+                    s32 width = MOSAMPLE_TEST_SIZES[s][0];
+                    s32 height = MOSAMPLE_TEST_SIZES[s][1];
+                    PxConvSrcFormat format = f == 1 ? PXCONV_SRC_FIXED16 : PXCONV_SRC_FLOAT32;
+                    float weight = 1.0f / 7.0f;
+
+                    s32 work_pitch = format == PXCONV_SRC_FIXED16 ? width * 3 * sizeof(u16) : width * 3 * sizeof(float);
+                    s32 work_size = work_pitch * height;
+
+                    memcpy(ref_work, format == PXCONV_SRC_FIXED16 ? (const void*)source_16 : (const void*)source_32f, work_size);
+                    memcpy(test_work, ref_work, work_size);
+
+                    u8* ref_planes[3];
+                    u8* test_planes[3];
+                    s32 frame_size = pxconv_set_frame_planes(pxconv, width, height, ref_mem, ref_planes);
+                    pxconv_set_frame_planes(pxconv, width, height, test_mem, test_planes);
+
+                    memset(test_mem, 0xcd, frame_size);
+
+                    if (format == PXCONV_SRC_FIXED16) mosample_fixed_level(SVR_SIMD_NONE, (u16*)ref_work, work_pitch, source_8, width * 4, width, 0, height, weight);
+                    else mosample_level(SVR_SIMD_NONE, (float*)ref_work, work_pitch, source_8, width * 4, width, 0, height, weight);
+
+                    pxconv_convert_level(SVR_SIMD_NONE, pxconv, ref_work, work_pitch, format, width, height, ref_planes);
+                    memset(ref_work, 0, work_size);
+
+                    pxconv_convert_mosample_level((SvrSimdLevel)l, pxconv, test_work, work_pitch, format, source_8, width * 4, weight, width, height, test_planes);
+
+                    if (memcmp(ref_mem, test_mem, frame_size) || memcmp(ref_work, test_work, work_size))
+                    {
+                        svr_log("Pixel conversion %s with %s and a motion sample from %s at %dx%d is not the same as the reference\n", PXCONV_NAMES[p], svr_get_simd_level_name((SvrSimdLevel)l), PXCONV_SRC_NAMES[format], width, height);
+                        num_fails++;
+                    }
+                }
+            }
+        }
+    }
+
+    svr_log("Pixel conversion test done with %d failures\n", num_fails);
+
+    if (bench)
+    {
+        pxconv_bench(max_level, source_8, test_mem, test_work);
+    }
+
+rexit:
+    free(source_8);
+    free(source_32f);
+    free(source_16);
+    free(ref_work);
+    free(test_work);
+    free(ref_mem);
+    free(test_mem);
+
+    return num_fails == 0;
+}
+
+#pragma float_control(pop)
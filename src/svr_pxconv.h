@@ -0,0 +1,69 @@
+#pragma once
+#include "svr_common.h"
+#include "svr_cpu.h"
+
+// Pixel format conversion for SW encoding.
+// The GPU does this with the compute shaders in tex2vid.hlsl. This is the CPU equivalent for frames that are already in system memory.
+// The CPU conversion follows the float operations of the shaders in the same order so the output is the same as what is downloaded from the GPU.
+// The conversion is vectorized with the best instruction set that the CPU has (see svr_pxconv_simd.h), and falls back to a pixel by pixel reference.
+
+enum PxConv
+{
+    PXCONV_YUV420_601 = 0,
+    PXCONV_YUV444_601,
+    PXCONV_NV12_601,
+    PXCONV_NV21_601,
+
+    PXCONV_YUV420_709,
+    PXCONV_YUV444_709,
+    PXCONV_NV12_709,
+    PXCONV_NV21_709,
+
+    PXCONV_BGR0,
+
+    NUM_PXCONVS,
+};
+
+// How many planes that are used in a pixel format.
+s32 calc_format_planes(PxConv pxconv);
+
+// Retrieves the size of a plane in a pixel format.
+void calc_plane_dims(PxConv pxconv, s32 width, s32 height, s32 plane, s32* out_width, s32* out_height);
+
+// Retrieves how many bytes one row of a plane takes in system memory (no padding).
+s32 calc_plane_pitch(PxConv pxconv, s32 width, s32 plane);
+
+// To be called once before converting. Selects the instruction set to use.
+void svr_pxconv_init();
+
+// Makes room for converting frames up to this width, which must be done before converting such as when a movie is started.
+// The memory is kept and is only allocated again when a wider frame is given. Conversions share this memory, so only
+// one conversion can be done at a time.
+bool svr_pxconv_reserve(s32 width);
+
+SvrSimdLevel svr_pxconv_get_simd_level();
+
+// Converts a BGRA8 frame into the planes of a video pixel format.
+// Every plane is tightly packed (see calc_plane_pitch) in the same layout that is sent to ffmpeg.
+void svr_pxconv_from_bgra8(PxConv pxconv, const u8* source, s32 source_pitch, s32 width, s32 height, u8** planes);
+
+// Same as above but for float frames from svr_mosample_bgra8, which have the R, G and B channels of a row one after the other.
+// The pitch is in bytes.
+void svr_pxconv_from_float32(PxConv pxconv, const float* source, s32 source_pitch, s32 width, s32 height, u8** planes);
+
+// Same as above but for fixed point frames from svr_mosample_bgra8_fixed16, which have the R, G and B channels of a row
+// one after the other. The pitch is in bytes.
+void svr_pxconv_from_fixed16(PxConv pxconv, const u16* source, s32 source_pitch, s32 width, s32 height, u8** planes);
+
+// Adds the last motion sample of a video frame to a work buffer while converting it, and clears the work buffer for the next frame.
+// The result is the same as svr_mosample_bgra8, svr_pxconv_from_float32 and clearing the work buffer one after the other,
+// but every row of the work buffer only has to come from memory once instead of three times. The sample is BGRA8.
+void svr_pxconv_from_mosample_float32(PxConv pxconv, float* work, s32 work_pitch, const u8* sample, s32 sample_pitch, float weight, s32 width, s32 height, u8** planes);
+
+// Same as above but for fixed point work buffers (see svr_mosample_bgra8_fixed16).
+void svr_pxconv_from_mosample_fixed16(PxConv pxconv, u16* work, s32 work_pitch, const u8* sample, s32 sample_pitch, float weight, s32 width, s32 height, u8** planes);
+
+// Checks that the conversions with every instruction set that the CPU has give the same result as the reference.
+// With bench, also logs how fast every conversion is and compares the time of a motion sampled video frame with and without
+// svr_pxconv_from_mosample_float32. Returns false if any check failed. Run by svr_headless.exe selftest, as this takes a while.
+bool svr_pxconv_self_test(bool bench);
@@ -0,0 +1,64 @@
+#include "svr_pxconv_impl.h"
+#include <immintrin.h>
+
+// Pixel conversion with AVX2 (8 pixels at a time). See svr_pxconv_simd.h.
+// This file is built with /arch:AVX2 and must only be called when the CPU has it.
+
+#pragma float_control(precise, on, push)
+#pragma fp_contract(off)
+
+typedef __m256 PxVf;
+typedef __m256i PxVi;
+
+#define PXV_LANES 8
+#define PXV_FN(NAME) NAME##_avx2
+#define PXV_KERNELS PXCONV_KERNELS_AVX2
+
+#define pxv_loadf(P) _mm256_loadu_ps(P)
+#define pxv_storef(P, V) _mm256_storeu_ps(P, V)
+#define pxv_set1f(X) _mm256_set1_ps(X)
+#define pxv_addf(A, B) _mm256_add_ps(A, B)
+#define pxv_mulf(A, B) _mm256_mul_ps(A, B)
+#define pxv_divf(A, B) _mm256_div_ps(A, B)
+#define pxv_maxf(A, B) _mm256_max_ps(A, B)
+#define pxv_minf(A, B) _mm256_min_ps(A, B)
+
+#define pxv_loadi(P) _mm256_loadu_si256((const __m256i*)(P))
+#define pxv_storei(P, V) _mm256_storeu_si256((__m256i*)(P), V)
+#define pxv_set1i(X) _mm256_set1_epi32(X)
+#define pxv_andi(A, B) _mm256_and_si256(A, B)
+#define pxv_ori(A, B) _mm256_or_si256(A, B)
+#define pxv_srli(V, N) _mm256_srli_epi32(V, N)
+#define pxv_slli(V, N) _mm256_slli_epi32(V, N)
+
+#define pxv_cvtif(V) _mm256_cvtepi32_ps(V)
+#define pxv_cvttfi(V) _mm256_cvttps_epi32(V)
+#define pxv_load_u16(P) _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(P)))
+
+static inline PxVf pxv_evenf(PxVf a, PxVf b)
+{
+    // The shuffle works within the 128-bit halves, which leaves the 64-bit pairs in the order of A0, B0, A1, B1.
+    PxVf halves = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(halves), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+// The packing instructions work within the 128-bit halves, so the halves are packed together instead.
+static inline __m128i pxv_pack_u16(PxVi v)
+{
+    return _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+
+static inline void pxv_store_u8(u8* dest, PxVi v)
+{
+    __m128i packed = pxv_pack_u16(v);
+    _mm_storel_epi64((__m128i*)dest, _mm_packus_epi16(packed, packed));
+}
+
+static inline void pxv_store_u16(u8* dest, PxVi v)
+{
+    _mm_storeu_si128((__m128i*)dest, pxv_pack_u16(v));
+}
+
+#include "svr_pxconv_simd.h"
+
+#pragma float_control(pop)
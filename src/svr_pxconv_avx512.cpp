@@ -0,0 +1,51 @@
+#include "svr_pxconv_impl.h"
+#include <immintrin.h>
+
+// Pixel conversion with AVX-512 (16 pixels at a time). See svr_pxconv_simd.h.
+// This file is built with /arch:AVX512 and must only be called when the CPU has it. The intrinsics are only from AVX-512F,
+// but the compiler can also use DQ, BW and VL in this file.
+
+#pragma float_control(precise, on, push)
+#pragma fp_contract(off)
+
+typedef __m512 PxVf;
+typedef __m512i PxVi;
+
+#define PXV_LANES 16
+#define PXV_FN(NAME) NAME##_avx512
+#define PXV_KERNELS PXCONV_KERNELS_AVX512
+
+#define pxv_loadf(P) _mm512_loadu_ps(P)
+#define pxv_storef(P, V) _mm512_storeu_ps(P, V)
+#define pxv_set1f(X) _mm512_set1_ps(X)
+#define pxv_addf(A, B) _mm512_add_ps(A, B)
+#define pxv_mulf(A, B) _mm512_mul_ps(A, B)
+#define pxv_divf(A, B) _mm512_div_ps(A, B)
+#define pxv_maxf(A, B) _mm512_max_ps(A, B)
+#define pxv_minf(A, B) _mm512_min_ps(A, B)
+
+#define pxv_loadi(P) _mm512_loadu_si512((const void*)(P))
+#define pxv_storei(P, V) _mm512_storeu_si512((void*)(P), V)
+#define pxv_set1i(X) _mm512_set1_epi32(X)
+#define pxv_andi(A, B) _mm512_and_si512(A, B)
+#define pxv_ori(A, B) _mm512_or_si512(A, B)
+#define pxv_srli(V, N) _mm512_srli_epi32(V, N)
+#define pxv_slli(V, N) _mm512_slli_epi32(V, N)
+
+#define pxv_cvtif(V) _mm512_cvtepi32_ps(V)
+#define pxv_cvttfi(V) _mm512_cvttps_epi32(V)
+#define pxv_load_u16(P) _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)(P)))
+
+// The values are already in range, so these do not need to saturate.
+#define pxv_store_u8(P, V) _mm_storeu_si128((__m128i*)(P), _mm512_cvtepi32_epi8(V))
+#define pxv_store_u16(P, V) _mm256_storeu_si256((__m256i*)(P), _mm512_cvtepi32_epi16(V))
+
+static inline PxVf pxv_evenf(PxVf a, PxVf b)
+{
+    const PxVi EVEN_INDEXES = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    return _mm512_permutex2var_ps(a, EVEN_INDEXES, b);
+}
+
+#include "svr_pxconv_simd.h"
+
+#pragma float_control(pop)
@@ -0,0 +1,156 @@
+#pragma once
+#include "svr_pxconv.h"
+
+// Internal to the pixel conversion.
+// Shared between the reference conversion in svr_pxconv.cpp and the vectorized conversions in the svr_pxconv_<instruction set>.cpp files.
+// Every file that uses this must keep precise floating point (see svr_pxconv.cpp), otherwise the results will differ.
+// The functions here are static as those files are built for different instruction sets. The linker would otherwise keep
+// one of the copies for all of them, which could be one that uses instructions the processor does not have.
+
+// Must be synchronized with convert_rgb_to_yuv in tex2vid.hlsl.
+struct PxConvCoeffs
+{
+    float y[3];
+    float u[3];
+    float v[3];
+};
+
+const PxConvCoeffs PXCONV_COEFFS_601 = {
+    { +0.299000f, +0.587000f, +0.114000f },
+    { -0.168736f, -0.331264f, +0.500000f },
+    { +0.500000f, -0.418688f, -0.081312f },
+};
+
+const PxConvCoeffs PXCONV_COEFFS_709 = {
+    { +0.212600f, +0.715200f, +0.072200f },
+    { -0.114572f, -0.385428f, +0.500000f },
+    { +0.500000f, -0.454153f, -0.045847f },
+};
+
+// Same as a float to uint conversion in a shader followed by a store into a R8_UINT texture.
+// Negative values become 0 and values above 255 are clamped.
+static inline u8 pxconv_store_u8(float v)
+{
+    if (!(v > 0.0f))
+    {
+        return 0;
+    }
+
+    if (v >= 255.0f)
+    {
+        return 255;
+    }
+
+    return (u8)v;
+}
+
+static inline u8 pxconv_calc_y(const PxConvCoeffs& c, const float* rgb)
+{
+    float r = rgb[0] * 255.0f;
+    float g = rgb[1] * 255.0f;
+    float b = rgb[2] * 255.0f;
+    return pxconv_store_u8(16.0f + (r * c.y[0]) + (g * c.y[1]) + (b * c.y[2]));
+}
+
+static inline void pxconv_calc_uv(const PxConvCoeffs& c, const float* rgb, u8* u, u8* v)
+{
+    float r = rgb[0] * 255.0f;
+    float g = rgb[1] * 255.0f;
+    float b = rgb[2] * 255.0f;
+    *u = pxconv_store_u8(128.0f + (r * c.u[0]) + (g * c.u[1]) + (b * c.u[2]));
+    *v = pxconv_store_u8(128.0f + (r * c.v[0]) + (g * c.v[1]) + (b * c.v[2]));
+}
+
+// -------------------------------------------------
+
+// One row of pixels split up into channels, as loaded by the shaders (normalized and in RGB order).
+// Rows are 1 pixel longer than the frame with the last pixel repeated, so the right neighbor is always there when averaging.
+struct PxConvRow
+{
+    float* r;
+    float* g;
+    float* b;
+};
+
+// Same as PxConvSrcBgra8 in svr_pxconv.cpp.
+static inline void pxconv_load_bgra8_px(const u8* source, s32 x, PxConvRow* dest)
+{
+    const u8* px = source + (x * 4);
+    dest->r[x] = (float)px[2] / 255.0f;
+    dest->g[x] = (float)px[1] / 255.0f;
+    dest->b[x] = (float)px[0] / 255.0f;
+}
+
+// Same as PxConvSrcFloat32 in svr_pxconv.cpp.
+static inline void pxconv_load_float32_px(const float* source, s32 width, s32 x, PxConvRow* dest)
+{
+    dest->r[x] = source[x];
+    dest->g[x] = source[width + x];
+    dest->b[x] = source[(width * 2) + x];
+}
+
+// Same as PxConvSrcFixed16 in svr_pxconv.cpp.
+static inline void pxconv_load_fixed16_px(const u16* source, s32 width, s32 x, PxConvRow* dest)
+{
+    dest->r[x] = (float)source[x] / 65280.0f;
+    dest->g[x] = (float)source[width + x] / 65280.0f;
+    dest->b[x] = (float)source[(width * 2) + x] / 65280.0f;
+}
+
+static inline void pxconv_repeat_last_px(PxConvRow* row, s32 width)
+{
+    row->r[width] = row->r[width - 1];
+    row->g[width] = row->g[width - 1];
+    row->b[width] = row->b[width - 1];
+}
+
+static inline void pxconv_row_px(const PxConvRow* row, s32 x, float* rgb)
+{
+    rgb[0] = row->r[x];
+    rgb[1] = row->g[x];
+    rgb[2] = row->b[x];
+}
+
+// Same as pxconv_average_nearby in svr_pxconv.cpp. The neighbors at the edges are the pixel itself, which the repeated
+// last pixel and the bottom row being the same as the top row take care of.
+static inline void pxconv_row_avg(const PxConvRow* top, const PxConvRow* bottom, s32 x, float* rgb)
+{
+    rgb[0] = (top->r[x] + top->r[x + 1] + bottom->r[x] + bottom->r[x + 1]) / 4.0f;
+    rgb[1] = (top->g[x] + top->g[x + 1] + bottom->g[x] + bottom->g[x + 1]) / 4.0f;
+    rgb[2] = (top->b[x] + top->b[x + 1] + bottom->b[x] + bottom->b[x + 1]) / 4.0f;
+}
+
+// Same as the swizzle and multiply in the shader.
+static inline void pxconv_bgr0_px(const float* rgb, u8* dest)
+{
+    dest[0] = pxconv_store_u8(rgb[2] * 255.0f);
+    dest[1] = pxconv_store_u8(rgb[1] * 255.0f);
+    dest[2] = pxconv_store_u8(rgb[0] * 255.0f);
+    dest[3] = 255;
+}
+
+// Conversion of whole rows for one instruction set.
+// The rows are worked on in this form so that every source pixel only has to be loaded and normalized once, and so
+// that chroma can be calculated once per 2x2 block in the subsampled formats.
+struct PxConvKernels
+{
+    // Loads a row of the source into a row of channels.
+    void(*load_bgra8)(const u8* source, s32 width, PxConvRow* dest);
+    void(*load_float32)(const float* source, s32 width, PxConvRow* dest);
+    void(*load_fixed16)(const u16* source, s32 width, PxConvRow* dest);
+
+    // Writes luma from the 2x2 averages of a row and the row below. For the last row, bottom is the same as top.
+    // The averages are also written to avg if it is not NULL, for chroma.
+    void(*luma)(const PxConvRow* top, const PxConvRow* bottom, s32 width, const PxConvCoeffs* c, u8* dest_y, PxConvRow* avg);
+
+    // Writes chroma from every other average of a row (from luma above). Either to 2 planes or interleaved in 1 plane.
+    void(*chroma_planar)(const PxConvRow* avg, s32 chroma_width, const PxConvCoeffs* c, u8* dest_u, u8* dest_v);
+    void(*chroma_interleaved)(const PxConvRow* avg, s32 chroma_width, const PxConvCoeffs* c, bool vu, u8* dest);
+
+    void(*yuv444)(const PxConvRow* row, s32 width, const PxConvCoeffs* c, u8* dest_y, u8* dest_u, u8* dest_v);
+    void(*bgr0)(const PxConvRow* row, s32 width, u8* dest);
+};
+
+extern const PxConvKernels PXCONV_KERNELS_SSE41;
+extern const PxConvKernels PXCONV_KERNELS_AVX2;
+extern const PxConvKernels PXCONV_KERNELS_AVX512;
@@ -0,0 +1,284 @@
+// Body of the vectorized pixel conversions. Not a normal header, there is no include guard.
+// Included once by each svr_pxconv_<instruction set>.cpp file, after they have defined the vector types and operations below
+// for their own vector width. This way the conversions are only written once.
+//
+// The operations are done in the same order as in the reference in svr_pxconv.cpp, so the results are the same to the bit.
+// Columns at the end of a row that do not fill a whole vector are done one by one with the reference operations.
+//
+// To be defined before including:
+// PXV_LANES - Number of floats in a vector.
+// PXV_FN(NAME) - Makes a function name unique for the instruction set.
+// PXV_KERNELS - Name of the PxConvKernels to define.
+// PxVf, PxVi - Vector of floats and vector of 32-bit integers.
+// pxv_loadf, pxv_storef, pxv_set1f, pxv_addf, pxv_mulf, pxv_divf, pxv_maxf, pxv_minf - Float operations (unaligned memory).
+// pxv_loadi, pxv_storei, pxv_set1i, pxv_andi, pxv_ori, pxv_srli, pxv_slli - Integer operations (unaligned memory).
+// pxv_cvtif, pxv_cvttfi - Integer to float and float to integer with truncation.
+// pxv_store_u8, pxv_store_u16 - Stores the low 8 or 16 bits of every integer (the values must fit).
+// pxv_evenf(A, B) - Every other float starting from the first, of A followed by B.
+// pxv_load_u16(P) - Loads 16-bit values into integers.
+
+// Same as pxconv_store_u8.
+// Max returns the second operand when one of them is NaN, so NaN becomes 0 like in the reference.
+static inline PxVi PXV_FN(pxv_store_range)(PxVf v)
+{
+    v = pxv_maxf(v, pxv_set1f(0.0f));
+    v = pxv_minf(v, pxv_set1f(255.0f));
+    return pxv_cvttfi(v);
+}
+
+// Same as the sums in pxconv_calc_y and pxconv_calc_uv, for values that are already scaled to 255.
+static inline PxVf PXV_FN(pxv_calc)(float base, const float* coeffs, PxVf r, PxVf g, PxVf b)
+{
+    PxVf ret = pxv_addf(pxv_set1f(base), pxv_mulf(r, pxv_set1f(coeffs[0])));
+    ret = pxv_addf(ret, pxv_mulf(g, pxv_set1f(coeffs[1])));
+    ret = pxv_addf(ret, pxv_mulf(b, pxv_set1f(coeffs[2])));
+    return ret;
+}
+
+// Same as pxconv_row_avg.
+static inline PxVf PXV_FN(pxv_avg)(const float* top, const float* bottom, s32 x)
+{
+    PxVf sum = pxv_addf(pxv_loadf(top + x), pxv_loadf(top + x + 1));
+    sum = pxv_addf(sum, pxv_loadf(bottom + x));
+    sum = pxv_addf(sum, pxv_loadf(bottom + x + 1));
+
+    // Same as dividing by 4.
+    return pxv_mulf(sum, pxv_set1f(0.25f));
+}
+
+// Chroma is calculated from the top left average of the 2x2 blocks, which is every other average in the row.
+static inline void PXV_FN(pxv_calc_uv)(const PxConvRow* avg, s32 chroma_x, const PxConvCoeffs* c, PxVi* u, PxVi* v)
+{
+    s32 x = chroma_x * 2;
+
+    PxVf scale = pxv_set1f(255.0f);
+
+    PxVf r = pxv_mulf(pxv_evenf(pxv_loadf(avg->r + x), pxv_loadf(avg->r + x + PXV_LANES)), scale);
+    PxVf g = pxv_mulf(pxv_evenf(pxv_loadf(avg->g + x), pxv_loadf(avg->g + x + PXV_LANES)), scale);
+    PxVf b = pxv_mulf(pxv_evenf(pxv_loadf(avg->b + x), pxv_loadf(avg->b + x + PXV_LANES)), scale);
+
+    *u = PXV_FN(pxv_store_range)(PXV_FN(pxv_calc)(128.0f, c->u, r, g, b));
+    *v = PXV_FN(pxv_store_range)(PXV_FN(pxv_calc)(128.0f, c->v, r, g, b));
+}
+
+// -------------------------------------------------
+
+static void PXV_FN(pxconv_load_bgra8)(const u8* source, s32 width, PxConvRow* dest)
+{
+    PxVf norm = pxv_set1f(255.0f);
+    PxVi mask = pxv_set1i(0xff);
+
+    s32 x = 0;
+
+    for (; x + PXV_LANES <= width; x += PXV_LANES)
+    {
+        PxVi px = pxv_loadi(source + (x * 4));
+
+        pxv_storef(dest->b + x, pxv_divf(pxv_cvtif(pxv_andi(px, mask)), norm));
+        pxv_storef(dest->g + x, pxv_divf(pxv_cvtif(pxv_andi(pxv_srli(px, 8), mask)), norm));
+        pxv_storef(dest->r + x, pxv_divf(pxv_cvtif(pxv_andi(pxv_srli(px, 16), mask)), norm));
+    }
+
+    for (; x < width; x++)
+    {
+        pxconv_load_bgra8_px(source, x, dest);
+    }
+
+    pxconv_repeat_last_px(dest, width);
+}
+
+static void PXV_FN(pxconv_load_float32)(const float* source, s32 width, PxConvRow* dest)
+{
+    s32 x = 0;
+
+    for (; x + PXV_LANES <= width; x += PXV_LANES)
+    {
+        pxv_storef(dest->r + x, pxv_loadf(source + x));
+        pxv_storef(dest->g + x, pxv_loadf(source + width + x));
+        pxv_storef(dest->b + x, pxv_loadf(source + (width * 2) + x));
+    }
+
+    for (; x < width; x++)
+    {
+        pxconv_load_float32_px(source, width, x, dest);
+    }
+
+    pxconv_repeat_last_px(dest, width);
+}
+
+static void PXV_FN(pxconv_load_fixed16)(const u16* source, s32 width, PxConvRow* dest)
+{
+    PxVf norm = pxv_set1f(65280.0f);
+
+    s32 x = 0;
+
+    for (; x + PXV_LANES <= width; x += PXV_LANES)
+    {
+        pxv_storef(dest->r + x, pxv_divf(pxv_cvtif(pxv_load_u16(source + x)), norm));
+        pxv_storef(dest->g + x, pxv_divf(pxv_cvtif(pxv_load_u16(source + width + x)), norm));
+        pxv_storef(dest->b + x, pxv_divf(pxv_cvtif(pxv_load_u16(source + (width * 2) + x)), norm));
+    }
+
+    for (; x < width; x++)
+    {
+        pxconv_load_fixed16_px(source, width, x, dest);
+    }
+
+    pxconv_repeat_last_px(dest, width);
+}
+
+static void PXV_FN(pxconv_luma)(const PxConvRow* top, const PxConvRow* bottom, s32 width, const PxConvCoeffs* c, u8* dest_y, PxConvRow* avg)
+{
+    PxVf scale = pxv_set1f(255.0f);
+
+    s32 x = 0;
+
+    for (; x + PXV_LANES <= width; x += PXV_LANES)
+    {
+        PxVf r = PXV_FN(pxv_avg)(top->r, bottom->r, x);
+        PxVf g = PXV_FN(pxv_avg)(top->g, bottom->g, x);
+        PxVf b = PXV_FN(pxv_avg)(top->b, bottom->b, x);
+
+        if (avg)
+        {
+            pxv_storef(avg->r + x, r);
+            pxv_storef(avg->g + x, g);
+            pxv_storef(avg->b + x, b);
+        }
+
+        PxVf y = PXV_FN(pxv_calc)(16.0f, c->y, pxv_mulf(r, scale), pxv_mulf(g, scale), pxv_mulf(b, scale));
+        pxv_store_u8(dest_y + x, PXV_FN(pxv_store_range)(y));
+    }
+
+    for (; x < width; x++)
+    {
+        float rgb[3];
+        pxconv_row_avg(top, bottom, x, rgb);
+
+        if (avg)
+        {
+            avg->r[x] = rgb[0];
+            avg->g[x] = rgb[1];
+            avg->b[x] = rgb[2];
+        }
+
+        dest_y[x] = pxconv_calc_y(*c, rgb);
+    }
+}
+
+static void PXV_FN(pxconv_chroma_planar)(const PxConvRow* avg, s32 chroma_width, const PxConvCoeffs* c, u8* dest_u, u8* dest_v)
+{
+    s32 cx = 0;
+
+    for (; cx + PXV_LANES <= chroma_width; cx += PXV_LANES)
+    {
+        PxVi u;
+        PxVi v;
+        PXV_FN(pxv_calc_uv)(avg, cx, c, &u, &v);
+
+        pxv_store_u8(dest_u + cx, u);
+        pxv_store_u8(dest_v + cx, v);
+    }
+
+    for (; cx < chroma_width; cx++)
+    {
+        float rgb[3];
+        pxconv_row_px(avg, cx * 2, rgb);
+
+        pxconv_calc_uv(*c, rgb, &dest_u[cx], &dest_v[cx]);
+    }
+}
+
+static void PXV_FN(pxconv_chroma_interleaved)(const PxConvRow* avg, s32 chroma_width, const PxConvCoeffs* c, bool vu, u8* dest)
+{
+    s32 cx = 0;
+
+    for (; cx + PXV_LANES <= chroma_width; cx += PXV_LANES)
+    {
+        PxVi u;
+        PxVi v;
+        PXV_FN(pxv_calc_uv)(avg, cx, c, &u, &v);
+
+        PxVi first = vu ? v : u;
+        PxVi second = vu ? u : v;
+
+        pxv_store_u16(dest + (cx * 2), pxv_ori(first, pxv_slli(second, 8)));
+    }
+
+    for (; cx < chroma_width; cx++)
+    {
+        float rgb[3];
+        pxconv_row_px(avg, cx * 2, rgb);
+
+        u8 u;
+        u8 v;
+        pxconv_calc_uv(*c, rgb, &u, &v);
+
+        dest[(cx * 2) + 0] = vu ? v : u;
+        dest[(cx * 2) + 1] = vu ? u : v;
+    }
+}
+
+static void PXV_FN(pxconv_yuv444)(const PxConvRow* row, s32 width, const PxConvCoeffs* c, u8* dest_y, u8* dest_u, u8* dest_v)
+{
+    PxVf scale = pxv_set1f(255.0f);
+
+    s32 x = 0;
+
+    for (; x + PXV_LANES <= width; x += PXV_LANES)
+    {
+        PxVf r = pxv_mulf(pxv_loadf(row->r + x), scale);
+        PxVf g = pxv_mulf(pxv_loadf(row->g + x), scale);
+        PxVf b = pxv_mulf(pxv_loadf(row->b + x), scale);
+
+        pxv_store_u8(dest_y + x, PXV_FN(pxv_store_range)(PXV_FN(pxv_calc)(16.0f, c->y, r, g, b)));
+        pxv_store_u8(dest_u + x, PXV_FN(pxv_store_range)(PXV_FN(pxv_calc)(128.0f, c->u, r, g, b)));
+        pxv_store_u8(dest_v + x, PXV_FN(pxv_store_range)(PXV_FN(pxv_calc)(128.0f, c->v, r, g, b)));
+    }
+
+    for (; x < width; x++)
+    {
+        float rgb[3];
+        pxconv_row_px(row, x, rgb);
+
+        dest_y[x] = pxconv_calc_y(*c, rgb);
+        pxconv_calc_uv(*c, rgb, &dest_u[x], &dest_v[x]);
+    }
+}
+
+static void PXV_FN(pxconv_bgr0)(const PxConvRow* row, s32 width, u8* dest)
+{
+    PxVf scale = pxv_set1f(255.0f);
+    PxVi alpha = pxv_set1i((s32)0xff000000);
+
+    s32 x = 0;
+
+    for (; x + PXV_LANES <= width; x += PXV_LANES)
+    {
+        PxVi r = PXV_FN(pxv_store_range)(pxv_mulf(pxv_loadf(row->r + x), scale));
+        PxVi g = PXV_FN(pxv_store_range)(pxv_mulf(pxv_loadf(row->g + x), scale));
+        PxVi b = PXV_FN(pxv_store_range)(pxv_mulf(pxv_loadf(row->b + x), scale));
+
+        PxVi px = pxv_ori(pxv_ori(b, pxv_slli(g, 8)), pxv_ori(pxv_slli(r, 16), alpha));
+        pxv_storei(dest + (x * 4), px);
+    }
+
+    for (; x < width; x++)
+    {
+        float rgb[3];
+        pxconv_row_px(row, x, rgb);
+
+        pxconv_bgr0_px(rgb, dest + (x * 4));
+    }
+}
+
+extern const PxConvKernels PXV_KERNELS = {
+    PXV_FN(pxconv_load_bgra8),
+    PXV_FN(pxconv_load_float32),
+    PXV_FN(pxconv_load_fixed16),
+    PXV_FN(pxconv_luma),
+    PXV_FN(pxconv_chroma_planar),
+    PXV_FN(pxconv_chroma_interleaved),
+    PXV_FN(pxconv_yuv444),
+    PXV_FN(pxconv_bgr0),
+};
@@ -0,0 +1,57 @@
+#include "svr_pxconv_impl.h"
+#include <string.h>
+#include <smmintrin.h>
+
+// Pixel conversion with SSE4.1 (4 pixels at a time). See svr_pxconv_simd.h.
+// SSE4.1 is needed for the unsigned 32-bit to 16-bit packing.
+
+#pragma float_control(precise, on, push)
+#pragma fp_contract(off)
+
+typedef __m128 PxVf;
+typedef __m128i PxVi;
+
+#define PXV_LANES 4
+#define PXV_FN(NAME) NAME##_sse41
+#define PXV_KERNELS PXCONV_KERNELS_SSE41
+
+#define pxv_loadf(P) _mm_loadu_ps(P)
+#define pxv_storef(P, V) _mm_storeu_ps(P, V)
+#define pxv_set1f(X) _mm_set1_ps(X)
+#define pxv_addf(A, B) _mm_add_ps(A, B)
+#define pxv_mulf(A, B) _mm_mul_ps(A, B)
+#define pxv_divf(A, B) _mm_div_ps(A, B)
+#define pxv_maxf(A, B) _mm_max_ps(A, B)
+#define pxv_minf(A, B) _mm_min_ps(A, B)
+
+#define pxv_loadi(P) _mm_loadu_si128((const __m128i*)(P))
+#define pxv_storei(P, V) _mm_storeu_si128((__m128i*)(P), V)
+#define pxv_set1i(X) _mm_set1_epi32(X)
+#define pxv_andi(A, B) _mm_and_si128(A, B)
+#define pxv_ori(A, B) _mm_or_si128(A, B)
+#define pxv_srli(V, N) _mm_srli_epi32(V, N)
+#define pxv_slli(V, N) _mm_slli_epi32(V, N)
+
+#define pxv_cvtif(V) _mm_cvtepi32_ps(V)
+#define pxv_cvttfi(V) _mm_cvttps_epi32(V)
+#define pxv_load_u16(P) _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)(P)))
+
+#define pxv_evenf(A, B) _mm_shuffle_ps(A, B, _MM_SHUFFLE(2, 0, 2, 0))
+
+static inline void pxv_store_u8(u8* dest, PxVi v)
+{
+    PxVi packed = _mm_packus_epi32(v, v);
+    packed = _mm_packus_epi16(packed, packed);
+
+    s32 bytes = _mm_cvtsi128_si32(packed);
+    memcpy(dest, &bytes, sizeof(s32));
+}
+
+static inline void pxv_store_u16(u8* dest, PxVi v)
+{
+    _mm_storel_epi64((__m128i*)dest, _mm_packus_epi32(v, v));
+}
+
+#include "svr_pxconv_simd.h"
+
+#pragma float_control(pop)
@@ -48,3 +48,23 @@ void svr_sem_wait(SvrSemaphore* sem)
         }
     }
 }
+
+bool svr_sem_try_wait(SvrSemaphore* sem)
+{
+    while (true)
+    {
+        s32 orig_count = sem->count;
+
+        if (orig_count == 0)
+        {
+            return false;
+        }
+
+        LONG prev_count = InterlockedCompareExchange((volatile LONG*)&sem->count, (LONG)orig_count - 1, (LONG)orig_count);
+
+        if (prev_count == (LONG)orig_count)
+        {
+            return true;
+        }
+    }
+}
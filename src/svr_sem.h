@@ -14,3 +14,6 @@ struct SvrSemaphore
 void svr_sem_init(SvrSemaphore* sem, s32 init_count, s32 max_count);
 void svr_sem_release(SvrSemaphore* sem);
 void svr_sem_wait(SvrSemaphore* sem);
+
+// Returns false instead of waiting when the count is 0.
+bool svr_sem_try_wait(SvrSemaphore* sem);
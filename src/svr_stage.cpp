@@ -0,0 +1,270 @@
+#include "svr_stage.h"
+#include "svr_trace.h"
+#include <Windows.h>
+#include <assert.h>
+#include <intrin.h>
+
+DWORD WINAPI svr_stage_thread_proc(LPVOID lpParameter)
+{
+    SvrStage* stage = (SvrStage*)lpParameter;
+
+    svr_trace_name_thread(stage->name, -1);
+
+    while (true)
+    {
+        svr_sem_wait(&stage->items_sem);
+
+        void* item;
+        bool res1 = stage->queue.pull(&item);
+        assert(res1);
+
+        svr_sem_release(&stage->space_sem);
+
+        if (item == NULL)
+        {
+            return 0;
+        }
+
+        svr_start_prof(&stage->prof);
+        svr_trace_begin(stage->name);
+        stage->fn(item, stage->user);
+        svr_trace_end(stage->name);
+        svr_end_prof(&stage->prof);
+    }
+
+    return 0;
+}
+
+void svr_stage_init(SvrStage* stage, const char* name, s32 max_depth)
+{
+    stage->name = name;
+    stage->queue.init(max_depth);
+}
+
+void svr_stage_start(SvrStage* stage, s32 depth, SvrStageFn fn, void* user)
+{
+    assert(depth > 0 && depth < stage->queue.buffer_capacity);
+
+    stage->fn = fn;
+    stage->user = user;
+
+    // We have a controlled environment until the thread is started.
+    // Set the semaphores and queue to known states.
+
+    svr_sem_init(&stage->items_sem, 0, depth);
+    svr_sem_init(&stage->space_sem, depth, depth);
+
+    stage->queue.reset();
+
+    svr_reset_hist(&stage->wait_hist);
+
+    _ReadWriteBarrier();
+
+    stage->thread = CreateThread(NULL, 0, svr_stage_thread_proc, stage, 0, NULL);
+}
+
+void stage_push_item(SvrStage* stage, void* item)
+{
+    svr_start_hist(&stage->wait_hist);
+    svr_trace_begin("Queue wait");
+
+    svr_sem_wait(&stage->space_sem);
+
+    svr_trace_end("Queue wait");
+    svr_end_hist(&stage->wait_hist);
+
+    bool res1 = stage->queue.push(&item);
+    assert(res1);
+
+    svr_sem_release(&stage->items_sem);
+}
+
+void svr_stage_push(SvrStage* stage, void* item)
+{
+    assert(item);
+    stage_push_item(stage, item);
+}
+
+void svr_stage_stop(SvrStage* stage)
+{
+    if (stage->thread == NULL)
+    {
+        return;
+    }
+
+    stage_push_item(stage, NULL);
+
+    WaitForSingleObject((HANDLE)stage->thread, INFINITE);
+
+    CloseHandle((HANDLE)stage->thread);
+    stage->thread = NULL;
+
+    assert(stage->queue.read_buffer_health() == 0);
+}
+
+// -------------------------------------------------
+
+void svr_pool_init(SvrPool* pool, s32 max_items)
+{
+    pool->queue.init(max_items);
+    svr_pool_reset(pool);
+}
+
+void svr_pool_reset(SvrPool* pool)
+{
+    svr_sem_init(&pool->sem, 0, pool->queue.buffer_capacity - 1);
+    pool->queue.reset();
+}
+
+void svr_pool_put(SvrPool* pool, void* item)
+{
+    bool res1 = pool->queue.push(&item);
+    assert(res1);
+
+    svr_sem_release(&pool->sem);
+}
+
+void* svr_pool_take(SvrPool* pool)
+{
+    svr_sem_wait(&pool->sem);
+
+    void* item;
+    bool res1 = pool->queue.pull(&item);
+    assert(res1);
+
+    return item;
+}
+
+// -------------------------------------------------
+
+// Band 0 is done by the calling thread, and the threads do the bands after.
+void calc_band_rows(SvrBandPool* pool, s32 band, s32* start_row, s32* end_row)
+{
+    s32 num_bands = pool->num_threads + 1;
+
+    *start_row = (s32)(((s64)pool->num_rows * band) / num_bands);
+    *end_row = (s32)(((s64)pool->num_rows * (band + 1)) / num_bands);
+}
+
+DWORD WINAPI svr_band_thread_proc(LPVOID lpParameter)
+{
+    SvrBandThread* bt = (SvrBandThread*)lpParameter;
+    SvrBandPool* pool = bt->pool;
+
+    svr_trace_name_thread("Band", bt->index);
+
+    while (true)
+    {
+        svr_sem_wait(&bt->start_sem);
+
+        if (pool->stopping)
+        {
+            return 0;
+        }
+
+        s32 start_row;
+        s32 end_row;
+        calc_band_rows(pool, bt->index + 1, &start_row, &end_row);
+
+        if (start_row < end_row)
+        {
+            svr_trace_begin("Band");
+            pool->fn(start_row, end_row, pool->user);
+            svr_trace_end("Band");
+        }
+
+        svr_sem_release(&pool->done_sem);
+    }
+
+    return 0;
+}
+
+void svr_band_pool_start(SvrBandPool* pool, s32 num_threads)
+{
+    assert(num_threads >= 0 && num_threads <= SVR_MAX_BAND_THREADS);
+
+    pool->num_threads = num_threads;
+    pool->stopping = false;
+
+    svr_sem_init(&pool->done_sem, 0, num_threads);
+
+    for (s32 i = 0; i < num_threads; i++)
+    {
+        SvrBandThread* bt = &pool->threads[i];
+        bt->pool = pool;
+        bt->index = i;
+
+        svr_sem_init(&bt->start_sem, 0, 1);
+    }
+
+    _ReadWriteBarrier();
+
+    for (s32 i = 0; i < num_threads; i++)
+    {
+        SvrBandThread* bt = &pool->threads[i];
+        bt->thread = CreateThread(NULL, 0, svr_band_thread_proc, bt, 0, NULL);
+    }
+}
+
+void svr_band_pool_run(SvrBandPool* pool, s32 num_rows, SvrBandFn fn, void* user)
+{
+    pool->fn = fn;
+    pool->user = user;
+    pool->num_rows = num_rows;
+
+    // The semaphores order the writes above with the threads.
+
+    for (s32 i = 0; i < pool->num_threads; i++)
+    {
+        svr_sem_release(&pool->threads[i].start_sem);
+    }
+
+    s32 start_row;
+    s32 end_row;
+    calc_band_rows(pool, 0, &start_row, &end_row);
+
+    if (start_row < end_row)
+    {
+        fn(start_row, end_row, user);
+    }
+
+    for (s32 i = 0; i < pool->num_threads; i++)
+    {
+        svr_sem_wait(&pool->done_sem);
+    }
+}
+
+void svr_band_pool_stop(SvrBandPool* pool)
+{
+    pool->stopping = true;
+
+    for (s32 i = 0; i < pool->num_threads; i++)
+    {
+        svr_sem_release(&pool->threads[i].start_sem);
+    }
+
+    for (s32 i = 0; i < pool->num_threads; i++)
+    {
+        SvrBandThread* bt = &pool->threads[i];
+
+        WaitForSingleObject((HANDLE)bt->thread, INFINITE);
+        CloseHandle((HANDLE)bt->thread);
+
+        bt->thread = NULL;
+    }
+
+    pool->num_threads = 0;
+}
+
+s32 svr_calc_band_threads()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+
+    // More threads than this does not help when the memory is the limit.
+    // The calling thread does one band too.
+    s32 num_threads = (s32)(info.dwNumberOfProcessors / 2) - 1;
+    svr_clamp(&num_threads, 0, 7);
+
+    return num_threads;
+}
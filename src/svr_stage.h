@@ -0,0 +1,119 @@
+#pragma once
+#include "svr_common.h"
+#include "svr_stream.h"
+#include "svr_sem.h"
+#include "svr_prof.h"
+#include "svr_hist.h"
+
+// Building blocks for the frame pipelines in proc.
+// Work is split up into stages where every stage has its own thread. Items are handed between the stages through bounded queues
+// and are processed in the order they were pushed. Pushing will wait when the queue is full, so a slow stage holds back the stages
+// before it instead of using more memory.
+// Items are pointers and are owned by whoever made them. NULL is used internally to stop the thread and cannot be pushed.
+
+typedef void(*SvrStageFn)(void* item, void* user);
+
+struct SvrStage
+{
+    const char* name;
+
+    SvrStageFn fn;
+    void* user;
+
+    SvrAsyncStream<void*> queue;
+
+    // Signalled when there are items in the queue.
+    SvrSemaphore items_sem;
+
+    // Signalled when there is room in the queue.
+    SvrSemaphore space_sem;
+
+    void* thread;
+
+    // Time spent in the stage function.
+    SvrProf prof;
+
+    // Time that pushing waited for room in the queue. Can be read while the stage is running.
+    SvrHist wait_hist;
+};
+
+// To be called once. The queue is allocated here and the depth when starting cannot be more than max_depth.
+void svr_stage_init(SvrStage* stage, const char* name, s32 max_depth);
+
+void svr_stage_start(SvrStage* stage, s32 depth, SvrStageFn fn, void* user);
+
+// Safe for 1 thread to push.
+void svr_stage_push(SvrStage* stage, void* item);
+
+// Waits for all pushed items to be processed and for the thread to exit.
+void svr_stage_stop(SvrStage* stage);
+
+// -------------------------------------------------
+
+// Free items that are waited on, such as the buffers that move between the stages.
+// Safe for 1 thread to put and for 1 thread to take.
+struct SvrPool
+{
+    SvrAsyncStream<void*> queue;
+    SvrSemaphore sem;
+};
+
+// To be called once.
+void svr_pool_init(SvrPool* pool, s32 max_items);
+
+// Empties the pool. The environment must be controlled and known for this to be called.
+void svr_pool_reset(SvrPool* pool);
+
+void svr_pool_put(SvrPool* pool, void* item);
+
+// Waits until there is an item.
+void* svr_pool_take(SvrPool* pool);
+
+// -------------------------------------------------
+
+// Splits up work on the rows of a frame between threads, for stages that are too slow for one thread.
+// The calling thread does the first band and waits for the other threads to finish theirs.
+
+const s32 SVR_MAX_BAND_THREADS = 16;
+
+typedef void(*SvrBandFn)(s32 start_row, s32 end_row, void* user);
+
+struct SvrBandPool;
+
+struct SvrBandThread
+{
+    SvrBandPool* pool;
+    s32 index;
+
+    void* thread;
+
+    // Signalled when there is a band to do.
+    SvrSemaphore start_sem;
+};
+
+struct SvrBandPool
+{
+    // Not counting the calling thread.
+    s32 num_threads;
+    SvrBandThread threads[SVR_MAX_BAND_THREADS];
+
+    // What is currently being run.
+    SvrBandFn fn;
+    void* user;
+    s32 num_rows;
+    bool stopping;
+
+    // Signalled by every thread when its band is done.
+    SvrSemaphore done_sem;
+};
+
+// A thread count of 0 runs everything on the calling thread.
+void svr_band_pool_start(SvrBandPool* pool, s32 num_threads);
+
+// Safe for 1 thread to run. Returns when all rows are done.
+void svr_band_pool_run(SvrBandPool* pool, s32 num_rows, SvrBandFn fn, void* user);
+
+void svr_band_pool_stop(SvrBandPool* pool);
+
+// How many threads to start for work that is limited by memory bandwidth, leaving room for the other threads of the pipeline.
+s32 svr_calc_band_threads();
@@ -0,0 +1,116 @@
+#include "svr_stats.h"
+#include "svr_prof.h"
+#include "svr_atom.h"
+#include "svr_logging.h"
+#include <Windows.h>
+#include <strsafe.h>
+#include <string.h>
+#include <intrin.h>
+
+// Kept for as long as the process lives, so the other process can see that no movie is active after the last one.
+HANDLE shared_stats_mapping;
+SvrSharedStats* shared_stats;
+
+s64 shared_stats_time;
+
+bool svr_create_shared_stats()
+{
+    bool ret = false;
+
+    char name[MAX_PATH];
+
+    if (shared_stats)
+    {
+        return true;
+    }
+
+    StringCchPrintfA(name, MAX_PATH, "%s%lu", SVR_SHARED_STATS_PREFIX, GetCurrentProcessId());
+
+    shared_stats_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(SvrSharedStats), name);
+
+    if (shared_stats_mapping == NULL)
+    {
+        svr_log("Could not create shared memory for the stats %s (%lu)\n", name, GetLastError());
+        goto rfail;
+    }
+
+    shared_stats = (SvrSharedStats*)MapViewOfFile(shared_stats_mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(SvrSharedStats));
+
+    if (shared_stats == NULL)
+    {
+        svr_log("Could not map shared memory for the stats %s (%lu)\n", name, GetLastError());
+        goto rfail;
+    }
+
+    // New memory is zeroed, so the stats say that no movie is active.
+    shared_stats->api_version = SVR_API_VERSION;
+
+    // Written last, the other process checks this to know that the memory is set up.
+    svr_atom_store((SvrAtom32*)&shared_stats->magic, SVR_SHARED_STATS_MAGIC);
+
+    ret = true;
+    goto rexit;
+
+rfail:
+    if (shared_stats_mapping)
+    {
+        CloseHandle(shared_stats_mapping);
+        shared_stats_mapping = NULL;
+    }
+
+rexit:
+    return ret;
+}
+
+bool svr_shared_stats_due()
+{
+    return shared_stats && svr_prof_get_real_time() - shared_stats_time >= SVR_SHARED_STATS_INTERVAL;
+}
+
+void svr_publish_stats(SvrStats* stats)
+{
+    if (shared_stats == NULL)
+    {
+        return;
+    }
+
+    shared_stats_time = svr_prof_get_real_time();
+
+    // The other process copies the stats again if the sequence is odd or changes while it copies.
+    // Stores are not reordered with other stores on x86, so only the compiler has to be kept from moving them.
+    SvrAtom32* sequence = (SvrAtom32*)&shared_stats->sequence;
+    s32 seq = svr_atom_read(sequence);
+
+    svr_atom_store(sequence, seq + 1);
+    _ReadWriteBarrier();
+
+    memcpy(&shared_stats->stats, stats, sizeof(SvrStats));
+
+    svr_atom_store(sequence, seq + 2);
+}
+
+// -------------------------------------------------
+
+void svr_start_rate(SvrRate* rate, s64 count)
+{
+    rate->start_time = svr_prof_get_real_time();
+    rate->start_count = count;
+    rate->rate = 0.0;
+}
+
+double svr_update_rate(SvrRate* rate, s64 count)
+{
+    const s64 RATE_INTERVAL = 1000000;
+
+    s64 now = svr_prof_get_real_time();
+    s64 elapsed = now - rate->start_time;
+
+    if (elapsed >= RATE_INTERVAL)
+    {
+        rate->rate = (double)(count - rate->start_count) * 1000000.0 / (double)elapsed;
+        rate->start_time = now;
+        rate->start_count = count;
+    }
+
+    return rate->rate;
+}
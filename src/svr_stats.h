@@ -0,0 +1,31 @@
+#pragma once
+#include "svr_common.h"
+#include "svr_api.h"
+
+// Publishes the stats of svr_get_stats in named shared memory, so that another process can read them without going through the game
+// (see SvrSharedStats in svr_api.h). Only used by the game thread.
+
+// How often the stats are published while a movie is being made, in microseconds.
+const s64 SVR_SHARED_STATS_INTERVAL = 100000;
+
+// Creates the shared memory for this process, where no movie is active until stats are published.
+// Nothing is published if this fails, which does not stop movies from being made.
+bool svr_create_shared_stats();
+
+// Returns true when it has been long enough since the stats were last published.
+bool svr_shared_stats_due();
+
+void svr_publish_stats(SvrStats* stats);
+
+// Rate of a count that goes up, such as the frames that have been written, over about the last second.
+struct SvrRate
+{
+    s64 start_time;
+    s64 start_count;
+    double rate;
+};
+
+void svr_start_rate(SvrRate* rate, s64 count);
+
+// The rate is measured again when a second has gone by since the last time, otherwise the rate from then is kept.
+double svr_update_rate(SvrRate* rate, s64 count);
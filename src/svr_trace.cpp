@@ -0,0 +1,300 @@
+#include "svr_trace.h"
+#include "svr_atom.h"
+#include <Windows.h>
+#include <strsafe.h>
+#include <malloc.h>
+#include <intrin.h>
+#include <stb_sprintf.h>
+
+struct SvrTraceEvent
+{
+    // TSC ticks.
+    u64 time;
+
+    const char* name;
+    s64 value;
+    SvrTraceType type;
+};
+
+struct SvrTraceRing
+{
+    // Allocated the first time the ring is used, and kept for the next traces.
+    SvrTraceEvent* events;
+
+    // Events that have been pushed, the last SVR_TRACE_RING_SIZE of which are in the ring.
+    // Only written by the thread of the ring, after the event. Read when the trace is written after tracing has been disabled,
+    // which a thread that has just checked the flag can still be pushing one more event at the same time as.
+    volatile s64 num_events;
+
+    DWORD thread_id;
+
+    const char* thread_name;
+    s32 thread_index;
+};
+
+bool svr_trace_enabled;
+
+SvrTraceRing trace_rings[SVR_TRACE_MAX_THREADS];
+SvrAtom32 trace_num_rings;
+
+// Every trace has a new generation, and a thread takes a new ring when it sees that the generation has changed.
+// This way the rings are given back when a trace ends without having to know when threads exit.
+s32 trace_generation;
+
+char trace_path[MAX_PATH];
+
+// For turning TSC ticks into time, which is measured over the whole trace.
+u64 trace_start_tsc;
+LARGE_INTEGER trace_start_qpc;
+
+thread_local SvrTraceRing* trace_thread_ring;
+thread_local s32 trace_thread_generation;
+thread_local const char* trace_thread_name;
+thread_local s32 trace_thread_index = -1;
+
+void trace_take_ring()
+{
+    trace_thread_generation = trace_generation;
+    trace_thread_ring = NULL;
+
+    s32 index = svr_atom_add(&trace_num_rings, 1);
+
+    if (index >= SVR_TRACE_MAX_THREADS)
+    {
+        return;
+    }
+
+    SvrTraceRing* ring = &trace_rings[index];
+
+    if (ring->events == NULL)
+    {
+        ring->events = (SvrTraceEvent*)malloc(sizeof(SvrTraceEvent) * SVR_TRACE_RING_SIZE);
+
+        // The thread is then not traced, and the ring is skipped when the trace is written.
+        if (ring->events == NULL)
+        {
+            return;
+        }
+    }
+
+    ring->num_events = 0;
+    ring->thread_id = GetCurrentThreadId();
+    ring->thread_name = trace_thread_name;
+    ring->thread_index = trace_thread_index;
+
+    trace_thread_ring = ring;
+}
+
+void svr_trace_push(SvrTraceType type, const char* name, s64 value)
+{
+    if (trace_thread_generation != trace_generation)
+    {
+        trace_take_ring();
+    }
+
+    SvrTraceRing* ring = trace_thread_ring;
+
+    if (ring == NULL)
+    {
+        return;
+    }
+
+    s64 num_events = ring->num_events;
+
+    SvrTraceEvent* ev = &ring->events[num_events & (SVR_TRACE_RING_SIZE - 1)];
+    ev->time = __rdtsc();
+    ev->name = name;
+    ev->value = value;
+    ev->type = type;
+
+    // The event must be complete before it is counted. Stores are not reordered with other stores on x86.
+    _ReadWriteBarrier();
+
+    ring->num_events = num_events + 1;
+}
+
+void svr_trace_name_thread(const char* name, s32 index)
+{
+    trace_thread_name = name;
+    trace_thread_index = index;
+
+    if (trace_thread_ring && trace_thread_generation == trace_generation)
+    {
+        trace_thread_ring->thread_name = name;
+        trace_thread_ring->thread_index = index;
+    }
+}
+
+void svr_start_trace(const char* path)
+{
+    svr_trace_enabled = false;
+
+    StringCchCopyA(trace_path, MAX_PATH, path);
+
+    svr_atom_set(&trace_num_rings, 0);
+    trace_generation++;
+
+    QueryPerformanceCounter(&trace_start_qpc);
+    trace_start_tsc = __rdtsc();
+
+    // The threads must see the new generation before they see that tracing is enabled. Stores are not reordered with other stores on x86.
+    _ReadWriteBarrier();
+
+    svr_trace_enabled = true;
+}
+
+// -------------------------------------------------
+
+// The trace is put together in this and written when it is full.
+struct TraceWriter
+{
+    HANDLE file;
+
+    char* buf;
+    s32 used;
+    s32 size;
+
+    bool failed;
+};
+
+void trace_flush(TraceWriter* w)
+{
+    DWORD written;
+
+    if (w->used > 0 && !WriteFile(w->file, w->buf, w->used, &written, NULL))
+    {
+        w->failed = true;
+    }
+
+    w->used = 0;
+}
+
+void trace_write(TraceWriter* w, const char* format, ...)
+{
+    const s32 MAX_LINE_SIZE = 512;
+
+    if (w->size - w->used < MAX_LINE_SIZE)
+    {
+        trace_flush(w);
+    }
+
+    va_list va;
+    va_start(va, format);
+
+    s32 len = stbsp_vsnprintf(w->buf + w->used, MAX_LINE_SIZE, format, va);
+
+    va_end(va);
+
+    w->used += svr_min(len, MAX_LINE_SIZE - 1);
+}
+
+bool svr_end_trace()
+{
+    const s32 WRITE_BUF_SIZE = 1024 * 1024;
+
+    // Phases of the Chrome trace format.
+    const char* EVENT_PHASES[] = { "B", "E", "C" };
+
+    if (!svr_trace_enabled)
+    {
+        return true;
+    }
+
+    svr_trace_enabled = false;
+
+    LARGE_INTEGER end_qpc;
+    LARGE_INTEGER qpc_freq;
+
+    QueryPerformanceCounter(&end_qpc);
+    QueryPerformanceFrequency(&qpc_freq);
+
+    u64 end_tsc = __rdtsc();
+
+    // Trace times are in microseconds.
+    double qpc_us = (double)(end_qpc.QuadPart - trace_start_qpc.QuadPart) * 1000000.0 / (double)qpc_freq.QuadPart;
+    double tsc_per_us = qpc_us > 0.0 ? (double)(end_tsc - trace_start_tsc) / qpc_us : 1.0;
+
+    s32 num_rings = svr_min(svr_atom_load(&trace_num_rings), SVR_TRACE_MAX_THREADS);
+
+    DWORD pid = GetCurrentProcessId();
+
+    TraceWriter w = {};
+
+    w.file = CreateFileA(trace_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (w.file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    w.buf = (char*)malloc(WRITE_BUF_SIZE);
+    w.size = WRITE_BUF_SIZE;
+
+    trace_write(&w, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    trace_write(&w, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%lu,\"tid\":0,\"args\":{\"name\":\"SVR\"}}", pid);
+
+    for (s32 i = 0; i < num_rings; i++)
+    {
+        SvrTraceRing* ring = &trace_rings[i];
+
+        // The thread may have taken the ring and not have set it up yet, in which case it has no events of this trace.
+        if (ring->events == NULL)
+        {
+            continue;
+        }
+
+        if (ring->thread_name)
+        {
+            if (ring->thread_index != -1)
+            {
+                trace_write(&w, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%lu,\"tid\":%lu,\"args\":{\"name\":\"%s %d\"}}", pid, ring->thread_id, ring->thread_name, ring->thread_index);
+            }
+
+            else
+            {
+                trace_write(&w, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%lu,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}", pid, ring->thread_id, ring->thread_name);
+            }
+        }
+
+        // Events that are pushed after this are left out. The oldest event of a full ring is left out too,
+        // as a push that is still going on would be writing over it.
+        s64 num_events = ring->num_events;
+        s64 first = 0;
+
+        if (num_events >= SVR_TRACE_RING_SIZE)
+        {
+            first = num_events - SVR_TRACE_RING_SIZE + 1;
+        }
+
+        for (s64 j = first; j < num_events; j++)
+        {
+            SvrTraceEvent* ev = &ring->events[j & (SVR_TRACE_RING_SIZE - 1)];
+
+            // A thread can have been in the middle of an event when the trace started.
+            if (ev->time < trace_start_tsc)
+            {
+                continue;
+            }
+
+            double ts = (double)(ev->time - trace_start_tsc) / tsc_per_us;
+
+            if (ev->type == SVR_TRACE_COUNTER)
+            {
+                trace_write(&w, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%0.3f,\"pid\":%lu,\"tid\":%lu,\"args\":{\"value\":%lld}}", ev->name, ts, pid, ring->thread_id, ev->value);
+            }
+
+            else
+            {
+                trace_write(&w, ",\n{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%0.3f,\"pid\":%lu,\"tid\":%lu}", ev->name, EVENT_PHASES[ev->type], ts, pid, ring->thread_id);
+            }
+        }
+    }
+
+    trace_write(&w, "\n]}\n");
+    trace_flush(&w);
+
+    CloseHandle(w.file);
+    free(w.buf);
+
+    return !w.failed;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "svr_common.h"
+
+// Tracing of what every thread is working on, for seeing where a frame spends its time and which thread is waiting for which.
+// This is enabled for a movie with trace_enabled in the profile. The trace is written when the
+// movie ends as a Chrome trace, which can be opened in chrome://tracing or ui.perfetto.dev.
+//
+// Every thread writes its events to a ring of its own, so nothing is shared or locked between threads. An event is a read of the TSC and
+// a few stores. When tracing is not enabled, an event is only the check of a flag. The rings keep the last events of every thread.
+//
+// Names are kept as pointers, so they must be string literals.
+
+enum SvrTraceType : u32
+{
+    SVR_TRACE_BEGIN,
+    SVR_TRACE_END,
+
+    // A value that is shown as a graph, such as how many buffers are in use.
+    SVR_TRACE_COUNTER,
+};
+
+// Events of a thread that are kept. Must be a power of 2.
+const s32 SVR_TRACE_RING_SIZE = 65536;
+
+// Threads that can be traced at once. Threads that are started after this many are not traced.
+const s32 SVR_TRACE_MAX_THREADS = 64;
+
+// Only set between svr_start_trace and svr_end_trace.
+extern bool svr_trace_enabled;
+
+void svr_trace_push(SvrTraceType type, const char* name, s64 value);
+
+// Starts a new trace that is written to the path when it ends. Events from before are thrown away.
+void svr_start_trace(const char* path);
+
+// Writes the trace if one was started. Returns false if it could not be written.
+// Other threads can still be pushing events while this is called, but what they push after tracing has been disabled is left out.
+// Only one trace can be made at a time, so this must be called before the next svr_start_trace.
+bool svr_end_trace();
+
+// Shown as the name of the thread, with the index after it if it is not -1. Kept for the next traces too.
+void svr_trace_name_thread(const char* name, s32 index);
+
+inline void svr_trace_begin(const char* name)
+{
+    if (svr_trace_enabled)
+    {
+        svr_trace_push(SVR_TRACE_BEGIN, name, 0);
+    }
+}
+
+inline void svr_trace_end(const char* name)
+{
+    if (svr_trace_enabled)
+    {
+        svr_trace_push(SVR_TRACE_END, name, 0);
+    }
+}
+
+inline void svr_trace_counter(const char* name, s64 value)
+{
+    if (svr_trace_enabled)
+    {
+        svr_trace_push(SVR_TRACE_COUNTER, name, value);
+    }
+}
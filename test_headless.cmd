@@ -0,0 +1,128 @@
+@echo off
+
+REM Runs movies through svr_headless.exe and checks that they come out as they should. Build the solution and run build_shaders.cmd first.
+REM Every check makes a movie in two ways that must give the same frames, with the stand-in ffmpeg that writes the raw frames instead
+REM of encoding them. The movies and the log (data\SVR_LOG.txt) are in bin\headless_standin.
+REM With "test_headless.cmd real", movies with audio are also made with the real ffmpeg in bin\headless, where the audio is the second
+REM input of ffmpeg through a named pipe. ffmpeg then has to decode both streams of the movie without errors.
+REM The exit code is the number of steps that failed.
+
+setlocal
+
+set HL=bin\svr_headless.exe
+set MOVIES=bin\headless_standin\movies
+set FAILS=0
+
+REM Odd sizes so the ends of the rows are used too.
+set COMMON=--standin --size 333x199 --frames 200
+set MB=--set motion_blur_enabled=1 --set motion_blur_fps_mult=10 --set motion_blur_exposure=0.5
+
+if not exist %HL% (
+    echo %HL% does not exist, build the solution first
+    exit /b 1
+)
+
+call :section "CPU conversions and motion sampling against the reference"
+%HL% selftest || call :fail
+
+call :section "CPU backend against the shaders"
+REM libx264 gives NV12 and libx264rgb gives BGR0, which are the only conversions that movies can use.
+%HL% compare plain.mp4 %COMMON% || call :fail
+%HL% compare mb.mp4 %COMMON% %MB% || call :fail
+%HL% compare plain_rgb.mp4 %COMMON% --set video_encoder=libx264rgb || call :fail
+%HL% compare mb_rgb.mp4 %COMMON% %MB% --set video_encoder=libx264rgb || call :fail
+
+call :section "Motion blur is the same when the game frames outside of the exposure are skipped"
+%HL% run mb_all.mp4 %COMMON% %MB% || call :fail
+%HL% run mb_skip.mp4 %COMMON% %MB% --skip || call :fail
+%HL% diff %MOVIES%\mb_all.mp4 %MOVIES%\mb_skip.mp4 || call :fail
+%HL% run mb_all_gpu.mp4 %COMMON% %MB% --gpu || call :fail
+%HL% run mb_skip_gpu.mp4 %COMMON% %MB% --gpu --skip || call :fail
+%HL% diff %MOVIES%\mb_all_gpu.mp4 %MOVIES%\mb_skip_gpu.mp4 || call :fail
+
+call :section "A movie encoded in parts by several processes is joined into the same frames"
+REM At 60 fps this is 4 parts of 1 second (the last one shorter).
+%HL% run one_part.mp4 %COMMON% || call :fail
+%HL% run parts.mp4 %COMMON% --set encoder_segments=4 --set encoder_segment_length=1 || call :fail
+%HL% diff %MOVIES%\one_part.mp4 %MOVIES%\parts.mp4 || call :fail
+
+call :section "A movie encoded in parts by an encoder worker is the same, and a worker refuses a wrong secret"
+REM The worker starts ffmpeg.exe from its working directory, which has the stand-in.
+set WORKER=--set encoder_segment_length=1 --set encoder_workers=127.0.0.1:27760
+pushd bin\headless_standin
+start "" /b svr_encoder.exe --worker 127.0.0.1:27760 headless_secret
+popd
+REM Give the worker a moment to start listening.
+ping -n 2 127.0.0.1 > nul
+%HL% run workers.mp4 %COMMON% %WORKER% --set encoder_workers_secret=headless_secret || call :fail
+%HL% diff %MOVIES%\parts.mp4 %MOVIES%\workers.mp4 || call :fail
+%HL% run wrong_secret.mp4 %COMMON% %WORKER% --set encoder_workers_secret=wrong_secret && call :fail
+findstr /c:"did not take the secret" bin\headless_standin\data\SVR_LOG.txt > nul || call :fail
+taskkill /im svr_encoder.exe /f > nul
+
+call :section "Frames that wait for a slow encoder in other ways are the same"
+REM The stand-in reads slowly so that the frames have to wait. The log says how many were spilled and how much of the queue was used.
+%HL% run spill.mp4 %COMMON% --standin-rate 10 --set encoder_spill_size=64 || call :fail
+%HL% diff %MOVIES%\one_part.mp4 %MOVIES%\spill.mp4 || call :fail
+%HL% run compressed.mp4 %COMMON% --standin-rate 10 --set encoder_compressed_queue=64 || call :fail
+%HL% diff %MOVIES%\one_part.mp4 %MOVIES%\compressed.mp4 || call :fail
+%HL% run small_buffer.mp4 %COMMON% --standin-rate 10 --set encoder_buffer_size=1 || call :fail
+%HL% diff %MOVIES%\one_part.mp4 %MOVIES%\small_buffer.mp4 || call :fail
+
+call :section "A movie that continues in new files is the same when they are joined"
+REM 200 frames in files of 60 frames. The stand-in writes raw frames, so the files can be joined by copying them together.
+%HL% run rotate.mp4 %COMMON% --rotate 60 || call :fail
+copy /b /y %MOVIES%\rotate.mp4 + %MOVIES%\r1_rotate.mp4 + %MOVIES%\r2_rotate.mp4 + %MOVIES%\r3_rotate.mp4 %MOVIES%\rotate_joined.mp4 > nul || call :fail
+%HL% diff %MOVIES%\one_part.mp4 %MOVIES%\rotate_joined.mp4 || call :fail
+
+call :section "A captured movie that is encoded later by svr_encoder.exe has the same video and audio"
+%HL% run direct.mp4 %COMMON% --audio || call :fail
+%HL% run captured.mp4 %COMMON% --audio --set encoder_intermediate=1 || call :fail
+REM The transcoder starts ffmpeg.exe from the working directory, which has the stand-in.
+pushd bin\headless_standin
+svr_encoder.exe --transcode 3 "%CD%\movies\captured.mp4.svrc" || call :fail
+popd
+%HL% diff %MOVIES%\direct.mp4 %MOVIES%\captured.mp4 || call :fail
+%HL% diff %MOVIES%\direct.mp4.aud %MOVIES%\captured.mp4.aud || call :fail
+
+call :section "Movies that go to ffmpeg processes started ahead of time are the same"
+REM The second and third movie get a warm ffmpeg. The time to the first frame is in the log ("Starting warm ffmpeg took").
+%HL% run cold.mp4 %COMMON% --movies 3 || call :fail
+%HL% run warm.mp4 %COMMON% --movies 3 --set encoder_prewarm=1 || call :fail
+%HL% diff %MOVIES%\cold.mp4 %MOVIES%\warm.mp4 || call :fail
+%HL% diff %MOVIES%\m2_cold.mp4 %MOVIES%\m2_warm.mp4 || call :fail
+%HL% diff %MOVIES%\m3_cold.mp4 %MOVIES%\m3_warm.mp4 || call :fail
+
+call :section "Movies that are finished in the background at the same time are the same"
+REM The frames wait in a large buffer for the slow stand-in, so two movies are still being finished when the third one starts.
+%HL% run finalize.mp4 %COMMON% --movies 3 --standin-rate 10 --set encoder_buffer_size=64 --set encoder_max_finalizing=2 || call :fail
+%HL% diff %MOVIES%\one_part.mp4 %MOVIES%\finalize.mp4 || call :fail
+%HL% diff %MOVIES%\one_part.mp4 %MOVIES%\m2_finalize.mp4 || call :fail
+%HL% diff %MOVIES%\one_part.mp4 %MOVIES%\m3_finalize.mp4 || call :fail
+
+if /I not "%~1"=="real" goto skip_real
+
+call :section "Movies with audio from the real ffmpeg have both streams and decode without errors"
+set REAL=--size 1280x720 --frames 300 --audio
+%HL% run real_audio.mp4 %REAL% || call :fail
+%HL% run real_rotate.mp4 %REAL% --rotate 100 || call :fail
+bin\ffmpeg.exe -hide_banner -v error -xerror -i bin\headless\movies\real_audio.mp4 -map 0:v -map 0:a -f null - || call :fail
+bin\ffmpeg.exe -hide_banner -v error -xerror -i bin\headless\movies\real_rotate.mp4 -map 0:v -map 0:a -f null - || call :fail
+bin\ffmpeg.exe -hide_banner -v error -xerror -i bin\headless\movies\r1_real_rotate.mp4 -map 0:v -map 0:a -f null - || call :fail
+bin\ffmpeg.exe -hide_banner -v error -xerror -i bin\headless\movies\r2_real_rotate.mp4 -map 0:v -map 0:a -f null - || call :fail
+
+:skip_real
+
+echo.
+echo %FAILS% steps failed
+exit /b %FAILS%
+
+:section
+echo.
+echo == %~1
+exit /b 0
+
+:fail
+set /a FAILS+=1
+echo FAILED
+exit /b 0